@@ -7,7 +7,7 @@
 (defmacro dolist (list . body)
   `(do () ((list))
      (set! list (cdr list))
-     (let (%current (car list))
+     (let ((%current (car list)))
        ,@body)))
 
 (define x 0)
@@ -126,7 +126,24 @@ libffi_call (int argc, Scheme_Value argv[])
   av = (void **) scheme_malloc(sizeof(void *) * num_av);
   for ( i=0 ; i<num_av ; ++i )
     {
-      av[i] = &argv[2 + i]->u;
+      Scheme_Value arg = argv[2 + i];
+      if (SCHEME_INTP (arg))
+	{
+	  /* immediates have no storage to point into */
+	  int *ip = (int *) scheme_malloc_atomic (sizeof (int));
+	  *ip = SCHEME_INT_VAL (arg);
+	  av[i] = ip;
+	}
+      else if (SCHEME_CHARP (arg))
+	{
+	  char *cp = (char *) scheme_malloc_atomic (sizeof (char));
+	  *cp = SCHEME_CHAR_VAL (arg);
+	  av[i] = cp;
+	}
+      else
+	{
+	  av[i] = &arg->u;
+	}
     }
   /* allocate return value */
   rv = scheme_malloc(sizeof(Scheme_Object));
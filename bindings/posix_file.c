@@ -344,7 +344,7 @@ posix_stat (int argc, Scheme_Value argv[])
   SCHEME_ASSERT ((argc == 1), "posix-stat: wrong number of args");
   SCHEME_ASSERT (SCHEME_STRINGP(argv[0]), "posix-stat: arg must be a string");
   path = SCHEME_STR_VAL (argv[0]);
-  s = scheme_malloc (sizeof (struct stat));
+  s = scheme_malloc_atomic (sizeof (struct stat));
   if (stat (path, s) != 0)
     {
       scheme_signal_error ("posix-stat: could not stat file: %s", path);
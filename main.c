@@ -28,6 +28,7 @@
 #include "libffi.h"
 
 #include <stdio.h>
+#include <string.h>
 
 void load_file(Scheme_Env *env, const char *path) {
   Scheme_Value in_port, obj;
@@ -46,7 +47,7 @@ void load_file(Scheme_Env *env, const char *path) {
       in_port = scheme_make_input_port (fp);
       while ((obj = scheme_read (in_port)) != scheme_eof)
         {
-          obj = SCHEME_CATCH_ERROR (scheme_eval (obj, env), 0);
+          obj = SCHEME_CATCH_ERROR (scheme_eval (scheme_freeze_literals (obj), env), 0);
         }
       scheme_close_input_port (in_port);
     }
@@ -63,7 +64,7 @@ void read_eval_print(Scheme_Env *env) {
           printf ("\n; done\n");
           exit (0);
         }
-      obj = SCHEME_CATCH_ERROR(scheme_eval (obj, env), 0);
+      obj = SCHEME_CATCH_ERROR(scheme_eval (scheme_freeze_literals (obj), env), 0);
       if (obj)
         {
           scheme_write (obj, scheme_stdout_port);
@@ -85,9 +86,22 @@ main(int argc, char *argv[])
   scheme_init_libdl(env);
   scheme_init_libffi(env);
 
-  /* load any files given on the command line */
+  /* load any files given on the command line, `-b' selects
+     the bytecode engine for the files after it and `-i' loads
+     an image saved with save-image */
   for ( i=1 ; i<argc ; ++i )
     {
+      if (strcmp (argv[i], "-b") == 0)
+        {
+          scheme_engine = SCHEME_BYTECODE_ENGINE;
+          continue;
+        }
+      if (strcmp (argv[i], "-i") == 0 && i + 1 < argc)
+        {
+          SCHEME_CATCH_ERROR ((scheme_load_image (argv[i + 1], env), 0), 0);
+          ++i;
+          continue;
+        }
       load_file(env, argv[i]);
     }
 
@@ -1,5 +1,15 @@
 
 (load "test.scm")
 (test-sc4)
+(test-tail-calls)
+(test-late-syntax)
+(test-modules)
+(test-clones)
+(test-freeze)
+(test-parallel)
+(test-futures)
+(test-channels)
+(test-image)
+(test-tables)
 
 (exit)
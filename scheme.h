@@ -29,6 +29,8 @@
 #include <setjmp.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -54,64 +56,200 @@ extern "C"
 struct Scheme_Object;
 struct Scheme_Env;
 struct Scheme_Cont;
+struct Scheme_Node;
+struct Scheme_Lambda;
 
 /* struct typedefs */
 typedef struct Scheme_Object Scheme_Object;
 typedef struct Scheme_Env Scheme_Env;
 typedef struct Scheme_Cont Scheme_Cont;
+typedef struct Scheme_Context Scheme_Context;
 
 /* pointer types */
 typedef struct Scheme_Object * Scheme_Value;
 
 /* function types */
 typedef Scheme_Value (Scheme_Prim) (int argc, Scheme_Value argv[]);
+typedef Scheme_Value (Scheme_Prim1) (Scheme_Value a);
+typedef Scheme_Value (Scheme_Prim2) (Scheme_Value a, Scheme_Value b);
+typedef Scheme_Value (Scheme_Prim3) (Scheme_Value a, Scheme_Value b, Scheme_Value c);
 typedef Scheme_Value (Scheme_Syntax) (Scheme_Value form, struct Scheme_Env *env);
+typedef struct Scheme_Node *(Scheme_Analyzer) (Scheme_Value form, struct Scheme_Env *env, int tail);
 
 /* struct types */
+
+/* A primitive's entry points.  FUN takes any number of arguments in
+   an array and may be NULL when the entries for a fixed number of
+   arguments cover the arity.  The arity is checked before either is
+   called; MAXA is -1 for no limit. */
+typedef struct Scheme_Prim_Desc
+{
+  char *name;
+  Scheme_Prim *fun;
+  int mina, maxa;
+  Scheme_Prim1 *prim1;
+  Scheme_Prim2 *prim2;
+  Scheme_Prim3 *prim3;
+} Scheme_Prim_Desc;
+
+/* The header word holds the index of the object's type in
+   scheme_type_table above SCHEME_HDR_SHIFT and flag bits below it.
+   Objects are allocated only as large as the union member they use
+   (see scheme_alloc_sized), so the union must come last. */
 struct Scheme_Object
 {
+  uintptr_t header;
   union
     {
-      char char_val;
-      int int_val;
       double double_val;
       char *string_val;
+      struct { char *name; int index; } type_val;
+      struct { char *name; int len; unsigned int hash; } symbol_val;
       void *ptr_val;
       struct Scheme_Cont *cont_val;
       struct { void *ptr1, *ptr2; } two_ptr_val;
-      Scheme_Value (*prim_val) (int argc, Scheme_Value argv[]);
-      Scheme_Value (*syntax_val) (Scheme_Value form, struct Scheme_Env *env);
+      const Scheme_Prim_Desc *prim_val;
+      struct { Scheme_Syntax *proc; Scheme_Analyzer *analyzer; } syntax_val;
       struct { Scheme_Value car, cdr; } pair_val;
       struct { int size; Scheme_Value *els; } vector_val;
-      struct { struct Scheme_Env *env; Scheme_Value code; } closure_val;
+      struct { struct Scheme_Env *env; struct Scheme_Lambda *lambda; } closure_val;
       struct { Scheme_Value def; struct Scheme_Method *meths; } methods_val;
 
     } u;
-  Scheme_Value type;
 };
 
+/* Fixnums and characters are immediates: a value with the low bit
+   set is an integer shifted left by one, a value whose low two bits
+   are 10 is a character shifted left by two.  Everything else is a
+   pointer to a Scheme_Object.  SCHEME_OBJ_TYPE may only be applied to
+   the latter.  Neither it nor SCHEME_TYPE can be assigned to: the
+   type of an object is given to scheme_alloc_object, or set with
+   SCHEME_SET_TYPE on one allocated otherwise. */
+#define SCHEME_FIXNUM_TAG    1
+#define SCHEME_CHAR_TAG      2
+#define SCHEME_TAG_MASK      3
+#define SCHEME_IMMEDIATEP(obj) (((uintptr_t) (obj)) & SCHEME_TAG_MASK)
+#define SCHEME_MAKE_FIXNUM(i) \
+  ((Scheme_Value) ((((uintptr_t) (intptr_t) (i)) << 1) | SCHEME_FIXNUM_TAG))
+#define SCHEME_MAKE_CHAR(c) \
+  ((Scheme_Value) ((((uintptr_t) (unsigned char) (c)) << 2) | SCHEME_CHAR_TAG))
+
+/* header word */
+#define SCHEME_HDR_SHIFT     8
+#define SCHEME_HDR_FLAGS(obj) ((obj)->header & ((1 << SCHEME_HDR_SHIFT) - 1))
+#define SCHEME_TYPE_INDEX(obj) ((obj)->header >> SCHEME_HDR_SHIFT)
+#define SCHEME_TYPE_NUM(type) ((type)->u.type_val.index)
+#define SCHEME_SET_TYPE(obj, type) \
+  ((obj)->header = (uintptr_t) SCHEME_TYPE_NUM (type) << SCHEME_HDR_SHIFT)
+/* flags of a type object: its instances are made by define-struct */
+#define SCHEME_STRUCT_TYPE_FLAG 1
+/* flags of any object: neither it nor anything it refers to may be
+   changed, see scheme_freeze */
+#define SCHEME_FROZEN_FLAG 2
+#define SCHEME_FROZENP(obj) (SCHEME_HDR_FLAGS (obj) & SCHEME_FROZEN_FLAG)
+
+/* size of an object that uses union member FIELD, and the address
+   just past it where variable-length data is placed */
+#define SCHEME_OBJ_SIZE(field) \
+  (offsetof (Scheme_Object, u) + sizeof (((Scheme_Object *) 0)->u.field))
+#define SCHEME_OBJ_PAYLOAD(obj, field) ((void *) ((char *) (obj) + SCHEME_OBJ_SIZE (field)))
+
 /* access macros */
-#define SCHEME_TYPE(obj)     ((obj)->type)
-#define SCHEME_CHAR_VAL(obj) ((obj)->u.char_val)
-#define SCHEME_INT_VAL(obj)  ((obj)->u.int_val)
+#define SCHEME_OBJ_TYPE(obj) ((Scheme_Value) scheme_type_table[SCHEME_TYPE_INDEX (obj)])
+#define SCHEME_TYPE(obj) \
+  (SCHEME_IMMEDIATEP(obj) \
+   ? (SCHEME_INTP(obj) ? scheme_integer_type : scheme_char_type) \
+   : SCHEME_OBJ_TYPE(obj))
+#define SCHEME_HAS_TYPE(obj, t) \
+  (!SCHEME_IMMEDIATEP(obj) && SCHEME_TYPE_INDEX(obj) == (uintptr_t) SCHEME_TYPE_NUM(t))
+#define SCHEME_HAS_TYPE_INDEX(obj, i) \
+  (!SCHEME_IMMEDIATEP(obj) && SCHEME_TYPE_INDEX(obj) == (i))
+#define SCHEME_CHAR_VAL(obj) ((char) (((uintptr_t) (obj)) >> 2))
+#define SCHEME_INT_VAL(obj)  ((int) (((intptr_t) (obj)) >> 1))
 #define SCHEME_DBL_VAL(obj)  ((obj)->u.double_val)
 #define SCHEME_STR_VAL(obj)  ((obj)->u.string_val)
 #define SCHEME_PTR_VAL(obj)  ((obj)->u.ptr_val)
+#define SCHEME_SYM_LEN(obj)  ((obj)->u.symbol_val.len)
+#define SCHEME_SYM_HASH(obj) ((obj)->u.symbol_val.hash)
 #define SCHEME_CONT_VAL(obj) ((obj)->u.cont_val)
+#define SCHEME_ENV_VAL(obj)  ((Scheme_Env *) (obj)->u.ptr_val)
 #define SCHEME_PTR1_VAL(obj) ((obj)->u.two_ptr_val.ptr1)
 #define SCHEME_PTR2_VAL(obj) ((obj)->u.two_ptr_val.ptr2)
-#define SCHEME_SYNTAX(obj)   ((obj)->u.syntax_val)
-#define SCHEME_PRIM(obj)     ((obj)->u.prim_val)
+#define SCHEME_SYNTAX(obj)   ((obj)->u.syntax_val.proc)
+#define SCHEME_SYNTAX_ANALYZER(obj) ((obj)->u.syntax_val.analyzer)
+#define SCHEME_PRIM(obj)     ((obj)->u.prim_val->fun)
+#define SCHEME_PRIM_DESC(obj) ((obj)->u.prim_val)
 #define SCHEME_CAR(obj)      ((obj)->u.pair_val.car)
 #define SCHEME_CDR(obj)      ((obj)->u.pair_val.cdr)
 #define SCHEME_VEC_SIZE(obj) ((obj)->u.vector_val.size)
 #define SCHEME_VEC_ELS(obj)  ((obj)->u.vector_val.els)
 #define SCHEME_CLOS_ENV(obj) ((obj)->u.closure_val.env)
-#define SCHEME_CLOS_CODE(obj)((obj)->u.closure_val.code)
+#define SCHEME_CLOS_LAMBDA(obj) ((obj)->u.closure_val.lambda)
 #define SCHEME_METH_DEF(obj) ((obj)->u.methods_val.def)
 #define SCHEME_METHS(obj)    ((obj)->u.methods_val.meths)
 
+/* indices of the builtin types in scheme_type_table */
+enum
+{
+  SCHEME_TYPE_TYPE_INDEX,
+  SCHEME_INTEGER_TYPE_INDEX,
+  SCHEME_CHAR_TYPE_INDEX,
+  SCHEME_DOUBLE_TYPE_INDEX,
+  SCHEME_STRING_TYPE_INDEX,
+  SCHEME_SYMBOL_TYPE_INDEX,
+  SCHEME_NULL_TYPE_INDEX,
+  SCHEME_PAIR_TYPE_INDEX,
+  SCHEME_VECTOR_TYPE_INDEX,
+  SCHEME_PRIM_TYPE_INDEX,
+  SCHEME_CLOSURE_TYPE_INDEX,
+  SCHEME_CONT_TYPE_INDEX,
+  SCHEME_INPUT_PORT_TYPE_INDEX,
+  SCHEME_OUTPUT_PORT_TYPE_INDEX,
+  SCHEME_EOF_TYPE_INDEX,
+  SCHEME_TRUE_TYPE_INDEX,
+  SCHEME_FALSE_TYPE_INDEX,
+  SCHEME_SYNTAX_TYPE_INDEX,
+  SCHEME_MACRO_TYPE_INDEX,
+  SCHEME_PROMISE_TYPE_INDEX,
+  SCHEME_STRUCT_PROC_TYPE_INDEX,
+  SCHEME_POINTER_TYPE_INDEX,
+  SCHEME_COMPILED_TYPE_INDEX,
+  SCHEME_HASH_TABLE_TYPE_INDEX,
+  SCHEME_ENVIRONMENT_TYPE_INDEX,
+  SCHEME_FUTURE_TYPE_INDEX,
+  SCHEME_CHANNEL_TYPE_INDEX,
+  SCHEME_NUM_BUILTIN_TYPES
+};
+
+/* An object whose header is set at compile time, for builtin objects
+   in static storage that need no allocation. */
+#define SCHEME_STATIC_HEADER(index) ((uintptr_t) (index) << SCHEME_HDR_SHIFT)
+
+/* A primitive in a static table for scheme_add_prims: the object
+   points at a descriptor in static storage too, so the table can be
+   const and registering it allocates nothing.  The name must be in
+   lower case. */
+typedef Scheme_Object Scheme_Prim_Entry;
+
+#define SCHEME_PRIM_OBJECT(name, fun, mina, maxa, fun1, fun2, fun3) \
+  { SCHEME_STATIC_HEADER (SCHEME_PRIM_TYPE_INDEX), \
+    { .prim_val = &(const Scheme_Prim_Desc) { name, fun, mina, maxa, fun1, fun2, fun3 } } }
+#define SCHEME_PRIM_ENTRY(name, fun, mina, maxa) \
+  SCHEME_PRIM_OBJECT (name, fun, mina, maxa, NULL, NULL, NULL)
+#define SCHEME_PRIM1_ENTRY(name, fun) \
+  SCHEME_PRIM_OBJECT (name, NULL, 1, 1, fun, NULL, NULL)
+#define SCHEME_PRIM2_ENTRY(name, fun) \
+  SCHEME_PRIM_OBJECT (name, NULL, 2, 2, NULL, fun, NULL)
+#define SCHEME_PRIM3_ENTRY(name, fun) \
+  SCHEME_PRIM_OBJECT (name, NULL, 3, 3, NULL, NULL, fun)
+/* an n-ary primitive with a direct entry for two args */
+#define SCHEME_PRIMN2_ENTRY(name, fun, mina, fun2) \
+  SCHEME_PRIM_OBJECT (name, fun, mina, -1, NULL, fun2, NULL)
+#define SCHEME_NUM_ENTRIES(table) ((int) (sizeof (table) / sizeof ((table)[0])))
+
 /* types */
+extern Scheme_Value *scheme_type_table;
+extern int scheme_num_types;
 extern Scheme_Value scheme_type_type;
 extern Scheme_Value scheme_char_type;
 extern Scheme_Value scheme_integer_type;
@@ -134,6 +272,11 @@ extern Scheme_Value scheme_macro_type;
 extern Scheme_Value scheme_promise_type;
 extern Scheme_Value scheme_struct_proc_type;
 extern Scheme_Value scheme_pointer_type;
+extern Scheme_Value scheme_compiled_type;
+extern Scheme_Value scheme_hash_table_type;
+extern Scheme_Value scheme_environment_type;
+extern Scheme_Value scheme_future_type;
+extern Scheme_Value scheme_channel_type;
 
 /* symbols */
 extern Scheme_Value scheme_quote_symbol;
@@ -147,43 +290,120 @@ extern Scheme_Value scheme_null;
 extern Scheme_Value scheme_true;
 extern Scheme_Value scheme_false;
 
-/* globals */
-extern Scheme_Env *scheme_env;
-extern jmp_buf scheme_error_buf;
+/* globals.  scheme_env and scheme_error_buf belong to the context
+   the calling thread runs in, see scheme_make_context. */
+#define scheme_env (*scheme_context_env ())
+#define scheme_error_buf (*scheme_context_error_buf ())
 extern Scheme_Value scheme_stdin_port;
 extern Scheme_Value scheme_stdout_port;
 extern Scheme_Value scheme_stderr_port;
 
+/* engines for scheme_eval */
+#define SCHEME_TREE_ENGINE     0
+#define SCHEME_BYTECODE_ENGINE 1
+extern int scheme_engine;
+
+/* contexts: the state of one interpreter.  Built with SCHEME_THREADS
+   several threads may run at once, each in a context of its own. */
+Scheme_Context *scheme_make_context (Scheme_Env *env);
+void scheme_free_context (Scheme_Context *context);
+Scheme_Context *scheme_current_context (void);
+Scheme_Context *scheme_set_context (Scheme_Context *context);
+void scheme_attach_thread (Scheme_Context *context);
+void scheme_detach_thread (void);
+Scheme_Env **scheme_context_env (void);
+jmp_buf *scheme_context_error_buf (void);
+
 /* environment */
 Scheme_Env *scheme_basic_env (void);
+Scheme_Env *scheme_make_module_env (Scheme_Env *base);
+Scheme_Env *scheme_clone_env (Scheme_Env *env);
+void scheme_import_global (Scheme_Value symbol, Scheme_Env *from, Scheme_Env *to);
 void scheme_add_global (char *name, Scheme_Value val, Scheme_Env *env);
 void scheme_add_prim (char *name, Scheme_Prim *prim, Scheme_Env *env);
+void scheme_add_prim_arity (char *name, Scheme_Prim *prim, int mina, int maxa, Scheme_Env *env);
+void scheme_add_prim1 (char *name, Scheme_Prim1 *prim, Scheme_Env *env);
+void scheme_add_prim2 (char *name, Scheme_Prim2 *prim, Scheme_Env *env);
+void scheme_add_prim3 (char *name, Scheme_Prim3 *prim, Scheme_Env *env);
+void scheme_add_prim_desc (Scheme_Prim_Desc *desc, Scheme_Env *env);
+void scheme_add_prims (const Scheme_Prim_Entry *prims, int num_prims, Scheme_Env *env);
 void scheme_set_value (Scheme_Value var, Scheme_Value val, Scheme_Env *env);
 Scheme_Value scheme_lookup_value (Scheme_Value symbol, Scheme_Env *env);
 Scheme_Value scheme_lookup_global (Scheme_Value symbol, Scheme_Env *env);
 
 /* constructors */
 Scheme_Value scheme_make_type (const char *name);
+Scheme_Value scheme_make_builtin_type (const char *name, int index);
 Scheme_Value scheme_make_string (const char *chars);
 Scheme_Value scheme_alloc_string (int size, char fill);
 Scheme_Value scheme_make_integer (int i);
 Scheme_Value scheme_make_double (double d);
 Scheme_Value scheme_make_char (char ch);
 Scheme_Value scheme_make_syntax (Scheme_Syntax *syntax);
+Scheme_Value scheme_make_syntax_analyzer (Scheme_Analyzer *analyzer);
 Scheme_Value scheme_make_promise (Scheme_Value expr, Scheme_Env *env);
 Scheme_Value scheme_make_pointer (void *ptr);
-
-/* alloc */
+Scheme_Value scheme_make_environment (Scheme_Env *env);
+Scheme_Value scheme_make_channel (int capacity);
+
+/* alloc.  Memory from scheme_malloc is scanned for pointers in full.
+   An atomic allocation holds no pointers the collector must follow and
+   is not cleared; a typed one holds them only in the words its layout
+   marks, SCHEME_LAYOUT_SLOT of each such field or'ed together.  Fixed
+   memory never moves and is atomic.  Memory from scheme_malloc_keys is
+   cleared and scanned in full after its first word, which the
+   collector sets when it moves an object the rest point to, so that
+   code hashing objects by address knows to hash them again. */
+typedef struct Scheme_Layout Scheme_Layout;
+#define SCHEME_LAYOUT_SLOT(type, field) \
+  ((uintptr_t) 1 << (offsetof (type, field) / sizeof (void *)))
 Scheme_Value scheme_alloc_object (Scheme_Value type, size_t nbytes);
+Scheme_Value scheme_alloc_sized (Scheme_Value type, size_t size);
+Scheme_Value scheme_alloc_atomic_object (Scheme_Value type, size_t nbytes);
+Scheme_Value scheme_alloc_atomic_sized (Scheme_Value type, size_t size);
+Scheme_Layout *scheme_make_layout (size_t size, uintptr_t bitmap);
 SCHEME_FUN_MALLOC void *scheme_malloc (size_t size);
 SCHEME_FUN_MALLOC void *scheme_calloc (size_t num, size_t size);
+SCHEME_FUN_MALLOC void *scheme_malloc_atomic (size_t size);
+SCHEME_FUN_MALLOC void *scheme_malloc_typed (size_t size, Scheme_Layout *layout);
 SCHEME_FUN_MALLOC char *scheme_strdup (char *str);
+SCHEME_FUN_MALLOC void *scheme_malloc_fixed (size_t size);
+SCHEME_FUN_MALLOC void *scheme_malloc_keys (size_t size);
+
+/* garbage collection.  Under PRECISE_GC a store into an object that
+   was not just allocated must be followed by SCHEME_GC_WRITE on the
+   slot, so that the collector finds old objects pointing to new ones. */
+void scheme_gc_collect (int major);
+void scheme_gc_add_roots (void *start, void *end);
+void scheme_gc_remove_roots (void *start, void *end);
+void scheme_gc_write (void *slot);
+#ifdef PRECISE_GC
+#define SCHEME_GC_WRITE(slot) scheme_gc_write ((void *) (slot))
+#else
+#define SCHEME_GC_WRITE(slot) ((void) 0)
+#endif
+
+/* heap images */
+void scheme_save_image (const char *path, Scheme_Env *env);
+void scheme_load_image (const char *path, Scheme_Env *env);
 
 /* bool */
 SCHEME_FUN_CONST int scheme_eq (Scheme_Value obj1, Scheme_Value obj2);
 SCHEME_FUN_PURE  int scheme_eqv (Scheme_Value obj1, Scheme_Value obj2);
 SCHEME_FUN_PURE  int scheme_equal (Scheme_Value obj1, Scheme_Value obj2);
 
+/* hash tables */
+unsigned int scheme_equal_hash (Scheme_Value obj, int *by_address);
+
+/* frozen data */
+Scheme_Value scheme_freeze (Scheme_Value obj);
+Scheme_Value scheme_freeze_literals (Scheme_Value form);
+int scheme_frozenp (Scheme_Value obj);
+
+/* compile */
+Scheme_Value scheme_compile (Scheme_Value obj, Scheme_Env *env);
+Scheme_Value scheme_execute (Scheme_Value code, Scheme_Env *env);
+
 /* error */
 SCHEME_FUN_NORETURN void scheme_signal_error (char *msg, ...);
 void scheme_warning (char *msg, ...);
@@ -194,9 +414,11 @@ Scheme_Value scheme_eval (Scheme_Value obj, Scheme_Env *env);
 
 /* fun */
 Scheme_Value scheme_make_prim (Scheme_Prim *prim);
+Scheme_Value scheme_make_prim_desc (Scheme_Prim_Desc *desc);
 Scheme_Value scheme_make_closure (Scheme_Env *env, Scheme_Value code);
 Scheme_Value scheme_make_cont (void);
 Scheme_Value scheme_apply (Scheme_Value rator, int num_rands, Scheme_Value *rands);
+Scheme_Value scheme_apply_prim (Scheme_Value prim, int num_rands, Scheme_Value *rands);
 Scheme_Value scheme_apply_to_list (Scheme_Value rator, Scheme_Value rands);
 Scheme_Value scheme_apply_struct_proc (Scheme_Value rator, Scheme_Value rands);
 
@@ -230,6 +452,7 @@ Scheme_Value scheme_read (Scheme_Value port);
 
 /* symbol */
 Scheme_Value scheme_intern_symbol (char *name);
+Scheme_Value scheme_intern_symbol_n (const char *name, int len);
 
 /* vector */
 Scheme_Value scheme_make_vector (int size, Scheme_Value fill);
@@ -237,30 +460,36 @@ Scheme_Value scheme_list_to_vector (Scheme_Value list);
 Scheme_Value scheme_vector_to_list (Scheme_Value vec);
 
 /* type macros */
-#define SCHEME_CHARP(obj)    (SCHEME_TYPE(obj) == scheme_char_type)
-#define SCHEME_INTP(obj)     (SCHEME_TYPE(obj) == scheme_integer_type)
-#define SCHEME_DBLP(obj)     (SCHEME_TYPE(obj) == scheme_double_type)
+#define SCHEME_CHARP(obj)    ((((uintptr_t) (obj)) & SCHEME_TAG_MASK) == SCHEME_CHAR_TAG)
+#define SCHEME_INTP(obj)     (((uintptr_t) (obj)) & SCHEME_FIXNUM_TAG)
+#define SCHEME_DBLP(obj)     SCHEME_HAS_TYPE_INDEX(obj, SCHEME_DOUBLE_TYPE_INDEX)
 #define SCHEME_NUMBERP(obj)  (SCHEME_INTP(obj) || SCHEME_DBLP(obj))
-#define SCHEME_STRINGP(obj)  (SCHEME_TYPE(obj) == scheme_string_type)
-#define SCHEME_SYMBOLP(obj)  (SCHEME_TYPE(obj) == scheme_symbol_type)
+#define SCHEME_STRINGP(obj)  SCHEME_HAS_TYPE_INDEX(obj, SCHEME_STRING_TYPE_INDEX)
+#define SCHEME_SYMBOLP(obj)  SCHEME_HAS_TYPE_INDEX(obj, SCHEME_SYMBOL_TYPE_INDEX)
 #define SCHEME_BOOLP(obj)    ((obj == scheme_true) || (obj == scheme_false))
 #define SCHEME_TRUEP(obj)    (obj == scheme_true)
 #define SCHEME_FALSEP(obj)   (obj == scheme_false)
-#define SCHEME_SYNTAXP(obj)  (SCHEME_TYPE(obj) == scheme_syntax_type)
-#define SCHEME_PRIMP(obj)    (SCHEME_TYPE(obj) == scheme_prim_type)
-#define SCHEME_CONTP(obj)    (SCHEME_TYPE(obj) == scheme_cont_type)
+#define SCHEME_SYNTAXP(obj)  SCHEME_HAS_TYPE_INDEX(obj, SCHEME_SYNTAX_TYPE_INDEX)
+#define SCHEME_MACROP(obj)   SCHEME_HAS_TYPE_INDEX(obj, SCHEME_MACRO_TYPE_INDEX)
+#define SCHEME_PRIMP(obj)    SCHEME_HAS_TYPE_INDEX(obj, SCHEME_PRIM_TYPE_INDEX)
+#define SCHEME_CONTP(obj)    SCHEME_HAS_TYPE_INDEX(obj, SCHEME_CONT_TYPE_INDEX)
 #define SCHEME_NULLP(obj)    (obj == scheme_null)
-#define SCHEME_PAIRP(obj)    (SCHEME_TYPE(obj) == scheme_pair_type)
+#define SCHEME_PAIRP(obj)    SCHEME_HAS_TYPE_INDEX(obj, SCHEME_PAIR_TYPE_INDEX)
 #define SCHEME_LISTP(obj)    (SCHEME_NULLP(obj) || SCHEME_PAIRP(obj))
-#define SCHEME_VECTORP(obj)  (SCHEME_TYPE(obj) == scheme_vector_type)
-#define SCHEME_CLOSUREP(obj) (SCHEME_TYPE(obj) == scheme_closure_type)
+#define SCHEME_VECTORP(obj)  SCHEME_HAS_TYPE_INDEX(obj, SCHEME_VECTOR_TYPE_INDEX)
+#define SCHEME_CLOSUREP(obj) SCHEME_HAS_TYPE_INDEX(obj, SCHEME_CLOSURE_TYPE_INDEX)
 #define SCHEME_PROCP(obj)    (SCHEME_PRIMP(obj) || SCHEME_CLOSUREP(obj) || SCHEME_CONTP(obj))
-#define SCHEME_INPORTP(obj)  (SCHEME_TYPE(obj) == scheme_input_port_type)
-#define SCHEME_OUTPORTP(obj) (SCHEME_TYPE(obj) == scheme_output_port_type)
+#define SCHEME_INPORTP(obj)  SCHEME_HAS_TYPE_INDEX(obj, SCHEME_INPUT_PORT_TYPE_INDEX)
+#define SCHEME_OUTPORTP(obj) SCHEME_HAS_TYPE_INDEX(obj, SCHEME_OUTPUT_PORT_TYPE_INDEX)
 #define SCHEME_PORTP(obj)    (SCHEME_INPORTP(obj) || SCHEME_OUTPORTP(obj))
-#define SCHEME_EOFP(obj)     (SCHEME_TYPE(obj) == scheme_eof_type)
-#define SCHEME_PROMP(obj)    (SCHEME_TYPE(obj) == scheme_promise_type)
-#define SCHEME_POINTERP(obj) (SCHEME_TYPE(obj) == scheme_pointer_type)
+#define SCHEME_EOFP(obj)     SCHEME_HAS_TYPE_INDEX(obj, SCHEME_EOF_TYPE_INDEX)
+#define SCHEME_PROMP(obj)    SCHEME_HAS_TYPE_INDEX(obj, SCHEME_PROMISE_TYPE_INDEX)
+#define SCHEME_POINTERP(obj) SCHEME_HAS_TYPE_INDEX(obj, SCHEME_POINTER_TYPE_INDEX)
+#define SCHEME_COMPILEDP(obj) SCHEME_HAS_TYPE_INDEX(obj, SCHEME_COMPILED_TYPE_INDEX)
+#define SCHEME_HASH_TABLEP(obj) SCHEME_HAS_TYPE_INDEX(obj, SCHEME_HASH_TABLE_TYPE_INDEX)
+#define SCHEME_ENVIRONMENTP(obj) SCHEME_HAS_TYPE_INDEX(obj, SCHEME_ENVIRONMENT_TYPE_INDEX)
+#define SCHEME_FUTUREP(obj)  SCHEME_HAS_TYPE_INDEX(obj, SCHEME_FUTURE_TYPE_INDEX)
+#define SCHEME_CHANNELP(obj) SCHEME_HAS_TYPE_INDEX(obj, SCHEME_CHANNEL_TYPE_INDEX)
 
 /* list macros */
 #define SCHEME_CADR(obj)     (SCHEME_CAR (SCHEME_CDR (obj)))
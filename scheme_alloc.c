@@ -22,33 +22,121 @@
   MODIFICATIONS.
 */
 
-#include "scheme.h"
+#include "scheme_private.h"
 #include <string.h>
 
+/* MALLOC_OBJECT and MALLOC_ATOMIC_OBJECT allocate Scheme_Objects,
+   which the precise collector scans by type whatever their layout. */
 #ifdef NO_GC
 #include <stdlib.h>
 #define MALLOC malloc
 #define CALLOC calloc
+#define MALLOC_ATOMIC malloc
+#define MALLOC_TYPED(n,l) malloc (n)
+#define MALLOC_OBJECT malloc
+#define MALLOC_ATOMIC_OBJECT malloc
+#define MALLOC_KEYS(n) calloc (1, (n))
+#elif defined(PRECISE_GC)
+#define MALLOC(n)        scheme_gc_malloc ((n), SCHEME_GC_SCANNED)
+#define CALLOC(n,s)      scheme_gc_malloc ((n) * (s), SCHEME_GC_SCANNED)
+#define MALLOC_ATOMIC(n) scheme_gc_malloc ((n), SCHEME_GC_ATOMIC)
+#define MALLOC_TYPED(n,l) scheme_gc_malloc ((n), SCHEME_GC_TYPED_KIND ((l)->descr))
+#define MALLOC_OBJECT(n) scheme_gc_malloc ((n), SCHEME_GC_OBJECT)
+#define MALLOC_ATOMIC_OBJECT(n) scheme_gc_malloc ((n), SCHEME_GC_OBJECT)
+#define MALLOC_KEYS(n)   scheme_gc_malloc ((n), SCHEME_GC_KEYS)
 #else
+#ifdef SCHEME_THREADS
+#define GC_THREADS
+#endif
 #include <gc.h>
+#include <gc_typed.h>
 #define MALLOC      GC_malloc
 #define CALLOC(n,s) GC_malloc(n*s)
+#define MALLOC_ATOMIC GC_malloc_atomic
+#define MALLOC_TYPED(n,l) GC_malloc_explicitly_typed ((n), (GC_descr) (l)->descr)
+#define MALLOC_OBJECT GC_malloc
+#define MALLOC_ATOMIC_OBJECT GC_malloc_atomic
+#define MALLOC_KEYS GC_malloc
 #endif
 
+/* Allocate an object with NBYTES of data following it, reached
+   through SCHEME_PTR_VAL.  With no data the object gets the full
+   union, since the caller may use any member of it. */
 Scheme_Value
 scheme_alloc_object (Scheme_Value type, size_t nbytes)
 {
   Scheme_Value object;
-  size_t total = sizeof(Scheme_Object) + nbytes;
 
-  object = (Scheme_Value) scheme_malloc (total);
-  SCHEME_TYPE(object) = type;
-  if(nbytes > 0) {
-    SCHEME_PTR_VAL(object) = (void*)&object[1];
+  if(nbytes == 0) {
+    return (scheme_alloc_sized (type, sizeof(Scheme_Object)));
   }
+  object = scheme_alloc_sized (type, SCHEME_OBJ_SIZE (ptr_val) + nbytes);
+  SCHEME_PTR_VAL(object) = SCHEME_OBJ_PAYLOAD (object, ptr_val);
+  return (object);
+}
+
+/* Allocate SIZE bytes, header included, and stamp them with TYPE. */
+Scheme_Value
+scheme_alloc_sized (Scheme_Value type, size_t size)
+{
+  Scheme_Value object;
+
+  object = (Scheme_Value) MALLOC_OBJECT (size);
+  SCHEME_ASSERT ((object != 0), "memory allocation failure");
+  SCHEME_SET_TYPE (object, type);
+  SCHEME_PROFILE (SCHEME_TYPE_NUM (type), size);
+  return (object);
+}
+
+/* The same for objects whose data holds no pointers, other than
+   SCHEME_PTR_VAL to the data itself. */
+Scheme_Value
+scheme_alloc_atomic_object (Scheme_Value type, size_t nbytes)
+{
+  Scheme_Value object;
+
+  object = scheme_alloc_atomic_sized (type, SCHEME_OBJ_SIZE (ptr_val) + nbytes);
+  SCHEME_PTR_VAL(object) = SCHEME_OBJ_PAYLOAD (object, ptr_val);
+  return (object);
+}
+
+Scheme_Value
+scheme_alloc_atomic_sized (Scheme_Value type, size_t size)
+{
+  Scheme_Value object;
+
+  object = (Scheme_Value) MALLOC_ATOMIC_OBJECT (size);
+  SCHEME_ASSERT ((object != 0), "memory allocation failure");
+  SCHEME_SET_TYPE (object, type);
+  SCHEME_PROFILE (SCHEME_TYPE_NUM (type), size);
   return (object);
 }
 
+/* Describe blocks of SIZE bytes holding pointers in the words set in
+   BITMAP, for scheme_malloc_typed. */
+Scheme_Layout *
+scheme_make_layout (size_t size, uintptr_t bitmap)
+{
+  Scheme_Layout *layout;
+
+  SCHEME_ASSERT ((size <= 8 * sizeof (uintptr_t) * sizeof (void *)),
+		 "layout too large for its bitmap");
+  layout = (Scheme_Layout *) scheme_malloc_atomic (sizeof (Scheme_Layout));
+  layout->size = size;
+  layout->bitmap = bitmap;
+#if defined(PRECISE_GC)
+  layout->descr = (uintptr_t) scheme_gc_layout (bitmap);
+#elif !defined(NO_GC)
+  {
+    GC_word bm[1];
+
+    bm[0] = (GC_word) bitmap;
+    layout->descr = (uintptr_t) GC_make_descriptor (bm, (size + sizeof (GC_word) - 1) / sizeof (GC_word));
+  }
+#endif
+  return (layout);
+}
+
 SCHEME_FUN_MALLOC
 void *
 scheme_malloc (size_t size)
@@ -71,6 +159,41 @@ scheme_calloc (size_t num, size_t size)
   return (space);
 }
 
+SCHEME_FUN_MALLOC
+void *
+scheme_malloc_atomic (size_t size)
+{
+  void *space;
+
+  space = MALLOC_ATOMIC (size);
+  SCHEME_ASSERT ((space != 0), "memory allocation failure");
+  return (space);
+}
+
+/* Allocate SIZE bytes laid out as LAYOUT says; any bytes past the
+   layout's own size hold no pointers. */
+SCHEME_FUN_MALLOC
+void *
+scheme_malloc_typed (size_t size, Scheme_Layout *layout)
+{
+  void *space;
+
+  space = MALLOC_TYPED (size, layout);
+  SCHEME_ASSERT ((space != 0), "memory allocation failure");
+  return (space);
+}
+
+SCHEME_FUN_MALLOC
+void *
+scheme_malloc_keys (size_t size)
+{
+  void *space;
+
+  space = MALLOC_KEYS (size);
+  SCHEME_ASSERT ((space != 0), "memory allocation failure");
+  return (space);
+}
+
 SCHEME_FUN_MALLOC
 char *
 scheme_strdup (char *str)
@@ -79,8 +202,80 @@ scheme_strdup (char *str)
   size_t len = strlen(str);
   size_t space = len + 1;
 
-  new = scheme_malloc (space);
+  new = scheme_malloc_atomic (space);
   strncpy (new, str, space);
   new[len] = 0;
   return (new);
 }
+
+#ifndef PRECISE_GC
+
+SCHEME_FUN_MALLOC
+void *
+scheme_malloc_fixed (size_t size)
+{
+  return (scheme_malloc_atomic (size));
+}
+
+void
+scheme_gc_collect (int major)
+{
+#ifndef NO_GC
+  GC_gcollect ();
+#endif
+}
+
+void
+scheme_gc_add_roots (void *start, void *end)
+{
+#ifndef NO_GC
+  GC_add_roots (start, end);
+#endif
+}
+
+void
+scheme_gc_remove_roots (void *start, void *end)
+{
+#ifndef NO_GC
+  GC_remove_roots (start, end);
+#endif
+}
+
+void
+scheme_gc_write (void *slot)
+{
+}
+
+#ifdef SCHEME_THREADS
+
+void
+scheme_gc_init_threads (void)
+{
+#ifndef NO_GC
+  GC_allow_register_threads ();
+#endif
+}
+
+void
+scheme_gc_register_thread (void)
+{
+#ifndef NO_GC
+  struct GC_stack_base base;
+
+  SCHEME_ASSERT ((GC_get_stack_base (&base) == GC_SUCCESS),
+		 "cannot find the stack of a new thread");
+  GC_register_my_thread (&base);
+#endif
+}
+
+void
+scheme_gc_unregister_thread (void)
+{
+#ifndef NO_GC
+  GC_unregister_my_thread ();
+#endif
+}
+
+#endif /* SCHEME_THREADS */
+
+#endif /* !PRECISE_GC */
@@ -25,39 +25,46 @@
 #include "scheme.h"
 #include <string.h>
 
+/* the booleans are static objects */
+static Scheme_Object true_object = { SCHEME_STATIC_HEADER (SCHEME_TRUE_TYPE_INDEX), { 0 } };
+static Scheme_Object false_object = { SCHEME_STATIC_HEADER (SCHEME_FALSE_TYPE_INDEX), { 0 } };
+
 /* globals */
-Scheme_Value scheme_true;
-Scheme_Value scheme_false;
+Scheme_Value scheme_true = &true_object;
+Scheme_Value scheme_false = &false_object;
 Scheme_Value scheme_true_type;
 Scheme_Value scheme_false_type;
 
 /* primitive declarations */
-static Scheme_Value not_prim (int argc, Scheme_Value argv[]);
-static Scheme_Value boolean_p_prim (int argc, Scheme_Value argv[]);
-static Scheme_Value eq_prim (int argc, Scheme_Value argv[]);
-static Scheme_Value eqv_prim (int argc, Scheme_Value argv[]);
-static Scheme_Value equal_prim (int argc, Scheme_Value argv[]);
+static Scheme_Value not_prim (Scheme_Value obj);
+static Scheme_Value boolean_p_prim (Scheme_Value obj);
+static Scheme_Value eq_prim (Scheme_Value obj1, Scheme_Value obj2);
+static Scheme_Value eqv_prim (Scheme_Value obj1, Scheme_Value obj2);
+static Scheme_Value equal_prim (Scheme_Value obj1, Scheme_Value obj2);
 
 /* internal declarations */
 static int list_equal (Scheme_Value lst1, Scheme_Value lst2);
 static int vector_equal (Scheme_Value vec1, Scheme_Value vec2);
 
+static const Scheme_Prim_Entry bool_prims[] =
+{
+  SCHEME_PRIM1_ENTRY ("not", not_prim),
+  SCHEME_PRIM1_ENTRY ("boolean?", boolean_p_prim),
+  SCHEME_PRIM2_ENTRY ("eq?", eq_prim),
+  SCHEME_PRIM2_ENTRY ("eqv?", eqv_prim),
+  SCHEME_PRIM2_ENTRY ("equal?", equal_prim)
+};
+
 /* exported functions */
 
 void
 scheme_init_bool (Scheme_Env *env)
 {
-  scheme_true_type = scheme_make_type ("<true>");
-  scheme_false_type = scheme_make_type ("<false>");
+  scheme_true_type = scheme_make_builtin_type ("<true>", SCHEME_TRUE_TYPE_INDEX);
+  scheme_false_type = scheme_make_builtin_type ("<false>", SCHEME_FALSE_TYPE_INDEX);
   scheme_add_global ("<true>", scheme_true_type, env);
   scheme_add_global ("<false>", scheme_false_type, env);
-  scheme_true = scheme_alloc_object(scheme_true_type, 0);
-  scheme_false = scheme_alloc_object(scheme_false_type, 0);
-  scheme_add_prim ("not", not_prim, env);
-  scheme_add_prim ("boolean?", boolean_p_prim, env);
-  scheme_add_prim ("eq?", eq_prim, env);
-  scheme_add_prim ("eqv?", eqv_prim, env);
-  scheme_add_prim ("equal?", equal_prim, env);
+  scheme_add_prims (bool_prims, SCHEME_NUM_ENTRIES (bool_prims), env);
 }
 
 SCHEME_FUN_CONST
@@ -148,10 +155,9 @@ scheme_equal (Scheme_Value obj1, Scheme_Value obj2)
 /* primitive functions */
 
 static Scheme_Value
-not_prim (int argc, Scheme_Value argv[])
+not_prim (Scheme_Value obj)
 {
-  SCHEME_ASSERT (argc == 1, "not: wrong number of args");
-  if (argv[0] == scheme_false)
+  if (obj == scheme_false)
     {
       return (scheme_true);
     }
@@ -162,10 +168,9 @@ not_prim (int argc, Scheme_Value argv[])
 }
 
 static Scheme_Value
-boolean_p_prim (int argc, Scheme_Value argv[])
+boolean_p_prim (Scheme_Value obj)
 {
-  SCHEME_ASSERT ((argc == 1), "boolean?: wrong number of args");
-  if ((argv[0] == scheme_false) || (argv[0] == scheme_true))
+  if ((obj == scheme_false) || (obj == scheme_true))
     {
       return (scheme_true);
     }
@@ -176,10 +181,9 @@ boolean_p_prim (int argc, Scheme_Value argv[])
 }
 
 static Scheme_Value
-eq_prim (int argc, Scheme_Value argv[])
+eq_prim (Scheme_Value obj1, Scheme_Value obj2)
 {
-  SCHEME_ASSERT ((argc == 2), "eq?: wrong number of args");
-  if (argv[0] == argv[1])
+  if (obj1 == obj2)
     {
       return (scheme_true);
     }
@@ -190,10 +194,9 @@ eq_prim (int argc, Scheme_Value argv[])
 }
 
 static Scheme_Value
-eqv_prim (int argc, Scheme_Value argv[])
+eqv_prim (Scheme_Value obj1, Scheme_Value obj2)
 {
-  SCHEME_ASSERT ((argc==2), "eqv?: wrong number of args");
-  if (scheme_eqv (argv[0], argv[1]))
+  if (scheme_eqv (obj1, obj2))
     {
       return (scheme_true);
     }
@@ -204,10 +207,9 @@ eqv_prim (int argc, Scheme_Value argv[])
 }
 
 static Scheme_Value
-equal_prim (int argc, Scheme_Value argv[])
+equal_prim (Scheme_Value obj1, Scheme_Value obj2)
 {
-  SCHEME_ASSERT ((argc == 2), "equal?: wrong number of args");
-  if (scheme_equal (argv[0], argv[1]))
+  if (scheme_equal (obj1, obj2))
     {
       return (scheme_true);
     }
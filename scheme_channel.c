@@ -0,0 +1,382 @@
+/*
+  libscheme
+  Copyright (c) 1994 Brent Benson
+  All rights reserved.
+
+  Permission is hereby granted, without written agreement and without
+  license or royalty fees, to use, copy, modify, and distribute this
+  software and its documentation for any purpose, provided that the
+  above copyright notice and the following two paragraphs appear in
+  all copies of this software.
+
+  IN NO EVENT SHALL BRENT BENSON BE LIABLE TO ANY PARTY FOR DIRECT,
+  INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES ARISING OUT
+  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF BRENT
+  BENSON HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+  BRENT BENSON SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT
+  NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER
+  IS ON AN "AS IS" BASIS, AND BRENT BENSON HAS NO OBLIGATION TO
+  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR
+  MODIFICATIONS.
+*/
+
+/* Channels, and threads that talk through them.
+
+   (make-channel) makes an unbounded channel and (make-channel n) one
+   holding at most N messages.  (channel-send ch obj) waits while CH is
+   full, (channel-receive ch) while it is empty, and
+   (channel-try-receive ch [default]) returns DEFAULT, or #f, at once
+   if there is nothing to receive.  Messages come out in the order
+   they went in.
+
+   A message is handed over as the receiver may have it without
+   locks: frozen data, which includes numbers, symbols and characters,
+   as it is, and mutable pairs, vectors and strings copied, down to the
+   frozen parts.  Everything else, procedures and channels among them,
+   is shared.  A mutable message should not be circular.
+
+   (spawn thunk) calls THUNK in a new thread running a context of its
+   own, in a clone of the current environment, and returns a future
+   for its value.  THUNK is analyzed again for the clone, with copies
+   of the local variables it captured, so the globals its body reads,
+   assigns and defines are the clone's.  Procedures it calls keep the
+   environment they were made in, as in any clone.  Without SCHEME_THREADS the thunk is called at once,
+   and an operation that would wait for another thread is an error. */
+
+#include "scheme_private.h"
+
+/* globals */
+Scheme_Value scheme_channel_type;
+
+typedef struct Channel
+{
+  Scheme_Value *items;		/* a ring of SIZE, from HEAD */
+  int size, head, count;
+  int capacity;			/* 0 if unbounded */
+#ifdef SCHEME_THREADS
+  pthread_mutex_t lock;
+  pthread_cond_t readable, writable;
+#endif
+} Channel;
+
+#define CHANNEL(obj) ((Channel *) SCHEME_PTR_VAL (obj))
+
+#ifdef SCHEME_THREADS
+#define LOCK(c)   pthread_mutex_lock (&(c)->lock)
+#define UNLOCK(c) pthread_mutex_unlock (&(c)->lock)
+#else
+#define LOCK(c)   ((void) (c))
+#define UNLOCK(c) ((void) (c))
+#endif
+
+/* locals */
+static Scheme_Value transfer (Scheme_Value msg);
+static Scheme_Value take (Channel *c);
+static Scheme_Value rebind (Scheme_Value thunk, Scheme_Env *env);
+static Scheme_Env *copy_frames (Scheme_Env *frame, Scheme_Env *env);
+static Scheme_Value make_channel (int argc, Scheme_Value argv[]);
+static Scheme_Value channel_p (Scheme_Value obj);
+static Scheme_Value channel_send (Scheme_Value ch, Scheme_Value msg);
+static Scheme_Value channel_receive (Scheme_Value ch);
+static Scheme_Value channel_try_receive (int argc, Scheme_Value argv[]);
+static Scheme_Value spawn (Scheme_Value thunk);
+#ifdef SCHEME_THREADS
+static void *spawn_main (void *arg);
+#endif
+
+static const Scheme_Prim_Entry channel_prims[] =
+{
+  SCHEME_PRIM_ENTRY ("make-channel", make_channel, 0, 1),
+  SCHEME_PRIM1_ENTRY ("channel?", channel_p),
+  SCHEME_PRIM2_ENTRY ("channel-send", channel_send),
+  SCHEME_PRIM1_ENTRY ("channel-receive", channel_receive),
+  SCHEME_PRIM_ENTRY ("channel-try-receive", channel_try_receive, 1, 2),
+  SCHEME_PRIM1_ENTRY ("spawn", spawn)
+};
+
+void
+scheme_init_channel (Scheme_Env *env)
+{
+  scheme_channel_type = scheme_make_builtin_type ("<channel>", SCHEME_CHANNEL_TYPE_INDEX);
+  scheme_add_global ("<channel>", scheme_channel_type, env);
+  scheme_add_prims (channel_prims, SCHEME_NUM_ENTRIES (channel_prims), env);
+}
+
+/* Make a channel holding at most CAPACITY messages, or any number if
+   CAPACITY is 0. */
+Scheme_Value
+scheme_make_channel (int capacity)
+{
+  Scheme_Value obj, *items;
+  Channel *c;
+  int size;
+
+  size = capacity ? capacity : SCHEME_CHANNEL_SIZE;
+  items = (Scheme_Value *) scheme_malloc (size * sizeof (Scheme_Value));
+  obj = scheme_alloc_object (scheme_channel_type, sizeof (Channel));
+  c = CHANNEL (obj);
+  c->items = items;
+  c->size = size;
+  c->head = 0;
+  c->count = 0;
+  c->capacity = capacity;
+#ifdef SCHEME_THREADS
+  pthread_mutex_init (&c->lock, NULL);
+  pthread_cond_init (&c->readable, NULL);
+  pthread_cond_init (&c->writable, NULL);
+#endif
+  return (obj);
+}
+
+/* locals */
+
+/* MSG as another context may have it */
+static Scheme_Value
+transfer (Scheme_Value msg)
+{
+  Scheme_Value first, last, pair, vec;
+  int i;
+
+  if (scheme_frozenp (msg))
+    {
+      return (msg);
+    }
+  switch (SCHEME_TYPE_INDEX (msg))
+    {
+    case SCHEME_PAIR_TYPE_INDEX:
+      first = last = scheme_make_pair (transfer (SCHEME_CAR (msg)), scheme_null);
+      for ( msg=SCHEME_CDR (msg) ; SCHEME_PAIRP (msg) && ! SCHEME_FROZENP (msg) ; msg=SCHEME_CDR (msg) )
+	{
+	  pair = scheme_make_pair (transfer (SCHEME_CAR (msg)), scheme_null);
+	  SCHEME_CDR (last) = pair;
+	  SCHEME_GC_WRITE (&SCHEME_CDR (last));
+	  last = pair;
+	}
+      SCHEME_CDR (last) = transfer (msg);
+      SCHEME_GC_WRITE (&SCHEME_CDR (last));
+      return (first);
+    case SCHEME_VECTOR_TYPE_INDEX:
+      vec = scheme_make_vector (SCHEME_VEC_SIZE (msg), scheme_null);
+      for ( i=0 ; i<SCHEME_VEC_SIZE (msg) ; ++i )
+	{
+	  SCHEME_VEC_ELS (vec)[i] = transfer (SCHEME_VEC_ELS (msg)[i]);
+	  SCHEME_GC_WRITE (&SCHEME_VEC_ELS (vec)[i]);
+	}
+      return (vec);
+    case SCHEME_STRING_TYPE_INDEX:
+      return (scheme_make_string (SCHEME_STR_VAL (msg)));
+    default:
+      return (msg);
+    }
+}
+
+/* the oldest message of C, which holds one */
+static Scheme_Value
+take (Channel *c)
+{
+  Scheme_Value msg;
+
+  msg = c->items[c->head];
+  c->items[c->head] = NULL;
+  c->head = (c->head + 1) % c->size;
+  c->count--;
+#ifdef SCHEME_THREADS
+  pthread_cond_signal (&c->writable);
+#endif
+  return (msg);
+}
+
+/* THUNK made again on ENV in place of the top-level environment it
+   was made in */
+static Scheme_Value
+rebind (Scheme_Value thunk, Scheme_Env *env)
+{
+  Scheme_Env *frames;
+
+  if (! SCHEME_CLOSUREP (thunk))
+    {
+      return (thunk);
+    }
+  frames = copy_frames (SCHEME_CLOS_ENV (thunk), env);
+  return (scheme_make_lambda_closure (frames, scheme_analyze_lambda (SCHEME_CLOS_LAMBDA (thunk)->code, frames)));
+}
+
+/* copies of the local frames from FRAME up, the last on ENV */
+static Scheme_Env *
+copy_frames (Scheme_Env *frame, Scheme_Env *env)
+{
+  Scheme_Env *copy;
+  int i;
+
+  if (! frame->next)
+    {
+      return (env);
+    }
+  env = copy_frames (frame->next, env);
+  copy = scheme_new_frame (frame->num_bindings);
+  for ( i=0 ; i<frame->num_bindings ; ++i )
+    {
+      scheme_add_binding (i, frame->symbols[i], frame->values[i], copy);
+    }
+  copy->frozen = frame->frozen;
+  return (scheme_extend_env (copy, env));
+}
+
+static Scheme_Value
+make_channel (int argc, Scheme_Value argv[])
+{
+  int capacity = 0;
+
+  if (argc == 1)
+    {
+      SCHEME_ASSERT ((SCHEME_INTP (argv[0]) && SCHEME_INT_VAL (argv[0]) > 0),
+		     "make-channel: arg must be a positive integer");
+      capacity = SCHEME_INT_VAL (argv[0]);
+    }
+  return (scheme_make_channel (capacity));
+}
+
+static Scheme_Value
+channel_p (Scheme_Value obj)
+{
+  return (SCHEME_CHANNELP (obj) ? scheme_true : scheme_false);
+}
+
+static Scheme_Value
+channel_send (Scheme_Value ch, Scheme_Value msg)
+{
+  Scheme_Value *items;
+  Channel *c;
+  int i;
+
+  SCHEME_ASSERT (SCHEME_CHANNELP (ch), "channel-send: first arg must be a channel");
+  c = CHANNEL (ch);
+  msg = transfer (msg);
+  LOCK (c);
+  while (c->capacity && c->count == c->capacity)
+    {
+#ifdef SCHEME_THREADS
+      pthread_cond_wait (&c->writable, &c->lock);
+#else
+      scheme_signal_error ("channel-send: channel is full");
+#endif
+    }
+  if (c->count == c->size)
+    {
+      items = (Scheme_Value *) scheme_malloc (2 * c->size * sizeof (Scheme_Value));
+      for ( i=0 ; i<c->count ; ++i )
+	{
+	  items[i] = c->items[(c->head + i) % c->size];
+	}
+      c->items = items;
+      SCHEME_GC_WRITE (&c->items);
+      c->size *= 2;
+      c->head = 0;
+    }
+  i = (c->head + c->count) % c->size;
+  c->items[i] = msg;
+  SCHEME_GC_WRITE (&c->items[i]);
+  c->count++;
+#ifdef SCHEME_THREADS
+  pthread_cond_signal (&c->readable);
+#endif
+  UNLOCK (c);
+  return (scheme_true);
+}
+
+static Scheme_Value
+channel_receive (Scheme_Value ch)
+{
+  Scheme_Value msg;
+  Channel *c;
+
+  SCHEME_ASSERT (SCHEME_CHANNELP (ch), "channel-receive: arg must be a channel");
+  c = CHANNEL (ch);
+  LOCK (c);
+  while (c->count == 0)
+    {
+#ifdef SCHEME_THREADS
+      pthread_cond_wait (&c->readable, &c->lock);
+#else
+      scheme_signal_error ("channel-receive: channel is empty");
+#endif
+    }
+  msg = take (c);
+  UNLOCK (c);
+  return (msg);
+}
+
+static Scheme_Value
+channel_try_receive (int argc, Scheme_Value argv[])
+{
+  Scheme_Value msg;
+  Channel *c;
+
+  SCHEME_ASSERT (SCHEME_CHANNELP (argv[0]), "channel-try-receive: first arg must be a channel");
+  c = CHANNEL (argv[0]);
+  msg = (argc == 2) ? argv[1] : scheme_false;
+  LOCK (c);
+  if (c->count > 0)
+    {
+      msg = take (c);
+    }
+  UNLOCK (c);
+  return (msg);
+}
+
+static Scheme_Value
+spawn (Scheme_Value thunk)
+{
+  Scheme_Value obj;
+  Scheme_Future *future;
+  Scheme_Context *context;
+  Scheme_Env *env;
+#ifdef SCHEME_THREADS
+  pthread_t thread;
+#else
+  Scheme_Context *old;
+#endif
+
+  SCHEME_ASSERT (SCHEME_PROCP (thunk), "spawn: arg must be a procedure");
+  env = scheme_clone_env (scheme_env);
+  obj = scheme_make_thunk_future (rebind (thunk, env));
+  future = (Scheme_Future *) SCHEME_PTR_VAL (obj);
+  context = scheme_make_context (env);
+  future->task.env = env;
+  future->task.in_port = scheme_context->in_port;
+  future->task.out_port = scheme_context->out_port;
+  /* the context is a root, so this also keeps the future alive */
+  context->task = &future->task;
+#ifdef SCHEME_THREADS
+  if (pthread_create (&thread, NULL, spawn_main, context) != 0)
+    {
+      scheme_free_context (context);
+      scheme_signal_error ("spawn: cannot start a thread");
+    }
+  pthread_detach (thread);
+#else
+  old = scheme_set_context (context);
+  scheme_run_task (&future->task);
+  scheme_set_context (old);
+  scheme_free_context (context);
+#endif
+  return (obj);
+}
+
+#ifdef SCHEME_THREADS
+
+static void *
+spawn_main (void *arg)
+{
+  Scheme_Context *context = (Scheme_Context *) arg;
+
+  scheme_attach_thread (context);
+  scheme_run_task (context->task);
+  scheme_detach_thread ();
+  scheme_free_context (context);
+  return (NULL);
+}
+
+#endif /* SCHEME_THREADS */
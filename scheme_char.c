@@ -25,14 +25,9 @@
 #include "scheme.h"
 #include <ctype.h>
 
-#define CHAR_CACHE_SIZE 256
-
 /* globals */
 Scheme_Value scheme_char_type;
 
-/* internal variables */
-static Scheme_Value char_cache[CHAR_CACHE_SIZE];
-
 /* primitive declarations */
 static Scheme_Value char_p (int argc, Scheme_Value argv[]);
 static Scheme_Value char_eq (int argc, Scheme_Value argv[]);
@@ -55,60 +50,44 @@ static Scheme_Value integer_to_char (int argc, Scheme_Value argv[]);
 static Scheme_Value char_upcase (int argc, Scheme_Value argv[]);
 static Scheme_Value char_downcase (int argc, Scheme_Value argv[]);
 
+static const Scheme_Prim_Entry char_prims[] =
+{
+  SCHEME_PRIM_ENTRY ("char?", char_p, 0, -1),
+  SCHEME_PRIM_ENTRY ("char=?", char_eq, 0, -1),
+  SCHEME_PRIM_ENTRY ("char<?", char_lt, 0, -1),
+  SCHEME_PRIM_ENTRY ("char>?", char_gt, 0, -1),
+  SCHEME_PRIM_ENTRY ("char<=?", char_lt_eq, 0, -1),
+  SCHEME_PRIM_ENTRY ("char>=?", char_gt_eq, 0, -1),
+  SCHEME_PRIM_ENTRY ("char-ci=?", char_eq_ci, 0, -1),
+  SCHEME_PRIM_ENTRY ("char-ci<?", char_lt_ci, 0, -1),
+  SCHEME_PRIM_ENTRY ("char-ci>?", char_gt_ci, 0, -1),
+  SCHEME_PRIM_ENTRY ("char-ci<=?", char_lt_eq_ci, 0, -1),
+  SCHEME_PRIM_ENTRY ("char-ci>=?", char_gt_eq_ci, 0, -1),
+  SCHEME_PRIM_ENTRY ("char-alphabetic?", char_alphabetic, 0, -1),
+  SCHEME_PRIM_ENTRY ("char-numeric?", char_numeric, 0, -1),
+  SCHEME_PRIM_ENTRY ("char-whitespace?", char_whitespace, 0, -1),
+  SCHEME_PRIM_ENTRY ("char-upper-case?", char_upper_case, 0, -1),
+  SCHEME_PRIM_ENTRY ("char-lower-case?", char_lower_case, 0, -1),
+  SCHEME_PRIM_ENTRY ("char->integer", char_to_integer, 0, -1),
+  SCHEME_PRIM_ENTRY ("integer->char", integer_to_char, 0, -1),
+  SCHEME_PRIM_ENTRY ("char-upcase", char_upcase, 0, -1),
+  SCHEME_PRIM_ENTRY ("char-downcase", char_downcase, 0, -1)
+};
+
 /* exported functions */
 
 void
 scheme_init_char (Scheme_Env *env)
 {
-  scheme_char_type = scheme_make_type ("<char>");
+  scheme_char_type = scheme_make_builtin_type ("<char>", SCHEME_CHAR_TYPE_INDEX);
   scheme_add_global ("<char>", scheme_char_type, env);
-  scheme_add_prim ("char?", char_p, env);
-  scheme_add_prim ("char=?", char_eq, env);
-  scheme_add_prim ("char<?", char_lt, env);
-  scheme_add_prim ("char>?", char_gt, env);
-  scheme_add_prim ("char<=?", char_lt_eq, env);
-  scheme_add_prim ("char>=?", char_gt_eq, env);
-  scheme_add_prim ("char-ci=?", char_eq_ci, env);
-  scheme_add_prim ("char-ci<?", char_lt_ci, env);
-  scheme_add_prim ("char-ci>?", char_gt_ci, env);
-  scheme_add_prim ("char-ci<=?", char_lt_eq_ci, env);
-  scheme_add_prim ("char-ci>=?", char_gt_eq_ci, env);
-  scheme_add_prim ("char-alphabetic?", char_alphabetic, env);
-  scheme_add_prim ("char-numeric?", char_numeric, env);
-  scheme_add_prim ("char-whitespace?", char_whitespace, env);
-  scheme_add_prim ("char-upper-case?", char_upper_case, env);
-  scheme_add_prim ("char-lower-case?", char_lower_case, env);
-  scheme_add_prim ("char->integer", char_to_integer, env);
-  scheme_add_prim ("integer->char", integer_to_char, env);
-  scheme_add_prim ("char-upcase", char_upcase, env);
-  scheme_add_prim ("char-downcase", char_downcase, env);
+  scheme_add_prims (char_prims, SCHEME_NUM_ENTRIES (char_prims), env);
 }
 
 Scheme_Value
 scheme_make_char (char ch)
 {
-  unsigned idx = (unsigned)ch;
-  Scheme_Value sc;
-
-  /* check if we have an object in the cache */
-  if(idx < CHAR_CACHE_SIZE) {
-    sc = char_cache[idx];
-    if(sc != NULL) {
-      return sc;
-    }
-  }
-
-  /* allocate and initialize the object */
-  sc = scheme_alloc_object (scheme_char_type, 0);
-  SCHEME_CHAR_VAL (sc) = ch;
-
-  /* put the object in the cache */
-  if(idx < CHAR_CACHE_SIZE) {
-    char_cache[idx] = sc;
-  }
-
-  /* done */
-  return (sc);
+  return (SCHEME_MAKE_CHAR (ch));
 }
 
 /* primitive functions */
@@ -0,0 +1,1611 @@
+/*
+  libscheme
+  Copyright (c) 1994 Brent Benson
+  All rights reserved.
+
+  Permission is hereby granted, without written agreement and without
+  license or royalty fees, to use, copy, modify, and distribute this
+  software and its documentation for any purpose, provided that the
+  above copyright notice and the following two paragraphs appear in
+  all copies of this software.
+
+  IN NO EVENT SHALL BRENT BENSON BE LIABLE TO ANY PARTY FOR DIRECT,
+  INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES ARISING OUT
+  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF BRENT
+  BENSON HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+  BRENT BENSON SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT
+  NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER
+  IS ON AN "AS IS" BASIS, AND BRENT BENSON HAS NO OBLIGATION TO
+  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR
+  MODIFICATIONS.
+*/
+
+#include "scheme_private.h"
+#include <string.h>
+
+/* The bytecode engine.  Expressions are compiled into instructions
+   for a stack machine that shares its closures and environment
+   frames with the tree evaluator, so the two can call each other.
+   Calls from compiled code to compiled closures, including tail
+   calls, stay inside one run of the machine instead of recursing
+   through scheme_apply.  Forms the compiler does not handle itself
+   are analyzed into nodes and run by the tree evaluator. */
+
+/* globals */
+Scheme_Value scheme_compiled_type;
+
+/* instructions and their operands */
+enum
+{
+  OP_CONST,			/* k: push literal k */
+  OP_LOCAL0,			/* i: push slot i of the innermost frame */
+  OP_LOCAL1,			/* i: same for the next frame out */
+  OP_LOCAL,			/* d i: same for the frame d out */
+  OP_GLOBAL,			/* k: push the value of global cell k */
+  OP_RATOR,			/* k f l: OP_GLOBAL for an operator; if it
+				   turns out to be syntax, run form f and
+				   continue at l */
+  OP_SET_LOCAL,			/* d i: store top in slot i of frame d */
+  OP_SET_GLOBAL,		/* k: store top in global cell k */
+  OP_DEFINE,			/* k c: store top in global cell c, replace
+				   it by symbol k */
+  OP_POP,
+  OP_JUMP,			/* l */
+  OP_JUMP_FALSE,		/* l: pop, jump if false */
+  OP_JUMP_TRUE,			/* l: pop, jump if true */
+  OP_AND_JUMP,			/* l: jump if top is false, else pop */
+  OP_OR_JUMP,			/* l: jump if top is true, else pop */
+  OP_CLOSURE,			/* k: push a closure for lambda k */
+  OP_MAKE_FRAME,		/* k n: pop n values into a frame for scope k */
+  OP_NEXT_FRAME,		/* k n: same, replacing the innermost frame */
+  OP_STACK_FRAME,		/* k n: OP_MAKE_FRAME for a frame nothing
+				   captures, kept by the machine */
+  OP_NEXT_STACK_FRAME,		/* k n: same for OP_NEXT_FRAME */
+  OP_EMPTY_FRAME,		/* k: a frame for scope k, bound to #f */
+  OP_POP_FRAME,
+  OP_INSERT,			/* n: move top below the n values under it */
+  OP_NODE,			/* k: push the value of node k */
+  OP_TAIL_NODE,			/* k: return the value of node k */
+  OP_CALL,			/* n: apply the procedure under n arguments */
+  OP_TAIL_CALL,			/* n: same, in place of the current call */
+  OP_RETURN
+};
+
+typedef struct Scheme_Bytecode
+{
+  int *codes;
+  int num_codes;
+  void **lits;			/* constants, symbols, scopes, lambdas, nodes */
+  int num_lits;
+  int max_stack;
+  Scheme_Value form;
+  Scheme_Lambda *lambda;	/* whose body this is, if any */
+} Scheme_Bytecode;
+
+typedef struct Compiler
+{
+  int *codes;
+  int num_codes, max_codes;
+  void **lits;
+  int num_lits, max_lits;
+  int depth, max_depth;
+} Compiler;
+
+typedef void (Compile_Proc) (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail);
+
+/* a compiled call saves the code, pc, env, frame base and number of
+   frames in use of its caller */
+#define VM_SAVED 5
+
+/* locals */
+static void compile_expr (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail);
+static void compile_seq (Compiler *c, Scheme_Value forms, Scheme_Env *scope, int tail);
+static void compile_body (Compiler *c, Scheme_Value forms, Scheme_Env *scope, int tail);
+static void compile_node (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail);
+static void compile_ref (Compiler *c, Scheme_Value sym, Scheme_Env *scope);
+static void compile_combination (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail);
+static Scheme_Lambda *compile_lambda (Scheme_Value code, Scheme_Env *scope);
+static void compile_quote (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail);
+static void compile_if (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail);
+static void compile_define (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail);
+static void compile_set (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail);
+static void compile_lambda_form (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail);
+static void compile_begin (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail);
+static void compile_let (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail);
+static void compile_named_let (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail);
+static void compile_let_star (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail);
+static void compile_letrec (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail);
+static void compile_and (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail);
+static void compile_or (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail);
+static void compile_cond (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail);
+static void compile_do (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail);
+static int bindings_ok (Scheme_Value bindings, int need_init);
+static Scheme_Env *binding_scope (Scheme_Value bindings, Scheme_Env *scope);
+static void emit (Compiler *c, int code);
+static int add_lit (Compiler *c, void *lit);
+static void track (Compiler *c, int n);
+static int emit_jump (Compiler *c, int op, int chain);
+static void patch_jumps (Compiler *c, int chain);
+static Scheme_Value make_code (Compiler *c, Scheme_Value form);
+static Scheme_Value execute (Scheme_Bytecode *code, Scheme_Env *env);
+static Scheme_Value bytecode_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value compile (int argc, Scheme_Value argv[]);
+
+/* the syntax compiled here rather than by the tree evaluator */
+static struct
+{
+  char *name;
+  Compile_Proc *compile;
+  Scheme_Value syntax;
+} specials[] =
+{
+  { "quote", compile_quote, NULL },
+  { "if", compile_if, NULL },
+  { "define", compile_define, NULL },
+  { "set!", compile_set, NULL },
+  { "lambda", compile_lambda_form, NULL },
+  { "begin", compile_begin, NULL },
+  { "let", compile_let, NULL },
+  { "let*", compile_let_star, NULL },
+  { "letrec", compile_letrec, NULL },
+  { "and", compile_and, NULL },
+  { "or", compile_or, NULL },
+  { "cond", compile_cond, NULL },
+  { "do", compile_do, NULL },
+  { NULL, NULL, NULL }
+};
+
+static Scheme_Value scheme_define;
+static Scheme_Value scheme_else;
+static Scheme_Value scheme_arrow;
+
+static const Scheme_Prim_Entry compile_prims[] =
+{
+  SCHEME_PRIM_ENTRY ("compile", compile, 0, -1)
+};
+
+void
+scheme_init_compile (Scheme_Env *env)
+{
+  int i;
+
+  scheme_compiled_type = scheme_make_builtin_type ("<compiled-code>", SCHEME_COMPILED_TYPE_INDEX);
+  scheme_add_global ("<compiled-code>", scheme_compiled_type, env);
+  scheme_define = scheme_intern_symbol ("define");
+  scheme_else = scheme_intern_symbol ("else");
+  scheme_arrow = scheme_intern_symbol ("=>");
+  for ( i=0 ; specials[i].name ; ++i )
+    {
+      specials[i].syntax = scheme_lookup_global (scheme_intern_symbol (specials[i].name), env);
+    }
+  scheme_add_prims (compile_prims, SCHEME_NUM_ENTRIES (compile_prims), env);
+}
+
+Scheme_Value
+scheme_compile (Scheme_Value obj, Scheme_Env *env)
+{
+  Compiler c;
+
+  memset (&c, 0, sizeof (c));
+  compile_expr (&c, obj, env, 1);
+  return (make_code (&c, obj));
+}
+
+/* Compiled code has to be run in an environment shaped like the one
+   it was compiled in. */
+Scheme_Value
+scheme_execute (Scheme_Value code, Scheme_Env *env)
+{
+  SCHEME_ASSERT (SCHEME_COMPILEDP (code), "execute: not compiled code");
+  return (execute ((Scheme_Bytecode *) SCHEME_PTR_VAL (code), env));
+}
+
+/* compiler */
+
+/* In tail position, the code for an expression returns its value;
+   otherwise it leaves it on the stack. */
+
+static void
+compile_expr (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail)
+{
+  if (SCHEME_SYMBOLP (form))
+    {
+      compile_ref (c, form, scope);
+    }
+  else if (SCHEME_PAIRP (form))
+    {
+      compile_combination (c, form, scope, tail);
+      return;
+    }
+  else
+    {
+      emit (c, OP_CONST);
+      emit (c, add_lit (c, form));
+      track (c, 1);
+    }
+  if (tail)
+    {
+      emit (c, OP_RETURN);
+      track (c, -1);
+    }
+}
+
+static void
+finish (Compiler *c, int tail)
+{
+  if (tail)
+    {
+      emit (c, OP_RETURN);
+      track (c, -1);
+    }
+}
+
+static void
+compile_seq (Compiler *c, Scheme_Value forms, Scheme_Env *scope, int tail)
+{
+  if (SCHEME_NULLP (forms))
+    {
+      emit (c, OP_CONST);
+      emit (c, add_lit (c, scheme_null));
+      track (c, 1);
+      finish (c, tail);
+      return;
+    }
+  while (! SCHEME_NULLP (SCHEME_CDR (forms)))
+    {
+      compile_expr (c, SCHEME_CAR (forms), scope, 0);
+      emit (c, OP_POP);
+      track (c, -1);
+      forms = SCHEME_CDR (forms);
+    }
+  compile_expr (c, SCHEME_CAR (forms), scope, tail);
+}
+
+/* Internal defines get a frame of their own, as with the tree
+   evaluator. */
+static void
+compile_body (Compiler *c, Scheme_Value forms, Scheme_Env *scope, int tail)
+{
+  Scheme_Value defs, def, sec;
+  Scheme_Env *frame;
+  int num_defs, i;
+
+  num_defs = 0;
+  defs = forms;
+  while (!SCHEME_NULLP (forms) && SCHEME_PAIRP (SCHEME_CAR (forms))
+	 && (SCHEME_CAAR (forms) == scheme_define))
+    {
+      SCHEME_ASSERT (SCHEME_PAIRP (SCHEME_CDR (SCHEME_CAR (forms))), "define: bad form");
+      num_defs++;
+      forms = SCHEME_CDR (forms);
+    }
+  if (! num_defs)
+    {
+      compile_seq (c, forms, scope, tail);
+      return;
+    }
+
+  frame = scheme_new_frame (num_defs);
+  forms = defs;
+  for ( i=0 ; i<num_defs ; ++i )
+    {
+      sec = SCHEME_CADR (SCHEME_CAR (forms));
+      scheme_add_binding (i, SCHEME_PAIRP (sec) ? SCHEME_CAR (sec) : sec, scheme_false, frame);
+      forms = SCHEME_CDR (forms);
+    }
+  scope = scheme_extend_env (frame, scope);
+  emit (c, OP_EMPTY_FRAME);
+  emit (c, add_lit (c, frame));
+  for ( i=0 ; i<num_defs ; ++i )
+    {
+      def = SCHEME_CAR (defs);
+      sec = SCHEME_CADR (def);
+      if (SCHEME_PAIRP (sec))
+	{
+	  emit (c, OP_CLOSURE);
+	  emit (c, add_lit (c, compile_lambda (scheme_make_pair (SCHEME_CDR (sec),
+								  SCHEME_CDDR (def)),
+					       scope)));
+	  track (c, 1);
+	}
+      else
+	{
+	  SCHEME_ASSERT (SCHEME_PAIRP (SCHEME_CDDR (def)), "define: bad form");
+	  compile_expr (c, SCHEME_CAR (SCHEME_CDDR (def)), scope, 0);
+	}
+      emit (c, OP_SET_LOCAL);
+      emit (c, 0);
+      emit (c, i);
+      emit (c, OP_POP);
+      track (c, -1);
+      defs = SCHEME_CDR (defs);
+    }
+  compile_seq (c, forms, scope, tail);
+  if (! tail)
+    {
+      emit (c, OP_POP_FRAME);
+    }
+}
+
+/* Anything else is left to the tree evaluator.  In tail position,
+   a call the node leaves pending is made as a tail call. */
+static void
+compile_node (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail)
+{
+  emit (c, tail ? OP_TAIL_NODE : OP_NODE);
+  emit (c, add_lit (c, scheme_analyze (form, scope, tail)));
+  if (! tail)
+    {
+      track (c, 1);
+    }
+}
+
+static void
+compile_ref (Compiler *c, Scheme_Value sym, Scheme_Env *scope)
+{
+  int depth, index;
+
+  if (scheme_lexical_address (sym, scope, &depth, &index))
+    {
+      if (depth < 2)
+	{
+	  emit (c, depth ? OP_LOCAL1 : OP_LOCAL0);
+	}
+      else
+	{
+	  emit (c, OP_LOCAL);
+	  emit (c, depth);
+	}
+      emit (c, index);
+    }
+  else
+    {
+      emit (c, OP_GLOBAL);
+      emit (c, add_lit (c, scheme_global_cell (sym, scope)));
+    }
+  track (c, 1);
+}
+
+static void
+compile_combination (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail)
+{
+  Scheme_Value rator, rands, val;
+  int num_rands, depth, index, skip, i;
+
+  rator = SCHEME_CAR (form);
+  rands = SCHEME_CDR (form);
+  skip = -1;
+  if (SCHEME_SYMBOLP (rator) && ! scheme_lexical_address (rator, scope, &depth, &index))
+    {
+      val = scheme_lookup_global (rator, scope);
+      if (val && SCHEME_SYNTAXP (val))
+	{
+	  for ( i=0 ; specials[i].name ; ++i )
+	    {
+	      if (val == specials[i].syntax)
+		{
+		  specials[i].compile (c, form, scope, tail);
+		  return;
+		}
+	    }
+	  compile_node (c, form, scope, tail);
+	  return;
+	}
+      else if (val && SCHEME_MACROP (val))
+	{
+	  val = scheme_apply_to_list ((Scheme_Value) SCHEME_PTR_VAL (val), rands);
+	  compile_expr (c, val, scope, tail);
+	  return;
+	}
+      emit (c, OP_RATOR);
+      emit (c, add_lit (c, scheme_global_cell (rator, scope)));
+      emit (c, add_lit (c, form));
+      skip = c->num_codes;
+      emit (c, 0);
+      track (c, 1);
+    }
+  else
+    {
+      compile_expr (c, rator, scope, 0);
+    }
+
+  num_rands = scheme_list_length (rands);
+  SCHEME_ASSERT ((num_rands < SCHEME_MAX_ARGS), "too many arguments in combination");
+  for ( i=0 ; i<num_rands ; ++i )
+    {
+      compile_expr (c, SCHEME_CAR (rands), scope, 0);
+      rands = SCHEME_CDR (rands);
+    }
+  emit (c, tail ? OP_TAIL_CALL : OP_CALL);
+  emit (c, num_rands);
+  track (c, -(num_rands + 1));
+  if (! tail)
+    {
+      track (c, 1);
+    }
+  if (skip >= 0)
+    {
+      c->codes[skip] = c->num_codes;
+      if (tail)
+	{
+	  track (c, 1);
+	  finish (c, tail);
+	}
+    }
+}
+
+static Scheme_Lambda *
+compile_lambda (Scheme_Value code, Scheme_Env *scope)
+{
+  Scheme_Lambda *lambda;
+  Scheme_Node *body;
+  Compiler c;
+  int captures;
+
+  lambda = scheme_make_lambda (code);
+  scope = scheme_extend_env (scheme_lambda_frame (lambda), scope);
+
+  /* captures are counted as the analyzers in scheme_syntax.c do */
+  memset (&c, 0, sizeof (c));
+  captures = scheme_capture_count;
+  compile_body (&c, SCHEME_CDR (code), scope, 1);
+  body = scheme_make_node (bytecode_eval, code, 0);
+  SCHEME_NODE_VAL (body) = make_code (&c, code);
+  ((Scheme_Bytecode *) SCHEME_PTR_VAL (SCHEME_NODE_VAL (body)))->lambda = lambda;
+  lambda->body = body;
+  lambda->stack_frame = (captures == scheme_capture_count
+			 && lambda->num_params <= SCHEME_STACK_FRAME);
+  scheme_capture_count++;
+  return (lambda);
+}
+
+/* special forms; malformed ones go to the tree evaluator's
+   analyzers, which report the error */
+
+static void
+compile_quote (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail)
+{
+  if (scheme_list_length (form) != 2)
+    {
+      compile_node (c, form, scope, tail);
+      return;
+    }
+  emit (c, OP_CONST);
+  emit (c, add_lit (c, SCHEME_CADR (form)));
+  track (c, 1);
+  finish (c, tail);
+}
+
+static void
+compile_if (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail)
+{
+  int len, else_jump, end_jump;
+
+  len = scheme_list_length (form);
+  if ((len != 3) && (len != 4))
+    {
+      compile_node (c, form, scope, tail);
+      return;
+    }
+  compile_expr (c, SCHEME_CADR (form), scope, 0);
+  else_jump = emit_jump (c, OP_JUMP_FALSE, -1);
+  track (c, -1);
+  compile_expr (c, SCHEME_CAR (SCHEME_CDDR (form)), scope, tail);
+  end_jump = -1;
+  if (! tail)
+    {
+      end_jump = emit_jump (c, OP_JUMP, -1);
+      track (c, -1);
+    }
+  patch_jumps (c, else_jump);
+  if (len == 4)
+    {
+      compile_expr (c, SCHEME_CAR (SCHEME_CDR (SCHEME_CDDR (form))), scope, tail);
+    }
+  else
+    {
+      emit (c, OP_CONST);
+      emit (c, add_lit (c, scheme_false));
+      track (c, 1);
+      finish (c, tail);
+    }
+  patch_jumps (c, end_jump);
+}
+
+static void
+compile_define (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail)
+{
+  Scheme_Value sec, var;
+
+  if (! SCHEME_PAIRP (SCHEME_CDR (form)))
+    {
+      compile_node (c, form, scope, tail);
+      return;
+    }
+  sec = SCHEME_CADR (form);
+  if (SCHEME_PAIRP (sec))
+    {
+      var = SCHEME_CAR (sec);
+      emit (c, OP_CLOSURE);
+      emit (c, add_lit (c, compile_lambda (scheme_make_pair (SCHEME_CDR (sec),
+							      SCHEME_CDDR (form)),
+					   scope)));
+      track (c, 1);
+    }
+  else if (SCHEME_SYMBOLP (sec) && SCHEME_PAIRP (SCHEME_CDDR (form)))
+    {
+      var = sec;
+      compile_expr (c, SCHEME_CAR (SCHEME_CDDR (form)), scope, 0);
+    }
+  else
+    {
+      compile_node (c, form, scope, tail);
+      return;
+    }
+  emit (c, OP_DEFINE);
+  emit (c, add_lit (c, var));
+  emit (c, add_lit (c, scheme_global_cell (var, scope)));
+  finish (c, tail);
+}
+
+static void
+compile_set (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail)
+{
+  Scheme_Value var;
+  int depth, index;
+
+  if ((scheme_list_length (form) != 3) || ! SCHEME_SYMBOLP (SCHEME_CADR (form)))
+    {
+      compile_node (c, form, scope, tail);
+      return;
+    }
+  var = SCHEME_CADR (form);
+  compile_expr (c, SCHEME_CAR (SCHEME_CDDR (form)), scope, 0);
+  if (scheme_lexical_address (var, scope, &depth, &index))
+    {
+      emit (c, OP_SET_LOCAL);
+      emit (c, depth);
+      emit (c, index);
+    }
+  else
+    {
+      emit (c, OP_SET_GLOBAL);
+      emit (c, add_lit (c, scheme_global_cell (var, scope)));
+    }
+  finish (c, tail);
+}
+
+static void
+compile_lambda_form (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail)
+{
+  if (! SCHEME_PAIRP (SCHEME_CDR (form)))
+    {
+      compile_node (c, form, scope, tail);
+      return;
+    }
+  emit (c, OP_CLOSURE);
+  emit (c, add_lit (c, compile_lambda (SCHEME_CDR (form), scope)));
+  track (c, 1);
+  finish (c, tail);
+}
+
+static void
+compile_begin (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail)
+{
+  if (SCHEME_NULLP (SCHEME_CDR (form)))
+    {
+      emit (c, OP_CONST);
+      emit (c, add_lit (c, scheme_false));
+      track (c, 1);
+      finish (c, tail);
+      return;
+    }
+  compile_seq (c, SCHEME_CDR (form), scope, tail);
+}
+
+static void
+compile_let (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail)
+{
+  Scheme_Value bindings;
+  Scheme_Env *frame;
+  int num_bindings, captures, at;
+
+  if (SCHEME_PAIRP (SCHEME_CDR (form)) && SCHEME_SYMBOLP (SCHEME_CADR (form)))
+    {
+      compile_named_let (c, form, scope, tail);
+      return;
+    }
+  if ((scheme_list_length (form) < 3) || ! bindings_ok (SCHEME_CADR (form), 1))
+    {
+      compile_node (c, form, scope, tail);
+      return;
+    }
+  num_bindings = 0;
+  for ( bindings = SCHEME_CADR (form) ; ! SCHEME_NULLP (bindings) ; bindings = SCHEME_CDR (bindings) )
+    {
+      compile_expr (c, SCHEME_CADR (SCHEME_CAR (bindings)), scope, 0);
+      num_bindings++;
+    }
+  frame = binding_scope (SCHEME_CADR (form), scope);
+  at = c->num_codes;
+  emit (c, OP_MAKE_FRAME);
+  emit (c, add_lit (c, frame));
+  emit (c, num_bindings);
+  track (c, -num_bindings);
+  captures = scheme_capture_count;
+  compile_body (c, SCHEME_CDDR (form), frame, tail);
+  if (captures == scheme_capture_count && num_bindings <= SCHEME_STACK_FRAME)
+    {
+      c->codes[at] = OP_STACK_FRAME;
+    }
+  if (! tail)
+    {
+      emit (c, OP_POP_FRAME);
+    }
+}
+
+/* The loop procedure is bound in a frame of its own, outside of
+   which the initial values are computed. */
+static void
+compile_named_let (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail)
+{
+  Scheme_Value bindings, vars;
+  Scheme_Env *frame;
+  int num_bindings;
+
+  if ((scheme_list_length (form) < 4) || ! bindings_ok (SCHEME_CAR (SCHEME_CDDR (form)), 1))
+    {
+      compile_node (c, form, scope, tail);
+      return;
+    }
+  bindings = SCHEME_CAR (SCHEME_CDDR (form));
+  vars = scheme_map_1 (scheme_car, bindings);
+  num_bindings = 0;
+  for ( ; ! SCHEME_NULLP (bindings) ; bindings = SCHEME_CDR (bindings) )
+    {
+      compile_expr (c, SCHEME_CADR (SCHEME_CAR (bindings)), scope, 0);
+      num_bindings++;
+    }
+  frame = scheme_new_frame (1);
+  scheme_add_binding (0, SCHEME_CADR (form), scheme_false, frame);
+  scope = scheme_extend_env (frame, scope);
+  emit (c, OP_EMPTY_FRAME);
+  emit (c, add_lit (c, frame));
+  emit (c, OP_CLOSURE);
+  emit (c, add_lit (c, compile_lambda (scheme_make_pair (vars, SCHEME_CDR (SCHEME_CDDR (form))),
+				       scope)));
+  emit (c, OP_SET_LOCAL);
+  emit (c, 0);
+  emit (c, 0);
+  emit (c, OP_INSERT);
+  emit (c, num_bindings);
+  track (c, 1);
+  emit (c, tail ? OP_TAIL_CALL : OP_CALL);
+  emit (c, num_bindings);
+  track (c, -(num_bindings + 1));
+  if (! tail)
+    {
+      track (c, 1);
+      emit (c, OP_POP_FRAME);
+    }
+}
+
+/* Each `let*' binding gets a frame, so an init only sees the ones
+   before it. */
+static void
+compile_let_star (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail)
+{
+  Scheme_Value bindings;
+  Scheme_Env *frame;
+  int num_frames, captures, i;
+  int *at;
+
+  if ((scheme_list_length (form) < 3) || ! bindings_ok (SCHEME_CADR (form), 1))
+    {
+      compile_node (c, form, scope, tail);
+      return;
+    }
+  num_frames = 0;
+  at = (int *) scheme_malloc_atomic (scheme_list_length (SCHEME_CADR (form)) * sizeof (int));
+  captures = scheme_capture_count;
+  for ( bindings = SCHEME_CADR (form) ; ! SCHEME_NULLP (bindings) ; bindings = SCHEME_CDR (bindings) )
+    {
+      compile_expr (c, SCHEME_CADR (SCHEME_CAR (bindings)), scope, 0);
+      frame = scheme_new_frame (1);
+      scheme_add_binding (0, SCHEME_CAAR (bindings), scheme_false, frame);
+      scope = scheme_extend_env (frame, scope);
+      at[num_frames] = c->num_codes;
+      emit (c, OP_MAKE_FRAME);
+      emit (c, add_lit (c, frame));
+      emit (c, 1);
+      track (c, -1);
+      num_frames++;
+    }
+  compile_body (c, SCHEME_CDDR (form), scope, tail);
+  if (captures == scheme_capture_count)
+    {
+      for ( i=0 ; i<num_frames ; ++i )
+	{
+	  c->codes[at[i]] = OP_STACK_FRAME;
+	}
+    }
+  if (! tail)
+    {
+      for ( i=0 ; i<num_frames ; ++i )
+	{
+	  emit (c, OP_POP_FRAME);
+	}
+    }
+}
+
+static void
+compile_letrec (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail)
+{
+  Scheme_Value bindings;
+  int i;
+
+  if ((scheme_list_length (form) < 3) || ! bindings_ok (SCHEME_CADR (form), 1))
+    {
+      compile_node (c, form, scope, tail);
+      return;
+    }
+  scope = binding_scope (SCHEME_CADR (form), scope);
+  emit (c, OP_EMPTY_FRAME);
+  emit (c, add_lit (c, scope));
+  i = 0;
+  for ( bindings = SCHEME_CADR (form) ; ! SCHEME_NULLP (bindings) ; bindings = SCHEME_CDR (bindings) )
+    {
+      compile_expr (c, SCHEME_CADR (SCHEME_CAR (bindings)), scope, 0);
+      emit (c, OP_SET_LOCAL);
+      emit (c, 0);
+      emit (c, i++);
+      emit (c, OP_POP);
+      track (c, -1);
+    }
+  compile_body (c, SCHEME_CDDR (form), scope, tail);
+  if (! tail)
+    {
+      emit (c, OP_POP_FRAME);
+    }
+}
+
+/* `and' and `or' leave the deciding value on the stack and jump to
+   the end. */
+static void
+compile_and_or (Compiler *c, Scheme_Value forms, Scheme_Env *scope, int tail, int op)
+{
+  int ends;
+
+  ends = -1;
+  while (! SCHEME_NULLP (SCHEME_CDR (forms)))
+    {
+      compile_expr (c, SCHEME_CAR (forms), scope, 0);
+      ends = emit_jump (c, op, ends);
+      track (c, -1);
+      forms = SCHEME_CDR (forms);
+    }
+  compile_expr (c, SCHEME_CAR (forms), scope, tail);
+  if (tail)
+    {
+      track (c, 1);
+    }
+  patch_jumps (c, ends);
+  finish (c, tail);
+}
+
+static void
+compile_and (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail)
+{
+  if (SCHEME_NULLP (SCHEME_CDR (form)))
+    {
+      emit (c, OP_CONST);
+      emit (c, add_lit (c, scheme_true));
+      track (c, 1);
+      finish (c, tail);
+      return;
+    }
+  compile_and_or (c, SCHEME_CDR (form), scope, tail, OP_AND_JUMP);
+}
+
+static void
+compile_or (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail)
+{
+  if (SCHEME_NULLP (SCHEME_CDR (form)))
+    {
+      emit (c, OP_CONST);
+      emit (c, add_lit (c, scheme_false));
+      track (c, 1);
+      finish (c, tail);
+      return;
+    }
+  compile_and_or (c, SCHEME_CDR (form), scope, tail, OP_OR_JUMP);
+}
+
+static void
+compile_cond (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail)
+{
+  Scheme_Value clauses, clause;
+  int ends, next;
+
+  /* `=>' clauses are left to the tree evaluator */
+  for ( clauses = SCHEME_CDR (form) ; SCHEME_PAIRP (clauses) ; clauses = SCHEME_CDR (clauses) )
+    {
+      clause = SCHEME_CAR (clauses);
+      if (! SCHEME_PAIRP (clause)
+	  || (SCHEME_PAIRP (SCHEME_CDR (clause)) && (SCHEME_CADR (clause) == scheme_arrow)))
+	{
+	  compile_node (c, form, scope, tail);
+	  return;
+	}
+    }
+
+  ends = -1;
+  for ( clauses = SCHEME_CDR (form) ; SCHEME_PAIRP (clauses) ; clauses = SCHEME_CDR (clauses) )
+    {
+      clause = SCHEME_CAR (clauses);
+      if (SCHEME_CAR (clause) == scheme_else)
+	{
+	  compile_seq (c, SCHEME_CDR (clause), scope, tail);
+	  break;
+	}
+      compile_expr (c, SCHEME_CAR (clause), scope, 0);
+      if (SCHEME_NULLP (SCHEME_CDR (clause)))
+	{
+	  /* the value of the test is the value of the clause */
+	  ends = emit_jump (c, OP_OR_JUMP, ends);
+	  track (c, -1);
+	  continue;
+	}
+      next = emit_jump (c, OP_JUMP_FALSE, -1);
+      track (c, -1);
+      compile_seq (c, SCHEME_CDR (clause), scope, tail);
+      if (! tail)
+	{
+	  ends = emit_jump (c, OP_JUMP, ends);
+	  track (c, -1);
+	}
+      patch_jumps (c, next);
+    }
+  if (! SCHEME_PAIRP (clauses))
+    {
+      emit (c, OP_CONST);
+      emit (c, add_lit (c, scheme_false));
+      track (c, 1);
+      finish (c, tail);
+    }
+  if (ends >= 0)
+    {
+      patch_jumps (c, ends);
+      if (tail)
+	{
+	  track (c, 1);
+	  finish (c, tail);
+	}
+    }
+}
+
+/* A `do' loop keeps the value of its last body evaluation on the
+   stack and rebinds its variables in a fresh frame each time
+   around. */
+static void
+compile_do (Compiler *c, Scheme_Value form, Scheme_Env *scope, int tail)
+{
+  Scheme_Value specs, spec, test_clause, body;
+  Scheme_Env *frame;
+  int num_vars, loop, done, captures, first, next, i;
+
+  if ((scheme_list_length (form) < 3) || ! bindings_ok (SCHEME_CADR (form), 0)
+      || ! SCHEME_PAIRP (SCHEME_CAR (SCHEME_CDDR (form))))
+    {
+      compile_node (c, form, scope, tail);
+      return;
+    }
+  num_vars = 0;
+  for ( specs = SCHEME_CADR (form) ; ! SCHEME_NULLP (specs) ; specs = SCHEME_CDR (specs) )
+    {
+      compile_expr (c, SCHEME_CADR (SCHEME_CAR (specs)), scope, 0);
+      num_vars++;
+    }
+  frame = binding_scope (SCHEME_CADR (form), scope);
+  first = c->num_codes;
+  emit (c, OP_MAKE_FRAME);
+  emit (c, add_lit (c, frame));
+  emit (c, num_vars);
+  track (c, -num_vars);
+  emit (c, OP_CONST);
+  emit (c, add_lit (c, scheme_null));
+  track (c, 1);
+  captures = scheme_capture_count;
+
+  test_clause = SCHEME_CAR (SCHEME_CDDR (form));
+  body = SCHEME_CDR (SCHEME_CDDR (form));
+  loop = c->num_codes;
+  compile_expr (c, SCHEME_CAR (test_clause), frame, 0);
+  done = emit_jump (c, OP_JUMP_TRUE, -1);
+  track (c, -1);
+  if (! SCHEME_NULLP (body))
+    {
+      emit (c, OP_POP);
+      track (c, -1);
+      compile_seq (c, body, frame, 0);
+    }
+  i = 0;
+  for ( specs = SCHEME_CADR (form) ; ! SCHEME_NULLP (specs) ; specs = SCHEME_CDR (specs) )
+    {
+      spec = SCHEME_CAR (specs);
+      if (SCHEME_NULLP (SCHEME_CDDR (spec)))
+	{
+	  emit (c, OP_LOCAL0);
+	  emit (c, i);
+	  track (c, 1);
+	}
+      else
+	{
+	  compile_expr (c, SCHEME_CAR (SCHEME_CDDR (spec)), frame, 0);
+	}
+      i++;
+    }
+  next = c->num_codes;
+  emit (c, OP_NEXT_FRAME);
+  emit (c, add_lit (c, frame));
+  emit (c, num_vars);
+  track (c, -num_vars);
+  emit (c, OP_JUMP);
+  emit (c, loop);
+
+  patch_jumps (c, done);
+  if (! SCHEME_NULLP (SCHEME_CDR (test_clause)))
+    {
+      emit (c, OP_POP);
+      track (c, -1);
+      compile_seq (c, SCHEME_CDR (test_clause), frame, tail);
+    }
+  else
+    {
+      finish (c, tail);
+    }
+  if (captures == scheme_capture_count && num_vars <= SCHEME_STACK_FRAME)
+    {
+      c->codes[first] = OP_STACK_FRAME;
+      c->codes[next] = OP_NEXT_STACK_FRAME;
+    }
+  if (! tail)
+    {
+      emit (c, OP_POP_FRAME);
+    }
+}
+
+/* compiler helpers */
+
+/* Check a list of bindings (or `do' specs) closely enough that
+   compiling it cannot fail. */
+static int
+bindings_ok (Scheme_Value bindings, int need_init)
+{
+  Scheme_Value binding;
+
+  while (SCHEME_PAIRP (bindings))
+    {
+      binding = SCHEME_CAR (bindings);
+      if (! SCHEME_PAIRP (binding) || ! SCHEME_SYMBOLP (SCHEME_CAR (binding))
+	  || ! SCHEME_PAIRP (SCHEME_CDR (binding)))
+	{
+	  return (0);
+	}
+      if (need_init && ! SCHEME_NULLP (SCHEME_CDDR (binding)))
+	{
+	  return (0);
+	}
+      if (! need_init && ! SCHEME_NULLP (SCHEME_CDDR (binding))
+	  && ! SCHEME_PAIRP (SCHEME_CDDR (binding)))
+	{
+	  return (0);
+	}
+      bindings = SCHEME_CDR (bindings);
+    }
+  return (SCHEME_NULLP (bindings));
+}
+
+static Scheme_Env *
+binding_scope (Scheme_Value bindings, Scheme_Env *scope)
+{
+  Scheme_Env *frame;
+  int i;
+
+  frame = scheme_new_frame (scheme_list_length (bindings));
+  for ( i=0 ; ! SCHEME_NULLP (bindings) ; ++i )
+    {
+      scheme_add_binding (i, SCHEME_CAAR (bindings), scheme_false, frame);
+      bindings = SCHEME_CDR (bindings);
+    }
+  return (scheme_extend_env (frame, scope));
+}
+
+static void
+emit (Compiler *c, int code)
+{
+  if (c->num_codes == c->max_codes)
+    {
+      int *codes;
+
+      c->max_codes = c->max_codes ? 2 * c->max_codes : 32;
+      codes = (int *) scheme_malloc_atomic (c->max_codes * sizeof (int));
+      memcpy (codes, c->codes, c->num_codes * sizeof (int));
+      c->codes = codes;
+    }
+  c->codes[c->num_codes++] = code;
+}
+
+static int
+add_lit (Compiler *c, void *lit)
+{
+  if (c->num_lits == c->max_lits)
+    {
+      void **lits;
+
+      c->max_lits = c->max_lits ? 2 * c->max_lits : 8;
+      lits = (void **) scheme_malloc (c->max_lits * sizeof (void *));
+      memcpy (lits, c->lits, c->num_lits * sizeof (void *));
+      c->lits = lits;
+    }
+  c->lits[c->num_lits] = lit;
+  return (c->num_lits++);
+}
+
+/* Forward jumps to the same place are chained through their
+   operands until the place is known. */
+static int
+emit_jump (Compiler *c, int op, int chain)
+{
+  emit (c, op);
+  emit (c, chain);
+  return (c->num_codes - 1);
+}
+
+static void
+patch_jumps (Compiler *c, int chain)
+{
+  int next;
+
+  while (chain >= 0)
+    {
+      next = c->codes[chain];
+      c->codes[chain] = c->num_codes;
+      chain = next;
+    }
+}
+
+/* keep track of how deep the value stack gets */
+static void
+track (Compiler *c, int n)
+{
+  c->depth += n;
+  if (c->depth > c->max_depth)
+    {
+      c->max_depth = c->depth;
+    }
+}
+
+static Scheme_Value
+make_code (Compiler *c, Scheme_Value form)
+{
+  Scheme_Value obj;
+  Scheme_Bytecode *code;
+
+  obj = scheme_alloc_object (scheme_compiled_type, sizeof (Scheme_Bytecode));
+  code = (Scheme_Bytecode *) SCHEME_PTR_VAL (obj);
+  code->codes = c->codes;
+  code->num_codes = c->num_codes;
+  code->lits = c->lits;
+  code->num_lits = c->num_lits;
+  code->max_stack = c->max_depth;
+  code->form = form;
+  code->lambda = NULL;
+  return (obj);
+}
+
+/* the machine */
+
+#ifdef __GNUC__
+#define VM_THREADED
+#endif
+
+#ifdef VM_THREADED
+#define VM_CASE(op)  lbl_##op
+#define VM_NEXT      goto *dispatch[*pc++]
+#else
+#define VM_CASE(op)  case op
+#define VM_NEXT      goto next
+#endif
+
+#define LIT(k)       (code->lits[k])
+
+/* Make room for N more values, moving the stack to the heap when
+   the one on the C stack runs out. */
+#define VM_RESERVE(n) \
+  if (sp + (n) + VM_SAVED > limit) \
+    { \
+      int size, used, base; \
+      Scheme_Value *bigger; \
+      size = 2 * (limit - stack) + (n) + VM_SAVED; \
+      if (size > SCHEME_VM_MAX_STACK) \
+	{ \
+	  scheme_signal_error ("stack overflow"); \
+	} \
+      used = sp - stack; \
+      base = fp - stack; \
+      bigger = (Scheme_Value *) scheme_malloc (size * sizeof (Scheme_Value)); \
+      memcpy (bigger, stack, used * sizeof (Scheme_Value)); \
+      stack = bigger; \
+      limit = stack + size; \
+      sp = stack + used; \
+      fp = stack + base; \
+    }
+
+/* Make FRAME the frame for applying LAMBDA to the N values on top of
+   the stack.  It is one of the machine's own when nothing in the body
+   can capture it, which is reused once the call returns. */
+#define VM_BIND(n) \
+  if (lambda->stack_frame && num_frames < SCHEME_VM_FRAMES) \
+    { \
+      frame = scheme_stack_frame (&frames[num_frames], frame_values[num_frames], \
+				  lambda->num_params, lambda->symbols); \
+      frame = scheme_fill_frame (lambda, frame, (n), sp - (n)); \
+      num_frames++; \
+    } \
+  else \
+    { \
+      frame = scheme_bind_args (lambda, (n), sp - (n)); \
+    }
+
+static Scheme_Env *
+vm_frame (Scheme_Env *scope, Scheme_Env *env)
+{
+  Scheme_Env *frame;
+
+  frame = scheme_alloc_frame ();
+  frame->num_bindings = scope->num_bindings;
+  frame->symbols = scope->symbols;
+  frame->values = (Scheme_Value *) scheme_malloc (scope->num_bindings * sizeof (Scheme_Value));
+  SCHEME_PROFILE (SCHEME_PROFILE_FRAME, sizeof (Scheme_Env) + scope->num_bindings * sizeof (Scheme_Value));
+  frame->globals = env->globals;
+  frame->next = env;
+  frame->on_stack = 0;
+  frame->frozen = 0;
+  return (frame);
+}
+
+/* ENV may hold frames of the machine's own, so this runs in a copy of
+   it, as late_syntax in scheme_eval.c does. */
+static Scheme_Value
+vm_syntax (Scheme_Value rator, Scheme_Value form, Scheme_Env *env)
+{
+  Scheme_Value val;
+  Scheme_Env *heap;
+
+  heap = scheme_heap_env (env);
+  if (SCHEME_SYNTAXP (rator))
+    {
+      val = scheme_eval_syntax (rator, form, heap);
+    }
+  else
+    {
+      form = scheme_apply_to_list ((Scheme_Value) SCHEME_PTR_VAL (rator), SCHEME_CDR (form));
+      val = scheme_eval (form, heap);
+    }
+  scheme_sync_env (env, heap);
+  return (val);
+}
+
+static Scheme_Value
+execute (Scheme_Bytecode *code, Scheme_Env *env)
+{
+  Scheme_Value initial[SCHEME_VM_STACK];
+  Scheme_Value *stack, *limit, *sp, *fp;
+  Scheme_Value val, rator;
+  Scheme_Env *frame;
+  Scheme_Env frames[SCHEME_VM_FRAMES];
+  Scheme_Value frame_values[SCHEME_VM_FRAMES][SCHEME_STACK_FRAME];
+  Scheme_Global_Cell *cell;
+  Scheme_Lambda *lambda;
+  int *pc;
+  int calls, num_frames, n, i;
+#ifdef VM_THREADED
+  static void *dispatch[] =
+  {
+    [OP_CONST] = &&lbl_OP_CONST,
+    [OP_LOCAL0] = &&lbl_OP_LOCAL0,
+    [OP_LOCAL1] = &&lbl_OP_LOCAL1,
+    [OP_LOCAL] = &&lbl_OP_LOCAL,
+    [OP_GLOBAL] = &&lbl_OP_GLOBAL,
+    [OP_RATOR] = &&lbl_OP_RATOR,
+    [OP_SET_LOCAL] = &&lbl_OP_SET_LOCAL,
+    [OP_SET_GLOBAL] = &&lbl_OP_SET_GLOBAL,
+    [OP_DEFINE] = &&lbl_OP_DEFINE,
+    [OP_POP] = &&lbl_OP_POP,
+    [OP_JUMP] = &&lbl_OP_JUMP,
+    [OP_JUMP_FALSE] = &&lbl_OP_JUMP_FALSE,
+    [OP_JUMP_TRUE] = &&lbl_OP_JUMP_TRUE,
+    [OP_AND_JUMP] = &&lbl_OP_AND_JUMP,
+    [OP_OR_JUMP] = &&lbl_OP_OR_JUMP,
+    [OP_CLOSURE] = &&lbl_OP_CLOSURE,
+    [OP_MAKE_FRAME] = &&lbl_OP_MAKE_FRAME,
+    [OP_NEXT_FRAME] = &&lbl_OP_NEXT_FRAME,
+    [OP_STACK_FRAME] = &&lbl_OP_STACK_FRAME,
+    [OP_NEXT_STACK_FRAME] = &&lbl_OP_NEXT_STACK_FRAME,
+    [OP_EMPTY_FRAME] = &&lbl_OP_EMPTY_FRAME,
+    [OP_POP_FRAME] = &&lbl_OP_POP_FRAME,
+    [OP_INSERT] = &&lbl_OP_INSERT,
+    [OP_NODE] = &&lbl_OP_NODE,
+    [OP_TAIL_NODE] = &&lbl_OP_TAIL_NODE,
+    [OP_CALL] = &&lbl_OP_CALL,
+    [OP_TAIL_CALL] = &&lbl_OP_TAIL_CALL,
+    [OP_RETURN] = &&lbl_OP_RETURN
+  };
+#endif
+
+  stack = sp = fp = initial;
+  limit = initial + SCHEME_VM_STACK;
+  VM_RESERVE (code->max_stack);
+  pc = code->codes;
+  calls = 0;
+  num_frames = 0;
+
+#ifdef VM_THREADED
+  VM_NEXT;
+#else
+ next:
+  switch (*pc++)
+#endif
+    {
+    VM_CASE (OP_CONST):
+      *sp++ = (Scheme_Value) LIT (pc[0]);
+      pc += 1;
+      VM_NEXT;
+
+    VM_CASE (OP_LOCAL0):
+      *sp++ = env->values[pc[0]];
+      pc += 1;
+      VM_NEXT;
+
+    VM_CASE (OP_LOCAL1):
+      *sp++ = env->next->values[pc[0]];
+      pc += 1;
+      VM_NEXT;
+
+    VM_CASE (OP_LOCAL):
+      frame = env;
+      for ( n=pc[0] ; n>0 ; --n )
+	{
+	  frame = frame->next;
+	}
+      *sp++ = frame->values[pc[1]];
+      pc += 2;
+      VM_NEXT;
+
+    VM_CASE (OP_GLOBAL):
+      cell = (Scheme_Global_Cell *) LIT (pc[0]);
+      val = cell->val;
+      if (! val && ! (val = scheme_base_value (cell)))
+	{
+	  scheme_signal_error ("reference to unbound symbol: %s", cell->name);
+	}
+      *sp++ = val;
+      pc += 1;
+      VM_NEXT;
+
+    VM_CASE (OP_RATOR):
+      cell = (Scheme_Global_Cell *) LIT (pc[0]);
+      val = cell->val;
+      if (! val && ! (val = scheme_base_value (cell)))
+	{
+	  scheme_signal_error ("reference to unbound symbol: %s", cell->name);
+	}
+      if (SCHEME_SYNTAXP (val) || SCHEME_MACROP (val))
+	{
+	  /* syntax that was not known when this was compiled */
+	  *sp++ = vm_syntax (val, (Scheme_Value) LIT (pc[1]), env);
+	  pc = code->codes + pc[2];
+	  VM_NEXT;
+	}
+      *sp++ = val;
+      pc += 3;
+      VM_NEXT;
+
+    VM_CASE (OP_SET_LOCAL):
+      frame = env;
+      for ( n=pc[0] ; n>0 ; --n )
+	{
+	  frame = frame->next;
+	}
+      if (frame->frozen)
+	{
+	  scheme_signal_error ("set!: variable is frozen: %s",
+			       SCHEME_STR_VAL (frame->symbols[pc[1]]));
+	}
+      frame->values[pc[1]] = sp[-1];
+      SCHEME_GC_WRITE (&frame->values[pc[1]]);
+      pc += 2;
+      VM_NEXT;
+
+    VM_CASE (OP_SET_GLOBAL):
+      cell = (Scheme_Global_Cell *) LIT (pc[0]);
+      if (! cell->val && ! scheme_base_value (cell))
+	{
+	  scheme_signal_error ("set!: var unbound: %s", cell->name);
+	}
+      cell->val = sp[-1];
+      SCHEME_GC_WRITE (&cell->val);
+      pc += 1;
+      VM_NEXT;
+
+    VM_CASE (OP_DEFINE):
+      ((Scheme_Global_Cell *) LIT (pc[1]))->val = sp[-1];
+      SCHEME_GC_WRITE (&((Scheme_Global_Cell *) LIT (pc[1]))->val);
+      sp[-1] = (Scheme_Value) LIT (pc[0]);
+      pc += 2;
+      VM_NEXT;
+
+    VM_CASE (OP_POP):
+      sp--;
+      VM_NEXT;
+
+    VM_CASE (OP_JUMP):
+      pc = code->codes + pc[0];
+      VM_NEXT;
+
+    VM_CASE (OP_JUMP_FALSE):
+      if (*--sp == scheme_false)
+	{
+	  pc = code->codes + pc[0];
+	}
+      else
+	{
+	  pc += 1;
+	}
+      VM_NEXT;
+
+    VM_CASE (OP_JUMP_TRUE):
+      if (*--sp != scheme_false)
+	{
+	  pc = code->codes + pc[0];
+	}
+      else
+	{
+	  pc += 1;
+	}
+      VM_NEXT;
+
+    VM_CASE (OP_AND_JUMP):
+      if (sp[-1] == scheme_false)
+	{
+	  pc = code->codes + pc[0];
+	}
+      else
+	{
+	  sp--;
+	  pc += 1;
+	}
+      VM_NEXT;
+
+    VM_CASE (OP_OR_JUMP):
+      if (sp[-1] != scheme_false)
+	{
+	  pc = code->codes + pc[0];
+	}
+      else
+	{
+	  sp--;
+	  pc += 1;
+	}
+      VM_NEXT;
+
+    VM_CASE (OP_CLOSURE):
+      *sp++ = scheme_make_lambda_closure (env, (Scheme_Lambda *) LIT (pc[0]));
+      pc += 1;
+      VM_NEXT;
+
+    VM_CASE (OP_MAKE_FRAME):
+    lbl_make_frame:
+      n = pc[1];
+      frame = vm_frame ((Scheme_Env *) LIT (pc[0]), env);
+      sp -= n;
+      memcpy (frame->values, sp, n * sizeof (Scheme_Value));
+      env = frame;
+      pc += 2;
+      VM_NEXT;
+
+    VM_CASE (OP_NEXT_FRAME):
+    lbl_next_frame:
+      n = pc[1];
+      frame = vm_frame ((Scheme_Env *) LIT (pc[0]), env->next);
+      sp -= n;
+      memcpy (frame->values, sp, n * sizeof (Scheme_Value));
+      env = frame;
+      pc += 2;
+      VM_NEXT;
+
+    VM_CASE (OP_STACK_FRAME):
+      if (num_frames == SCHEME_VM_FRAMES)
+	{
+	  goto lbl_make_frame;
+	}
+      n = pc[1];
+      frame = (Scheme_Env *) LIT (pc[0]);
+      frame = scheme_stack_frame (&frames[num_frames], frame_values[num_frames],
+				  frame->num_bindings, frame->symbols);
+      num_frames++;
+      sp -= n;
+      memcpy (frame->values, sp, n * sizeof (Scheme_Value));
+      env = scheme_extend_env (frame, env);
+      pc += 2;
+      VM_NEXT;
+
+    VM_CASE (OP_NEXT_STACK_FRAME):
+      if (! num_frames || env != &frames[num_frames - 1])
+	{
+	  /* the first frame did not fit */
+	  goto lbl_next_frame;
+	}
+      n = pc[1];
+      sp -= n;
+      memcpy (env->values, sp, n * sizeof (Scheme_Value));
+      pc += 2;
+      VM_NEXT;
+
+    VM_CASE (OP_EMPTY_FRAME):
+      frame = vm_frame ((Scheme_Env *) LIT (pc[0]), env);
+      for ( i=0 ; i<frame->num_bindings ; ++i )
+	{
+	  frame->values[i] = scheme_false;
+	}
+      env = frame;
+      pc += 1;
+      VM_NEXT;
+
+    VM_CASE (OP_POP_FRAME):
+      if (num_frames && env == &frames[num_frames - 1])
+	{
+	  num_frames--;
+	}
+      env = env->next;
+      VM_NEXT;
+
+    VM_CASE (OP_INSERT):
+      n = pc[0];
+      val = sp[-1];
+      memmove (sp - n, sp - n - 1, n * sizeof (Scheme_Value));
+      sp[-n - 1] = val;
+      pc += 1;
+      VM_NEXT;
+
+    VM_CASE (OP_NODE):
+      *sp++ = SCHEME_EVAL_NODE ((Scheme_Node *) LIT (pc[0]), env);
+      pc += 1;
+      VM_NEXT;
+
+    VM_CASE (OP_CALL):
+      n = pc[0];
+      rator = sp[-n - 1];
+      if (SCHEME_CLOSUREP (rator)
+	  && (SCHEME_CLOS_LAMBDA (rator)->body->eval == bytecode_eval))
+	{
+	  lambda = SCHEME_CLOS_LAMBDA (rator);
+	  i = num_frames;
+	  VM_BIND (n);
+	  sp -= n + 1;
+	  sp[0] = (Scheme_Value) code;
+	  sp[1] = (Scheme_Value) (pc + 1);
+	  sp[2] = (Scheme_Value) env;
+	  sp[3] = (Scheme_Value) (fp - stack);
+	  sp[4] = (Scheme_Value) (long) i;
+	  sp += VM_SAVED;
+	  fp = sp;
+	  calls++;
+	  env = scheme_extend_env (frame, SCHEME_CLOS_ENV (rator));
+	  code = (Scheme_Bytecode *) SCHEME_PTR_VAL (SCHEME_NODE_VAL (lambda->body));
+	  SCHEME_PROFILE_ENTER (lambda);
+	  pc = code->codes;
+	  VM_RESERVE (code->max_stack);
+	  VM_NEXT;
+	}
+      if (SCHEME_PRIMP (rator))
+	{
+	  val = scheme_apply_prim (rator, n, sp - n);
+	}
+      else
+	{
+	  val = scheme_apply (rator, n, sp - n);
+	}
+      sp -= n;
+      sp[-1] = val;
+      pc += 1;
+      VM_NEXT;
+
+    VM_CASE (OP_TAIL_NODE):
+      val = SCHEME_EVAL_NODE ((Scheme_Node *) LIT (pc[0]), env);
+      if (val != scheme_tail_call)
+	{
+	  goto do_return;
+	}
+      n = scheme_pending_call.num_rands;
+      VM_RESERVE (n + 1);
+      *sp++ = scheme_pending_call.rator;
+      memcpy (sp, scheme_pending_call.rands, n * sizeof (Scheme_Value));
+      sp += n;
+      goto tail_call;
+
+    VM_CASE (OP_TAIL_CALL):
+      n = pc[0];
+    tail_call:
+      rator = sp[-n - 1];
+      if (SCHEME_PRIMP (rator))
+	{
+	  if (! scheme_applyp (rator))
+	    {
+	      val = scheme_apply_prim (rator, n, sp - n);
+	      goto do_return;
+	    }
+	  /* keep a tail call through apply a tail call */
+	  i = n;
+	  VM_RESERVE (SCHEME_MAX_ARGS);
+	  rator = scheme_unwrap_apply (rator, &n, sp - i);
+	  sp[-i - 1] = rator;
+	  sp += n - i;
+	}
+      if (SCHEME_CLOSUREP (rator)
+	  && (SCHEME_CLOS_LAMBDA (rator)->body->eval == bytecode_eval))
+	{
+	  lambda = SCHEME_CLOS_LAMBDA (rator);
+	  /* the frame of the current call is dead */
+	  num_frames = calls ? (long) fp[-1] : 0;
+	  VM_BIND (n);
+	  sp = fp;
+	  env = scheme_extend_env (frame, SCHEME_CLOS_ENV (rator));
+	  code = (Scheme_Bytecode *) SCHEME_PTR_VAL (SCHEME_NODE_VAL (lambda->body));
+	  SCHEME_PROFILE_ENTER (lambda);
+	  pc = code->codes;
+	  VM_RESERVE (code->max_stack);
+	  VM_NEXT;
+	}
+      val = scheme_apply (rator, n, sp - n);
+      goto do_return;
+
+    VM_CASE (OP_RETURN):
+      val = sp[-1];
+    do_return:
+      if (! calls)
+	{
+	  return (val);
+	}
+      calls--;
+      sp = fp - VM_SAVED;
+      code = (Scheme_Bytecode *) sp[0];
+      SCHEME_PROFILE_ENTER (code->lambda);
+      pc = (int *) sp[1];
+      env = (Scheme_Env *) sp[2];
+      fp = stack + (long) sp[3];
+      num_frames = (long) sp[4];
+      *sp++ = val;
+      VM_NEXT;
+    }
+#ifndef VM_THREADED
+  /* not reached */
+  return (scheme_false);
+#endif
+}
+
+static Scheme_Value
+bytecode_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  return (execute ((Scheme_Bytecode *) SCHEME_PTR_VAL (SCHEME_NODE_VAL (node)), env));
+}
+
+static Scheme_Value
+compile (int argc, Scheme_Value argv[])
+{
+  SCHEME_ASSERT ((argc == 1), "compile: wrong number of args");
+  return (scheme_compile (argv[0], scheme_env));
+}
@@ -33,9 +33,43 @@
 #define SCHEME_MAX_ARGS 256
 /* maximum length of symbols */
 #define SCHEME_MAX_SYM 1024
-/* number of buckets for globals */
-#define SCHEME_GLOBAL_BUCKETS 100313
-/* number of buckets for symbols */
-#define SCHEME_SYMBOL_BUCKETS 1023
+/* initial sizes of the globals and symbol tables; they grow by
+   doubling when SCHEME_HASH_LOAD percent of their entries are used */
+#define SCHEME_GLOBAL_TABLE_SIZE 512
+#define SCHEME_SYMBOL_TABLE_SIZE 512
+#define SCHEME_MODULE_TABLE_SIZE 64
+#define SCHEME_HASH_LOAD 70
+/* initial and maximum size of the bytecode value stack */
+#define SCHEME_VM_STACK 256
+#define SCHEME_VM_MAX_STACK (1 << 22)
+/* largest frame kept on the C stack when nothing can capture it, and
+   how many such frames a run of the bytecode machine keeps */
+#define SCHEME_STACK_FRAME 8
+#define SCHEME_VM_FRAMES 32
+/* precise collector (PRECISE_GC): log2 of the block and card sizes,
+   nursery size in blocks, and the address space reserved for the heap */
+#define SCHEME_GC_BLOCK_SHIFT 15
+#define SCHEME_GC_CARD_SHIFT 9
+#ifndef SCHEME_GC_NURSERY
+#define SCHEME_GC_NURSERY 128
+#endif
+#define SCHEME_GC_HEAP ((size_t) 1 << 31)
+/* allocation profiler (SCHEME_PROFILE_ALLOC): one allocation in this
+   many is charged to the running procedure, and at most this many
+   procedures are told apart */
+#define SCHEME_PROFILE_SAMPLE 64
+#define SCHEME_PROFILE_SITES 1024
+/* parallel procedures (SCHEME_THREADS): shorter sequences are done
+   by the calling thread alone, longer ones cut into this many chunks
+   per thread.  At most this many workers are started, and each
+   deque of tasks starts this large. */
+#define SCHEME_PARALLEL_MIN 64
+#define SCHEME_PARALLEL_CHUNKS 8
+#define SCHEME_PARALLEL_WORKERS 64
+#define SCHEME_PARALLEL_DEQUE 64
+/* longest error message kept from a pool task, see scheme_parallel.c */
+#define SCHEME_TASK_ERROR 1024
+/* initial size of the buffer of an unbounded channel */
+#define SCHEME_CHANNEL_SIZE 16
 
 #endif /* !SCHEME_CONFIG_H */
@@ -0,0 +1,135 @@
+/*
+  libscheme
+  Copyright (c) 1994 Brent Benson
+  All rights reserved.
+
+  Permission is hereby granted, without written agreement and without
+  license or royalty fees, to use, copy, modify, and distribute this
+  software and its documentation for any purpose, provided that the
+  above copyright notice and the following two paragraphs appear in
+  all copies of this software.
+
+  IN NO EVENT SHALL BRENT BENSON BE LIABLE TO ANY PARTY FOR DIRECT,
+  INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES ARISING OUT
+  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF BRENT
+  BENSON HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+  BRENT BENSON SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT
+  NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER
+  IS ON AN "AS IS" BASIS, AND BRENT BENSON HAS NO OBLIGATION TO
+  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR
+  MODIFICATIONS.
+*/
+
+/* Contexts hold the state of an interpreter: the environment, the
+   error handler, the current ports and the bookkeeping of calls and
+   continuations.  The thread that calls scheme_basic_env runs in the
+   main context.  Built with SCHEME_THREADS, any other thread may run
+   an interpreter once it is attached to a context of its own:
+
+     context = scheme_make_context (scheme_clone_env (env));
+     scheme_attach_thread (context);
+     SCHEME_CATCH_ERROR (scheme_eval (obj, scheme_env), 0);
+     scheme_detach_thread ();
+     scheme_free_context (context);
+
+   Contexts running at once may share an environment: its globals
+   table is locked while it is searched or changed, and a global's
+   value is read and set in a single word.  A clone of it gives a
+   context definitions of its own.  Types and interned symbols are
+   shared by all contexts. */
+
+#include "scheme_private.h"
+
+/* locals */
+static Scheme_Context main_context;
+
+/* globals */
+SCHEME_THREAD_LOCAL Scheme_Context *scheme_context = &main_context;
+
+void
+scheme_init_context (Scheme_Env *env)
+{
+#ifdef SCHEME_THREADS
+  scheme_gc_init_threads ();
+#endif
+}
+
+/* Make a context running in ENV and reading and writing the
+   standard ports.  It is a root for the collectors until it is
+   freed. */
+Scheme_Context *
+scheme_make_context (Scheme_Env *env)
+{
+  Scheme_Context *context;
+
+  context = (Scheme_Context *) calloc (1, sizeof (Scheme_Context));
+  SCHEME_ASSERT ((context != NULL), "memory allocation failure");
+  context->env = env;
+  context->in_port = scheme_stdin_port;
+  context->out_port = scheme_stdout_port;
+  context->error_port = scheme_stderr_port;
+  scheme_gc_add_roots (context, context + 1);
+  return (context);
+}
+
+void
+scheme_free_context (Scheme_Context *context)
+{
+  SCHEME_ASSERT ((context != &main_context), "cannot free the main context");
+  scheme_gc_remove_roots (context, context + 1);
+  free (context);
+}
+
+Scheme_Context *
+scheme_current_context (void)
+{
+  return (scheme_context);
+}
+
+/* Run the calling thread in CONTEXT from now on, returning the
+   context it ran in before. */
+Scheme_Context *
+scheme_set_context (Scheme_Context *context)
+{
+  Scheme_Context *old = scheme_context;
+
+  scheme_context = context;
+  return (old);
+}
+
+/* Run a thread the library did not start in CONTEXT, making it known
+   to the collector first.  It is detached before it exits. */
+void
+scheme_attach_thread (Scheme_Context *context)
+{
+#ifdef SCHEME_THREADS
+  scheme_gc_register_thread ();
+#endif
+  scheme_context = context;
+}
+
+void
+scheme_detach_thread (void)
+{
+  scheme_context = NULL;
+#ifdef SCHEME_THREADS
+  scheme_gc_unregister_thread ();
+#endif
+}
+
+/* for code outside the library, which sees scheme_env and
+   scheme_error_buf through these */
+
+Scheme_Env **
+scheme_context_env (void)
+{
+  return (&scheme_context->env);
+}
+
+jmp_buf *
+scheme_context_error_buf (void)
+{
+  return (&scheme_context->error_buf);
+}
@@ -25,11 +25,20 @@
 #include "scheme_private.h"
 #include <ctype.h>
 
-/* globals */
-Scheme_Env *scheme_env;
-
 /* locals */
+static Scheme_Layout *frame_layout;
+static Scheme_Layout *desc_layout;
+SCHEME_DEFINE_ONCE (layouts_once);
+static void init_layouts (void);
 static Scheme_Env *scheme_make_env (void);
+/* guards every globals table, as contexts running at once share
+   those of a base environment through its clones */
+SCHEME_DEFINE_LOCK (globals_lock);
+static Scheme_Global_Cell *make_cell (Scheme_Hash_Table *globals, char *name);
+static Scheme_Global_Cell *global_cell (Scheme_Value symbol, Scheme_Env *env);
+static Scheme_Value lookup_global (Scheme_Value symbol, Scheme_Env *env);
+static void add_global (char *name, Scheme_Value obj, Scheme_Env *env);
+static Scheme_Env *top_env (Scheme_Env *env);
 
 Scheme_Env *
 scheme_basic_env (void)
@@ -55,27 +64,122 @@ scheme_basic_env (void)
   scheme_init_promise (env);
   scheme_init_struct (env);
   scheme_init_pointer (env);
+  scheme_init_compile (env);
+  scheme_init_profile (env);
+  scheme_init_image (env);
+  scheme_init_table (env);
+  scheme_init_module (env);
+  scheme_init_context (env);
+  scheme_init_freeze (env);
+  scheme_init_parallel (env);
+  scheme_init_channel (env);
   scheme_env = env;
   return (env);
 }
 
+/* the layouts are the same for every environment made */
+static void
+init_layouts (void)
+{
+  frame_layout = scheme_make_layout (sizeof (Scheme_Env),
+				     SCHEME_LAYOUT_SLOT (Scheme_Env, symbols)
+				     | SCHEME_LAYOUT_SLOT (Scheme_Env, values)
+				     | SCHEME_LAYOUT_SLOT (Scheme_Env, globals)
+				     | SCHEME_LAYOUT_SLOT (Scheme_Env, next)
+				     | SCHEME_LAYOUT_SLOT (Scheme_Env, base));
+  desc_layout = scheme_make_layout (sizeof (Scheme_Prim_Desc),
+				    SCHEME_LAYOUT_SLOT (Scheme_Prim_Desc, name));
+}
+
 static Scheme_Env *
 scheme_make_env (void)
 {
   Scheme_Env *env;
 
-  env = (Scheme_Env *) scheme_malloc (sizeof (Scheme_Env));
-  env->globals = scheme_make_hash_table (SCHEME_GLOBAL_BUCKETS);
+  SCHEME_ONCE (layouts_once, init_layouts);
+  env = scheme_alloc_frame ();
+  env->globals = scheme_make_hash_table (SCHEME_GLOBAL_TABLE_SIZE);
   env->next = NULL;
+  env->on_stack = 0;
+  env->frozen = 0;
+  env->base = NULL;
   return (env);
 }
 
+/* Make a top-level environment with globals of its own, for a module.
+   A global it lacks has the value it has in BASE, if not NULL, now and
+   later, until code here defines or assigns it: that gives the module
+   a binding of its own, so nothing defined or assigned here reaches
+   BASE. */
+Scheme_Env *
+scheme_make_module_env (Scheme_Env *base)
+{
+  Scheme_Env *env;
+
+  env = scheme_alloc_frame ();
+  env->num_bindings = 0;
+  env->symbols = NULL;
+  env->values = NULL;
+  env->next = NULL;
+  env->on_stack = 0;
+  env->frozen = 0;
+  env->base = base ? top_env (base) : NULL;
+  env->globals = scheme_make_hash_table (SCHEME_MODULE_TABLE_SIZE);
+  SCHEME_GC_WRITE (&env->globals);
+  return (env);
+}
+
+/* A copy of the top-level environment of ENV, for running code that
+   must not change it: a module on ENV, so making one takes the same
+   time however many globals ENV has.  Only definitions and
+   assignments made by code in the clone are its own; procedures
+   defined in ENV still see and change ENV's globals. */
+Scheme_Env *
+scheme_clone_env (Scheme_Env *env)
+{
+  return (scheme_make_module_env (env));
+}
+
+/* Bind SYMBOL in TO to the cell of the global SYMBOL in FROM, so that
+   each sees the other's definitions and assignments. */
+void
+scheme_import_global (Scheme_Value symbol, Scheme_Env *from, Scheme_Env *to)
+{
+  Scheme_Global_Cell *cell, *exported;
+
+  SCHEME_LOCK (globals_lock);
+  exported = global_cell (symbol, from);
+  cell = (Scheme_Global_Cell *) scheme_lookup_hashed (to->globals, SCHEME_STR_VAL (symbol), SCHEME_SYM_HASH (symbol));
+  if (! cell)
+    {
+      scheme_add_hashed (to->globals, exported->name, SCHEME_SYM_HASH (symbol), exported);
+    }
+  SCHEME_UNLOCK (globals_lock);
+  if (cell && cell != exported)
+    {
+      scheme_signal_error ("import: already defined or used: %s", SCHEME_STR_VAL (symbol));
+    }
+}
+
 void
 scheme_add_global (char *name, Scheme_Value obj, Scheme_Env *env)
 {
   char lower_name[SCHEME_MAX_SYM];
   int i;
 
+  /* most names are lower case already and need no copy */
+  for ( i=0 ; name[i] ; ++i )
+    {
+      if (isupper ((unsigned char) name[i]))
+	{
+	  break;
+	}
+    }
+  if (! name[i])
+    {
+      add_global (name, obj, env);
+      return;
+    }
   i = 0;
   while ( name[i] )
     {
@@ -83,13 +187,81 @@ scheme_add_global (char *name, Scheme_Value obj, Scheme_Env *env)
       i++;
     }
   lower_name[i] = '\0';
-  scheme_add_to_table (env->globals, lower_name, obj);
+  add_global (lower_name, obj, env);
 }
 
 void
 scheme_add_prim (char *name, Scheme_Prim *prim, Scheme_Env *env)
 {
-  scheme_add_global(name, scheme_make_prim(prim), env);
+  scheme_add_prim_arity (name, prim, 0, -1, env);
+}
+
+void
+scheme_add_prim_arity (char *name, Scheme_Prim *prim, int mina, int maxa, Scheme_Env *env)
+{
+  Scheme_Prim_Desc *desc;
+
+  desc = scheme_make_desc (name, mina, maxa);
+  desc->fun = prim;
+  scheme_add_prim_desc (desc, env);
+}
+
+void
+scheme_add_prim1 (char *name, Scheme_Prim1 *prim, Scheme_Env *env)
+{
+  Scheme_Prim_Desc *desc;
+
+  desc = scheme_make_desc (name, 1, 1);
+  desc->prim1 = prim;
+  scheme_add_prim_desc (desc, env);
+}
+
+void
+scheme_add_prim2 (char *name, Scheme_Prim2 *prim, Scheme_Env *env)
+{
+  Scheme_Prim_Desc *desc;
+
+  desc = scheme_make_desc (name, 2, 2);
+  desc->prim2 = prim;
+  scheme_add_prim_desc (desc, env);
+}
+
+void
+scheme_add_prim3 (char *name, Scheme_Prim3 *prim, Scheme_Env *env)
+{
+  Scheme_Prim_Desc *desc;
+
+  desc = scheme_make_desc (name, 3, 3);
+  desc->prim3 = prim;
+  scheme_add_prim_desc (desc, env);
+}
+
+/* Bind each primitive in the static table PRIMS; the objects are the
+   table's own, so nothing is allocated for them.  Nothing writes to a
+   primitive, so the const can be cast away. */
+void
+scheme_add_prims (const Scheme_Prim_Entry *prims, int num_prims, Scheme_Env *env)
+{
+  int i;
+
+  for ( i=0 ; i<num_prims ; ++i )
+    {
+      add_global (SCHEME_PRIM_DESC (&prims[i])->name, (Scheme_Value) &prims[i], env);
+    }
+}
+
+/* DESC is not copied, so it should be static. */
+void
+scheme_add_prim_desc (Scheme_Prim_Desc *desc, Scheme_Env *env)
+{
+  scheme_add_global (desc->name, scheme_make_prim_desc (desc), env);
+}
+
+/* A frame whose values are allocated separately. */
+Scheme_Env *
+scheme_alloc_frame (void)
+{
+  return ((Scheme_Env *) scheme_malloc_typed (sizeof (Scheme_Env), frame_layout));
 }
 
 Scheme_Env *
@@ -97,13 +269,75 @@ scheme_new_frame (int num_bindings)
 {
   Scheme_Env *frame;
 
-  frame = (Scheme_Env *) scheme_malloc (sizeof (Scheme_Env));
+  frame = scheme_alloc_frame ();
   frame->num_bindings = num_bindings;
   frame->symbols = (Scheme_Value *) scheme_malloc (num_bindings * sizeof (Scheme_Object*));
   frame->values = (Scheme_Value *) scheme_malloc (num_bindings * sizeof (Scheme_Object*));
+  frame->on_stack = 0;
+  frame->frozen = 0;
+  SCHEME_PROFILE (SCHEME_PROFILE_FRAME, sizeof (Scheme_Env) + 2 * num_bindings * sizeof (Scheme_Value));
+  return (frame);
+}
+
+/* Set up FRAME and VALUES, which the caller allocated in its own C
+   frame.  Only frames no closure or promise can capture may be made
+   this way. */
+Scheme_Env *
+scheme_stack_frame (Scheme_Env *frame, Scheme_Value *values,
+		    int num_bindings, Scheme_Value *symbols)
+{
+  frame->num_bindings = num_bindings;
+  frame->symbols = symbols;
+  frame->values = values;
+  frame->on_stack = 1;
+  frame->frozen = 0;
   return (frame);
 }
 
+/* Return ENV with any frames on the C stack copied to the heap, for
+   code that wants to hold on to an environment it was not analyzed to
+   capture.  Assignments made through the copy are not seen by the
+   original frames until scheme_sync_env copies them back. */
+Scheme_Env *
+scheme_heap_env (Scheme_Env *env)
+{
+  Scheme_Env *next, *frame;
+  int i;
+
+  if (env->next == NULL)
+    {
+      return (env);
+    }
+  next = scheme_heap_env (env->next);
+  if (next == env->next && ! env->on_stack)
+    {
+      return (env);
+    }
+  frame = scheme_new_frame (env->num_bindings);
+  for ( i=0 ; i<env->num_bindings ; ++i )
+    {
+      scheme_add_binding (i, env->symbols[i], env->values[i], frame);
+    }
+  return (scheme_extend_env (frame, next));
+}
+
+/* Copy the values of COPY, made from ENV by scheme_heap_env, back
+   into the frames of ENV it was copied from. */
+void
+scheme_sync_env (Scheme_Env *env, Scheme_Env *copy)
+{
+  int i;
+
+  for ( ; env != copy ; env=env->next, copy=copy->next )
+    {
+      for ( i=0 ; i<env->num_bindings ; ++i )
+	{
+	  env->values[i] = copy->values[i];
+	  SCHEME_GC_WRITE (&env->values[i]);
+	}
+    }
+}
+
 void
 scheme_add_binding (int index, Scheme_Value sym, Scheme_Value val, Scheme_Env *frame)
 {
@@ -113,6 +347,7 @@ scheme_add_binding (int index, Scheme_Value sym, Scheme_Value val, Scheme_Env *f
     }
   frame->symbols[index] = sym;
   frame->values[index] = val;
+  SCHEME_GC_WRITE (&frame->values[index]);
 }
 
 Scheme_Env *
@@ -129,11 +364,12 @@ scheme_add_frame (Scheme_Value syms, Scheme_Value vals, Scheme_Env *env)
   Scheme_Env *frame;
   int len, i;
 
-  frame = (Scheme_Env *) scheme_malloc (sizeof (Scheme_Env));
+  frame = scheme_alloc_frame ();
   len = scheme_list_length (syms);
   frame->num_bindings = len;
   frame->symbols = (Scheme_Value *) scheme_malloc (len * sizeof (Scheme_Object*));
   frame->values = (Scheme_Value *) scheme_malloc (len * sizeof (Scheme_Object*));
+  SCHEME_PROFILE (SCHEME_PROFILE_FRAME, sizeof (Scheme_Env) + 2 * len * sizeof (Scheme_Value));
   for ( i=0 ; i<len ; ++i )
     {
       if (SCHEME_SYMBOLP(syms))
@@ -151,6 +387,8 @@ scheme_add_frame (Scheme_Value syms, Scheme_Value vals, Scheme_Env *env)
     }
   frame->globals = env->globals;
   frame->next = env;
+  frame->on_stack = 0;
+  frame->frozen = 0;
   scheme_env = frame;
   return (frame);
 }
@@ -178,16 +416,35 @@ scheme_set_value (Scheme_Value symbol, Scheme_Value val, Scheme_Env *env)
 	  if (symbol == frame->symbols[i])
 	    {
 	      frame->values[i] = val;
+	      SCHEME_GC_WRITE (&frame->values[i]);
 	      return;
 	    }
 	}
       frame = frame->next;
     }
-  if (scheme_lookup_global (symbol, frame))
+  scheme_set_global (symbol, val, frame);
+}
+
+void
+scheme_set_global (Scheme_Value symbol, Scheme_Value val, Scheme_Env *env)
+{
+  Scheme_Global_Cell *cell;
+  int bound;
+
+  SCHEME_LOCK (globals_lock);
+  cell = (Scheme_Global_Cell *) scheme_lookup_hashed (env->globals, SCHEME_STR_VAL (symbol), SCHEME_SYM_HASH (symbol));
+  if (! cell && top_env (env)->base)
+    {
+      cell = global_cell (symbol, env);
+    }
+  bound = cell && (cell->val || scheme_base_value (cell));
+  if (bound)
     {
-      scheme_change_in_table (frame->globals, SCHEME_STR_VAL (symbol), val);
+      cell->val = val;
+      SCHEME_GC_WRITE (&cell->val);
     }
-  else
+  SCHEME_UNLOCK (globals_lock);
+  if (! bound)
     {
       scheme_signal_error ("set!: var unbound: %s", SCHEME_STR_VAL(symbol));
     }
@@ -215,8 +472,165 @@ scheme_lookup_value (Scheme_Value symbol, Scheme_Env *env)
   return (scheme_lookup_global (symbol, frame));
 }
 
+/* Find the lexical address of SYMBOL in ENV: the number of frames
+   to skip and the slot within that frame.  Returns 0 for globals. */
+int
+scheme_lexical_address (Scheme_Value symbol, Scheme_Env *env, int *depth, int *index)
+{
+  Scheme_Env *frame;
+  int d, i;
+
+  d = 0;
+  frame = env;
+  while ( frame->next != NULL )
+    {
+      for ( i=0 ; i<frame->num_bindings ; ++i )
+	{
+	  if (symbol == frame->symbols[i])
+	    {
+	      *depth = d;
+	      *index = i;
+	      return (1);
+	    }
+	}
+      frame = frame->next;
+      d++;
+    }
+  return (0);
+}
+
 Scheme_Value
 scheme_lookup_global (Scheme_Value symbol, Scheme_Env *env)
 {
-  return (scheme_lookup_in_table (env->globals, SCHEME_STR_VAL(symbol)));
+  Scheme_Value val;
+
+  SCHEME_LOCK (globals_lock);
+  val = lookup_global (symbol, env);
+  SCHEME_UNLOCK (globals_lock);
+  return (val);
+}
+
+/* Return the cell for global SYMBOL, creating an unbound one if the
+   variable has not been defined yet.  In a module the new cell is
+   linked to the base's, which is made too if need be, so that a
+   definition there is seen here. */
+Scheme_Global_Cell *
+scheme_global_cell (Scheme_Value symbol, Scheme_Env *env)
+{
+  Scheme_Global_Cell *cell;
+
+  SCHEME_LOCK (globals_lock);
+  cell = global_cell (symbol, env);
+  SCHEME_UNLOCK (globals_lock);
+  return (cell);
+}
+
+/* The value an unbound CELL has from the base of its module, or NULL:
+   the slow path of a global reference. */
+Scheme_Value
+scheme_base_value (Scheme_Global_Cell *cell)
+{
+  for ( cell=cell->base ; cell ; cell=cell->base )
+    {
+      if (cell->val)
+	{
+	  return (cell->val);
+	}
+    }
+  return (NULL);
+}
+
+/* scheme_global_cell and scheme_lookup_global, holding the lock */
+static Scheme_Global_Cell *
+global_cell (Scheme_Value symbol, Scheme_Env *env)
+{
+  Scheme_Global_Cell *cell, *base_cell;
+  Scheme_Env *base;
+
+  cell = (Scheme_Global_Cell *) scheme_lookup_hashed (env->globals, SCHEME_STR_VAL (symbol), SCHEME_SYM_HASH (symbol));
+  if (! cell)
+    {
+      base = top_env (env)->base;
+      base_cell = base ? global_cell (symbol, base) : NULL;
+      cell = make_cell (env->globals, SCHEME_STR_VAL(symbol));
+      cell->base = base_cell;
+      SCHEME_GC_WRITE (&cell->base);
+    }
+  return (cell);
+}
+
+static Scheme_Value
+lookup_global (Scheme_Value symbol, Scheme_Env *env)
+{
+  Scheme_Global_Cell *cell;
+
+  cell = (Scheme_Global_Cell *) scheme_lookup_hashed (env->globals, SCHEME_STR_VAL (symbol), SCHEME_SYM_HASH (symbol));
+  if (cell)
+    {
+      return (cell->val ? cell->val : scheme_base_value (cell));
+    }
+  env = top_env (env)->base;
+  return (env ? lookup_global (symbol, env) : NULL);
+}
+
+/* bind NAME, which is in lower case, to OBJ */
+static void
+add_global (char *name, Scheme_Value obj, Scheme_Env *env)
+{
+  Scheme_Global_Cell *cell;
+
+  SCHEME_LOCK (globals_lock);
+  cell = (Scheme_Global_Cell *) scheme_lookup_in_table (env->globals, name);
+  if (! cell)
+    {
+      cell = make_cell (env->globals, name);
+    }
+  else if (cell->home != env->globals)
+    {
+      SCHEME_UNLOCK (globals_lock);
+      scheme_signal_error ("define: cannot redefine imported variable: %s", name);
+    }
+  cell->val = obj;
+  SCHEME_GC_WRITE (&cell->val);
+  SCHEME_UNLOCK (globals_lock);
+}
+
+static Scheme_Global_Cell *
+make_cell (Scheme_Hash_Table *globals, char *name)
+{
+  Scheme_Global_Cell *cell;
+
+  cell = (Scheme_Global_Cell *) scheme_malloc (sizeof (Scheme_Global_Cell));
+  cell->val = NULL;
+  cell->base = NULL;
+  cell->home = globals;
+  cell->name = scheme_strdup (name);
+  scheme_add_to_table (globals, cell->name, cell);
+  return (cell);
+}
+
+static Scheme_Env *
+top_env (Scheme_Env *env)
+{
+  while (env->next)
+    {
+      env = env->next;
+    }
+  return (env);
+}
+
+Scheme_Prim_Desc *
+scheme_make_desc (char *name, int mina, int maxa)
+{
+  Scheme_Prim_Desc *desc;
+
+  desc = (Scheme_Prim_Desc *) scheme_malloc_typed (sizeof (Scheme_Prim_Desc), desc_layout);
+  desc->name = name;
+  desc->fun = NULL;
+  desc->mina = mina;
+  desc->maxa = maxa;
+  desc->prim1 = NULL;
+  desc->prim2 = NULL;
+  desc->prim3 = NULL;
+  return (desc);
 }
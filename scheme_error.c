@@ -22,21 +22,24 @@
   MODIFICATIONS.
 */
 
-#include "scheme.h"
+#include "scheme_private.h"
 #include <stdio.h>
 
-/* globals */
-jmp_buf scheme_error_buf;
-
 /* locals */
+static FILE *error_stream (void);
 static Scheme_Value error (int argc, Scheme_Value argv[]);
 static Scheme_Value scheme_exit (int argc, Scheme_Value argv[]);
 
+static const Scheme_Prim_Entry error_prims[] =
+{
+  SCHEME_PRIM_ENTRY ("error", error, 0, -1),
+  SCHEME_PRIM_ENTRY ("exit", scheme_exit, 0, -1)
+};
+
 void
 scheme_init_error (Scheme_Env *env)
 {
-  scheme_add_prim ("error", error, env);
-  scheme_add_prim ("exit", scheme_exit, env);
+  scheme_add_prims (error_prims, SCHEME_NUM_ENTRIES (error_prims), env);
 }
 
 SCHEME_FUN_NORETURN
@@ -46,8 +49,8 @@ scheme_signal_error (char *msg, ...)
   va_list args;
   va_start (args, msg);
   /* fprintf (stderr, "error: "); */
-  vfprintf (stderr, msg, args);
-  fprintf (stderr, "\n");
+  vfprintf (error_stream (), msg, args);
+  fprintf (error_stream (), "\n");
   va_end (args);
   longjmp (scheme_error_buf, 1);
 }
@@ -69,15 +72,27 @@ error (int argc, Scheme_Value argv[])
 
   SCHEME_ASSERT ((argc > 0), "error: wrong number of args");
   SCHEME_ASSERT (SCHEME_STRINGP (argv[0]), "error: first arg must be a string");
-  fprintf (stderr, "error: %s:", SCHEME_STR_VAL (argv[0]));
+  fprintf (error_stream (), "error: %s:", SCHEME_STR_VAL (argv[0]));
   for ( i=1; i<argc ; ++i )
     {
-      scheme_write (argv[i], scheme_stderr_port);
+      scheme_write (argv[i], scheme_context->error_port);
     }
-  fprintf (stderr, "\n");
+  fprintf (error_stream (), "\n");
   longjmp (scheme_error_buf, 1);
 }
 
+/* the stream of the context's error port, which is stderr until the
+   ports are made */
+static FILE *
+error_stream (void)
+{
+  if (scheme_context->error_port)
+    {
+      return (((Scheme_Port *) SCHEME_PTR_VAL (scheme_context->error_port))->stream);
+    }
+  return (stderr);
+}
+
 void
 scheme_default_handler (void)
 {
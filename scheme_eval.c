@@ -24,14 +24,35 @@
 
 #include "scheme_private.h"
 
+/* globals */
+int scheme_engine = SCHEME_TREE_ENGINE;
+
 /* locals */
-static Scheme_Value scheme_eval_combination (Scheme_Value comb, Scheme_Env *env);
+static Scheme_Node *analyze_combination (Scheme_Value comb, Scheme_Env *env, int tail);
+static Scheme_Value const_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value local0_ref_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value local1_ref_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value local_ref_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value global_ref_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value seq_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value syntax_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value combination_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value tail_combination_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value small_combination (Scheme_Node *node, Scheme_Env *env, int tail);
+static Scheme_Value small_combination_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value small_tail_combination_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value late_syntax (Scheme_Value rator, Scheme_Node *node, Scheme_Env *env);
 static Scheme_Value eval (int argc, Scheme_Value argv[]);
 
+static const Scheme_Prim_Entry eval_prims[] =
+{
+  SCHEME_PRIM_ENTRY ("eval", eval, 0, -1)
+};
+
 void
 scheme_init_eval (Scheme_Env *env)
 {
-  scheme_add_prim ("eval", eval, env);
+  scheme_add_prims (eval_prims, SCHEME_NUM_ENTRIES (eval_prims), env);
 }
 
 Scheme_Value
@@ -53,7 +74,18 @@ scheme_eval (Scheme_Value obj, Scheme_Env *env)
     }
   else if (type == scheme_pair_type)
     {
-      return (scheme_eval_combination (obj, env));
+      Scheme_Node *node;
+
+      if (scheme_engine == SCHEME_BYTECODE_ENGINE)
+	{
+	  return (scheme_execute (scheme_compile (obj, env), env));
+	}
+      node = scheme_analyze (obj, env, 0);
+      return (SCHEME_EVAL_NODE (node, env));
+    }
+  else if (type == scheme_compiled_type)
+    {
+      return (scheme_execute (obj, env));
     }
   else
     {
@@ -61,47 +93,378 @@ scheme_eval (Scheme_Value obj, Scheme_Env *env)
     }
 }
 
+/* Analysis turns a form into a tree of nodes.  ENV describes the
+   lexical frames the form will be run in: either a runtime
+   environment or a chain of frames built by the analyzers in
+   scheme_syntax.c that mirrors the frames created at runtime.  TAIL
+   is nonzero for forms in tail position of a lambda body. */
+
+Scheme_Node *
+scheme_analyze (Scheme_Value obj, Scheme_Env *env, int tail)
+{
+  Scheme_Value type;
+  Scheme_Node *node;
+  int depth, index;
+
+  type = SCHEME_TYPE (obj);
+  if (type == scheme_symbol_type)
+    {
+      if (scheme_lexical_address (obj, env, &depth, &index))
+	{
+	  node = scheme_make_node ((depth == 0 ? local0_ref_eval
+				    : depth == 1 ? local1_ref_eval
+				    : local_ref_eval), obj, 0);
+	  SCHEME_NODE_DEPTH (node) = depth;
+	  SCHEME_NODE_INDEX (node) = index;
+	}
+      else
+	{
+	  node = scheme_make_node (global_ref_eval, obj, 0);
+	  SCHEME_NODE_CELL (node) = scheme_global_cell (obj, env);
+	}
+      return (node);
+    }
+  else if (type == scheme_pair_type)
+    {
+      return (analyze_combination (obj, env, tail));
+    }
+  else
+    {
+      return (scheme_make_const_node (obj));
+    }
+}
+
+Scheme_Node *
+scheme_analyze_seq (Scheme_Value forms, Scheme_Env *env, int tail)
+{
+  Scheme_Node *node;
+  int num_forms, i;
+
+  num_forms = scheme_list_length (forms);
+  if (num_forms == 0)
+    {
+      return (scheme_make_const_node (scheme_null));
+    }
+  if (num_forms == 1)
+    {
+      return (scheme_analyze (SCHEME_CAR (forms), env, tail));
+    }
+  node = scheme_make_node (seq_eval, forms, num_forms);
+  for ( i=0 ; i<num_forms ; ++i )
+    {
+      node->nodes[i] = scheme_analyze (SCHEME_CAR (forms), env,
+				       (i == num_forms - 1) ? tail : 0);
+      forms = SCHEME_CDR (forms);
+    }
+  return (node);
+}
+
+Scheme_Node *
+scheme_make_node (Scheme_Node_Proc *proc, Scheme_Value form, int num_nodes)
+{
+  Scheme_Node *node;
+
+  node = (Scheme_Node *) scheme_malloc (sizeof (Scheme_Node)
+					+ num_nodes * sizeof (Scheme_Node *));
+  node->eval = proc;
+  node->form = form;
+  node->num_nodes = num_nodes;
+  return (node);
+}
+
+Scheme_Node *
+scheme_make_const_node (Scheme_Value val)
+{
+  Scheme_Node *node;
+
+  node = scheme_make_node (const_eval, val, 0);
+  SCHEME_NODE_VAL (node) = val;
+  return (node);
+}
+
+Scheme_Value
+scheme_eval_syntax (Scheme_Value syntax, Scheme_Value form, Scheme_Env *env)
+{
+  if (SCHEME_SYNTAX_ANALYZER (syntax))
+    {
+      Scheme_Node *node;
+
+      node = SCHEME_SYNTAX_ANALYZER (syntax) (form, env, 0);
+      return (SCHEME_EVAL_NODE (node, env));
+    }
+  else
+    {
+      return (SCHEME_SYNTAX (syntax) (form, env));
+    }
+}
+
 /* local functions */
 
+static Scheme_Node *
+analyze_combination (Scheme_Value comb, Scheme_Env *env, int tail)
+{
+  Scheme_Value rator, rands, val;
+  Scheme_Node *node;
+  int num_rands, depth, i;
+
+  rator = SCHEME_CAR (comb);
+  rands = SCHEME_CDR (comb);
+
+  /* Syntax and macros are resolved here, once.  A keyword that is
+     shadowed by a lexical binding is an ordinary variable. */
+  if (SCHEME_SYMBOLP (rator) && ! scheme_lexical_address (rator, env, &depth, &i))
+    {
+      val = scheme_lookup_global (rator, env);
+      if (val && SCHEME_SYNTAXP (val))
+	{
+	  if (SCHEME_SYNTAX_ANALYZER (val))
+	    {
+	      return (SCHEME_SYNTAX_ANALYZER (val) (comb, env, tail));
+	    }
+	  scheme_capture_count++;
+	  node = scheme_make_node (syntax_eval, comb, 0);
+	  SCHEME_NODE_VAL (node) = val;
+	  return (node);
+	}
+      else if (val && SCHEME_MACROP (val))
+	{
+	  val = scheme_apply_to_list ((Scheme_Value) SCHEME_PTR_VAL (val), rands);
+	  return (scheme_analyze (val, env, tail));
+	}
+    }
+
+  num_rands = scheme_list_length (rands);
+  SCHEME_ASSERT ((num_rands < SCHEME_MAX_ARGS), "too many arguments in combination");
+  if (num_rands <= 3)
+    {
+      node = scheme_make_node (tail ? small_tail_combination_eval : small_combination_eval,
+			       comb, num_rands + 1);
+    }
+  else
+    {
+      node = scheme_make_node (tail ? tail_combination_eval : combination_eval,
+			       comb, num_rands + 1);
+    }
+  node->nodes[0] = scheme_analyze (rator, env, 0);
+  for ( i=1 ; i<=num_rands ; ++i )
+    {
+      node->nodes[i] = scheme_analyze (SCHEME_CAR (rands), env, 0);
+      rands = SCHEME_CDR (rands);
+    }
+  return (node);
+}
+
+/* node handlers */
+
+static Scheme_Value
+const_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  return (SCHEME_NODE_VAL (node));
+}
+
+/* Local references were resolved to a (depth, index) address at
+   analysis time; the common shallow cases get their own handlers. */
+
+static Scheme_Value
+local0_ref_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  return (env->values[SCHEME_NODE_INDEX (node)]);
+}
+
 static Scheme_Value
-scheme_eval_combination (Scheme_Value comb, Scheme_Env *env)
+local1_ref_eval (Scheme_Node *node, Scheme_Env *env)
 {
-  Scheme_Value rator, type, rands;
-  Scheme_Value evaled_rands[SCHEME_MAX_ARGS];
-  Scheme_Value fun, form;
+  return (env->next->values[SCHEME_NODE_INDEX (node)]);
+}
+
+static Scheme_Value
+local_ref_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  int depth;
+
+  for ( depth=SCHEME_NODE_DEPTH (node) ; depth>0 ; --depth )
+    {
+      env = env->next;
+    }
+  return (env->values[SCHEME_NODE_INDEX (node)]);
+}
+
+static Scheme_Value
+global_ref_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  Scheme_Value val;
+
+  val = SCHEME_NODE_CELL (node)->val;
+  if (! val && ! (val = scheme_base_value (SCHEME_NODE_CELL (node))))
+    {
+      scheme_signal_error ("reference to unbound symbol: %s",
+			   SCHEME_NODE_CELL (node)->name);
+    }
+  return (val);
+}
+
+static Scheme_Value
+seq_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  int i, last;
+
+  last = node->num_nodes - 1;
+  for ( i=0 ; i<last ; ++i )
+    {
+      SCHEME_EVAL_NODE (node->nodes[i], env);
+    }
+  return (SCHEME_EVAL_NODE (node->nodes[last], env));
+}
+
+static Scheme_Value
+syntax_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  return (SCHEME_SYNTAX (SCHEME_NODE_VAL (node)) (node->form, env));
+}
+
+/* Evaluate the operator and operands into RANDS.  Returns the
+   operator, or NULL when it turned out to be syntax or a macro that
+   was not known when the combination was analyzed; *VAL is then the
+   value of the form. */
+static Scheme_Value
+eval_combination (Scheme_Node *node, Scheme_Env *env, Scheme_Value *rands, Scheme_Value *val)
+{
+  Scheme_Value rator;
   int num_rands, i;
 
-  rator = scheme_eval (SCHEME_CAR (comb), env);
-  type = SCHEME_TYPE (rator);
-  if (type == scheme_syntax_type)
+  rator = SCHEME_EVAL_NODE (node->nodes[0], env);
+  if (SCHEME_SYNTAXP (rator) || SCHEME_MACROP (rator))
     {
-      return (SCHEME_SYNTAX(rator)(comb, env));
+      *val = late_syntax (rator, node, env);
+      return (NULL);
     }
-  else if (type == scheme_macro_type)
+
+  num_rands = node->num_nodes - 1;
+  for ( i=0 ; i<num_rands ; ++i )
     {
-      fun = (Scheme_Value) SCHEME_PTR_VAL (rator);
-      rands = SCHEME_CDR (comb);
-      form = scheme_apply_to_list (fun, rands);
-      return (scheme_eval (form, env));
+      rands[i] = SCHEME_EVAL_NODE (node->nodes[i + 1], env);
     }
-  else
+  return (rator);
+}
+
+static Scheme_Value
+combination_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  Scheme_Value rator, val;
+  Scheme_Value rands[SCHEME_MAX_ARGS];
+
+  rator = eval_combination (node, env, rands, &val);
+  if (! rator)
+    {
+      return (val);
+    }
+  return (scheme_apply (rator, node->num_nodes - 1, rands));
+}
+
+static Scheme_Value
+tail_combination_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  Scheme_Value rator, val;
+  Scheme_Value rands[SCHEME_MAX_ARGS];
+
+  rator = eval_combination (node, env, rands, &val);
+  if (! rator)
     {
-      rands = SCHEME_CDR (comb);
-      num_rands = scheme_list_length (rands);
-      i = 0;
-      while (rands != scheme_null)
+      return (val);
+    }
+  return (scheme_tail_apply (rator, node->num_nodes - 1, rands));
+}
+
+/* Combinations of up to three operands keep them in a small array,
+   and call primitives with a direct entry for that many arguments
+   without going through scheme_apply. */
+
+static Scheme_Value
+small_combination (Scheme_Node *node, Scheme_Env *env, int tail)
+{
+  Scheme_Value rator, rands[3];
+  const Scheme_Prim_Desc *desc;
+  int num_rands, i;
+
+  rator = SCHEME_EVAL_NODE (node->nodes[0], env);
+  if (SCHEME_SYNTAXP (rator) || SCHEME_MACROP (rator))
+    {
+      return (late_syntax (rator, node, env));
+    }
+  num_rands = node->num_nodes - 1;
+  for ( i=0 ; i<num_rands ; ++i )
+    {
+      rands[i] = SCHEME_EVAL_NODE (node->nodes[i + 1], env);
+    }
+  if (SCHEME_PRIMP (rator))
+    {
+      desc = SCHEME_PRIM_DESC (rator);
+      if (num_rands == 1 && desc->prim1)
 	{
-	  evaled_rands[i] = scheme_eval (SCHEME_CAR (rands), env);
-	  i++;
-	  rands = SCHEME_CDR (rands);
+	  return (desc->prim1 (rands[0]));
 	}
-      return (scheme_apply (rator, num_rands, evaled_rands));
+      if (num_rands == 2 && desc->prim2)
+	{
+	  return (desc->prim2 (rands[0], rands[1]));
+	}
+      if (num_rands == 3 && desc->prim3)
+	{
+	  return (desc->prim3 (rands[0], rands[1], rands[2]));
+	}
+    }
+  if (tail)
+    {
+      return (scheme_tail_apply (rator, num_rands, rands));
     }
+  return (scheme_apply (rator, num_rands, rands));
+}
+
+static Scheme_Value
+small_combination_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  return (small_combination (node, env, 0));
 }
 
+static Scheme_Value
+small_tail_combination_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  return (small_combination (node, env, 1));
+}
+
+/* RATOR is syntax or a macro that was not known when NODE was
+   analyzed; run the form the slow way. */
+static Scheme_Value
+late_syntax (Scheme_Value rator, Scheme_Node *node, Scheme_Env *env)
+{
+  Scheme_Value form, val;
+  Scheme_Env *heap;
+
+  /* this was not analyzed as syntax, so ENV may be on the stack: run
+     it in a copy and copy back what it assigned */
+  heap = scheme_heap_env (env);
+  if (SCHEME_SYNTAXP (rator))
+    {
+      val = scheme_eval_syntax (rator, node->form, heap);
+    }
+  else
+    {
+      form = scheme_apply_to_list ((Scheme_Value) SCHEME_PTR_VAL (rator),
+				   SCHEME_CDR (node->form));
+      val = scheme_eval (form, heap);
+    }
+  scheme_sync_env (env, heap);
+  return (val);
+}
+
+/* (eval expr [environment]) */
 static Scheme_Value
 eval (int argc, Scheme_Value argv[])
 {
-  SCHEME_ASSERT ((argc == 1), "eval: wrong number of args");
+  SCHEME_ASSERT ((argc == 1 || argc == 2), "eval: wrong number of args");
+  if (argc == 2)
+    {
+      SCHEME_ASSERT (SCHEME_ENVIRONMENTP (argv[1]), "eval: second arg must be an environment");
+      return (scheme_eval (argv[0], SCHEME_ENV_VAL (argv[1])));
+    }
   return (scheme_eval (argv[0], scheme_env));
 }
@@ -0,0 +1,203 @@
+/*
+  libscheme
+  Copyright (c) 1994 Brent Benson
+  All rights reserved.
+
+  Permission is hereby granted, without written agreement and without
+  license or royalty fees, to use, copy, modify, and distribute this
+  software and its documentation for any purpose, provided that the
+  above copyright notice and the following two paragraphs appear in
+  all copies of this software.
+
+  IN NO EVENT SHALL BRENT BENSON BE LIABLE TO ANY PARTY FOR DIRECT,
+  INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES ARISING OUT
+  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF BRENT
+  BENSON HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+  BRENT BENSON SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT
+  NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER
+  IS ON AN "AS IS" BASIS, AND BRENT BENSON HAS NO OBLIGATION TO
+  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR
+  MODIFICATIONS.
+*/
+
+/* Frozen data, which no context may change and every context may
+   therefore read without locks or copies.  (freeze! obj) marks OBJ and
+   everything reachable from it with SCHEME_FROZEN_FLAG: pairs,
+   vectors, strings, struct instances and their types, hash tables,
+   and closures together with the variables they capture.  The
+   mutators check the flag and signal an error.  Quoted constants in
+   the forms `load' and the toplevel read are frozen before they are
+   evaluated, but not data quoted by a form built at run time, which
+   may still belong to its caller.  Symbols, numbers, characters,
+   booleans, primitives and types cannot change and count as frozen
+   without the flag.
+
+   A base environment whose tables and procedures are frozen is
+   shared by all the contexts running clones of it, so the data costs
+   nothing per thread. */
+
+#include "scheme_private.h"
+
+/* locals */
+static void freeze (Scheme_Value obj);
+static void freeze_literals (Scheme_Value form);
+static void freeze_closure (Scheme_Value closure);
+static Scheme_Value freeze_prim (Scheme_Value obj);
+static Scheme_Value frozen_p (Scheme_Value obj);
+
+static const Scheme_Prim_Entry freeze_prims[] =
+{
+  SCHEME_PRIM1_ENTRY ("freeze!", freeze_prim),
+  SCHEME_PRIM1_ENTRY ("frozen?", frozen_p)
+};
+
+void
+scheme_init_freeze (Scheme_Env *env)
+{
+  scheme_add_prims (freeze_prims, SCHEME_NUM_ENTRIES (freeze_prims), env);
+}
+
+/* Freeze OBJ and everything reachable from it, returning OBJ.  It
+   should be called before OBJ is shared, as the flags are set in
+   place. */
+Scheme_Value
+scheme_freeze (Scheme_Value obj)
+{
+  freeze (obj);
+  return (obj);
+}
+
+/* Freeze the quoted constants in FORM, which the reader made, and
+   return FORM. */
+Scheme_Value
+scheme_freeze_literals (Scheme_Value form)
+{
+  freeze_literals (form);
+  return (form);
+}
+
+/* Whether OBJ can be handed to another context as it is. */
+int
+scheme_frozenp (Scheme_Value obj)
+{
+  if (SCHEME_IMMEDIATEP (obj) || SCHEME_FROZENP (obj))
+    {
+      return (1);
+    }
+  switch (SCHEME_TYPE_INDEX (obj))
+    {
+    case SCHEME_TYPE_TYPE_INDEX:
+    case SCHEME_DOUBLE_TYPE_INDEX:
+    case SCHEME_SYMBOL_TYPE_INDEX:
+    case SCHEME_NULL_TYPE_INDEX:
+    case SCHEME_PRIM_TYPE_INDEX:
+    case SCHEME_EOF_TYPE_INDEX:
+    case SCHEME_TRUE_TYPE_INDEX:
+    case SCHEME_FALSE_TYPE_INDEX:
+    case SCHEME_STRUCT_PROC_TYPE_INDEX:
+      return (1);
+    default:
+      return (0);
+    }
+}
+
+/* locals */
+
+/* An object already frozen was frozen with everything it reaches, so
+   marking before descending also stops at cycles.  Lists are followed
+   down their cdrs by looping. */
+static void
+freeze (Scheme_Value obj)
+{
+  int i;
+
+  while (! SCHEME_IMMEDIATEP (obj) && ! SCHEME_FROZENP (obj))
+    {
+      switch (SCHEME_TYPE_INDEX (obj))
+	{
+	case SCHEME_PAIR_TYPE_INDEX:
+	  obj->header |= SCHEME_FROZEN_FLAG;
+	  freeze (SCHEME_CAR (obj));
+	  obj = SCHEME_CDR (obj);
+	  continue;
+	case SCHEME_VECTOR_TYPE_INDEX:
+	  obj->header |= SCHEME_FROZEN_FLAG;
+	  for ( i=0 ; i<SCHEME_VEC_SIZE (obj) ; ++i )
+	    {
+	      freeze (SCHEME_VEC_ELS (obj)[i]);
+	    }
+	  return;
+	case SCHEME_STRING_TYPE_INDEX:
+	case SCHEME_TYPE_TYPE_INDEX:
+	  obj->header |= SCHEME_FROZEN_FLAG;
+	  return;
+	case SCHEME_CLOSURE_TYPE_INDEX:
+	  freeze_closure (obj);
+	  return;
+	case SCHEME_HASH_TABLE_TYPE_INDEX:
+	  scheme_freeze_table (obj);
+	  return;
+	default:
+	  if (SCHEME_HDR_FLAGS (SCHEME_OBJ_TYPE (obj)) & SCHEME_STRUCT_TYPE_FLAG)
+	    {
+	      obj->header |= SCHEME_FROZEN_FLAG;
+	      freeze (SCHEME_OBJ_TYPE (obj));
+	      for ( i=0 ; i<SCHEME_VEC_SIZE (obj) ; ++i )
+		{
+		  freeze (SCHEME_VEC_ELS (obj)[i]);
+		}
+	    }
+	  /* anything else is left as it is */
+	  return;
+	}
+    }
+}
+
+static void
+freeze_literals (Scheme_Value form)
+{
+  while (SCHEME_PAIRP (form))
+    {
+      if (SCHEME_CAR (form) == scheme_quote_symbol && SCHEME_PAIRP (SCHEME_CDR (form)))
+	{
+	  freeze (SCHEME_CADR (form));
+	  return;
+	}
+      freeze_literals (SCHEME_CAR (form));
+      form = SCHEME_CDR (form);
+    }
+}
+
+/* A closure's frames are frozen up to the top-level environment,
+   whose globals stay with the environment. */
+static void
+freeze_closure (Scheme_Value closure)
+{
+  Scheme_Env *frame;
+  int i;
+
+  closure->header |= SCHEME_FROZEN_FLAG;
+  scheme_image_analyze_lambda (SCHEME_CLOS_LAMBDA (closure), SCHEME_CLOS_ENV (closure));
+  for ( frame=SCHEME_CLOS_ENV (closure) ; frame->next && ! frame->frozen ; frame=frame->next )
+    {
+      frame->frozen = 1;
+      for ( i=0 ; i<frame->num_bindings ; ++i )
+	{
+	  freeze (frame->values[i]);
+	}
+    }
+}
+
+static Scheme_Value
+freeze_prim (Scheme_Value obj)
+{
+  return (scheme_freeze (obj));
+}
+
+static Scheme_Value
+frozen_p (Scheme_Value obj)
+{
+  return (scheme_frozenp (obj) ? scheme_true : scheme_false);
+}
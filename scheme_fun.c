@@ -29,8 +29,10 @@
 Scheme_Value scheme_prim_type;
 Scheme_Value scheme_closure_type;
 Scheme_Value scheme_cont_type;
+Scheme_Value scheme_tail_call;
 
 /* locals */
+static Scheme_Value apply_pending_call (Scheme_Value rator);
 static Scheme_Value scheme_collect_rest (int num_rest, Scheme_Value *rest);
 static Scheme_Value procedure_p (int argc, Scheme_Value argv[]);
 static Scheme_Value apply (int argc, Scheme_Value argv[]);
@@ -38,43 +40,64 @@ static Scheme_Value map (int argc, Scheme_Value argv[]);
 static Scheme_Value for_each (int argc, Scheme_Value argv[]);
 static Scheme_Value call_cc (int argc, Scheme_Value argv[]);
 
-#define CONS(a,b) scheme_make_pair(a,b)
+static const Scheme_Prim_Entry fun_prims[] =
+{
+  SCHEME_PRIM_ENTRY ("procedure?", procedure_p, 0, -1),
+  SCHEME_PRIM_ENTRY ("apply", apply, 0, -1),
+  SCHEME_PRIM_ENTRY ("map", map, 0, -1),
+  SCHEME_PRIM_ENTRY ("for-each", for_each, 0, -1),
+  SCHEME_PRIM_ENTRY ("call-with-current-continuation", call_cc, 0, -1),
+  SCHEME_PRIM_ENTRY ("call/cc", call_cc, 0, -1)
+};
 
 void
 scheme_init_fun (Scheme_Env *env)
 {
-  scheme_prim_type = scheme_make_type ("<primitive>");
-  scheme_closure_type = scheme_make_type ("<closure>");
-  scheme_cont_type = scheme_make_type ("<continuation>");
+  scheme_prim_type = scheme_make_builtin_type ("<primitive>", SCHEME_PRIM_TYPE_INDEX);
+  scheme_closure_type = scheme_make_builtin_type ("<closure>", SCHEME_CLOSURE_TYPE_INDEX);
+  scheme_cont_type = scheme_make_builtin_type ("<continuation>", SCHEME_CONT_TYPE_INDEX);
+  scheme_tail_call = scheme_alloc_object (scheme_make_type ("<tail-call>"), 0);
   scheme_add_global ("<primitive>", scheme_prim_type, env);
   scheme_add_global ("<closure>", scheme_closure_type, env);
   scheme_add_global ("<continuation>", scheme_cont_type, env);
-  scheme_add_prim ("procedure?", procedure_p, env);
-  scheme_add_prim ("apply", apply, env);
-  scheme_add_prim ("map", map, env);
-  scheme_add_prim ("for-each", for_each, env);
-  scheme_add_prim ("call-with-current-continuation", call_cc, env);
-  scheme_add_prim ("call/cc", call_cc, env);
+  scheme_add_prims (fun_prims, SCHEME_NUM_ENTRIES (fun_prims), env);
 }
 
 Scheme_Value
 scheme_make_prim (Scheme_Prim *fun)
+{
+  Scheme_Prim_Desc *desc;
+
+  desc = scheme_make_desc ("primitive", 0, -1);
+  desc->fun = fun;
+  return (scheme_make_prim_desc (desc));
+}
+
+Scheme_Value
+scheme_make_prim_desc (Scheme_Prim_Desc *desc)
 {
   Scheme_Value prim;
 
-  prim = scheme_alloc_object (scheme_prim_type, 0);
-  SCHEME_PRIM (prim) = fun;
+  prim = scheme_alloc_sized (scheme_prim_type, SCHEME_OBJ_SIZE (prim_val));
+  SCHEME_PRIM_DESC (prim) = desc;
   return (prim);
 }
 
 Scheme_Value
 scheme_make_closure (Scheme_Env *env, Scheme_Value code)
+{
+  env = scheme_heap_env (env);
+  return (scheme_make_lambda_closure (env, scheme_analyze_lambda (code, env)));
+}
+
+Scheme_Value
+scheme_make_lambda_closure (Scheme_Env *env, Scheme_Lambda *lambda)
 {
   Scheme_Value closure;
 
-  closure = scheme_alloc_object (scheme_closure_type, 0);
+  closure = scheme_alloc_sized (scheme_closure_type, SCHEME_OBJ_SIZE (closure_val));
   SCHEME_CLOS_ENV (closure) = env;
-  SCHEME_CLOS_CODE (closure) = code;
+  SCHEME_CLOS_LAMBDA (closure) = lambda;
   return (closure);
 }
 
@@ -88,6 +111,9 @@ scheme_make_cont ()
   cont = SCHEME_PTR_VAL(obj);
   cont->escaped = 0;
   cont->retval = scheme_null;
+  cont->next = NULL;
+  cont->context = scheme_context;
+  cont->task = scheme_context->task;
   SCHEME_CONT_VAL (obj) = cont;
   return (obj);
 }
@@ -100,124 +126,50 @@ scheme_apply (Scheme_Value rator, int num_rands, Scheme_Value *rands)
   fun_type = SCHEME_TYPE (rator);
   if (fun_type == scheme_closure_type)
     {
-      Scheme_Env *env, *frame;
-      Scheme_Value params, forms, ret = scheme_null;
-      Scheme_Value vars, vals, vars_last, vals_last, pair, aform;
-      int num_int_defs, num_params, i, has_rest;
-
-      env = SCHEME_CLOS_ENV (rator);
-      params = SCHEME_CAR (SCHEME_CLOS_CODE (rator));
-      num_params = scheme_list_length (params);
-      frame = scheme_new_frame (num_params);
-      has_rest = 0;
-      for ( i=0 ; i<num_params ; ++i )
-	{
-	  if (! SCHEME_PAIRP (params))
-	    {
-	      Scheme_Value rest_vals;
+      Scheme_Env *frame, stack_frame;
+      Scheme_Value val, stack_values[SCHEME_STACK_FRAME];
+      Scheme_Lambda *lambda, *caller;
 
-	      rest_vals = scheme_collect_rest ((num_rands - i), (rands + i));
-	      scheme_add_binding (i, params, rest_vals, frame);
-	      has_rest = 1;
-	    }
-	  else
-	    {
-	      scheme_add_binding (i, SCHEME_CAR (params), rands[i], frame);
-	      params = SCHEME_CDR (params);
-	    }
-	}
-      if ( has_rest )
+      caller = SCHEME_PROFILE_CURRENT;
+      /* calls in tail position of the body come back here */
+      while (1)
 	{
-	  if (num_rands < (num_params - 1))
+	  lambda = SCHEME_CLOS_LAMBDA (rator);
+	  SCHEME_PROFILE_ENTER (lambda);
+	  if (lambda->stack_frame)
 	    {
-	      scheme_signal_error ("too few arguments to procedure");
+	      /* nothing in the body can capture the frame, and the
+		 previous one is dead by the time of a tail call */
+	      frame = scheme_stack_frame (&stack_frame, stack_values,
+					  lambda->num_params, lambda->symbols);
+	      frame = scheme_fill_frame (lambda, frame, num_rands, rands);
 	    }
-	}
-      else
-	{
-	  if (num_rands < num_params)
-	    {
-	      scheme_signal_error ("too few arguments to procedure");
-	    }
-	  if (num_rands > num_params)
-	    {
-	      scheme_signal_error ("too many arguments to procedure");
-	    }
-	}
-      env = scheme_extend_env (frame, env);
-      forms = SCHEME_CDR (SCHEME_CLOS_CODE (rator));
-      SCHEME_ASSERT (forms != scheme_null, "apply: no forms in closure body");
-
-      /* process internal defines */
-      num_int_defs = 0;
-      vars = vals = vars_last = vals_last = scheme_null;
-      while (!SCHEME_NULLP(forms) &&
-	     SCHEME_PAIRP (SCHEME_CAR(forms)) &&
-	     SCHEME_CAR (SCHEME_CAR (forms)) == scheme_intern_symbol ("define"))
-	{
-	  num_int_defs++;
-	  aform = SCHEME_CAR (forms);
-	  /* get var */
-	  if (SCHEME_PAIRP (SCHEME_CAR (SCHEME_CDR (aform))))
-	    pair = scheme_make_pair (SCHEME_CAR (SCHEME_CAR (SCHEME_CDR (aform))), scheme_null);
-	  else
-	    pair = scheme_make_pair (SCHEME_CAR (SCHEME_CDR (aform)), scheme_null);
-
-	  if (SCHEME_NULLP (vars))
-	    vars = vars_last = pair;
 	  else
 	    {
-	      SCHEME_CDR (vars_last) = pair;
-	      vars_last = pair;
+	      frame = scheme_bind_args (lambda, num_rands, rands);
 	    }
-	  /* get val */
-	  if (SCHEME_PAIRP (SCHEME_CAR (SCHEME_CDR (aform))))
-	    pair = CONS (CONS (scheme_intern_symbol("lambda"),
-			       CONS (SCHEME_CDR (SCHEME_CAR (SCHEME_CDR (aform))),
-				     SCHEME_CDR (SCHEME_CDR (aform)))),
-			 scheme_null);
-	  else
-	    pair = scheme_make_pair (SCHEME_CAR (SCHEME_CDR (SCHEME_CDR (aform))), scheme_null);
-
-	  if (SCHEME_NULLP (vals))
-	    vals = vals_last = pair;
-	  else
+	  frame = scheme_extend_env (frame, SCHEME_CLOS_ENV (rator));
+	  val = SCHEME_EVAL_NODE (SCHEME_CLOS_LAMBDA (rator)->body, frame);
+	  if (val != scheme_tail_call)
 	    {
-	      SCHEME_CDR (vals_last) = pair;
-	      vals_last = pair;
+	      SCHEME_PROFILE_ENTER (caller);
+	      return (val);
 	    }
-	  forms = SCHEME_CDR (forms);
-	}
-      if ( num_int_defs )
-	{
-	  env = scheme_add_frame (vars, scheme_alloc_list (num_int_defs), env);
-	  while (! SCHEME_NULLP (vars))
+	  rator = scheme_unwrap_apply (scheme_pending_call.rator,
+				       &scheme_pending_call.num_rands,
+				       scheme_pending_call.rands);
+	  if (! SCHEME_CLOSUREP (rator))
 	    {
-	      scheme_set_value (SCHEME_CAR(vars),
-				scheme_eval (SCHEME_CAR (vals), env),
-				env);
-	      vars = SCHEME_CDR (vars);
-	      vals = SCHEME_CDR (vals);
+	      SCHEME_PROFILE_ENTER (caller);
+	      return (apply_pending_call (rator));
 	    }
+	  num_rands = scheme_pending_call.num_rands;
+	  rands = scheme_pending_call.rands;
 	}
-
-      while (forms != scheme_null)
-	{
-	  ret = scheme_eval (SCHEME_CAR (forms), env);
-	  forms = SCHEME_CDR (forms);
-	}
-      /* pop internal define frame */
-      if ( num_int_defs )
-	{
-	  env = scheme_pop_frame (env);
-	}
-      /* pop regular binding frame */
-      env = scheme_pop_frame (env);
-      return (ret);
     }
   else if (fun_type == scheme_prim_type)
     {
-      return (SCHEME_PRIM(rator)(num_rands, rands));
+      return (scheme_apply_prim (rator, num_rands, rands));
     }
   else if (fun_type == scheme_cont_type)
     {
@@ -228,6 +180,12 @@ scheme_apply (Scheme_Value rator, int num_rands, Scheme_Value *rands)
         {
           scheme_signal_error("apply: continuation has been escaped");
         }
+      /* its C frames are on the stack of another thread, or below
+	 the pool task running now */
+      if (cont->context != scheme_context || cont->task != scheme_context->task)
+        {
+          scheme_signal_error("apply: continuation belongs to another thread");
+        }
       cont->retval = rands[0];
       longjmp (cont->buffer, 0);
     }
@@ -242,6 +200,144 @@ scheme_apply (Scheme_Value rator, int num_rands, Scheme_Value *rands)
     }
 }
 
+/* Check the arity of primitive PRIM once and call the most direct
+   entry it has for this many arguments. */
+Scheme_Value
+scheme_apply_prim (Scheme_Value prim, int num_rands, Scheme_Value *rands)
+{
+  const Scheme_Prim_Desc *desc;
+
+  desc = SCHEME_PRIM_DESC (prim);
+  if ((num_rands < desc->mina) || ((desc->maxa >= 0) && (num_rands > desc->maxa)))
+    {
+      scheme_signal_error ("%s: wrong number of args", desc->name);
+    }
+  switch (num_rands)
+    {
+    case 1:
+      if (desc->prim1)
+	{
+	  return (desc->prim1 (rands[0]));
+	}
+      break;
+    case 2:
+      if (desc->prim2)
+	{
+	  return (desc->prim2 (rands[0], rands[1]));
+	}
+      break;
+    case 3:
+      if (desc->prim3)
+	{
+	  return (desc->prim3 (rands[0], rands[1], rands[2]));
+	}
+      break;
+    }
+  return (desc->fun (num_rands, rands));
+}
+
+Scheme_Value
+scheme_tail_apply (Scheme_Value rator, int num_rands, Scheme_Value *rands)
+{
+  int i;
+
+  scheme_pending_call.rator = rator;
+  scheme_pending_call.num_rands = num_rands;
+  for ( i=0 ; i<num_rands ; ++i )
+    {
+      scheme_pending_call.rands[i] = rands[i];
+    }
+  return (scheme_tail_call);
+}
+
+/* Whether RATOR is apply, which scheme_unwrap_apply takes apart. */
+int
+scheme_applyp (Scheme_Value rator)
+{
+  return (SCHEME_PRIMP (rator) && (SCHEME_PRIM (rator) == apply));
+}
+
+/* When RATOR is `apply', turn the call (apply proc arg ... list) in
+   RANDS into a call of proc, so that a tail call made through apply
+   is still a tail call.  Returns the procedure to call, with its
+   arguments left in RANDS.  RANDS must have room for
+   SCHEME_MAX_ARGS values. */
+Scheme_Value
+scheme_unwrap_apply (Scheme_Value rator, int *num_rands, Scheme_Value *rands)
+{
+  Scheme_Value proc, list;
+  int i, n;
+
+  if (! SCHEME_PRIMP (rator) || (SCHEME_PRIM (rator) != apply))
+    {
+      return (rator);
+    }
+  n = *num_rands;
+  SCHEME_ASSERT ((n >= 2), "apply: two argument version only");
+  SCHEME_ASSERT (SCHEME_PROCP (rands[0]), "apply: first arg must be a procedure");
+  SCHEME_ASSERT (SCHEME_LISTP (rands[n - 1]), "apply: last arg must be a list");
+  proc = rands[0];
+  list = rands[n - 1];
+  for ( i=1 ; i<(n-1) ; ++i )
+    {
+      rands[i - 1] = rands[i];
+    }
+  n -= 2;
+  while (! SCHEME_NULLP (list))
+    {
+      SCHEME_ASSERT ((n < SCHEME_MAX_ARGS), "apply: too many arguments");
+      rands[n++] = SCHEME_CAR (list);
+      list = SCHEME_CDR (list);
+    }
+  *num_rands = n;
+  return (proc);
+}
+
+/* Make the frame for applying LAMBDA to the given arguments. */
+Scheme_Env *
+scheme_bind_args (Scheme_Lambda *lambda, int num_rands, Scheme_Value *rands)
+{
+  Scheme_Env *frame;
+
+  /* the frame and its values are a single allocation */
+  frame = (Scheme_Env *) scheme_malloc (sizeof (Scheme_Env)
+					+ lambda->num_params * sizeof (Scheme_Value));
+  frame->num_bindings = lambda->num_params;
+  frame->symbols = lambda->symbols;
+  frame->values = (Scheme_Value *) (frame + 1);
+  frame->on_stack = 0;
+  frame->frozen = 0;
+  SCHEME_PROFILE (SCHEME_PROFILE_FRAME, sizeof (Scheme_Env) + lambda->num_params * sizeof (Scheme_Value));
+  return (scheme_fill_frame (lambda, frame, num_rands, rands));
+}
+
+/* Check the arguments against LAMBDA's arity and store them in
+   FRAME. */
+Scheme_Env *
+scheme_fill_frame (Scheme_Lambda *lambda, Scheme_Env *frame, int num_rands, Scheme_Value *rands)
+{
+  int num_required, i;
+
+  num_required = lambda->rest ? lambda->num_params - 1 : lambda->num_params;
+  if (num_rands < num_required)
+    {
+      scheme_signal_error ("too few arguments to procedure");
+    }
+  if (num_rands > num_required && ! lambda->rest)
+    {
+      scheme_signal_error ("too many arguments to procedure");
+    }
+  for ( i=0 ; i<num_required ; ++i )
+    {
+      frame->values[i] = rands[i];
+    }
+  if (lambda->rest)
+    {
+      frame->values[i] = scheme_collect_rest (num_rands - i, rands + i);
+    }
+  return (frame);
+}
+
 Scheme_Value
 scheme_apply_to_list (Scheme_Value rator, Scheme_Value rands)
 {
@@ -259,6 +355,22 @@ scheme_apply_to_list (Scheme_Value rator, Scheme_Value rands)
 
 /* locals */
 
+/* Anything but a closure gets its own copy of the arguments, since
+   the next tail call reuses scheme_pending_call. */
+static Scheme_Value
+apply_pending_call (Scheme_Value rator)
+{
+  Scheme_Value rands[SCHEME_MAX_ARGS];
+  int num_rands, i;
+
+  num_rands = scheme_pending_call.num_rands;
+  for ( i=0 ; i<num_rands ; ++i )
+    {
+      rands[i] = scheme_pending_call.rands[i];
+    }
+  return (scheme_apply (rator, num_rands, rands));
+}
+
 static Scheme_Value
 scheme_collect_rest (int num_rest, Scheme_Value *rest)
 {
@@ -426,6 +538,7 @@ for_each (int argc, Scheme_Value argv[])
 static Scheme_Value
 call_cc (int argc, Scheme_Value argv[])
 {
+  Scheme_Context *context = scheme_context;
   Scheme_Cont *cont;
   Scheme_Value ret = scheme_null, obj;
 
@@ -435,6 +548,8 @@ call_cc (int argc, Scheme_Value argv[])
 
   obj = scheme_make_cont();
   cont = SCHEME_CONT_VAL(obj);
+  cont->next = context->live_conts;
+  context->live_conts = cont;
 
   if (setjmp (cont->buffer))
     {
@@ -443,10 +558,18 @@ call_cc (int argc, Scheme_Value argv[])
     }
   else
     {
-      return (scheme_apply_to_list (argv[0], scheme_make_pair (obj, scheme_null)));
+      ret = scheme_apply_to_list (argv[0], scheme_make_pair (obj, scheme_null));
     }
 
+  /* Our C frame is gone once we return, and so are the frames of
+     any continuations captured (and not yet escaped) inside it. */
+  while (context->live_conts != cont)
+    {
+      context->live_conts->escaped = 1;
+      context->live_conts = context->live_conts->next;
+    }
   cont->escaped = 1;
+  context->live_conts = cont->next;
 
   return (ret);
 }
@@ -0,0 +1,948 @@
+/*
+  libscheme
+  Copyright (c) 1994 Brent Benson
+  All rights reserved.
+
+  Permission is hereby granted, without written agreement and without
+  license or royalty fees, to use, copy, modify, and distribute this
+  software and its documentation for any purpose, provided that the
+  above copyright notice and the following two paragraphs appear in
+  all copies of this software.
+
+  IN NO EVENT SHALL BRENT BENSON BE LIABLE TO ANY PARTY FOR DIRECT,
+  INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES ARISING OUT
+  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF BRENT
+  BENSON HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+  BRENT BENSON SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT
+  NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER
+  IS ON AN "AS IS" BASIS, AND BRENT BENSON HAS NO OBLIGATION TO
+  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR
+  MODIFICATIONS.
+*/
+
+/* A mostly-copying generational collector, used in place of the
+   Boehm collector when libscheme is built with PRECISE_GC.
+
+   The heap is one reserved range of address space cut into blocks.
+   New allocations are bump-allocated in nursery blocks, each behind a
+   prefix word giving its size and kind, and a bitmap per block records
+   where allocations start, so that any address in the heap can be
+   mapped back to its allocation.
+
+   Allocations are scanned precisely: a Scheme_Object according to its
+   type, a typed block according to its layout, an atomic block not at
+   all and any other block as an array of pointers, noting in the first
+   word of a block from scheme_malloc_keys that one of them moved.  The C
+   stack, the registers, the data segment and the ranges given to
+   scheme_gc_add_roots are scanned conservatively; a block they point
+   into is pinned and kept where it is with everything in it, and every
+   other live allocation is copied.  A minor collection copies the live
+   part of the nursery into old blocks, finding pointers from old
+   objects to young ones through the cards dirtied by SCHEME_GC_WRITE.
+   A major collection copies the whole heap.  Allocations too big for a
+   block get blocks of their own and are never moved.
+
+   The collector knows a single thread, the one that made the heap. */
+
+#include "scheme_private.h"
+
+#ifdef PRECISE_GC
+
+#ifdef SCHEME_THREADS
+#error The precise collector runs a single thread, build SCHEME_THREADS with GC=boehm or GC=none
+#endif
+
+#include <string.h>
+#include <sys/mman.h>
+
+#define WORD		sizeof (uintptr_t)
+#define BITS		(8 * WORD)
+#define BLOCK_SIZE	((size_t) 1 << SCHEME_GC_BLOCK_SHIFT)
+#define CARD_SIZE	((size_t) 1 << SCHEME_GC_CARD_SHIFT)
+#define NUM_BLOCKS	(SCHEME_GC_HEAP >> SCHEME_GC_BLOCK_SHIFT)
+#define NUM_CARDS	(SCHEME_GC_HEAP >> SCHEME_GC_CARD_SHIFT)
+#define BLOCK_CARDS	(BLOCK_SIZE / CARD_SIZE)
+#define BLOCK_WORDS	(BLOCK_SIZE / WORD)
+#define LARGE_SIZE	(BLOCK_SIZE / 4)
+
+/* The prefix word holds the size of the allocation, prefix included,
+   above its kind and, for a typed allocation, its layout.  A copied
+   allocation gets kind FORWARDED and the address of the copy's prefix
+   in its first word. */
+#define FORWARDED		0
+#define PREFIX(size, kind)	(((uintptr_t) (size) << 16) | (kind))
+#define PREFIX_SIZE(w)		((size_t) ((w) >> 16))
+#define PREFIX_KIND(w)		((int) ((w) & 0xff))
+#define PREFIX_LAYOUT(w)	((int) (((w) >> 8) & 0xff))
+#define MAX_LAYOUTS		256
+
+/* block states */
+#define FREE	0
+#define YOUNG	1		/* allocated since the last collection */
+#define OLD	2
+#define COPY	3		/* receiving copies during a collection */
+
+/* block roles */
+#define SMALL	0
+#define HEAD	1		/* first block of a large allocation */
+#define TAIL	2		/* the rest of it */
+
+/* bypass the address sanitizer when reading stacks and globals */
+#if defined(__GNUC__)
+#define NO_SANITIZE __attribute__ ((no_sanitize_address, noinline))
+#else
+#define NO_SANITIZE
+#endif
+
+typedef struct Block
+{
+  unsigned char state;
+  unsigned char role;
+  unsigned char pinned;		/* referenced conservatively */
+  unsigned char marked;		/* large allocation found live */
+  unsigned char dirty;		/* has dirty cards */
+  int head;			/* index of the HEAD of a TAIL block */
+  int span;			/* number of blocks of a HEAD block */
+  char *top;			/* end of the allocations in a SMALL block */
+  uintptr_t starts[BLOCK_WORDS / BITS];
+} Block;
+
+typedef struct Range
+{
+  char *lo, *hi;
+} Range;
+
+static struct
+{
+  char *base;
+  Block *blocks;
+  unsigned char *cards;
+  int high;			/* no block at or above this was ever used */
+  int hint;			/* where to look for a free block */
+  int major;			/* collecting the old generation too */
+  /* nursery */
+  Block *alloc_block;
+  char *alloc, *limit;
+  size_t young;			/* blocks allocated since the last collection */
+  /* old generation */
+  size_t old;
+  size_t major_limit;
+  /* to-space, in the order it was filled, and the scan position */
+  Block *copy_block;
+  char *copy, *copy_limit;
+  int *copied;
+  int num_copied, max_copied;
+  int scan_index;
+  char *scan;
+  /* pinned blocks, and large allocations still to be scanned */
+  int *pinned;
+  int num_pinned, max_pinned;
+  int *gray;
+  int num_gray, max_gray;
+  /* conservative roots */
+  char *stack_base;
+  Range *roots;
+  int num_roots, max_roots;
+  /* pointer maps of typed allocations */
+  uintptr_t layouts[MAX_LAYOUTS];
+  int num_layouts;
+} gc;
+
+/* ELF: the initialized and zeroed data of the executable */
+extern char __data_start[], _end[];
+#ifdef __GLIBC__
+extern void *__libc_stack_end;
+#endif
+
+static void init_heap (void);
+static Block *take_block (int state);
+static int take_span (int n);
+static void nursery_block (void);
+static void *large_alloc (size_t total, int kind);
+static void collect (int major);
+static void scan_conservative (char *lo, char *hi);
+static void pin (uintptr_t p);
+static void scan_cards (void);
+static void scan_block (Block *b);
+static void scan_object (uintptr_t *prefix, char *lo, char *hi);
+static void scan_typed (uintptr_t *prefix, char *lo, char *hi);
+static uintptr_t relocate (uintptr_t p);
+static char *copy_alloc (size_t total);
+static void drain (void);
+static void finish (void);
+static void free_block (Block *b);
+static uintptr_t *find_start (Block *b, char *p);
+static void push_index (int **array, int *num, int *max, int index);
+
+#define BLOCK_INDEX(p)	((int) (((char *) (p) - gc.base) >> SCHEME_GC_BLOCK_SHIFT))
+#define BLOCK_OF(p)	(&gc.blocks[BLOCK_INDEX (p)])
+#define BLOCK_ADDR(b)	(gc.base + ((size_t) ((b) - gc.blocks) << SCHEME_GC_BLOCK_SHIFT))
+#define IN_HEAP(p)	((uintptr_t) (p) - (uintptr_t) gc.base < SCHEME_GC_HEAP)
+
+/* exported functions */
+
+void *
+scheme_gc_malloc (size_t size, int kind)
+{
+  size_t total;
+  char *p;
+  Block *b;
+
+  if (! gc.base)
+    {
+      init_heap ();
+    }
+  /* every allocation has room for a forwarding address */
+  total = (size + WORD - 1) / WORD * WORD + WORD;
+  if (total < 2 * WORD)
+    {
+      total = 2 * WORD;
+    }
+  if (total > LARGE_SIZE)
+    {
+      return (large_alloc (total, kind));
+    }
+  if (gc.alloc + total > gc.limit)
+    {
+      nursery_block ();
+    }
+  p = gc.alloc;
+  gc.alloc += total;
+  *(uintptr_t *) p = PREFIX (total, kind);
+  b = gc.alloc_block;
+  b->starts[(p - BLOCK_ADDR (b)) / WORD / BITS] |= (uintptr_t) 1 << ((p - BLOCK_ADDR (b)) / WORD % BITS);
+  return (p + WORD);
+}
+
+/* Allocate memory that is never moved, for buffers handed to the C
+   library. */
+void *
+scheme_malloc_fixed (size_t size)
+{
+  if (! gc.base)
+    {
+      init_heap ();
+    }
+  return (large_alloc ((size + WORD - 1) / WORD * WORD + WORD, SCHEME_GC_ATOMIC));
+}
+
+/* Register the pointer map of a layout; typed allocations give the
+   index in their kind. */
+int
+scheme_gc_layout (uintptr_t bitmap)
+{
+  SCHEME_ASSERT ((gc.num_layouts < MAX_LAYOUTS), "too many allocation layouts");
+  gc.layouts[gc.num_layouts] = bitmap;
+  return (gc.num_layouts++);
+}
+
+void
+scheme_gc_write (void *slot)
+{
+  uintptr_t offset = (uintptr_t) slot - (uintptr_t) gc.base;
+
+  if (offset < SCHEME_GC_HEAP && gc.cards)
+    {
+      gc.cards[offset >> SCHEME_GC_CARD_SHIFT] = 1;
+      gc.blocks[offset >> SCHEME_GC_BLOCK_SHIFT].dirty = 1;
+    }
+}
+
+void
+scheme_gc_add_roots (void *start, void *end)
+{
+  if (gc.num_roots == gc.max_roots)
+    {
+      gc.max_roots = gc.max_roots ? 2 * gc.max_roots : 8;
+      gc.roots = (Range *) realloc (gc.roots, gc.max_roots * sizeof (Range));
+      SCHEME_ASSERT ((gc.roots != NULL), "memory allocation failure");
+    }
+  gc.roots[gc.num_roots].lo = (char *) start;
+  gc.roots[gc.num_roots].hi = (char *) end;
+  gc.num_roots++;
+}
+
+void
+scheme_gc_remove_roots (void *start, void *end)
+{
+  int i;
+
+  for ( i=0 ; i<gc.num_roots ; ++i )
+    {
+      if (gc.roots[i].lo == (char *) start && gc.roots[i].hi == (char *) end)
+	{
+	  gc.roots[i] = gc.roots[--gc.num_roots];
+	  return;
+	}
+    }
+}
+
+void
+scheme_gc_collect (int major)
+{
+  jmp_buf regs;
+
+  /* spill the registers into this frame, which collect's stack scan
+     covers */
+  setjmp (regs);
+  if (! gc.base)
+    {
+      return;
+    }
+  collect (major);
+  if (! major && gc.old > gc.major_limit)
+    {
+      collect (1);
+    }
+}
+
+/* heap and blocks */
+
+static void
+init_heap (void)
+{
+  void *heap, *blocks, *cards;
+
+  heap = mmap (NULL, SCHEME_GC_HEAP, PROT_READ | PROT_WRITE,
+	       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  blocks = mmap (NULL, NUM_BLOCKS * sizeof (Block), PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  cards = mmap (NULL, NUM_CARDS, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (heap == MAP_FAILED || blocks == MAP_FAILED || cards == MAP_FAILED)
+    {
+      fprintf (stderr, "libscheme: cannot reserve the heap\n");
+      abort ();
+    }
+  gc.base = (char *) heap;
+  gc.blocks = (Block *) blocks;
+  gc.cards = (unsigned char *) cards;
+  gc.major_limit = 4 * SCHEME_GC_NURSERY;
+#ifdef __GLIBC__
+  gc.stack_base = (char *) __libc_stack_end;
+#else
+  {
+    char here;
+    gc.stack_base = &here + 4096;
+  }
+#endif
+}
+
+static Block *
+take_block (int state)
+{
+  int i, n;
+  Block *b;
+
+  for ( n=0 ; n<(int) NUM_BLOCKS ; ++n )
+    {
+      i = (gc.hint + n) % (int) NUM_BLOCKS;
+      if (gc.blocks[i].state == FREE)
+	{
+	  b = &gc.blocks[i];
+	  gc.hint = i + 1;
+	  if (i >= gc.high)
+	    {
+	      gc.high = i + 1;
+	    }
+	  b->state = state;
+	  b->role = SMALL;
+	  b->top = BLOCK_ADDR (b);
+	  memset (b->starts, 0, sizeof (b->starts));
+	  memset (gc.cards + ((size_t) i * BLOCK_CARDS), 0, BLOCK_CARDS);
+	  b->dirty = 0;
+	  return (b);
+	}
+    }
+  return (NULL);
+}
+
+/* find N free blocks in a row, returning the first or -1 */
+static int
+take_span (int n)
+{
+  int i, run;
+
+  run = 0;
+  for ( i=0 ; i<(int) NUM_BLOCKS ; ++i )
+    {
+      run = (gc.blocks[i].state == FREE) ? run + 1 : 0;
+      if (run == n)
+	{
+	  return (i - n + 1);
+	}
+    }
+  return (-1);
+}
+
+static void
+nursery_block (void)
+{
+  Block *b;
+
+  if (gc.alloc_block)
+    {
+      gc.alloc_block->top = gc.alloc;
+      gc.alloc_block = NULL;
+    }
+  if (gc.young >= SCHEME_GC_NURSERY)
+    {
+      scheme_gc_collect (0);
+    }
+  b = take_block (YOUNG);
+  if (! b)
+    {
+      scheme_gc_collect (1);
+      b = take_block (YOUNG);
+      SCHEME_ASSERT ((b != NULL), "memory allocation failure");
+    }
+  gc.young++;
+  memset (BLOCK_ADDR (b), 0, BLOCK_SIZE);
+  gc.alloc_block = b;
+  gc.alloc = BLOCK_ADDR (b);
+  gc.limit = gc.alloc + BLOCK_SIZE;
+}
+
+static void *
+large_alloc (size_t total, int kind)
+{
+  int i, n, first;
+  char *p;
+
+  n = (int) ((total + BLOCK_SIZE - 1) / BLOCK_SIZE);
+  if (gc.young + n > SCHEME_GC_NURSERY)
+    {
+      scheme_gc_collect (0);
+    }
+  first = take_span (n);
+  if (first < 0)
+    {
+      scheme_gc_collect (1);
+      first = take_span (n);
+      SCHEME_ASSERT ((first >= 0), "memory allocation failure");
+    }
+  for ( i=first ; i<first + n ; ++i )
+    {
+      gc.blocks[i].state = YOUNG;
+      gc.blocks[i].role = (i == first) ? HEAD : TAIL;
+      gc.blocks[i].head = first;
+      gc.blocks[i].pinned = 0;
+      gc.blocks[i].marked = 0;
+      gc.blocks[i].dirty = 0;
+      memset (gc.blocks[i].starts, 0, sizeof (gc.blocks[i].starts));
+    }
+  if (first + n > gc.high)
+    {
+      gc.high = first + n;
+    }
+  gc.blocks[first].span = n;
+  gc.blocks[first].starts[0] = 1;
+  gc.young += n;
+  p = BLOCK_ADDR (&gc.blocks[first]);
+  memset (p, 0, total);
+  memset (gc.cards + ((size_t) first * BLOCK_CARDS), 0, n * BLOCK_CARDS);
+  *(uintptr_t *) p = PREFIX (total, kind);
+  return (p + WORD);
+}
+
+static void
+free_block (Block *b)
+{
+  b->state = FREE;
+  b->role = SMALL;
+  b->pinned = 0;
+  b->marked = 0;
+  b->dirty = 0;
+}
+
+/* collection */
+
+static void NO_SANITIZE
+collect (int major)
+{
+  char here;
+  int i;
+
+  gc.major = major;
+  if (gc.alloc_block)
+    {
+      gc.alloc_block->top = gc.alloc;
+      gc.alloc_block = NULL;
+    }
+  gc.alloc = gc.limit = NULL;
+  gc.copy_block = NULL;
+  gc.copy = gc.copy_limit = NULL;
+  gc.num_copied = gc.scan_index = 0;
+  gc.scan = NULL;
+  gc.num_pinned = gc.num_gray = 0;
+
+  /* conservative roots pin what they point into */
+  scan_conservative (&here, gc.stack_base);
+  scan_conservative (__data_start, (char *) &gc);
+  scan_conservative ((char *) (&gc + 1), _end);
+  for ( i=0 ; i<gc.num_roots ; ++i )
+    {
+      scan_conservative (gc.roots[i].lo, gc.roots[i].hi);
+    }
+
+  /* everything in a pinned block is treated as live */
+  for ( i=0 ; i<gc.num_pinned ; ++i )
+    {
+      scan_block (&gc.blocks[gc.pinned[i]]);
+    }
+  if (! major)
+    {
+      scan_cards ();
+    }
+  drain ();
+  finish ();
+}
+
+static void NO_SANITIZE
+scan_conservative (char *lo, char *hi)
+{
+  uintptr_t *p;
+
+  p = (uintptr_t *) (((uintptr_t) lo + WORD - 1) & ~(WORD - 1));
+  for ( ; (char *) p + WORD <= hi ; ++p )
+    {
+      if (IN_HEAP (*p))
+	{
+	  pin (*p);
+	}
+    }
+}
+
+static int
+from_space (Block *b)
+{
+  return (b->state == YOUNG || (gc.major && b->state == OLD));
+}
+
+static void
+pin (uintptr_t p)
+{
+  Block *b;
+
+  b = BLOCK_OF (p);
+  if (! from_space (b))
+    {
+      return;
+    }
+  if (b->role != SMALL)
+    {
+      relocate (p);
+    }
+  else if (! b->pinned && (char *) p < b->top)
+    {
+      b->pinned = 1;
+      push_index (&gc.pinned, &gc.num_pinned, &gc.max_pinned, BLOCK_INDEX (p));
+    }
+}
+
+/* scan the dirty cards of old blocks for pointers to young objects */
+static void
+scan_cards (void)
+{
+  int i, c;
+  Block *b;
+  char *base, *lo, *hi, *p;
+  uintptr_t *prefix;
+
+  for ( i=0 ; i<gc.high ; ++i )
+    {
+      b = &gc.blocks[i];
+      if (! b->dirty || b->state != OLD)
+	{
+	  continue;
+	}
+      b->dirty = 0;
+      base = BLOCK_ADDR (b);
+      for ( c=0 ; c<(int) BLOCK_CARDS ; ++c )
+	{
+	  if (! gc.cards[(size_t) i * BLOCK_CARDS + c])
+	    {
+	      continue;
+	    }
+	  gc.cards[(size_t) i * BLOCK_CARDS + c] = 0;
+	  lo = base + c * CARD_SIZE;
+	  hi = lo + CARD_SIZE;
+	  if (b->role != SMALL)
+	    {
+	      scan_object ((uintptr_t *) BLOCK_ADDR (&gc.blocks[b->head]), lo, hi);
+	      continue;
+	    }
+	  prefix = find_start (b, lo);
+	  p = prefix ? (char *) prefix : base;
+	  while (p < hi && p < b->top)
+	    {
+	      scan_object ((uintptr_t *) p, lo, hi);
+	      p += PREFIX_SIZE (*(uintptr_t *) p);
+	    }
+	}
+    }
+}
+
+static void
+scan_block (Block *b)
+{
+  char *p;
+
+  for ( p=BLOCK_ADDR (b) ; p<b->top ; p+=PREFIX_SIZE (*(uintptr_t *) p) )
+    {
+      scan_object ((uintptr_t *) p, NULL, NULL);
+    }
+}
+
+/* the number of union words of a Scheme_Object that can hold
+   pointers, or -1 if all of the object can */
+static long
+object_words (Scheme_Value obj)
+{
+  switch (SCHEME_TYPE_INDEX (obj))
+    {
+    case SCHEME_DOUBLE_TYPE_INDEX:
+    case SCHEME_NULL_TYPE_INDEX:
+    case SCHEME_TRUE_TYPE_INDEX:
+    case SCHEME_FALSE_TYPE_INDEX:
+    case SCHEME_EOF_TYPE_INDEX:
+      return (0);
+    case SCHEME_STRING_TYPE_INDEX:
+    case SCHEME_SYMBOL_TYPE_INDEX:
+    case SCHEME_PRIM_TYPE_INDEX:
+    case SCHEME_MACRO_TYPE_INDEX:
+    case SCHEME_POINTER_TYPE_INDEX:
+    case SCHEME_HASH_TABLE_TYPE_INDEX:
+    case SCHEME_ENVIRONMENT_TYPE_INDEX:
+      return (1);
+    case SCHEME_PAIR_TYPE_INDEX:
+    case SCHEME_CLOSURE_TYPE_INDEX:
+      return (2);
+    default:
+      return (-1);
+    }
+}
+
+/* update the pointers of an allocation, or those between LO and HI */
+static void
+scan_object (uintptr_t *prefix, char *lo, char *hi)
+{
+  uintptr_t *p, *end, old;
+  long n;
+
+  end = (uintptr_t *) ((char *) prefix + PREFIX_SIZE (*prefix));
+  switch (PREFIX_KIND (*prefix))
+    {
+    case SCHEME_GC_OBJECT:
+      p = (uintptr_t *) &((Scheme_Value) (prefix + 1))->u;
+      n = object_words ((Scheme_Value) (prefix + 1));
+      if (n >= 0 && p + n < end)
+	{
+	  end = p + n;
+	}
+      break;
+    case SCHEME_GC_SCANNED:
+      p = prefix + 1;
+      break;
+    case SCHEME_GC_KEYS:
+      p = prefix + 2;
+      break;
+    case SCHEME_GC_TYPED:
+      scan_typed (prefix, lo, hi);
+      return;
+    default:
+      return;
+    }
+  if (lo && (char *) p < lo)
+    {
+      p = (uintptr_t *) lo;
+    }
+  if (hi && (char *) end > hi)
+    {
+      end = (uintptr_t *) hi;
+    }
+  for ( ; p<end ; ++p )
+    {
+      if (IN_HEAP (*p))
+	{
+	  old = *p;
+	  *p = relocate (old);
+	  if (*p != old && PREFIX_KIND (*prefix) == SCHEME_GC_KEYS)
+	    {
+	      prefix[1] = 1;
+	    }
+	}
+    }
+}
+
+/* update the words of a typed allocation that its layout marks */
+static void
+scan_typed (uintptr_t *prefix, char *lo, char *hi)
+{
+  uintptr_t bitmap, *p, *end;
+  int i;
+
+  bitmap = gc.layouts[PREFIX_LAYOUT (*prefix)];
+  end = (uintptr_t *) ((char *) prefix + PREFIX_SIZE (*prefix));
+  for ( i=0 ; bitmap ; ++i, bitmap>>=1 )
+    {
+      p = prefix + 1 + i;
+      if (p >= end || (hi && (char *) p >= hi))
+	{
+	  break;
+	}
+      if ((bitmap & 1) && ! (lo && (char *) p < lo) && IN_HEAP (*p))
+	{
+	  *p = relocate (*p);
+	}
+    }
+}
+
+/* Return where the allocation P points into lives after this
+   collection, copying it there if need be. */
+static uintptr_t
+relocate (uintptr_t p)
+{
+  Block *b, *head;
+  uintptr_t *prefix;
+  size_t size;
+  char *copy;
+
+  b = BLOCK_OF (p);
+  if (! from_space (b))
+    {
+      return (p);
+    }
+  if (b->role != SMALL)
+    {
+      head = &gc.blocks[b->head];
+      if (! head->marked)
+	{
+	  head->marked = 1;
+	  push_index (&gc.gray, &gc.num_gray, &gc.max_gray, b->head);
+	}
+      return (p);
+    }
+  if (b->pinned)
+    {
+      return (p);
+    }
+  prefix = find_start (b, (char *) p);
+  if (! prefix)
+    {
+      return (p);
+    }
+  if (PREFIX_KIND (*prefix) == FORWARDED)
+    {
+      return (prefix[1] + (p - (uintptr_t) prefix));
+    }
+  size = PREFIX_SIZE (*prefix);
+  if (p >= (uintptr_t) prefix + size)
+    {
+      return (p);
+    }
+  copy = copy_alloc (size);
+  memcpy (copy, prefix, size);
+  *prefix = PREFIX (size, FORWARDED);
+  prefix[1] = (uintptr_t) copy;
+  return ((uintptr_t) copy + (p - (uintptr_t) prefix));
+}
+
+static char *
+copy_alloc (size_t total)
+{
+  Block *b;
+  char *p;
+
+  if (gc.copy + total > gc.copy_limit)
+    {
+      if (gc.copy_block)
+	{
+	  gc.copy_block->top = gc.copy;
+	}
+      b = take_block (COPY);
+      if (! b)
+	{
+	  fprintf (stderr, "libscheme: out of memory during collection\n");
+	  abort ();
+	}
+      push_index (&gc.copied, &gc.num_copied, &gc.max_copied, (int) (b - gc.blocks));
+      gc.copy_block = b;
+      gc.copy = BLOCK_ADDR (b);
+      gc.copy_limit = gc.copy + BLOCK_SIZE;
+    }
+  p = gc.copy;
+  gc.copy += total;
+  b = gc.copy_block;
+  b->starts[(p - BLOCK_ADDR (b)) / WORD / BITS] |= (uintptr_t) 1 << ((p - BLOCK_ADDR (b)) / WORD % BITS);
+  return (p);
+}
+
+/* scan copies and large allocations until nothing new is found */
+static void
+drain (void)
+{
+  Block *b;
+  char *top;
+  int head;
+
+  for (;;)
+    {
+      if (gc.scan_index < gc.num_copied)
+	{
+	  b = &gc.blocks[gc.copied[gc.scan_index]];
+	  top = (b == gc.copy_block) ? gc.copy : b->top;
+	  if (! gc.scan)
+	    {
+	      gc.scan = BLOCK_ADDR (b);
+	    }
+	  if (gc.scan < top)
+	    {
+	      scan_object ((uintptr_t *) gc.scan, NULL, NULL);
+	      gc.scan += PREFIX_SIZE (*(uintptr_t *) gc.scan);
+	      continue;
+	    }
+	  if (b != gc.copy_block)
+	    {
+	      gc.scan_index++;
+	      gc.scan = NULL;
+	      continue;
+	    }
+	}
+      if (gc.num_gray > 0)
+	{
+	  head = gc.gray[--gc.num_gray];
+	  scan_object ((uintptr_t *) BLOCK_ADDR (&gc.blocks[head]), NULL, NULL);
+	  continue;
+	}
+      break;
+    }
+}
+
+/* Free what was not reached and promote what was.  Pinned blocks and
+   large allocations that were young may still be being filled in by
+   the code that holds them, so their cards are left dirty for the
+   next collection. */
+static void
+finish (void)
+{
+  int i, j, was_young;
+  Block *b;
+
+  if (gc.copy_block)
+    {
+      gc.copy_block->top = gc.copy;
+    }
+  if (gc.major)
+    {
+      memset (gc.cards, 0, (size_t) gc.high * BLOCK_CARDS);
+      for ( i=0 ; i<gc.high ; ++i )
+	{
+	  gc.blocks[i].dirty = 0;
+	}
+    }
+  gc.old = 0;
+  for ( i=0 ; i<gc.high ; ++i )
+    {
+      b = &gc.blocks[i];
+      if (b->state == COPY)
+	{
+	  b->state = OLD;
+	}
+      else if (from_space (b) && b->role == HEAD)
+	{
+	  if (b->marked || b->pinned)
+	    {
+	      was_young = (b->state == YOUNG);
+	      for ( j=i ; j<i + b->span ; ++j )
+		{
+		  if (was_young)
+		    {
+		      memset (gc.cards + ((size_t) j * BLOCK_CARDS), 1, BLOCK_CARDS);
+		      gc.blocks[j].dirty = 1;
+		    }
+		  gc.blocks[j].state = OLD;
+		}
+	      b->state = OLD;
+	      b->marked = 0;
+	    }
+	  else
+	    {
+	      for ( j=i ; j<i + b->span ; ++j )
+		{
+		  free_block (&gc.blocks[j]);
+		}
+	    }
+	}
+      else if (from_space (b) && b->role == SMALL)
+	{
+	  if (b->pinned)
+	    {
+	      b->state = OLD;
+	      b->pinned = 0;
+	      memset (gc.cards + ((size_t) i * BLOCK_CARDS), 1, BLOCK_CARDS);
+	      b->dirty = 1;
+	    }
+	  else
+	    {
+	      free_block (b);
+	    }
+	}
+      if (b->state == OLD)
+	{
+	  gc.old++;
+	}
+    }
+  gc.young = 0;
+  gc.hint = 0;
+  if (gc.major)
+    {
+      gc.major_limit = 2 * gc.old > 4 * SCHEME_GC_NURSERY ? 2 * gc.old : 4 * SCHEME_GC_NURSERY;
+    }
+}
+
+/* the prefix of the allocation containing P, or NULL */
+static uintptr_t *
+find_start (Block *b, char *p)
+{
+  char *base;
+  size_t w, i;
+  uintptr_t bits;
+  int j;
+
+  base = BLOCK_ADDR (b);
+  w = (size_t) (p - base) / WORD;
+  i = w / BITS;
+  bits = b->starts[i] & ((((uintptr_t) 2) << (w % BITS)) - 1);
+  while (! bits)
+    {
+      if (i == 0)
+	{
+	  return (NULL);
+	}
+      bits = b->starts[--i];
+    }
+  for ( j=BITS - 1 ; ! (bits >> j) ; --j )
+    ;
+  return ((uintptr_t *) (base + (i * BITS + j) * WORD));
+}
+
+static void
+push_index (int **array, int *num, int *max, int index)
+{
+  if (*num == *max)
+    {
+      *max = *max ? 2 * *max : 64;
+      *array = (int *) realloc (*array, *max * sizeof (int));
+      if (! *array)
+	{
+	  fprintf (stderr, "libscheme: out of memory during collection\n");
+	  abort ();
+	}
+    }
+  (*array)[(*num)++] = index;
+}
+
+#endif /* PRECISE_GC */
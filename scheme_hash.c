@@ -24,67 +24,127 @@
 
 #include "scheme_private.h"
 #include <string.h>
+#include <ctype.h>
 
 /* static function declarations */
-static unsigned int scheme_hash (char *key);
+static int find (Scheme_Hash_Table *table, char *key, unsigned int h);
+static void grow (Scheme_Hash_Table *table);
+static void alloc_entries (Scheme_Hash_Table *table, int size);
+static void init_layout (void);
+
+static Scheme_Layout *table_layout;
+SCHEME_DEFINE_ONCE (layout_once);
 
 /* exported functions */
 
+/* Make a table with room for about SIZE keys before it first grows. */
 Scheme_Hash_Table *
 scheme_make_hash_table (int size)
 {
   Scheme_Hash_Table *table;
-
-  table = (Scheme_Hash_Table*) scheme_malloc (sizeof (Scheme_Hash_Table));
-  table->size = size;
-  table->buckets = (Scheme_Hash_Bucket **) scheme_calloc (size, sizeof (Scheme_Hash_Bucket *));
+  int n;
+
+  SCHEME_ONCE (layout_once, init_layout);
+  table = (Scheme_Hash_Table*) scheme_malloc_typed (sizeof (Scheme_Hash_Table), table_layout);
+  for ( n=8 ; n<size ; n*=2 )
+    ;
+  table->count = 0;
+  alloc_entries (table, n);
   return (table);
 }
 
-void
-scheme_add_to_table (Scheme_Hash_Table *table, char *key, void *val)
+unsigned int
+scheme_hash_string (char *key)
 {
-  unsigned int h, i;
-  Scheme_Hash_Bucket *bucket;
+  unsigned int h;
 
-  h = i = 0;
-  while ( key[i] )
+  h = 0;
+  while (*key)
     {
-      h += (h << 5) + h + key[i++];
+      h += (h << 5) + h + (unsigned char) *key++;
     }
-  h = h % table->size;
-  bucket = (Scheme_Hash_Bucket *) scheme_malloc (sizeof (Scheme_Hash_Bucket));
-  bucket->key = scheme_strdup (key);
-  bucket->val = val;
-  bucket->next = table->buckets[h];
-  table->buckets[h] = bucket;
+  /* 0 marks an empty entry */
+  return (h ? h : 1);
 }
 
-void *
-scheme_lookup_in_table (Scheme_Hash_Table *table, char *key)
+/* the hash scheme_hash_string gives the LEN characters at NAME in
+   lower case */
+unsigned int
+scheme_hash_folded (const char *name, int len)
 {
   unsigned int h;
-  char *str;
-  Scheme_Hash_Bucket *bucket;
+  int i;
 
   h = 0;
-  str = key;
-  while ( *str )
+  for ( i=0 ; i<len ; ++i )
     {
-      h += (h << 5) + h + *str++;
+      h += (h << 5) + h + (unsigned char) tolower ((unsigned char) name[i]);
     }
-  h = h % table->size;
-  bucket = table->buckets[h];
-  while ( bucket )
+  return (h ? h : 1);
+}
+
+/* Add KEY, which must not be in TABLE yet.  KEY is not copied, so it
+   should belong to VAL or otherwise live as long as the entry. */
+void
+scheme_add_to_table (Scheme_Hash_Table *table, char *key, void *val)
+{
+  scheme_add_hashed (table, key, scheme_hash_string (key), val);
+}
+
+/* the same, given the hash of KEY */
+void
+scheme_add_hashed (Scheme_Hash_Table *table, char *key, unsigned int h, void *val)
+{
+  int i;
+
+  if (100 * (table->count + 1) > SCHEME_HASH_LOAD * table->size)
     {
-      if (strcmp (key, bucket->key) == 0)
-        {
-          return (bucket->val);
-        }
-      else
-        {
-          bucket = bucket->next;
-        }
+      grow (table);
+    }
+  i = find (table, key, h);
+  table->hashes[i] = h;
+  table->entries[i].key = key;
+  table->entries[i].val = val;
+  SCHEME_GC_WRITE (&table->entries[i].key);
+  SCHEME_GC_WRITE (&table->entries[i].val);
+  table->count++;
+}
+
+void *
+scheme_lookup_in_table (Scheme_Hash_Table *table, char *key)
+{
+  return (table->entries[find (table, key, scheme_hash_string (key))].val);
+}
+
+void *
+scheme_lookup_hashed (Scheme_Hash_Table *table, char *key, unsigned int hash)
+{
+  return (table->entries[find (table, key, hash)].val);
+}
+
+/* Look up the LEN characters at NAME as if they were in lower case,
+   given their scheme_hash_folded.  The keys of TABLE must be in lower
+   case. */
+void *
+scheme_lookup_folded (Scheme_Hash_Table *table, const char *name, int len, unsigned int hash)
+{
+  unsigned int mask = table->size - 1;
+  char *key;
+  int i, j;
+
+  for ( i=hash & mask ; table->hashes[i] ; i=(i + 1) & mask )
+    {
+      if (table->hashes[i] != hash)
+	{
+	  continue;
+	}
+      key = table->entries[i].key;
+      for ( j=0 ; j<len && key[j] == tolower ((unsigned char) name[j]) ; ++j )
+	;
+      if (j == len && key[len] == '\0')
+	{
+	  return (table->entries[i].val);
+	}
     }
   return (NULL);
 }
@@ -92,38 +152,79 @@ scheme_lookup_in_table (Scheme_Hash_Table *table, char *key)
 void
 scheme_change_in_table (Scheme_Hash_Table *table, char *key, void *new)
 {
-  unsigned int h, i;
-  Scheme_Hash_Bucket *bucket;
+  Scheme_Hash_Entry *entry;
 
-  h = i = 0;
-  while ( key[i] )
-    {
-      h += (h << 5) + h + key[i++];
-    }
-  h = h % table->size;
-  bucket = table->buckets[h];
-  while ( bucket )
+  entry = &table->entries[find (table, key, scheme_hash_string (key))];
+  if (entry->key)
     {
-      if (strcmp (key, bucket->key) == 0)
-        {
-          bucket->val = new;
-          return;
-        }
-      bucket = bucket->next;
+      entry->val = new;
+      SCHEME_GC_WRITE (&entry->val);
     }
 }
 
 /* static functions */
 
-static unsigned int
-scheme_hash (char *key)
+static void
+init_layout (void)
 {
-  unsigned int h;
+  table_layout = scheme_make_layout (sizeof (Scheme_Hash_Table),
+				     SCHEME_LAYOUT_SLOT (Scheme_Hash_Table, hashes)
+				     | SCHEME_LAYOUT_SLOT (Scheme_Hash_Table, entries));
+}
 
-  h = 0;
-  while (*key)
+/* the entry of KEY, whose hash is H, or the empty one it would go in */
+static int
+find (Scheme_Hash_Table *table, char *key, unsigned int h)
+{
+  unsigned int mask = table->size - 1;
+  int i;
+
+  for ( i=h & mask ; table->hashes[i] ; i=(i + 1) & mask )
     {
-      h += (h << 5) + h + *key++;
+      if (table->hashes[i] == h && strcmp (key, table->entries[i].key) == 0)
+	{
+	  break;
+	}
     }
-  return (h);
+  return (i);
+}
+
+static void
+grow (Scheme_Hash_Table *table)
+{
+  unsigned int *hashes = table->hashes;
+  Scheme_Hash_Entry *entries = table->entries;
+  unsigned int mask;
+  int i, j, size = table->size;
+
+  alloc_entries (table, 2 * size);
+  mask = table->size - 1;
+  for ( i=0 ; i<size ; ++i )
+    {
+      if (hashes[i])
+	{
+	  for ( j=hashes[i] & mask ; table->hashes[j] ; j=(j + 1) & mask )
+	    ;
+	  table->hashes[j] = hashes[i];
+	  table->entries[j] = entries[i];
+	}
+    }
+}
+
+static void
+alloc_entries (Scheme_Hash_Table *table, int size)
+{
+  unsigned int *hashes;
+  Scheme_Hash_Entry *entries;
+
+  /* both are allocated before either is stored, so that no collection
+     comes between a store and its write barrier */
+  hashes = (unsigned int *) scheme_malloc_atomic (size * sizeof (unsigned int));
+  entries = (Scheme_Hash_Entry *) scheme_calloc (size, sizeof (Scheme_Hash_Entry));
+  memset (hashes, 0, size * sizeof (unsigned int));
+  table->size = size;
+  table->hashes = hashes;
+  table->entries = entries;
+  SCHEME_GC_WRITE (&table->hashes);
+  SCHEME_GC_WRITE (&table->entries);
 }
@@ -0,0 +1,1140 @@
+/*
+  libscheme
+  Copyright (c) 1994 Brent Benson
+  All rights reserved.
+
+  Permission is hereby granted, without written agreement and without
+  license or royalty fees, to use, copy, modify, and distribute this
+  software and its documentation for any purpose, provided that the
+  above copyright notice and the following two paragraphs appear in
+  all copies of this software.
+
+  IN NO EVENT SHALL BRENT BENSON BE LIABLE TO ANY PARTY FOR DIRECT,
+  INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES ARISING OUT
+  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF BRENT
+  BENSON HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+  BRENT BENSON SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT
+  NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER
+  IS ON AN "AS IS" BASIS, AND BRENT BENSON HAS NO OBLIGATION TO
+  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR
+  MODIFICATIONS.
+*/
+
+/* Heap images.  (save-image FILE [ENV]) writes everything reachable
+   from the global variables of ENV, by default the current
+   environment, to FILE, and scheme_load_image, or (load-image FILE
+   [ENV]), maps such a file back in and binds the globals again, so a
+   program's prelude need not be read and evaluated on every start.
+
+   An image is a header followed by records, each a kind and size
+   word, a word for the address the record ends up at once loaded,
+   and a body.  Pointers between records are stored as the offset of
+   the record in the file; fixnums and characters are stored as they
+   are.  Pairs, vectors, strings, closures and the like are laid out
+   in their bodies as the objects themselves and are used in place in
+   the mapped file.  Symbols are interned again, types are found by
+   index or name, and primitives and syntax are rebuilt from the
+   offsets of their C functions from scheme_basic_env, which ties an
+   image to the executable that saved it.  Closures keep the source
+   of their lambda, whose body is analyzed the first time it runs.
+   Hash tables keep their kind and entries and are filled again once
+   everything else is loaded, since keys may be hashed by address. */
+
+#include "scheme_private.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define IMAGE_MAGIC	"LSIMAGE1"
+
+/* record kinds */
+#define OBJECT	1		/* a Scheme_Object, used in place */
+#define SYMBOL	2		/* the name of a symbol */
+#define TYPE	3		/* a type, by index or name */
+#define CONST	4		/* one of the constants below */
+#define PRIM	5		/* a primitive */
+#define SYNTAX	6		/* a syntax object */
+#define FRAME	7		/* a Scheme_Env, used in place */
+#define ARRAY	8		/* an array of values, used in place */
+#define LAMBDA	9		/* the code of a lambda */
+#define TABLE	10		/* a hash table */
+
+/* constants */
+#define C_NULL		0
+#define C_TRUE		1
+#define C_FALSE		2
+#define C_EOF		3
+#define C_STDIN		4
+#define C_STDOUT	5
+#define C_STDERR	6
+#define C_GLOBAL_ENV	7
+
+#define WORD		sizeof (uintptr_t)
+#define ALIGN(n)	(((n) + WORD - 1) / WORD * WORD)
+#define INFO(kind, size) (((uintptr_t) (size) << 8) | (kind))
+#define INFO_KIND(w)	((int) ((w) & 0xff))
+#define INFO_SIZE(w)	((size_t) ((w) >> 8))
+
+typedef struct Image_Header
+{
+  char magic[8];
+  uintptr_t word_size;
+  uintptr_t num_builtin_types;
+  uintptr_t code_check;		/* tells executables apart */
+  uintptr_t size;		/* of the whole image */
+  uintptr_t globals;		/* an ARRAY of names and values */
+} Image_Header;
+
+typedef struct Image_Record
+{
+  uintptr_t info;
+  uintptr_t forward;
+} Image_Record;
+
+#define BODY(rec)	((char *) ((Image_Record *) (rec) + 1))
+
+typedef struct Image_Type
+{
+  intptr_t index;		/* of a builtin type, or -1 */
+  uintptr_t flags;
+  char name[];
+} Image_Type;
+
+typedef struct Image_Prim
+{
+  intptr_t fun, prim1, prim2, prim3;
+  int mina, maxa;
+  char name[];
+} Image_Prim;
+
+typedef struct Image_Syntax
+{
+  intptr_t proc, analyzer;
+} Image_Syntax;
+
+typedef struct Image_Lambda
+{
+  Scheme_Value code;
+  Scheme_Lambda *lambda;	/* made when the image is loaded */
+} Image_Lambda;
+
+typedef struct Image_Table
+{
+  uintptr_t kind;
+  Scheme_Value entries[];	/* keys and values */
+} Image_Table;
+
+#define TABLE_ENTRIES(rec) \
+  ((INFO_SIZE ((rec)->info) - sizeof (Image_Table)) / WORD)
+
+/* what save-image keeps while it writes; nothing in it is allocated
+   from the collector, so no collection can move what it points to */
+typedef struct Saver
+{
+  char *buf;
+  size_t size, max;
+  /* the record written for each address */
+  void **keys;
+  uintptr_t *refs;
+  size_t num_keys, max_keys;
+  /* records whose pointers are still to be converted */
+  uintptr_t *todo;
+  size_t num_todo, max_todo;
+  /* of the environment being saved */
+  Scheme_Hash_Table *globals;
+} Saver;
+
+/* locals */
+static Scheme_Value save_image (int argc, Scheme_Value argv[]);
+static Scheme_Value load_image (int argc, Scheme_Value argv[]);
+static Scheme_Env *image_env (int argc, Scheme_Value argv[], const char *name);
+static void save_error (Saver *s, const char *msg, const char *what);
+static uintptr_t save_value (Saver *s, Scheme_Value v);
+static uintptr_t save_frame (Saver *s, Scheme_Env *env);
+static uintptr_t save_array (Saver *s, Scheme_Value *array, int n);
+static uintptr_t save_lambda (Saver *s, Scheme_Lambda *lambda);
+static uintptr_t save_symbol (Saver *s, const char *name);
+static uintptr_t save_const (Saver *s, void *key, int which);
+static uintptr_t save_type (Saver *s, Scheme_Value type);
+static uintptr_t save_prim (Saver *s, Scheme_Value prim);
+static uintptr_t save_syntax (Saver *s, Scheme_Value syntax);
+static uintptr_t save_object (Saver *s, Scheme_Value obj, size_t size);
+static uintptr_t save_table (Saver *s, Scheme_Value table);
+static void save_slot (Saver *s, uintptr_t offset, int kind);
+static void convert (Saver *s, uintptr_t ref);
+static uintptr_t new_record (Saver *s, void *key, int kind, size_t size);
+static uintptr_t lookup (Saver *s, void *key);
+static void remember (Saver *s, void *key, uintptr_t ref);
+static size_t object_size (Scheme_Value obj);
+static intptr_t code_offset (void *fun);
+static void *code_address (intptr_t offset);
+static void resolve (char *base, Image_Record *rec, Scheme_Env *env);
+static void fix (char *base, Image_Record *rec, Scheme_Env *env);
+static void fix_slot (char *base, void *slot);
+static Scheme_Value load_type (Image_Type *it);
+static Scheme_Value lazy_body_eval (Scheme_Node *node, Scheme_Env *env);
+
+static const Scheme_Prim_Entry image_prims[] =
+{
+  SCHEME_PRIM_ENTRY ("save-image", save_image, 0, -1),
+  SCHEME_PRIM_ENTRY ("load-image", load_image, 0, -1)
+};
+
+void
+scheme_init_image (Scheme_Env *env)
+{
+  scheme_add_prims (image_prims, SCHEME_NUM_ENTRIES (image_prims), env);
+}
+
+/* Write the globals of ENV and everything they reach to PATH. */
+void
+scheme_save_image (const char *path, Scheme_Env *env)
+{
+  Saver saver, *s = &saver;
+  Image_Header *header;
+  Scheme_Hash_Table *globals;
+  Scheme_Global_Cell *cell;
+  uintptr_t array, ref;
+  int i, n;
+  FILE *fp;
+
+  memset (s, 0, sizeof (Saver));
+  new_record (s, NULL, 0, sizeof (Image_Header) - sizeof (Image_Record));
+  s->size = sizeof (Image_Header);
+
+  /* the globals, as name and value pairs */
+  globals = env->globals;
+  s->globals = globals;
+  n = 0;
+  for ( i=0 ; i<globals->size ; ++i )
+    {
+      cell = (Scheme_Global_Cell *) globals->entries[i].val;
+      if (cell && cell->val)
+	{
+	  n++;
+	}
+    }
+  /* the values are converted with everything else and the names
+     filled in once nothing is left to convert */
+  array = new_record (s, NULL, ARRAY, 2 * n * WORD);
+  n = 0;
+  for ( i=0 ; i<globals->size ; ++i )
+    {
+      cell = (Scheme_Global_Cell *) globals->entries[i].val;
+      if (cell && cell->val)
+	{
+	  ((Scheme_Value *) BODY (s->buf + array))[2 * n++ + 1] = cell->val;
+	}
+    }
+  while (s->num_todo)
+    {
+      convert (s, s->todo[--s->num_todo]);
+    }
+  n = 0;
+  for ( i=0 ; i<globals->size ; ++i )
+    {
+      cell = (Scheme_Global_Cell *) globals->entries[i].val;
+      if (cell && cell->val)
+	{
+	  ref = save_symbol (s, cell->name);
+	  ((uintptr_t *) BODY (s->buf + array))[2 * n++] = ref;
+	}
+    }
+
+  header = (Image_Header *) s->buf;
+  memset (header, 0, sizeof (Image_Header));
+  memcpy (header->magic, IMAGE_MAGIC, sizeof (header->magic));
+  header->word_size = WORD;
+  header->num_builtin_types = SCHEME_NUM_BUILTIN_TYPES;
+  header->code_check = code_offset ((void *) scheme_load_image);
+  header->size = s->size;
+  header->globals = array;
+
+  fp = fopen (path, "wb");
+  if (! fp)
+    {
+      save_error (s, "save-image: could not open file for writing: %s", path);
+    }
+  if (fwrite (s->buf, 1, s->size, fp) != s->size || fclose (fp) != 0)
+    {
+      save_error (s, "save-image: could not write image: %s", path);
+    }
+  free (s->buf);
+  free (s->keys);
+  free (s->refs);
+  free (s->todo);
+}
+
+/* Map the image in PATH and bind its globals in ENV. */
+void
+scheme_load_image (const char *path, Scheme_Env *env)
+{
+  Image_Header *header;
+  Image_Record *rec;
+  struct stat st;
+  char *base, *p;
+  uintptr_t *globals;
+  size_t i, n;
+  int fd;
+
+  fd = open (path, O_RDONLY);
+  if (fd < 0)
+    {
+      scheme_signal_error ("could not open image: %s", path);
+    }
+  if (fstat (fd, &st) != 0 || (size_t) st.st_size < sizeof (Image_Header))
+    {
+      close (fd);
+      scheme_signal_error ("not an image: %s", path);
+    }
+  base = mmap (NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (base == MAP_FAILED)
+    {
+      scheme_signal_error ("could not map image: %s", path);
+    }
+  header = (Image_Header *) base;
+  if (memcmp (header->magic, IMAGE_MAGIC, sizeof (header->magic)) != 0
+      || header->size != (uintptr_t) st.st_size)
+    {
+      munmap (base, st.st_size);
+      scheme_signal_error ("not an image: %s", path);
+    }
+  if (header->word_size != WORD
+      || header->num_builtin_types != SCHEME_NUM_BUILTIN_TYPES
+      || header->code_check != (uintptr_t) code_offset ((void *) scheme_load_image))
+    {
+      munmap (base, st.st_size);
+      scheme_signal_error ("image was saved by a different executable: %s", path);
+    }
+
+  /* the objects in the image point into the heap from now on, and
+     the forwarding words hold what is made below */
+  scheme_gc_add_roots (base, base + header->size);
+
+  /* find or make what each record stands for, then turn offsets into
+     addresses, then make the lambdas, which need their code */
+  for ( p=base + sizeof (Image_Header) ; p<base + header->size ; p=BODY (p) + INFO_SIZE (rec->info) )
+    {
+      rec = (Image_Record *) p;
+      resolve (base, rec, env);
+    }
+  for ( p=base + sizeof (Image_Header) ; p<base + header->size ; p=BODY (p) + INFO_SIZE (rec->info) )
+    {
+      rec = (Image_Record *) p;
+      fix (base, rec, env);
+    }
+  for ( p=base + sizeof (Image_Header) ; p<base + header->size ; p=BODY (p) + INFO_SIZE (rec->info) )
+    {
+      rec = (Image_Record *) p;
+      if (INFO_KIND (rec->info) == LAMBDA)
+	{
+	  Image_Lambda *il = (Image_Lambda *) BODY (rec);
+	  Scheme_Node *body;
+
+	  il->lambda = scheme_make_lambda (il->code);
+	  body = scheme_make_node (lazy_body_eval, il->code, 0);
+	  SCHEME_NODE_LAMBDA (body) = il->lambda;
+	  il->lambda->body = body;
+	  rec->forward = (uintptr_t) il->lambda;
+	}
+    }
+  for ( p=base + sizeof (Image_Header) ; p<base + header->size ; p=BODY (p) + INFO_SIZE (rec->info) )
+    {
+      rec = (Image_Record *) p;
+      if (INFO_KIND (rec->info) == OBJECT && SCHEME_CLOSUREP ((Scheme_Value) BODY (rec)))
+	{
+	  fix_slot (base, &SCHEME_CLOS_LAMBDA ((Scheme_Value) BODY (rec)));
+	}
+    }
+  /* the tables last, as their keys must be complete to be hashed */
+  for ( p=base + sizeof (Image_Header) ; p<base + header->size ; p=BODY (p) + INFO_SIZE (rec->info) )
+    {
+      rec = (Image_Record *) p;
+      if (INFO_KIND (rec->info) == TABLE)
+	{
+	  Image_Table *it = (Image_Table *) BODY (rec);
+
+	  n = TABLE_ENTRIES (rec);
+	  for ( i=0 ; i<n ; i+=2 )
+	    {
+	      scheme_table_put ((Scheme_Value) rec->forward, it->entries[i], it->entries[i + 1]);
+	    }
+	}
+    }
+
+  rec = (Image_Record *) (base + header->globals);
+  globals = (uintptr_t *) BODY (rec);
+  n = INFO_SIZE (rec->info) / WORD;
+  for ( i=0 ; i<n ; i+=2 )
+    {
+      scheme_add_global (SCHEME_STR_VAL ((Scheme_Value) globals[i]),
+			 (Scheme_Value) globals[i + 1], env);
+    }
+}
+
+/* locals */
+
+static Scheme_Value
+save_image (int argc, Scheme_Value argv[])
+{
+  scheme_save_image (SCHEME_STR_VAL (argv[0]), image_env (argc, argv, "save-image"));
+  return (scheme_true);
+}
+
+static Scheme_Value
+load_image (int argc, Scheme_Value argv[])
+{
+  scheme_load_image (SCHEME_STR_VAL (argv[0]), image_env (argc, argv, "load-image"));
+  return (scheme_true);
+}
+
+/* the environment of (NAME file [env]) */
+static Scheme_Env *
+image_env (int argc, Scheme_Value argv[], const char *name)
+{
+  if (argc != 1 && argc != 2)
+    {
+      scheme_signal_error ("%s: wrong number of args", name);
+    }
+  if (! SCHEME_STRINGP (argv[0]))
+    {
+      scheme_signal_error ("%s: first arg must be a string", name);
+    }
+  if (argc == 1)
+    {
+      return (scheme_env);
+    }
+  if (! SCHEME_ENVIRONMENTP (argv[1]))
+    {
+      scheme_signal_error ("%s: second arg must be an environment", name);
+    }
+  return (SCHEME_ENV_VAL (argv[1]));
+}
+
+static void
+save_error (Saver *s, const char *msg, const char *what)
+{
+  free (s->buf);
+  free (s->keys);
+  free (s->refs);
+  free (s->todo);
+  scheme_signal_error ((char *) msg, what);
+}
+
+/* the record for V, written now if it was not already */
+static uintptr_t
+save_value (Saver *s, Scheme_Value v)
+{
+  uintptr_t ref;
+
+  if (! v || SCHEME_IMMEDIATEP (v))
+    {
+      return ((uintptr_t) v);
+    }
+  ref = lookup (s, v);
+  if (ref)
+    {
+      return (ref);
+    }
+  if (v == scheme_null)
+    {
+      return (save_const (s, v, C_NULL));
+    }
+  if (v == scheme_true)
+    {
+      return (save_const (s, v, C_TRUE));
+    }
+  if (v == scheme_false)
+    {
+      return (save_const (s, v, C_FALSE));
+    }
+  if (v == scheme_eof)
+    {
+      return (save_const (s, v, C_EOF));
+    }
+  if (v == scheme_stdin_port)
+    {
+      return (save_const (s, v, C_STDIN));
+    }
+  if (v == scheme_stdout_port)
+    {
+      return (save_const (s, v, C_STDOUT));
+    }
+  if (v == scheme_stderr_port)
+    {
+      return (save_const (s, v, C_STDERR));
+    }
+  switch (SCHEME_TYPE_INDEX (v))
+    {
+    case SCHEME_TYPE_TYPE_INDEX:
+      return (save_type (s, v));
+    case SCHEME_SYMBOL_TYPE_INDEX:
+      ref = save_symbol (s, SCHEME_STR_VAL (v));
+      remember (s, v, ref);
+      return (ref);
+    case SCHEME_PRIM_TYPE_INDEX:
+      return (save_prim (s, v));
+    case SCHEME_SYNTAX_TYPE_INDEX:
+      return (save_syntax (s, v));
+    case SCHEME_PAIR_TYPE_INDEX:
+    case SCHEME_DOUBLE_TYPE_INDEX:
+    case SCHEME_STRING_TYPE_INDEX:
+    case SCHEME_VECTOR_TYPE_INDEX:
+    case SCHEME_CLOSURE_TYPE_INDEX:
+    case SCHEME_MACRO_TYPE_INDEX:
+    case SCHEME_PROMISE_TYPE_INDEX:
+    case SCHEME_STRUCT_PROC_TYPE_INDEX:
+      return (save_object (s, v, object_size (v)));
+    case SCHEME_HASH_TABLE_TYPE_INDEX:
+      return (save_table (s, v));
+    default:
+      if (SCHEME_HDR_FLAGS (SCHEME_OBJ_TYPE (v)) & SCHEME_STRUCT_TYPE_FLAG)
+	{
+	  return (save_object (s, v, object_size (v)));
+	}
+      save_error (s, "save-image: cannot save a %s", SCHEME_STR_VAL (SCHEME_OBJ_TYPE (v)));
+      return (0);
+    }
+}
+
+static uintptr_t
+save_frame (Saver *s, Scheme_Env *env)
+{
+  uintptr_t ref;
+
+  if (env->globals != s->globals)
+    {
+      save_error (s, "save-image: %s", "cannot save a closure made in another environment");
+    }
+  if (env->next == NULL)
+    {
+      ref = lookup (s, env);
+      return (ref ? ref : save_const (s, env, C_GLOBAL_ENV));
+    }
+  ref = lookup (s, env);
+  if (ref)
+    {
+      return (ref);
+    }
+  if (env->on_stack)
+    {
+      save_error (s, "save-image: %s", "cannot save a frame on the stack");
+    }
+  ref = new_record (s, env, FRAME, sizeof (Scheme_Env));
+  memcpy (BODY (s->buf + ref), env, sizeof (Scheme_Env));
+  return (ref);
+}
+
+static uintptr_t
+save_array (Saver *s, Scheme_Value *array, int n)
+{
+  uintptr_t ref;
+
+  /* an empty array may share its address with something else */
+  if (n == 0)
+    {
+      return (0);
+    }
+  ref = lookup (s, array);
+  if (ref)
+    {
+      return (ref);
+    }
+  ref = new_record (s, array, ARRAY, n * WORD);
+  memcpy (BODY (s->buf + ref), array, n * WORD);
+  return (ref);
+}
+
+static uintptr_t
+save_lambda (Saver *s, Scheme_Lambda *lambda)
+{
+  uintptr_t ref;
+
+  ref = lookup (s, lambda);
+  if (ref)
+    {
+      return (ref);
+    }
+  ref = new_record (s, lambda, LAMBDA, sizeof (Image_Lambda));
+  ((Image_Lambda *) BODY (s->buf + ref))->code = lambda->code;
+  ((Image_Lambda *) BODY (s->buf + ref))->lambda = NULL;
+  return (ref);
+}
+
+static uintptr_t
+save_symbol (Saver *s, const char *name)
+{
+  uintptr_t ref;
+
+  ref = new_record (s, NULL, SYMBOL, strlen (name) + 1);
+  strcpy (BODY (s->buf + ref), name);
+  return (ref);
+}
+
+static uintptr_t
+save_const (Saver *s, void *key, int which)
+{
+  uintptr_t ref;
+
+  ref = new_record (s, key, CONST, WORD);
+  *(uintptr_t *) BODY (s->buf + ref) = which;
+  return (ref);
+}
+
+static uintptr_t
+save_type (Saver *s, Scheme_Value type)
+{
+  Image_Type *it;
+  const char *name = SCHEME_STR_VAL (type);
+  uintptr_t ref;
+
+  ref = new_record (s, type, TYPE, sizeof (Image_Type) + strlen (name) + 1);
+  it = (Image_Type *) BODY (s->buf + ref);
+  it->index = (SCHEME_TYPE_NUM (type) < SCHEME_NUM_BUILTIN_TYPES) ? SCHEME_TYPE_NUM (type) : -1;
+  it->flags = SCHEME_HDR_FLAGS (type);
+  strcpy (it->name, name);
+  return (ref);
+}
+
+static uintptr_t
+save_prim (Saver *s, Scheme_Value prim)
+{
+  const Scheme_Prim_Desc *desc = SCHEME_PRIM_DESC (prim);
+  Image_Prim *ip;
+  uintptr_t ref;
+
+  ref = new_record (s, prim, PRIM, sizeof (Image_Prim) + strlen (desc->name) + 1);
+  ip = (Image_Prim *) BODY (s->buf + ref);
+  ip->fun = code_offset ((void *) desc->fun);
+  ip->prim1 = code_offset ((void *) desc->prim1);
+  ip->prim2 = code_offset ((void *) desc->prim2);
+  ip->prim3 = code_offset ((void *) desc->prim3);
+  ip->mina = desc->mina;
+  ip->maxa = desc->maxa;
+  strcpy (ip->name, desc->name);
+  return (ref);
+}
+
+static uintptr_t
+save_syntax (Saver *s, Scheme_Value syntax)
+{
+  Image_Syntax *is;
+  uintptr_t ref;
+
+  ref = new_record (s, syntax, SYNTAX, sizeof (Image_Syntax));
+  is = (Image_Syntax *) BODY (s->buf + ref);
+  is->proc = code_offset ((void *) SCHEME_SYNTAX (syntax));
+  is->analyzer = code_offset ((void *) SCHEME_SYNTAX_ANALYZER (syntax));
+  return (ref);
+}
+
+/* Copy OBJ into a record as it is; convert() turns its pointers into
+   record offsets later. */
+static uintptr_t
+save_object (Saver *s, Scheme_Value obj, size_t size)
+{
+  uintptr_t ref;
+
+  ref = new_record (s, obj, OBJECT, size);
+  memcpy (BODY (s->buf + ref), obj, size);
+  return (ref);
+}
+
+/* Write the entries of TABLE into a record; convert() turns them
+   into record offsets later. */
+static uintptr_t
+save_table (Saver *s, Scheme_Value table)
+{
+  Scheme_Value key, val;
+  Image_Table *it;
+  uintptr_t ref;
+  int i, n;
+
+  n = 0;
+  for ( i=scheme_table_next (table, 0, &key, &val) ; i>=0 ; i=scheme_table_next (table, i + 1, &key, &val) )
+    {
+      n += 2;
+    }
+  ref = new_record (s, table, TABLE, sizeof (Image_Table) + n * WORD);
+  it = (Image_Table *) BODY (s->buf + ref);
+  it->kind = scheme_table_kind (table);
+  n = 0;
+  for ( i=scheme_table_next (table, 0, &key, &val) ; i>=0 ; i=scheme_table_next (table, i + 1, &key, &val) )
+    {
+      it->entries[n++] = key;
+      it->entries[n++] = val;
+    }
+  return (ref);
+}
+
+/* replace the pointer at OFFSET in the buffer by its record */
+static void
+save_slot (Saver *s, uintptr_t offset, int kind)
+{
+  void *p = *(void **) (s->buf + offset);
+  uintptr_t ref;
+
+  if (! p)
+    {
+      return;
+    }
+  switch (kind)
+    {
+    case FRAME:
+      ref = save_frame (s, (Scheme_Env *) p);
+      break;
+    case LAMBDA:
+      ref = save_lambda (s, (Scheme_Lambda *) p);
+      break;
+    default:
+      ref = save_value (s, (Scheme_Value) p);
+      break;
+    }
+  *(uintptr_t *) (s->buf + offset) = ref;
+}
+
+/* Convert the pointers in the record at REF.  Offsets are used
+   throughout since saving a pointer may move the buffer. */
+static void
+convert (Saver *s, uintptr_t ref)
+{
+  Image_Record *rec = (Image_Record *) (s->buf + ref);
+  uintptr_t body = ref + sizeof (Image_Record);
+  size_t i, n;
+
+  switch (INFO_KIND (rec->info))
+    {
+    case OBJECT:
+      {
+	Scheme_Value obj = (Scheme_Value) BODY (rec);
+	Scheme_Value type = SCHEME_OBJ_TYPE (obj);
+	uintptr_t index = SCHEME_TYPE_INDEX (obj);
+	uintptr_t payload = body + SCHEME_OBJ_SIZE (ptr_val);
+
+	switch (index)
+	  {
+	  case SCHEME_PAIR_TYPE_INDEX:
+	    save_slot (s, body + offsetof (Scheme_Object, u.pair_val.car), OBJECT);
+	    save_slot (s, body + offsetof (Scheme_Object, u.pair_val.cdr), OBJECT);
+	    break;
+	  case SCHEME_CLOSURE_TYPE_INDEX:
+	    save_slot (s, body + offsetof (Scheme_Object, u.closure_val.env), FRAME);
+	    save_slot (s, body + offsetof (Scheme_Object, u.closure_val.lambda), LAMBDA);
+	    break;
+	  case SCHEME_MACRO_TYPE_INDEX:
+	    save_slot (s, body + offsetof (Scheme_Object, u.ptr_val), OBJECT);
+	    break;
+	  case SCHEME_PROMISE_TYPE_INDEX:
+	    save_slot (s, payload + offsetof (Scheme_Promise, val), OBJECT);
+	    save_slot (s, payload + offsetof (Scheme_Promise, env), FRAME);
+	    break;
+	  case SCHEME_STRUCT_PROC_TYPE_INDEX:
+	    save_slot (s, payload + offsetof (Scheme_Struct_Proc, struct_type), OBJECT);
+	    break;
+	  case SCHEME_DOUBLE_TYPE_INDEX:
+	  case SCHEME_STRING_TYPE_INDEX:
+	    break;
+	  default:
+	    /* vectors and structure instances */
+	    n = SCHEME_VEC_SIZE (obj);
+	    for ( i=0 ; i<n ; ++i )
+	      {
+		save_slot (s, body + SCHEME_OBJ_SIZE (vector_val) + i * WORD, OBJECT);
+	      }
+	    break;
+	  }
+	/* the header last, as it says how to read the rest */
+	*(uintptr_t *) (s->buf + body) = (uintptr_t) type;
+	save_slot (s, body, OBJECT);
+	break;
+      }
+    case FRAME:
+      {
+	Scheme_Env frame = *(Scheme_Env *) BODY (rec);
+	uintptr_t r;
+
+	r = save_array (s, frame.symbols, frame.num_bindings);
+	*(uintptr_t *) (s->buf + body + offsetof (Scheme_Env, symbols)) = r;
+	r = save_array (s, frame.values, frame.num_bindings);
+	*(uintptr_t *) (s->buf + body + offsetof (Scheme_Env, values)) = r;
+	*(uintptr_t *) (s->buf + body + offsetof (Scheme_Env, globals)) = 0;
+	*(uintptr_t *) (s->buf + body + offsetof (Scheme_Env, base)) = 0;
+	save_slot (s, body + offsetof (Scheme_Env, next), FRAME);
+	break;
+      }
+    case ARRAY:
+      n = INFO_SIZE (rec->info) / WORD;
+      for ( i=0 ; i<n ; ++i )
+	{
+	  save_slot (s, body + i * WORD, OBJECT);
+	}
+      break;
+    case LAMBDA:
+      save_slot (s, body + offsetof (Image_Lambda, code), OBJECT);
+      break;
+    case TABLE:
+      n = TABLE_ENTRIES (rec);
+      for ( i=0 ; i<n ; ++i )
+	{
+	  save_slot (s, body + offsetof (Image_Table, entries) + i * WORD, OBJECT);
+	}
+      break;
+    }
+}
+
+/* Append a record with SIZE bytes of body for KEY, to be converted
+   later if it holds pointers. */
+static uintptr_t
+new_record (Saver *s, void *key, int kind, size_t size)
+{
+  uintptr_t ref;
+  size_t total;
+
+  total = sizeof (Image_Record) + ALIGN (size);
+  if (s->size + total > s->max)
+    {
+      char *buf;
+
+      s->max = 2 * (s->size + total) + 4096;
+      buf = (char *) realloc (s->buf, s->max);
+      if (! buf)
+	{
+	  save_error (s, "save-image: %s", "out of memory");
+	}
+      s->buf = buf;
+    }
+  ref = s->size;
+  memset (s->buf + ref, 0, total);
+  ((Image_Record *) (s->buf + ref))->info = INFO (kind, ALIGN (size));
+  s->size += total;
+  if (key)
+    {
+      remember (s, key, ref);
+    }
+  if (kind == OBJECT || kind == FRAME || kind == ARRAY || kind == LAMBDA
+      || kind == TABLE)
+    {
+      if (s->num_todo == s->max_todo)
+	{
+	  uintptr_t *todo;
+
+	  s->max_todo = s->max_todo ? 2 * s->max_todo : 256;
+	  todo = (uintptr_t *) realloc (s->todo, s->max_todo * sizeof (uintptr_t));
+	  if (! todo)
+	    {
+	      save_error (s, "save-image: %s", "out of memory");
+	    }
+	  s->todo = todo;
+	}
+      s->todo[s->num_todo++] = ref;
+    }
+  return (ref);
+}
+
+static uintptr_t
+lookup (Saver *s, void *key)
+{
+  size_t i;
+
+  if (! s->max_keys)
+    {
+      return (0);
+    }
+  for ( i=((uintptr_t) key >> 3) % s->max_keys ; s->keys[i] ; i=(i + 1) % s->max_keys )
+    {
+      if (s->keys[i] == key)
+	{
+	  return (s->refs[i]);
+	}
+    }
+  return (0);
+}
+
+static void
+remember (Saver *s, void *key, uintptr_t ref)
+{
+  size_t i;
+
+  if (2 * (s->num_keys + 1) > s->max_keys)
+    {
+      void **keys = s->keys;
+      uintptr_t *refs = s->refs;
+      size_t j, old = s->max_keys;
+
+      s->max_keys = old ? 2 * old : 1024;
+      s->keys = (void **) calloc (s->max_keys, sizeof (void *));
+      s->refs = (uintptr_t *) calloc (s->max_keys, sizeof (uintptr_t));
+      if (! s->keys || ! s->refs)
+	{
+	  free (keys);
+	  free (refs);
+	  save_error (s, "save-image: %s", "out of memory");
+	}
+      s->num_keys = 0;
+      for ( j=0 ; j<old ; ++j )
+	{
+	  if (keys[j])
+	    {
+	      remember (s, keys[j], refs[j]);
+	    }
+	}
+      free (keys);
+      free (refs);
+    }
+  for ( i=((uintptr_t) key >> 3) % s->max_keys ; s->keys[i] ; i=(i + 1) % s->max_keys )
+    ;
+  s->keys[i] = key;
+  s->refs[i] = ref;
+  s->num_keys++;
+}
+
+static size_t
+object_size (Scheme_Value obj)
+{
+  switch (SCHEME_TYPE_INDEX (obj))
+    {
+    case SCHEME_PAIR_TYPE_INDEX:
+      return (SCHEME_OBJ_SIZE (pair_val));
+    case SCHEME_DOUBLE_TYPE_INDEX:
+      return (SCHEME_OBJ_SIZE (double_val));
+    case SCHEME_STRING_TYPE_INDEX:
+      return (SCHEME_OBJ_SIZE (ptr_val) + strlen (SCHEME_STR_VAL (obj)) + 1);
+    case SCHEME_CLOSURE_TYPE_INDEX:
+      return (SCHEME_OBJ_SIZE (closure_val));
+    case SCHEME_MACRO_TYPE_INDEX:
+      return (SCHEME_OBJ_SIZE (ptr_val));
+    case SCHEME_PROMISE_TYPE_INDEX:
+      return (SCHEME_OBJ_SIZE (ptr_val) + sizeof (Scheme_Promise));
+    case SCHEME_STRUCT_PROC_TYPE_INDEX:
+      return (SCHEME_OBJ_SIZE (ptr_val) + sizeof (Scheme_Struct_Proc));
+    default:
+      return (SCHEME_OBJ_SIZE (vector_val) + SCHEME_VEC_SIZE (obj) * sizeof (Scheme_Value));
+    }
+}
+
+static intptr_t
+code_offset (void *fun)
+{
+  return (fun ? (intptr_t) fun - (intptr_t) scheme_basic_env : 0);
+}
+
+static void *
+code_address (intptr_t offset)
+{
+  return (offset ? (void *) ((intptr_t) scheme_basic_env + offset) : NULL);
+}
+
+/* Set the address the record REC stands for once loaded. */
+static void
+resolve (char *base, Image_Record *rec, Scheme_Env *env)
+{
+  switch (INFO_KIND (rec->info))
+    {
+    case SYMBOL:
+      rec->forward = (uintptr_t) scheme_intern_symbol (BODY (rec));
+      break;
+    case TYPE:
+      rec->forward = (uintptr_t) load_type ((Image_Type *) BODY (rec));
+      break;
+    case CONST:
+      {
+	Scheme_Value consts[] =
+	{
+	  scheme_null, scheme_true, scheme_false, scheme_eof,
+	  scheme_stdin_port, scheme_stdout_port, scheme_stderr_port,
+	  (Scheme_Value) env
+	};
+
+	rec->forward = (uintptr_t) consts[*(uintptr_t *) BODY (rec)];
+	break;
+      }
+    case PRIM:
+      {
+	Image_Prim *ip = (Image_Prim *) BODY (rec);
+	Scheme_Prim_Desc *desc;
+
+	desc = scheme_make_desc (ip->name, ip->mina, ip->maxa);
+	desc->fun = (Scheme_Prim *) code_address (ip->fun);
+	desc->prim1 = (Scheme_Prim1 *) code_address (ip->prim1);
+	desc->prim2 = (Scheme_Prim2 *) code_address (ip->prim2);
+	desc->prim3 = (Scheme_Prim3 *) code_address (ip->prim3);
+	rec->forward = (uintptr_t) scheme_make_prim_desc (desc);
+	break;
+      }
+    case SYNTAX:
+      {
+	Image_Syntax *is = (Image_Syntax *) BODY (rec);
+
+	rec->forward = (uintptr_t) scheme_make_syntax ((Scheme_Syntax *) code_address (is->proc));
+	SCHEME_SYNTAX_ANALYZER ((Scheme_Value) rec->forward) =
+	  (Scheme_Analyzer *) code_address (is->analyzer);
+	break;
+      }
+    case LAMBDA:
+      rec->forward = 0;
+      break;
+    case TABLE:
+      rec->forward = (uintptr_t) scheme_make_table (((Image_Table *) BODY (rec))->kind,
+						   TABLE_ENTRIES (rec) / 2);
+      break;
+    default:
+      rec->forward = (uintptr_t) BODY (rec);
+      break;
+    }
+}
+
+/* Turn the offsets in the record REC into addresses. */
+static void
+fix (char *base, Image_Record *rec, Scheme_Env *env)
+{
+  size_t i, n;
+
+  switch (INFO_KIND (rec->info))
+    {
+    case OBJECT:
+      {
+	Scheme_Value obj = (Scheme_Value) BODY (rec);
+	Image_Record *type = (Image_Record *) (base + obj->header);
+
+	SCHEME_SET_TYPE (obj, (Scheme_Value) type->forward);
+	switch (SCHEME_TYPE_INDEX (obj))
+	  {
+	  case SCHEME_PAIR_TYPE_INDEX:
+	    fix_slot (base, &SCHEME_CAR (obj));
+	    fix_slot (base, &SCHEME_CDR (obj));
+	    break;
+	  case SCHEME_CLOSURE_TYPE_INDEX:
+	    /* the lambda once it is made */
+	    fix_slot (base, &SCHEME_CLOS_ENV (obj));
+	    break;
+	  case SCHEME_MACRO_TYPE_INDEX:
+	    fix_slot (base, &SCHEME_PTR_VAL (obj));
+	    break;
+	  case SCHEME_PROMISE_TYPE_INDEX:
+	  case SCHEME_STRUCT_PROC_TYPE_INDEX:
+	    SCHEME_PTR_VAL (obj) = SCHEME_OBJ_PAYLOAD (obj, ptr_val);
+	    if (SCHEME_TYPE_INDEX (obj) == SCHEME_PROMISE_TYPE_INDEX)
+	      {
+		fix_slot (base, &((Scheme_Promise *) SCHEME_PTR_VAL (obj))->val);
+		fix_slot (base, &((Scheme_Promise *) SCHEME_PTR_VAL (obj))->env);
+	      }
+	    else
+	      {
+		fix_slot (base, &((Scheme_Struct_Proc *) SCHEME_PTR_VAL (obj))->struct_type);
+	      }
+	    break;
+	  case SCHEME_STRING_TYPE_INDEX:
+	    SCHEME_STR_VAL (obj) = SCHEME_OBJ_PAYLOAD (obj, ptr_val);
+	    break;
+	  case SCHEME_DOUBLE_TYPE_INDEX:
+	    break;
+	  default:
+	    SCHEME_VEC_ELS (obj) = (Scheme_Value *) SCHEME_OBJ_PAYLOAD (obj, vector_val);
+	    n = SCHEME_VEC_SIZE (obj);
+	    for ( i=0 ; i<n ; ++i )
+	      {
+		fix_slot (base, &SCHEME_VEC_ELS (obj)[i]);
+	      }
+	    break;
+	  }
+	break;
+      }
+    case FRAME:
+      {
+	Scheme_Env *frame = (Scheme_Env *) BODY (rec);
+
+	fix_slot (base, &frame->symbols);
+	fix_slot (base, &frame->values);
+	fix_slot (base, &frame->next);
+	frame->globals = env->globals;
+	frame->on_stack = 0;
+	frame->frozen = 0;
+	break;
+      }
+    case ARRAY:
+      n = INFO_SIZE (rec->info) / WORD;
+      for ( i=0 ; i<n ; ++i )
+	{
+	  fix_slot (base, (Scheme_Value *) BODY (rec) + i);
+	}
+      break;
+    case LAMBDA:
+      fix_slot (base, &((Image_Lambda *) BODY (rec))->code);
+      break;
+    case TABLE:
+      n = TABLE_ENTRIES (rec);
+      for ( i=0 ; i<n ; ++i )
+	{
+	  fix_slot (base, &((Image_Table *) BODY (rec))->entries[i]);
+	}
+      break;
+    }
+}
+
+static void
+fix_slot (char *base, void *slot)
+{
+  uintptr_t ref = *(uintptr_t *) slot;
+
+  if (ref && ! SCHEME_IMMEDIATEP ((Scheme_Value) ref))
+    {
+      *(uintptr_t *) slot = ((Image_Record *) (base + ref))->forward;
+    }
+}
+
+/* a builtin type by index, another one by name, or a new one */
+static Scheme_Value
+load_type (Image_Type *it)
+{
+  Scheme_Value type;
+  int i;
+
+  if (it->index >= 0)
+    {
+      return (scheme_type_table[it->index]);
+    }
+  if (! (it->flags & SCHEME_STRUCT_TYPE_FLAG))
+    {
+      for ( i=SCHEME_NUM_BUILTIN_TYPES ; i<scheme_num_types ; ++i )
+	{
+	  if (strcmp (SCHEME_STR_VAL (scheme_type_table[i]), it->name) == 0)
+	    {
+	      return (scheme_type_table[i]);
+	    }
+	}
+    }
+  type = scheme_make_type (it->name);
+  type->header |= it->flags;
+  return (type);
+}
+
+/* The body of a lambda from an image: analyze the real body in the
+   environment the closure was made in, then run it. */
+static Scheme_Value
+lazy_body_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  Scheme_Lambda *lambda = SCHEME_NODE_LAMBDA (node);
+
+  if (lambda->body == node)
+    {
+      scheme_analyze_lambda_body (lambda, env->next);
+    }
+  return (SCHEME_EVAL_NODE (lambda->body, env));
+}
+
+/* Analyze the body of LAMBDA, whose closures are made in ENV, if it
+   came from an image and has not run yet.  Code shared by several
+   threads is analyzed this way before they can race to do it. */
+void
+scheme_image_analyze_lambda (Scheme_Lambda *lambda, Scheme_Env *env)
+{
+  if (lambda->body && lambda->body->eval == lazy_body_eval)
+    {
+      scheme_analyze_lambda_body (lambda, env);
+    }
+}
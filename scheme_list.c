@@ -24,19 +24,22 @@
 
 #include "scheme.h"
 
+/* the empty list is a static object */
+static Scheme_Object null_object = { SCHEME_STATIC_HEADER (SCHEME_NULL_TYPE_INDEX), { 0 } };
+
 /* globals */
-Scheme_Value scheme_null;
+Scheme_Value scheme_null = &null_object;
 Scheme_Value scheme_null_type;
 Scheme_Value scheme_pair_type;
 
 /* primitive declarations */
-static Scheme_Value pair_p_prim (int argc, Scheme_Value argv[]);
-static Scheme_Value cons_prim (int argc, Scheme_Value argv[]);
-static Scheme_Value car_prim (int argc, Scheme_Value argv[]);
-static Scheme_Value cdr_prim (int argc, Scheme_Value argv[]);
-static Scheme_Value set_car_prim (int argc, Scheme_Value argv[]);
-static Scheme_Value set_cdr_prim (int argc, Scheme_Value argv[]);
-static Scheme_Value null_p_prim (int argc, Scheme_Value argv[]);
+static Scheme_Value pair_p_prim (Scheme_Value obj);
+static Scheme_Value cons_prim (Scheme_Value car, Scheme_Value cdr);
+static Scheme_Value car_prim (Scheme_Value pair);
+static Scheme_Value cdr_prim (Scheme_Value pair);
+static Scheme_Value set_car_prim (Scheme_Value pair, Scheme_Value val);
+static Scheme_Value set_cdr_prim (Scheme_Value pair, Scheme_Value val);
+static Scheme_Value null_p_prim (Scheme_Value obj);
 static Scheme_Value list_p_prim (int argc, Scheme_Value argv[]);
 static Scheme_Value list_prim (int argc, Scheme_Value argv[]);
 static Scheme_Value length_prim (int argc, Scheme_Value argv[]);
@@ -50,64 +53,68 @@ static Scheme_Value member (int argc, Scheme_Value argv[]);
 static Scheme_Value assv (int argc, Scheme_Value argv[]);
 static Scheme_Value assq (int argc, Scheme_Value argv[]);
 static Scheme_Value assoc (int argc, Scheme_Value argv[]);
-static Scheme_Value caar_prim (int argc, Scheme_Value argv[]);
-static Scheme_Value cadr_prim (int argc, Scheme_Value argv[]);
-static Scheme_Value cdar_prim (int argc, Scheme_Value argv[]);
-static Scheme_Value cddr_prim (int argc, Scheme_Value argv[]);
-static Scheme_Value caaar_prim (int argc, Scheme_Value argv[]);
-static Scheme_Value caadr_prim (int argc, Scheme_Value argv[]);
-static Scheme_Value cadar_prim (int argc, Scheme_Value argv[]);
-static Scheme_Value cdaar_prim (int argc, Scheme_Value argv[]);
-static Scheme_Value cdadr_prim (int argc, Scheme_Value argv[]);
-static Scheme_Value cddar_prim (int argc, Scheme_Value argv[]);
-static Scheme_Value caddr_prim (int argc, Scheme_Value argv[]);
-static Scheme_Value cdddr_prim (int argc, Scheme_Value argv[]);
+static Scheme_Value caar_prim (Scheme_Value pair);
+static Scheme_Value cadr_prim (Scheme_Value pair);
+static Scheme_Value cdar_prim (Scheme_Value pair);
+static Scheme_Value cddr_prim (Scheme_Value pair);
+static Scheme_Value caaar_prim (Scheme_Value pair);
+static Scheme_Value caadr_prim (Scheme_Value pair);
+static Scheme_Value cadar_prim (Scheme_Value pair);
+static Scheme_Value cdaar_prim (Scheme_Value pair);
+static Scheme_Value cdadr_prim (Scheme_Value pair);
+static Scheme_Value cddar_prim (Scheme_Value pair);
+static Scheme_Value caddr_prim (Scheme_Value pair);
+static Scheme_Value cdddr_prim (Scheme_Value pair);
 
 /* internal declarations */
 static Scheme_Value append (Scheme_Value lst1, Scheme_Value lst2);
 
+static const Scheme_Prim_Entry list_prims[] =
+{
+  SCHEME_PRIM1_ENTRY ("pair?", pair_p_prim),
+  SCHEME_PRIM2_ENTRY ("cons", cons_prim),
+  SCHEME_PRIM1_ENTRY ("car", car_prim),
+  SCHEME_PRIM1_ENTRY ("cdr", cdr_prim),
+  SCHEME_PRIM2_ENTRY ("set-car!", set_car_prim),
+  SCHEME_PRIM2_ENTRY ("set-cdr!", set_cdr_prim),
+  SCHEME_PRIM1_ENTRY ("null?", null_p_prim),
+  SCHEME_PRIM_ENTRY ("list?", list_p_prim, 0, -1),
+  SCHEME_PRIM_ENTRY ("list", list_prim, 0, -1),
+  SCHEME_PRIM_ENTRY ("length", length_prim, 0, -1),
+  SCHEME_PRIM_ENTRY ("append", append_prim, 0, -1),
+  SCHEME_PRIM_ENTRY ("reverse", reverse_prim, 0, -1),
+  SCHEME_PRIM_ENTRY ("list-tail", list_tail_prim, 0, -1),
+  SCHEME_PRIM_ENTRY ("list-ref", list_ref_prim, 0, -1),
+  SCHEME_PRIM_ENTRY ("memq", memq, 0, -1),
+  SCHEME_PRIM_ENTRY ("memv", memv, 0, -1),
+  SCHEME_PRIM_ENTRY ("member", member, 0, -1),
+  SCHEME_PRIM_ENTRY ("assq", assq, 0, -1),
+  SCHEME_PRIM_ENTRY ("assv", assv, 0, -1),
+  SCHEME_PRIM_ENTRY ("assoc", assoc, 0, -1),
+  SCHEME_PRIM1_ENTRY ("caar", caar_prim),
+  SCHEME_PRIM1_ENTRY ("cadr", cadr_prim),
+  SCHEME_PRIM1_ENTRY ("cdar", cdar_prim),
+  SCHEME_PRIM1_ENTRY ("cddr", cddr_prim),
+  SCHEME_PRIM1_ENTRY ("caaar", caaar_prim),
+  SCHEME_PRIM1_ENTRY ("caadr", caadr_prim),
+  SCHEME_PRIM1_ENTRY ("cadar", cadar_prim),
+  SCHEME_PRIM1_ENTRY ("cdaar", cdaar_prim),
+  SCHEME_PRIM1_ENTRY ("cdadr", cdadr_prim),
+  SCHEME_PRIM1_ENTRY ("cddar", cddar_prim),
+  SCHEME_PRIM1_ENTRY ("caddr", caddr_prim),
+  SCHEME_PRIM1_ENTRY ("cdddr", cdddr_prim)
+};
+
 /* exported functions */
 
 void
 scheme_init_list (Scheme_Env *env)
 {
-  scheme_null_type = scheme_make_type ("<empty-list>");
+  scheme_null_type = scheme_make_builtin_type ("<empty-list>", SCHEME_NULL_TYPE_INDEX);
   scheme_add_global ("<empty-list>", scheme_null_type, env);
-  scheme_null = scheme_alloc_object (scheme_null_type, 0);
-  scheme_pair_type = scheme_make_type ("<pair>");
+  scheme_pair_type = scheme_make_builtin_type ("<pair>", SCHEME_PAIR_TYPE_INDEX);
   scheme_add_global ("<pair>", scheme_pair_type, env);
-  scheme_add_prim ("pair?", pair_p_prim, env);
-  scheme_add_prim ("cons", cons_prim, env);
-  scheme_add_prim ("car", car_prim, env);
-  scheme_add_prim ("cdr", cdr_prim, env);
-  scheme_add_prim ("set-car!", set_car_prim, env);
-  scheme_add_prim ("set-cdr!", set_cdr_prim, env);
-  scheme_add_prim ("null?", null_p_prim, env);
-  scheme_add_prim ("list?", list_p_prim, env);
-  scheme_add_prim ("list", list_prim, env);
-  scheme_add_prim ("length", length_prim, env);
-  scheme_add_prim ("append", append_prim, env);
-  scheme_add_prim ("reverse", reverse_prim, env);
-  scheme_add_prim ("list-tail", list_tail_prim, env);
-  scheme_add_prim ("list-ref", list_ref_prim, env);
-  scheme_add_prim ("memq", memq, env);
-  scheme_add_prim ("memv", memv, env);
-  scheme_add_prim ("member", member, env);
-  scheme_add_prim ("assq", assq, env);
-  scheme_add_prim ("assv", assv, env);
-  scheme_add_prim ("assoc", assoc, env);
-  scheme_add_prim ("caar", caar_prim, env);
-  scheme_add_prim ("cadr", cadr_prim, env);
-  scheme_add_prim ("cdar", cdar_prim, env);
-  scheme_add_prim ("cddr", cddr_prim, env);
-  scheme_add_prim ("caaar", caaar_prim, env);
-  scheme_add_prim ("caadr", caadr_prim, env);
-  scheme_add_prim ("cadar", cadar_prim, env);
-  scheme_add_prim ("cdaar", cdaar_prim, env);
-  scheme_add_prim ("cdadr", cdadr_prim, env);
-  scheme_add_prim ("cddar", cddar_prim, env);
-  scheme_add_prim ("caddr", caddr_prim, env);
-  scheme_add_prim ("cdddr", cdddr_prim, env);
+  scheme_add_prims (list_prims, SCHEME_NUM_ENTRIES (list_prims), env);
 }
 
 Scheme_Value
@@ -115,7 +122,7 @@ scheme_make_pair (Scheme_Value car, Scheme_Value cdr)
 {
   Scheme_Value cons;
 
-  cons = scheme_alloc_object (scheme_pair_type, 0);
+  cons = scheme_alloc_sized (scheme_pair_type, SCHEME_OBJ_SIZE (pair_val));
   SCHEME_CAR(cons) = car;
   SCHEME_CDR(cons) = cdr;
   return (cons);
@@ -211,61 +218,58 @@ scheme_caddr (Scheme_Value pair)
 /* primitive functions */
 
 static Scheme_Value
-pair_p_prim (int argc, Scheme_Value argv[])
+pair_p_prim (Scheme_Value obj)
 {
-  SCHEME_ASSERT ((argc == 1), "pair?: wrong number of args");
-  return ((SCHEME_TYPE (argv[0]) == scheme_pair_type) ? scheme_true : scheme_false);
+  return ((SCHEME_TYPE (obj) == scheme_pair_type) ? scheme_true : scheme_false);
 }
 
 static Scheme_Value
-cons_prim (int argc, Scheme_Value argv[])
+cons_prim (Scheme_Value car, Scheme_Value cdr)
 {
   Scheme_Value cons;
 
-  SCHEME_ASSERT ((argc == 2), "cons: wrong number of args");
-  cons = scheme_make_pair (argv[0], argv[1]);
+  cons = scheme_make_pair (car, cdr);
   return (cons);
 }
 
 static Scheme_Value
-car_prim (int argc, Scheme_Value argv[])
+car_prim (Scheme_Value pair)
 {
-  SCHEME_ASSERT ((argc == 1), "car: wrong number of args");
-  SCHEME_ASSERT (SCHEME_TYPE(argv[0])==scheme_pair_type, "car: arg must be pair");
-  return (SCHEME_CAR (argv[0]));
+  SCHEME_ASSERT (SCHEME_TYPE(pair)==scheme_pair_type, "car: arg must be pair");
+  return (SCHEME_CAR (pair));
 }
 
 static Scheme_Value
-cdr_prim (int argc, Scheme_Value argv[])
+cdr_prim (Scheme_Value pair)
 {
-  SCHEME_ASSERT ((argc == 1), "cdr: wrong number of args");
-  SCHEME_ASSERT (SCHEME_TYPE(argv[0])==scheme_pair_type, "cdr: arg must be pair");
-  return (SCHEME_CDR (argv[0]));
+  SCHEME_ASSERT (SCHEME_TYPE(pair)==scheme_pair_type, "cdr: arg must be pair");
+  return (SCHEME_CDR (pair));
 }
 
 static Scheme_Value
-set_car_prim (int argc, Scheme_Value argv[])
+set_car_prim (Scheme_Value pair, Scheme_Value val)
 {
-  SCHEME_ASSERT ((argc == 2), "set-car!: wrong number of args");
-  SCHEME_ASSERT (SCHEME_TYPE(argv[0])==scheme_pair_type, "set-car!: first arg must be pair");
-  SCHEME_CAR (argv[0]) = argv[1];
-  return (argv[1]);
+  SCHEME_ASSERT (SCHEME_TYPE(pair)==scheme_pair_type, "set-car!: first arg must be pair");
+  SCHEME_ASSERT (! SCHEME_FROZENP (pair), "set-car!: pair is frozen");
+  SCHEME_CAR (pair) = val;
+  SCHEME_GC_WRITE (&SCHEME_CAR (pair));
+  return (val);
 }
 
 static Scheme_Value
-set_cdr_prim (int argc, Scheme_Value argv[])
+set_cdr_prim (Scheme_Value pair, Scheme_Value val)
 {
-  SCHEME_ASSERT ((argc == 2), "set-cdr!: wrong number of args");
-  SCHEME_ASSERT (SCHEME_TYPE(argv[0])==scheme_pair_type, "set-cdr!: first arg must be pair");
-  SCHEME_CDR (argv[0]) = argv[1];
-  return (argv[1]);
+  SCHEME_ASSERT (SCHEME_TYPE(pair)==scheme_pair_type, "set-cdr!: first arg must be pair");
+  SCHEME_ASSERT (! SCHEME_FROZENP (pair), "set-cdr!: pair is frozen");
+  SCHEME_CDR (pair) = val;
+  SCHEME_GC_WRITE (&SCHEME_CDR (pair));
+  return (val);
 }
 
 static Scheme_Value
-null_p_prim (int argc, Scheme_Value argv[])
+null_p_prim (Scheme_Value obj)
 {
-  SCHEME_ASSERT ((argc == 1), "null?: wrong number of args");
-  return ((argv[0] == scheme_null) ? scheme_true : scheme_false);
+  return ((obj == scheme_null) ? scheme_true : scheme_false);
 }
 
 static Scheme_Value
@@ -449,99 +453,87 @@ GEN_ASS(assq, assq, scheme_eq)
 GEN_ASS(assoc, assoc, scheme_equal)
 
 static Scheme_Value
-caar_prim (int argc, Scheme_Value argv[])
+caar_prim (Scheme_Value pair)
 {
-  SCHEME_ASSERT((argc == 1), "caar: wrong number of args");
-  SCHEME_ASSERT(SCHEME_PAIRP(argv[0]), "caar: arg must be a pair");
-  return (SCHEME_CAR (SCHEME_CAR (argv[0])));
+  SCHEME_ASSERT(SCHEME_PAIRP(pair), "caar: arg must be a pair");
+  return (SCHEME_CAR (SCHEME_CAR (pair)));
 }
 
 static Scheme_Value
-cadr_prim (int argc, Scheme_Value argv[])
+cadr_prim (Scheme_Value pair)
 {
-  SCHEME_ASSERT((argc == 1), "cadr: wrong number of args");
-  SCHEME_ASSERT(SCHEME_PAIRP(argv[0]), "cadr: arg must be a pair");
-  return (SCHEME_CAR (SCHEME_CDR (argv[0])));
+  SCHEME_ASSERT(SCHEME_PAIRP(pair), "cadr: arg must be a pair");
+  return (SCHEME_CAR (SCHEME_CDR (pair)));
 }
 
 static Scheme_Value
-cdar_prim (int argc, Scheme_Value argv[])
+cdar_prim (Scheme_Value pair)
 {
-  SCHEME_ASSERT((argc == 1), "cdar: wrong number of args");
-  SCHEME_ASSERT(SCHEME_PAIRP(argv[0]), "cdar: arg must be a pair");
-  return (SCHEME_CDR (SCHEME_CAR (argv[0])));
+  SCHEME_ASSERT(SCHEME_PAIRP(pair), "cdar: arg must be a pair");
+  return (SCHEME_CDR (SCHEME_CAR (pair)));
 }
 
 static Scheme_Value
-cddr_prim (int argc, Scheme_Value argv[])
+cddr_prim (Scheme_Value pair)
 {
-  SCHEME_ASSERT((argc == 1), "cddr: wrong number of args");
-  SCHEME_ASSERT(SCHEME_PAIRP(argv[0]), "cddr: arg must be a pair");
-  return (SCHEME_CDR (SCHEME_CDR (argv[0])));
+  SCHEME_ASSERT(SCHEME_PAIRP(pair), "cddr: arg must be a pair");
+  return (SCHEME_CDR (SCHEME_CDR (pair)));
 }
 
 static Scheme_Value
-caaar_prim (int argc, Scheme_Value argv[])
+caaar_prim (Scheme_Value pair)
 {
-  SCHEME_ASSERT((argc == 1), "caaar: wrong number of args");
-  SCHEME_ASSERT(SCHEME_PAIRP(argv[0]), "caaar: arg must be a pair");
-  return (SCHEME_CAR (SCHEME_CAR (SCHEME_CAR (argv[0]))));
+  SCHEME_ASSERT(SCHEME_PAIRP(pair), "caaar: arg must be a pair");
+  return (SCHEME_CAR (SCHEME_CAR (SCHEME_CAR (pair))));
 }
 
 static Scheme_Value
-caadr_prim (int argc, Scheme_Value argv[])
+caadr_prim (Scheme_Value pair)
 {
-  SCHEME_ASSERT((argc == 1), "caadr: wrong number of args");
-  SCHEME_ASSERT(SCHEME_PAIRP(argv[0]), "caadr: arg must be a pair");
-  return (SCHEME_CAR (SCHEME_CAR (SCHEME_CDR (argv[0]))));
+  SCHEME_ASSERT(SCHEME_PAIRP(pair), "caadr: arg must be a pair");
+  return (SCHEME_CAR (SCHEME_CAR (SCHEME_CDR (pair))));
 }
 
 static Scheme_Value
-cadar_prim (int argc, Scheme_Value argv[])
+cadar_prim (Scheme_Value pair)
 {
-  SCHEME_ASSERT((argc == 1), "cadar: wrong number of args");
-  SCHEME_ASSERT(SCHEME_PAIRP(argv[0]), "cadar: arg must be a pair");
-  return (SCHEME_CAR (SCHEME_CDR (SCHEME_CAR (argv[0]))));
+  SCHEME_ASSERT(SCHEME_PAIRP(pair), "cadar: arg must be a pair");
+  return (SCHEME_CAR (SCHEME_CDR (SCHEME_CAR (pair))));
 }
 
 static Scheme_Value
-cdaar_prim (int argc, Scheme_Value argv[])
+cdaar_prim (Scheme_Value pair)
 {
-  SCHEME_ASSERT((argc == 1), "cdaar: wrong number of args");
-  SCHEME_ASSERT(SCHEME_PAIRP(argv[0]), "cdaar: arg must be a pair");
-  return (SCHEME_CDR (SCHEME_CAR (SCHEME_CAR (argv[0]))));
+  SCHEME_ASSERT(SCHEME_PAIRP(pair), "cdaar: arg must be a pair");
+  return (SCHEME_CDR (SCHEME_CAR (SCHEME_CAR (pair))));
 }
 
 static Scheme_Value
-cdadr_prim (int argc, Scheme_Value argv[])
+cdadr_prim (Scheme_Value pair)
 {
-  SCHEME_ASSERT((argc == 1), "cdadr: wrong number of args");
-  SCHEME_ASSERT(SCHEME_PAIRP(argv[0]), "cdadr: arg must be a pair");
-  return (SCHEME_CDR (SCHEME_CAR (SCHEME_CDR (argv[0]))));
+  SCHEME_ASSERT(SCHEME_PAIRP(pair), "cdadr: arg must be a pair");
+  return (SCHEME_CDR (SCHEME_CAR (SCHEME_CDR (pair))));
 }
 
 static Scheme_Value
-cddar_prim (int argc, Scheme_Value argv[])
+cddar_prim (Scheme_Value pair)
 {
-  SCHEME_ASSERT((argc == 1), "cddar: wrong number of args");
-  SCHEME_ASSERT(SCHEME_PAIRP(argv[0]), "cddar: arg must be a pair");
-  return (SCHEME_CDR (SCHEME_CDR (SCHEME_CDR (argv[0]))));
+  SCHEME_ASSERT(SCHEME_PAIRP(pair), "cddar: arg must be a pair");
+  return (SCHEME_CDR (SCHEME_CDR (SCHEME_CDR (pair))));
 }
 
 static Scheme_Value
-caddr_prim (int argc, Scheme_Value argv[])
+caddr_prim (Scheme_Value pair)
 {
-  SCHEME_ASSERT((argc == 1), "caddr: wrong number of args");
-  SCHEME_ASSERT(SCHEME_PAIRP(argv[0]), "caddr: arg must be a pair");
-  return (SCHEME_CAR (SCHEME_CDR (SCHEME_CDR (argv[0]))));
+  SCHEME_ASSERT(SCHEME_PAIRP(pair), "caddr: arg must be a pair");
+  return (SCHEME_CAR (SCHEME_CDR (SCHEME_CDR (pair))));
 }
 
 static Scheme_Value
-cdddr_prim (int argc, Scheme_Value argv[])
+cdddr_prim (Scheme_Value pair)
 {
-  SCHEME_ASSERT((argc == 1), "cdddr: wrong number of args");
-  SCHEME_ASSERT(SCHEME_PAIRP(argv[0]), "cdddr: arg must be a pair");
-  return (SCHEME_CDR (SCHEME_CDR (SCHEME_CDR (argv[0]))));
+  SCHEME_ASSERT(SCHEME_PAIRP(pair), "cdddr: arg must be a pair");
+  return (SCHEME_CDR (SCHEME_CDR (SCHEME_CDR (pair))));
 }
 
 /* internal functions */
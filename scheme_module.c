@@ -0,0 +1,138 @@
+/*
+  libscheme
+  Copyright (c) 1994 Brent Benson
+  All rights reserved.
+
+  Permission is hereby granted, without written agreement and without
+  license or royalty fees, to use, copy, modify, and distribute this
+  software and its documentation for any purpose, provided that the
+  above copyright notice and the following two paragraphs appear in
+  all copies of this software.
+
+  IN NO EVENT SHALL BRENT BENSON BE LIABLE TO ANY PARTY FOR DIRECT,
+  INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES ARISING OUT
+  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF BRENT
+  BENSON HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+  BRENT BENSON SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT
+  NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER
+  IS ON AN "AS IS" BASIS, AND BRENT BENSON HAS NO OBLIGATION TO
+  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR
+  MODIFICATIONS.
+*/
+
+/* Environments as Scheme values, for modules: each made by
+   make-environment has its own globals, so code loaded or evaluated
+   in it cannot clash with code elsewhere.  It sees the globals of its
+   base until code in it defines or assigns them, see
+   scheme_make_module_env.  environment-import! shares a global of one
+   environment with another. */
+
+#include "scheme_private.h"
+
+/* globals */
+Scheme_Value scheme_environment_type;
+
+/* locals */
+static Scheme_Value make_environment (int argc, Scheme_Value argv[]);
+static Scheme_Value interaction_environment (int argc, Scheme_Value argv[]);
+static Scheme_Value clone_environment (int argc, Scheme_Value argv[]);
+static Scheme_Value environment_p (Scheme_Value obj);
+static Scheme_Value environment_import (int argc, Scheme_Value argv[]);
+
+static const Scheme_Prim_Entry module_prims[] =
+{
+  SCHEME_PRIM_ENTRY ("make-environment", make_environment, 0, 1),
+  SCHEME_PRIM_ENTRY ("interaction-environment", interaction_environment, 0, 0),
+  SCHEME_PRIM_ENTRY ("clone-environment", clone_environment, 0, 1),
+  SCHEME_PRIM1_ENTRY ("environment?", environment_p),
+  SCHEME_PRIM_ENTRY ("environment-import!", environment_import, 2, -1)
+};
+
+void
+scheme_init_module (Scheme_Env *env)
+{
+  scheme_environment_type = scheme_make_builtin_type ("<environment>", SCHEME_ENVIRONMENT_TYPE_INDEX);
+  scheme_add_global ("<environment>", scheme_environment_type, env);
+  scheme_add_prims (module_prims, SCHEME_NUM_ENTRIES (module_prims), env);
+}
+
+Scheme_Value
+scheme_make_environment (Scheme_Env *env)
+{
+  Scheme_Value obj;
+
+  obj = scheme_alloc_sized (scheme_environment_type, SCHEME_OBJ_SIZE (ptr_val));
+  SCHEME_PTR_VAL (obj) = env;
+  return (obj);
+}
+
+/* locals */
+
+/* (make-environment [base]) makes a module environment on BASE, by
+   default the interaction environment */
+static Scheme_Value
+make_environment (int argc, Scheme_Value argv[])
+{
+  Scheme_Env *base;
+
+  base = scheme_env;
+  if (argc == 1)
+    {
+      SCHEME_ASSERT (SCHEME_ENVIRONMENTP (argv[0]), "make-environment: arg must be an environment");
+      base = SCHEME_ENV_VAL (argv[0]);
+    }
+  return (scheme_make_environment (scheme_make_module_env (base)));
+}
+
+static Scheme_Value
+interaction_environment (int argc, Scheme_Value argv[])
+{
+  Scheme_Env *env;
+
+  for ( env=scheme_env ; env->next ; env=env->next )
+    ;
+  return (scheme_make_environment (env));
+}
+
+/* (clone-environment [env]) copies ENV, by default the interaction
+   environment, for code whose definitions and assignments must not
+   outlive it.  Procedures defined in ENV still work on ENV's globals,
+   which all its clones share. */
+static Scheme_Value
+clone_environment (int argc, Scheme_Value argv[])
+{
+  Scheme_Env *env;
+
+  env = scheme_env;
+  if (argc == 1)
+    {
+      SCHEME_ASSERT (SCHEME_ENVIRONMENTP (argv[0]), "clone-environment: arg must be an environment");
+      env = SCHEME_ENV_VAL (argv[0]);
+    }
+  return (scheme_make_environment (scheme_clone_env (env)));
+}
+
+static Scheme_Value
+environment_p (Scheme_Value obj)
+{
+  return (SCHEME_ENVIRONMENTP (obj) ? scheme_true : scheme_false);
+}
+
+/* (environment-import! to from name ...) binds each NAME in TO to the
+   global of that name in FROM */
+static Scheme_Value
+environment_import (int argc, Scheme_Value argv[])
+{
+  int i;
+
+  SCHEME_ASSERT (SCHEME_ENVIRONMENTP (argv[0]), "environment-import!: first arg must be an environment");
+  SCHEME_ASSERT (SCHEME_ENVIRONMENTP (argv[1]), "environment-import!: second arg must be an environment");
+  for ( i=2 ; i<argc ; ++i )
+    {
+      SCHEME_ASSERT (SCHEME_SYMBOLP (argv[i]), "environment-import!: names must be symbols");
+      scheme_import_global (argv[i], SCHEME_ENV_VAL (argv[1]), SCHEME_ENV_VAL (argv[0]));
+    }
+  return (scheme_true);
+}
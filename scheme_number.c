@@ -27,36 +27,28 @@
 #include <math.h>
 #include <string.h>
 
-/* hold up to 4k objects in the cache */
-#define INTEGER_CACHE_SIZE  2048
-/* split off 1k for negative integers  */
-#define INTEGER_CACHE_SPLIT 1024
-
 /* globals */
 Scheme_Value scheme_integer_type;
 Scheme_Value scheme_double_type;
 
-/* internal variables */
-static Scheme_Value integer_cache[INTEGER_CACHE_SIZE];
-
 /* locals */
-static Scheme_Value number_p (int argc, Scheme_Value argv[]);
-static Scheme_Value complex_p (int argc, Scheme_Value argv[]);
-static Scheme_Value real_p (int argc, Scheme_Value argv[]);
-static Scheme_Value rational_p (int argc, Scheme_Value argv[]);
-static Scheme_Value integer_p (int argc, Scheme_Value argv[]);
-static Scheme_Value exact_p (int argc, Scheme_Value argv[]);
-static Scheme_Value inexact_p (int argc, Scheme_Value argv[]);
+static Scheme_Value number_p (Scheme_Value obj);
+static Scheme_Value complex_p (Scheme_Value obj);
+static Scheme_Value real_p (Scheme_Value obj);
+static Scheme_Value rational_p (Scheme_Value obj);
+static Scheme_Value integer_p (Scheme_Value obj);
+static Scheme_Value exact_p (Scheme_Value obj);
+static Scheme_Value inexact_p (Scheme_Value obj);
 static Scheme_Value eq (int argc, Scheme_Value argv[]);
 static Scheme_Value lt (int argc, Scheme_Value argv[]);
 static Scheme_Value gt (int argc, Scheme_Value argv[]);
 static Scheme_Value lt_eq (int argc, Scheme_Value argv[]);
 static Scheme_Value gt_eq (int argc, Scheme_Value argv[]);
-static Scheme_Value zero_p (int argc, Scheme_Value argv[]);
-static Scheme_Value positive_p (int argc, Scheme_Value argv[]);
-static Scheme_Value negative_p (int argc, Scheme_Value argv[]);
-static Scheme_Value odd_p (int argc, Scheme_Value argv[]);
-static Scheme_Value even_p (int argc, Scheme_Value argv[]);
+static Scheme_Value zero_p (Scheme_Value num);
+static Scheme_Value positive_p (Scheme_Value num);
+static Scheme_Value negative_p (Scheme_Value num);
+static Scheme_Value odd_p (Scheme_Value num);
+static Scheme_Value even_p (Scheme_Value num);
 static Scheme_Value max (int argc, Scheme_Value argv[]);
 static Scheme_Value min (int argc, Scheme_Value argv[]);
 static Scheme_Value plus (int argc, Scheme_Value argv[]);
@@ -64,9 +56,9 @@ static Scheme_Value minus (int argc, Scheme_Value argv[]);
 static Scheme_Value mult (int argc, Scheme_Value argv[]);
 static Scheme_Value div_prim (int argc, Scheme_Value argv[]);
 static Scheme_Value abs_prim (int argc, Scheme_Value argv[]);
-static Scheme_Value quotient (int argc, Scheme_Value argv[]);
-static Scheme_Value rem_prim (int argc, Scheme_Value argv[]);
-static Scheme_Value modulo (int argc, Scheme_Value argv[]);
+static Scheme_Value quotient (Scheme_Value n1, Scheme_Value n2);
+static Scheme_Value rem_prim (Scheme_Value n1, Scheme_Value n2);
+static Scheme_Value modulo (Scheme_Value n1, Scheme_Value n2);
 static Scheme_Value gcd (int argc, Scheme_Value argv[]);
 static Scheme_Value lcm (int argc, Scheme_Value argv[]);
 static Scheme_Value floor_prim (int argc, Scheme_Value argv[]);
@@ -86,89 +78,82 @@ static Scheme_Value exact_to_inexact (int argc, Scheme_Value argv[]);
 static Scheme_Value inexact_to_exact (int argc, Scheme_Value argv[]);
 static Scheme_Value number_to_string (int argc, Scheme_Value argv[]);
 static Scheme_Value string_to_number (int argc, Scheme_Value argv[]);
+static Scheme_Value eq2 (Scheme_Value n1, Scheme_Value n2);
+static Scheme_Value lt2 (Scheme_Value n1, Scheme_Value n2);
+static Scheme_Value gt2 (Scheme_Value n1, Scheme_Value n2);
+static Scheme_Value lt_eq2 (Scheme_Value n1, Scheme_Value n2);
+static Scheme_Value gt_eq2 (Scheme_Value n1, Scheme_Value n2);
+static Scheme_Value bin_plus (Scheme_Value n1, Scheme_Value n2);
+static Scheme_Value bin_minus (Scheme_Value n1, Scheme_Value n2);
+static Scheme_Value bin_mult (Scheme_Value n1, Scheme_Value n2);
+static Scheme_Value bin_div (Scheme_Value n1, Scheme_Value n2);
+
+static const Scheme_Prim_Entry number_prims[] =
+{
+  SCHEME_PRIM1_ENTRY ("number?", number_p),
+  SCHEME_PRIM1_ENTRY ("complex?", complex_p),
+  SCHEME_PRIM1_ENTRY ("real?", real_p),
+  SCHEME_PRIM1_ENTRY ("rational?", rational_p),
+  SCHEME_PRIM1_ENTRY ("integer?", integer_p),
+  SCHEME_PRIM1_ENTRY ("exact?", exact_p),
+  SCHEME_PRIM1_ENTRY ("inexact?", inexact_p),
+  SCHEME_PRIMN2_ENTRY ("=", eq, 2, eq2),
+  SCHEME_PRIMN2_ENTRY ("<", lt, 2, lt2),
+  SCHEME_PRIMN2_ENTRY (">", gt, 2, gt2),
+  SCHEME_PRIMN2_ENTRY ("<=", lt_eq, 2, lt_eq2),
+  SCHEME_PRIMN2_ENTRY (">=", gt_eq, 2, gt_eq2),
+  SCHEME_PRIM1_ENTRY ("zero?", zero_p),
+  SCHEME_PRIM1_ENTRY ("positive?", positive_p),
+  SCHEME_PRIM1_ENTRY ("negative?", negative_p),
+  SCHEME_PRIM1_ENTRY ("odd?", odd_p),
+  SCHEME_PRIM1_ENTRY ("even?", even_p),
+  SCHEME_PRIM_ENTRY ("max", max, 2, -1),
+  SCHEME_PRIM_ENTRY ("min", min, 2, -1),
+  SCHEME_PRIMN2_ENTRY ("+", plus, 0, bin_plus),
+  SCHEME_PRIMN2_ENTRY ("-", minus, 1, bin_minus),
+  SCHEME_PRIMN2_ENTRY ("*", mult, 0, bin_mult),
+  SCHEME_PRIMN2_ENTRY ("/", div_prim, 1, bin_div),
+  SCHEME_PRIM_ENTRY ("abs", abs_prim, 0, -1),
+  SCHEME_PRIM2_ENTRY ("quotient", quotient),
+  SCHEME_PRIM2_ENTRY ("remainder", rem_prim),
+  SCHEME_PRIM2_ENTRY ("modulo", modulo),
+  SCHEME_PRIM_ENTRY ("gcd", gcd, 0, -1),
+  SCHEME_PRIM_ENTRY ("lcm", lcm, 0, -1),
+  SCHEME_PRIM_ENTRY ("floor", floor_prim, 0, -1),
+  SCHEME_PRIM_ENTRY ("ceiling", ceiling, 0, -1),
+  SCHEME_PRIM_ENTRY ("truncate", truncate, 0, -1),
+  SCHEME_PRIM_ENTRY ("round", scheme_round, 0, -1),
+  SCHEME_PRIM_ENTRY ("exp", exp_prim, 0, -1),
+  SCHEME_PRIM_ENTRY ("log", log_prim, 0, -1),
+  SCHEME_PRIM_ENTRY ("sin", sin_prim, 0, -1),
+  SCHEME_PRIM_ENTRY ("cos", cos_prim, 0, -1),
+  SCHEME_PRIM_ENTRY ("asin", asin_prim, 0, -1),
+  SCHEME_PRIM_ENTRY ("acos", acos_prim, 0, -1),
+  SCHEME_PRIM_ENTRY ("atan", atan_prim, 0, -1),
+  SCHEME_PRIM_ENTRY ("sqrt", sqrt_prim, 0, -1),
+  SCHEME_PRIM_ENTRY ("expt", expt, 0, -1),
+  SCHEME_PRIM_ENTRY ("exact->inexact", exact_to_inexact, 0, -1),
+  SCHEME_PRIM_ENTRY ("inexact->exact", inexact_to_exact, 0, -1),
+  SCHEME_PRIM_ENTRY ("number->string", number_to_string, 0, -1),
+  SCHEME_PRIM_ENTRY ("string->number", string_to_number, 0, -1)
+};
 
 /* exported functions */
 
 void
 scheme_init_number (Scheme_Env *env)
 {
-  scheme_integer_type = scheme_make_type ("<integer>");
-  scheme_double_type = scheme_make_type ("<double>");
+  scheme_integer_type = scheme_make_builtin_type ("<integer>", SCHEME_INTEGER_TYPE_INDEX);
+  scheme_double_type = scheme_make_builtin_type ("<double>", SCHEME_DOUBLE_TYPE_INDEX);
   scheme_add_global ("<integer>", scheme_integer_type, env);
   scheme_add_global ("<double>", scheme_double_type, env);
-  scheme_add_prim ("number?", number_p, env);
-  scheme_add_prim ("complex?", complex_p, env);
-  scheme_add_prim ("real?", real_p, env);
-  scheme_add_prim ("rational?", rational_p, env);
-  scheme_add_prim ("integer?", integer_p, env);
-  scheme_add_prim ("exact?", exact_p, env);
-  scheme_add_prim ("inexact?", inexact_p, env);
-  scheme_add_prim ("=", eq, env);
-  scheme_add_prim ("<", lt, env);
-  scheme_add_prim (">", gt, env);
-  scheme_add_prim ("<=", lt_eq, env);
-  scheme_add_prim (">=", gt_eq, env);
-  scheme_add_prim ("zero?", zero_p, env);
-  scheme_add_prim ("positive?", positive_p, env);
-  scheme_add_prim ("negative?", negative_p, env);
-  scheme_add_prim ("odd?", odd_p, env);
-  scheme_add_prim ("even?", even_p, env);
-  scheme_add_prim ("max", max, env);
-  scheme_add_prim ("min", min, env);
-  scheme_add_prim ("+", plus, env);
-  scheme_add_prim ("-", minus, env);
-  scheme_add_prim ("*", mult, env);
-  scheme_add_prim ("/", div_prim, env);
-  scheme_add_prim ("abs", abs_prim, env);
-  scheme_add_prim ("quotient", quotient, env);
-  scheme_add_prim ("remainder", rem_prim, env);
-  scheme_add_prim ("modulo", modulo, env);
-  scheme_add_prim ("gcd", gcd, env);
-  scheme_add_prim ("lcm", lcm, env);
-  scheme_add_prim ("floor", floor_prim, env);
-  scheme_add_prim ("ceiling", ceiling, env);
-  scheme_add_prim ("truncate", truncate, env);
-  scheme_add_prim ("round", scheme_round, env);
-  scheme_add_prim ("exp", exp_prim, env);
-  scheme_add_prim ("log", log_prim, env);
-  scheme_add_prim ("sin", sin_prim, env);
-  scheme_add_prim ("cos", cos_prim, env);
-  scheme_add_prim ("asin", asin_prim, env);
-  scheme_add_prim ("acos", acos_prim, env);
-  scheme_add_prim ("atan", atan_prim, env);
-  scheme_add_prim ("sqrt", sqrt_prim, env);
-  scheme_add_prim ("expt", expt, env);
-  scheme_add_prim ("exact->inexact", exact_to_inexact, env);
-  scheme_add_prim ("inexact->exact", inexact_to_exact, env);
-  scheme_add_prim ("number->string", number_to_string, env);
-  scheme_add_prim ("string->number", string_to_number, env);
+  scheme_add_prims (number_prims, SCHEME_NUM_ENTRIES (number_prims), env);
 }
 
 Scheme_Value
 scheme_make_integer (int i)
 {
-  int idx = i + INTEGER_CACHE_SPLIT;
-  Scheme_Value si;
-
-  /* check if we have an object in the cache */
-  if(idx >= 0 && idx < INTEGER_CACHE_SIZE) {
-    si = integer_cache[idx];
-    if(si != NULL) {
-      return si;
-    }
-  }
-
-  /* allocate and initialize the object */
-  si = scheme_alloc_object (scheme_integer_type, 0);
-  SCHEME_INT_VAL (si) = i;
-
-  /* put the object in the cache */
-  if(idx >= 0 && idx < INTEGER_CACHE_SIZE) {
-    integer_cache[idx] = si;
-  }
-
-  /* done */
-  return (si);
+  return (SCHEME_MAKE_FIXNUM (i));
 }
 
 Scheme_Value
@@ -176,7 +161,7 @@ scheme_make_double (double d)
 {
   Scheme_Value sd;
 
-  sd = scheme_alloc_object (scheme_double_type, 0);
+  sd = scheme_alloc_atomic_sized (scheme_double_type, SCHEME_OBJ_SIZE (double_val));
   SCHEME_DBL_VAL (sd) = d;
   return (sd);
 }
@@ -184,52 +169,45 @@ scheme_make_double (double d)
 /* locals */
 
 static Scheme_Value
-number_p (int argc, Scheme_Value argv[])
+number_p (Scheme_Value obj)
 {
-  SCHEME_ASSERT ((argc == 1), "number?: wrong number of args");
-  return (SCHEME_NUMBERP(argv[0]) ? scheme_true : scheme_false);
+  return (SCHEME_NUMBERP(obj) ? scheme_true : scheme_false);
 }
 
 static Scheme_Value
-complex_p (int argc, Scheme_Value argv[])
+complex_p (Scheme_Value obj)
 {
-  SCHEME_ASSERT ((argc == 1), "complex?: wrong number of args");
-  return (SCHEME_NUMBERP(argv[0]) ? scheme_true : scheme_false);
+  return (SCHEME_NUMBERP(obj) ? scheme_true : scheme_false);
 }
 
 static Scheme_Value
-real_p (int argc, Scheme_Value argv[])
+real_p (Scheme_Value obj)
 {
-  SCHEME_ASSERT ((argc == 1), "real?: wrong number of args");
-  return (SCHEME_NUMBERP(argv[0]) ? scheme_true : scheme_false);
+  return (SCHEME_NUMBERP(obj) ? scheme_true : scheme_false);
 }
 
 static Scheme_Value
-rational_p (int argc, Scheme_Value argv[])
+rational_p (Scheme_Value obj)
 {
-  SCHEME_ASSERT ((argc == 1), "rational?: wrong number of args");
-  return (SCHEME_INTP(argv[0]) ? scheme_true : scheme_false);
+  return (SCHEME_INTP(obj) ? scheme_true : scheme_false);
 }
 
 static Scheme_Value
-integer_p (int argc, Scheme_Value argv[])
+integer_p (Scheme_Value obj)
 {
-  SCHEME_ASSERT ((argc == 1), "integer?: wrong number of args");
-  return (SCHEME_INTP(argv[0]) ? scheme_true : scheme_false);
+  return (SCHEME_INTP(obj) ? scheme_true : scheme_false);
 }
 
 static Scheme_Value
-exact_p (int argc, Scheme_Value argv[])
+exact_p (Scheme_Value obj)
 {
-  SCHEME_ASSERT ((argc == 1), "exact?: wrong number of args");
-  return (SCHEME_INTP(argv[0]) ? scheme_true : scheme_false);
+  return (SCHEME_INTP(obj) ? scheme_true : scheme_false);
 }
 
 static Scheme_Value
-inexact_p (int argc, Scheme_Value argv[])
+inexact_p (Scheme_Value obj)
 {
-  SCHEME_ASSERT ((argc == 1), "inexact?: wrong number of args");
-  return (SCHEME_DBLP(argv[0]) ? scheme_true : scheme_false);
+  return (SCHEME_DBLP(obj) ? scheme_true : scheme_false);
 }
 
 GEN_BIN_COMP_PROT(bin_eq);
@@ -250,17 +228,22 @@ GEN_BIN_COMP(bin_gt, ">", >)
 GEN_BIN_COMP(bin_lt_eq, "<=", <=)
 GEN_BIN_COMP(bin_gt_eq, ">=", >=)
 
+GEN_BIN_COMP_PRIM(eq2, bin_eq)
+GEN_BIN_COMP_PRIM(lt2, bin_lt)
+GEN_BIN_COMP_PRIM(gt2, bin_gt)
+GEN_BIN_COMP_PRIM(lt_eq2, bin_lt_eq)
+GEN_BIN_COMP_PRIM(gt_eq2, bin_gt_eq)
+
 static Scheme_Value
-zero_p (int argc, Scheme_Value argv[])
+zero_p (Scheme_Value num)
 {
-  SCHEME_ASSERT ((argc == 1), "zero?: wrong number of args");
-  if (SCHEME_INTP(argv[0]))
+  if (SCHEME_INTP(num))
     {
-      return (SCHEME_INT_VAL(argv[0])==0 ? scheme_true : scheme_false);
+      return (SCHEME_INT_VAL(num)==0 ? scheme_true : scheme_false);
     }
-  else if (SCHEME_DBLP(argv[0]))
+  else if (SCHEME_DBLP(num))
     {
-      return (SCHEME_DBL_VAL(argv[0])==0 ? scheme_true : scheme_false);
+      return (SCHEME_DBL_VAL(num)==0 ? scheme_true : scheme_false);
     }
   else
     {
@@ -269,16 +252,15 @@ zero_p (int argc, Scheme_Value argv[])
 }
 
 static Scheme_Value
-positive_p (int argc, Scheme_Value argv[])
+positive_p (Scheme_Value num)
 {
-  SCHEME_ASSERT ((argc == 1), "positive?: wrong number of args");
-  if (SCHEME_INTP(argv[0]))
+  if (SCHEME_INTP(num))
     {
-      return (SCHEME_INT_VAL(argv[0])>0 ? scheme_true : scheme_false);
+      return (SCHEME_INT_VAL(num)>0 ? scheme_true : scheme_false);
     }
-  else if (SCHEME_DBLP(argv[0]))
+  else if (SCHEME_DBLP(num))
     {
-      return (SCHEME_DBL_VAL(argv[0])>0 ? scheme_true : scheme_false);
+      return (SCHEME_DBL_VAL(num)>0 ? scheme_true : scheme_false);
     }
   else
     {
@@ -287,16 +269,15 @@ positive_p (int argc, Scheme_Value argv[])
 }
 
 static Scheme_Value
-negative_p (int argc, Scheme_Value argv[])
+negative_p (Scheme_Value num)
 {
-  SCHEME_ASSERT ((argc == 1), "negative?: wrong number of args");
-  if (SCHEME_INTP(argv[0]))
+  if (SCHEME_INTP(num))
     {
-      return (SCHEME_INT_VAL(argv[0])<0 ? scheme_true : scheme_false);
+      return (SCHEME_INT_VAL(num)<0 ? scheme_true : scheme_false);
     }
-  else if (SCHEME_DBLP(argv[0]))
+  else if (SCHEME_DBLP(num))
     {
-      return (SCHEME_DBL_VAL(argv[0])<0 ? scheme_true : scheme_false);
+      return (SCHEME_DBL_VAL(num)<0 ? scheme_true : scheme_false);
     }
   else
     {
@@ -305,14 +286,13 @@ negative_p (int argc, Scheme_Value argv[])
 }
 
 static Scheme_Value
-odd_p (int argc, Scheme_Value argv[])
+odd_p (Scheme_Value num)
 {
-  SCHEME_ASSERT ((argc == 1), "odd?: wrong number of args");
-  if (SCHEME_INTP(argv[0]))
+  if (SCHEME_INTP(num))
     {
-      return (((SCHEME_INT_VAL(argv[0])%2) != 0) ? scheme_true : scheme_false);
+      return (((SCHEME_INT_VAL(num)%2) != 0) ? scheme_true : scheme_false);
     }
-  else if (SCHEME_DBLP(argv[0]))
+  else if (SCHEME_DBLP(num))
     {
       return (scheme_false);
     }
@@ -323,14 +303,13 @@ odd_p (int argc, Scheme_Value argv[])
 }
 
 static Scheme_Value
-even_p (int argc, Scheme_Value argv[])
+even_p (Scheme_Value num)
 {
-  SCHEME_ASSERT ((argc == 1), "even?: wrong number of args");
-  if (SCHEME_INTP(argv[0]))
+  if (SCHEME_INTP(num))
     {
-      return ((SCHEME_INT_VAL(argv[0])%2)==0 ? scheme_true : scheme_false);
+      return ((SCHEME_INT_VAL(num)%2)==0 ? scheme_true : scheme_false);
     }
-  else if (SCHEME_DBLP(argv[0]))
+  else if (SCHEME_DBLP(num))
     {
       return (scheme_false);
     }
@@ -422,7 +401,6 @@ minus (int argc, Scheme_Value argv[])
   Scheme_Value ret;
   int i;
 
-  SCHEME_ASSERT ((argc > 0), "-: need at least one arg");
   ret = argv[0];
   if (argc == 1)
     {
@@ -441,7 +419,6 @@ div_prim (int argc, Scheme_Value argv[])
   Scheme_Value ret;
   int i;
 
-  SCHEME_ASSERT ((argc > 0), "/: need at least one arg");
   ret = argv[0];
   if (argc == 1)
     {
@@ -497,22 +474,16 @@ bin_quotient (Scheme_Value n1, Scheme_Value n2)
     }
 }
 static Scheme_Value
-quotient (int argc, Scheme_Value argv[])
+quotient (Scheme_Value n1, Scheme_Value n2)
 {
-  SCHEME_ASSERT ((argc == 2), "quotient: wrong number of args");
-  SCHEME_ASSERT ((SCHEME_NUMBERP(argv[0]) && SCHEME_NUMBERP(argv[1])),
+  SCHEME_ASSERT ((SCHEME_NUMBERP(n1) && SCHEME_NUMBERP(n2)),
 		 "quotient: args must be numbers");
-  return (bin_quotient (argv[0], argv[1]));
+  return (bin_quotient (n1, n2));
 }
 
 static Scheme_Value
-rem_prim (int argc, Scheme_Value argv[])
+rem_prim (Scheme_Value n1, Scheme_Value n2)
 {
-  Scheme_Value n1, n2;
-
-  SCHEME_ASSERT ((argc == 2), "remainder: wrong number of args");
-  n1 = argv[0];
-  n2 = argv[1];
   SCHEME_ASSERT ((SCHEME_NUMBERP(n1) && SCHEME_NUMBERP(n2)),
 		 "remainder: args must be numbers");
   if (SCHEME_INTP(n1))
@@ -532,13 +503,8 @@ rem_prim (int argc, Scheme_Value argv[])
 }
 
 static Scheme_Value
-modulo (int argc, Scheme_Value argv[])
+modulo (Scheme_Value n1, Scheme_Value n2)
 {
-  Scheme_Value n1, n2;
-
-  SCHEME_ASSERT ((argc == 2), "modulo: wrong number of args");
-  n1 = argv[0];
-  n2 = argv[1];
   SCHEME_ASSERT ((SCHEME_NUMBERP(n1) && SCHEME_NUMBERP(n2)),
 		 "modulo: args must be numbers");
   if (SCHEME_INTP(n1))
@@ -642,7 +608,7 @@ bin_lcm (Scheme_Value n1, Scheme_Value n2)
     }
   if (SCHEME_INTP (ret))
     {
-      SCHEME_INT_VAL(ret) = ABS (SCHEME_INT_VAL(ret));
+      ret = scheme_make_integer (ABS (SCHEME_INT_VAL(ret)));
     }
   return (ret);
 }
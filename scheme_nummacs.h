@@ -52,7 +52,6 @@ static Scheme_Value  \
 name (int argc, Scheme_Value argv[]) \
 { \
   int i; \
-  SCHEME_ASSERT ((argc > 1), #scheme_name ": wrong number of args"); \
   for ( i=0 ; i<(argc-1) ; ++i ) \
     { \
       if (! bin_name(argv[i], argv[i+1])) \
@@ -63,6 +62,13 @@ name (int argc, Scheme_Value argv[]) \
   return (scheme_true); \
 }
 
+#define GEN_BIN_COMP_PRIM(name, bin_name) \
+static Scheme_Value \
+name (Scheme_Value n1, Scheme_Value n2) \
+{ \
+  return (bin_name (n1, n2) ? scheme_true : scheme_false); \
+}
+
 #define GEN_BIN_PROT(name) \
 static Scheme_Value name (Scheme_Value n1, Scheme_Value n2)
 
@@ -108,7 +114,6 @@ name (int argc, Scheme_Value argv[]) \
 { \
   Scheme_Value ret; \
   int i; \
-  SCHEME_ASSERT ((argc > 1), #scheme_name ": wrong number of args"); \
   ret = argv[0]; \
   for ( i=1 ; i<argc ; ++i ) \
     { \
@@ -0,0 +1,653 @@
+/*
+  libscheme
+  Copyright (c) 1994 Brent Benson
+  All rights reserved.
+
+  Permission is hereby granted, without written agreement and without
+  license or royalty fees, to use, copy, modify, and distribute this
+  software and its documentation for any purpose, provided that the
+  above copyright notice and the following two paragraphs appear in
+  all copies of this software.
+
+  IN NO EVENT SHALL BRENT BENSON BE LIABLE TO ANY PARTY FOR DIRECT,
+  INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES ARISING OUT
+  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF BRENT
+  BENSON HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+  BRENT BENSON SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT
+  NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER
+  IS ON AN "AS IS" BASIS, AND BRENT BENSON HAS NO OBLIGATION TO
+  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR
+  MODIFICATIONS.
+*/
+
+/* Parallel procedures over lists and vectors, and the pool of worker
+   threads they run on.
+
+   (parallel-map proc seq) and (parallel-for-each proc seq) apply PROC
+   to each element of the list or vector SEQ, and parallel-map returns
+   the results in order, in a sequence of the same kind as SEQ.
+   (parallel-reduce proc init seq) folds SEQ from the left with PROC,
+   starting from INIT.  Runs of elements are folded separately and
+   their results folded in order, so PROC must be associative.  PROC
+   and SEQ are shared by the threads, not copied: PROC should change
+   nothing that another of its applications reads, which frozen data
+   guarantees.  Nor can it call a continuation captured outside it
+   once the work is split.  An error in PROC is signalled again by the
+   call, with its message.
+
+   Built with SCHEME_THREADS, a sequence of SCHEME_PARALLEL_MIN
+   elements or more is cut into SCHEME_PARALLEL_CHUNKS chunks per
+   thread.  A task holding a range of chunks pushes its upper half
+   onto the deque of the thread running it until one chunk is left.
+   A thread takes its own newest task first and otherwise steals the
+   oldest, and so the largest, task of another.  The calling thread
+   works on its call too, as does a worker calling parallel-map
+   itself.  The workers are started on first use, one for each
+   processor but the caller's, and each runs in a context of its own,
+   switched to the environment and ports of the caller for each
+   task.  Shorter sequences, and all sequences without SCHEME_THREADS,
+   are done by the calling thread alone.  Futures, in scheme_promise.c,
+   run on the same pool. */
+
+#include "scheme_private.h"
+#include <string.h>
+#ifdef SCHEME_THREADS
+#include <unistd.h>
+#endif
+
+/* kinds of job */
+#define MAP      0
+#define FOR_EACH 1
+#define REDUCE   2
+
+/* one call of a parallel procedure */
+typedef struct Job
+{
+  int kind;
+  Scheme_Value proc, init;
+  Scheme_Value *items;
+  Scheme_Value *results;	/* of each item, or of each chunk for REDUCE */
+  int num_items, chunk_size;
+  int pending;			/* chunks not done yet */
+  int failed;
+  Scheme_Value message;		/* of the first error */
+} Job;
+
+/* locals */
+static Scheme_Value parallel (int kind, const char *name, Scheme_Value proc,
+			      Scheme_Value init, Scheme_Value seq);
+static void run_chunk (Job *job, int chunk);
+static Scheme_Value parallel_map (Scheme_Value proc, Scheme_Value seq);
+static Scheme_Value parallel_for_each (Scheme_Value proc, Scheme_Value seq);
+static Scheme_Value parallel_reduce (Scheme_Value proc, Scheme_Value init, Scheme_Value seq);
+static Scheme_Value task_error (Scheme_Value port);
+
+#ifdef SCHEME_THREADS
+
+/* a task running the chunks from LO up to HI of a job */
+typedef struct Range
+{
+  Scheme_Task task;
+  Job *job;
+  int lo, hi;
+} Range;
+
+/* A worker and its deque of tasks, TOP being the oldest.  The
+   indices only grow, and are taken modulo the size. */
+typedef struct Worker
+{
+  pthread_t thread;
+  pthread_mutex_t lock;
+  Scheme_Task **tasks;
+  int size, top, bottom;
+  Scheme_Context *context;
+} Worker;
+
+static int num_workers = -1;	/* not started */
+static Worker *workers;
+static int next_worker;		/* for tasks from other threads */
+static int queued;		/* tasks in all the deques */
+SCHEME_DEFINE_LOCK (pool_lock);
+static pthread_cond_t pool_wake = PTHREAD_COND_INITIALIZER;
+static SCHEME_THREAD_LOCAL Worker *self;
+
+static int start_pool (void);
+static void *worker_main (void *arg);
+static void push_task (Scheme_Task *task);
+static Scheme_Task *take_task (void);
+static Scheme_Task *make_range (Job *job, int lo, int hi);
+static Scheme_Value range_run (Scheme_Task *task);
+static void range_done (Scheme_Task *task, Scheme_Value val, int failed);
+
+#endif /* SCHEME_THREADS */
+
+static const Scheme_Prim_Entry parallel_prims[] =
+{
+  SCHEME_PRIM2_ENTRY ("parallel-map", parallel_map),
+  SCHEME_PRIM2_ENTRY ("parallel-for-each", parallel_for_each),
+  SCHEME_PRIM3_ENTRY ("parallel-reduce", parallel_reduce)
+};
+
+void
+scheme_init_parallel (Scheme_Env *env)
+{
+  scheme_add_prims (parallel_prims, SCHEME_NUM_ENTRIES (parallel_prims), env);
+}
+
+/* Have TASK run in the current environment, by a worker or by the
+   first thread to wait for it. */
+void
+scheme_pool_submit (Scheme_Task *task)
+{
+  task->env = scheme_env;
+  task->in_port = scheme_context->in_port;
+  task->out_port = scheme_context->out_port;
+#ifdef SCHEME_THREADS
+  if (start_pool () > 0)
+    {
+      push_task (task);
+      return;
+    }
+#endif
+  scheme_run_task (task);
+}
+
+/* Wait until *PENDING drops to zero through scheme_pool_finish,
+   running queued tasks in the meantime. */
+void
+scheme_pool_wait (int *pending)
+{
+#ifdef SCHEME_THREADS
+  Scheme_Task *task;
+
+  while (__atomic_load_n (pending, __ATOMIC_ACQUIRE) > 0)
+    {
+      task = take_task ();
+      if (task)
+	{
+	  scheme_run_task (task);
+	  continue;
+	}
+      /* the rest is running elsewhere: wait for it to finish, or for
+	 tasks split off from it */
+      SCHEME_LOCK (pool_lock);
+      while (queued <= 0 && __atomic_load_n (pending, __ATOMIC_ACQUIRE) > 0)
+	{
+	  pthread_cond_wait (&pool_wake, &pool_lock);
+	}
+      SCHEME_UNLOCK (pool_lock);
+    }
+#endif
+}
+
+/* Take COUNT off *PENDING, waking its waiters when none are left.
+   What was stored before is seen by them. */
+void
+scheme_pool_finish (int *pending, int count)
+{
+#ifdef SCHEME_THREADS
+  if (__atomic_sub_fetch (pending, count, __ATOMIC_ACQ_REL) == 0)
+    {
+      SCHEME_LOCK (pool_lock);
+      pthread_cond_broadcast (&pool_wake);
+      SCHEME_UNLOCK (pool_lock);
+    }
+#else
+  *pending -= count;
+#endif
+}
+
+/* Run TASK in the calling thread's context, leaving the context as
+   it was.  Continuations captured before cannot be called from the
+   task, since their frames are below it, and those captured in it
+   are dead after it.  The message of an error is kept for DONE
+   rather than printed. */
+void
+scheme_run_task (Scheme_Task *task)
+{
+  Scheme_Context *context = scheme_context;
+  Scheme_Env *env = context->env;
+  Scheme_Value in_port = context->in_port, out_port = context->out_port;
+  Scheme_Value error_port = context->error_port;
+  Scheme_Task *outer = context->task;
+  Scheme_Cont *live = context->live_conts;
+  jmp_buf error_buf;
+
+  memcpy (error_buf, context->error_buf, sizeof (jmp_buf));
+  context->env = task->env;
+  context->in_port = task->in_port;
+  context->out_port = task->out_port;
+  context->task = task;
+  if (! context->task_errors)
+    {
+      context->task_errors = scheme_make_string_output_port (SCHEME_TASK_ERROR);
+    }
+  context->error_port = context->task_errors;
+  if (setjmp (context->error_buf))
+    {
+      task->done (task, task_error (context->task_errors), 1);
+    }
+  else
+    {
+      task->done (task, task->run (task), 0);
+    }
+  while (context->live_conts != live)
+    {
+      context->live_conts->escaped = 1;
+      context->live_conts = context->live_conts->next;
+    }
+  context->task = outer;
+  context->env = env;
+  context->in_port = in_port;
+  context->out_port = out_port;
+  context->error_port = error_port;
+  memcpy (context->error_buf, error_buf, sizeof (jmp_buf));
+}
+
+/* locals */
+
+static Scheme_Value
+parallel (int kind, const char *name, Scheme_Value proc, Scheme_Value init, Scheme_Value seq)
+{
+  Job *job;
+  Scheme_Value *items, *results, result, args[2];
+  int i, n, num_chunks, chunk_size;
+
+  if (! SCHEME_PROCP (proc))
+    {
+      scheme_signal_error ("%s: first arg must be a procedure", name);
+    }
+  if (SCHEME_VECTORP (seq))
+    {
+      n = SCHEME_VEC_SIZE (seq);
+      items = SCHEME_VEC_ELS (seq);
+    }
+  else if (SCHEME_LISTP (seq))
+    {
+      n = scheme_list_length (seq);
+      items = (Scheme_Value *) scheme_malloc ((n + 1) * sizeof (Scheme_Value));
+      for ( i=0 ; i<n ; ++i, seq=SCHEME_CDR (seq) )
+	{
+	  items[i] = SCHEME_CAR (seq);
+	}
+    }
+  else
+    {
+      scheme_signal_error ("%s: last arg must be a list or vector", name);
+    }
+  if (n == 0)
+    {
+      return (kind == REDUCE ? init : seq);
+    }
+
+  chunk_size = n;
+  num_chunks = 1;
+#ifdef SCHEME_THREADS
+  if (n >= SCHEME_PARALLEL_MIN && start_pool () > 0)
+    {
+      num_chunks = (num_workers + 1) * SCHEME_PARALLEL_CHUNKS;
+      if (num_chunks > n)
+	{
+	  num_chunks = n;
+	}
+      chunk_size = (n + num_chunks - 1) / num_chunks;
+      num_chunks = (n + chunk_size - 1) / chunk_size;
+    }
+#endif
+
+  /* nothing is allocated between making the job and filling it in,
+     which the precise collector's write barrier relies on */
+  results = NULL;
+  if (kind != FOR_EACH)
+    {
+      results = (Scheme_Value *) scheme_malloc ((kind == MAP ? n : num_chunks)
+						* sizeof (Scheme_Value));
+    }
+  job = (Job *) scheme_malloc (sizeof (Job));
+  job->kind = kind;
+  job->proc = proc;
+  job->init = init;
+  job->items = items;
+  job->results = results;
+  job->num_items = n;
+  job->chunk_size = chunk_size;
+  job->pending = num_chunks;
+  job->failed = 0;
+  job->message = scheme_null;
+
+  /* a body read from an image is analyzed before the threads run it */
+  if (SCHEME_CLOSUREP (proc))
+    {
+      scheme_image_analyze_lambda (SCHEME_CLOS_LAMBDA (proc), SCHEME_CLOS_ENV (proc));
+    }
+
+#ifdef SCHEME_THREADS
+  if (num_chunks > 1)
+    {
+      scheme_pool_submit (make_range (job, 0, num_chunks));
+      scheme_pool_wait (&job->pending);
+      if (job->failed)
+	{
+	  scheme_signal_error ("%s: %s", name, SCHEME_STR_VAL (job->message));
+	}
+    }
+  else
+#endif
+    {
+      run_chunk (job, 0);
+    }
+
+  switch (kind)
+    {
+    case MAP:
+      if (SCHEME_VECTORP (seq))
+	{
+	  result = scheme_make_vector (n, scheme_null);
+	  memcpy (SCHEME_VEC_ELS (result), results, n * sizeof (Scheme_Value));
+	}
+      else
+	{
+	  result = scheme_null;
+	  for ( i=n-1 ; i>=0 ; --i )
+	    {
+	      result = scheme_make_pair (results[i], result);
+	    }
+	}
+      return (result);
+    case REDUCE:
+      args[0] = results[0];
+      for ( i=1 ; i<num_chunks ; ++i )
+	{
+	  args[1] = results[i];
+	  args[0] = scheme_apply (proc, 2, args);
+	}
+      return (args[0]);
+    default:
+      return (scheme_null);
+    }
+}
+
+/* Apply the procedure of JOB to the items of chunk CHUNK.  The first
+   chunk of a reduction starts from the initial value, the others from
+   their first item. */
+static void
+run_chunk (Job *job, int chunk)
+{
+  Scheme_Value args[2];
+  int i, end;
+
+  i = chunk * job->chunk_size;
+  end = i + job->chunk_size;
+  if (end > job->num_items)
+    {
+      end = job->num_items;
+    }
+  if (job->kind == REDUCE)
+    {
+      args[0] = (chunk == 0) ? job->init : job->items[i++];
+      for ( ; i<end ; ++i )
+	{
+	  args[1] = job->items[i];
+	  args[0] = scheme_apply (job->proc, 2, args);
+	}
+      job->results[chunk] = args[0];
+      SCHEME_GC_WRITE (&job->results[chunk]);
+      return;
+    }
+  for ( ; i<end ; ++i )
+    {
+      args[0] = job->items[i];
+      args[0] = scheme_apply (job->proc, 1, args);
+      if (job->kind == MAP)
+	{
+	  job->results[i] = args[0];
+	  SCHEME_GC_WRITE (&job->results[i]);
+	}
+    }
+}
+
+static Scheme_Value
+parallel_map (Scheme_Value proc, Scheme_Value seq)
+{
+  return (parallel (MAP, "parallel-map", proc, scheme_null, seq));
+}
+
+static Scheme_Value
+parallel_for_each (Scheme_Value proc, Scheme_Value seq)
+{
+  return (parallel (FOR_EACH, "parallel-for-each", proc, scheme_null, seq));
+}
+
+static Scheme_Value
+parallel_reduce (Scheme_Value proc, Scheme_Value init, Scheme_Value seq)
+{
+  return (parallel (REDUCE, "parallel-reduce", proc, init, seq));
+}
+
+/* the message written to PORT, which is emptied */
+static Scheme_Value
+task_error (Scheme_Value port)
+{
+  Scheme_Port *p = (Scheme_Port *) SCHEME_PTR_VAL (port);
+  long len;
+
+  fflush (p->stream);
+  len = ftell (p->stream);
+  while (len > 0 && p->buf[len - 1] == '\n')
+    {
+      len--;
+    }
+  p->buf[len] = 0;
+  rewind (p->stream);
+  return (scheme_make_string (p->buf));
+}
+
+#ifdef SCHEME_THREADS
+
+/* Start the workers if they are not running yet, and return how many
+   there are. */
+static int
+start_pool (void)
+{
+  Worker *w;
+  long n;
+  int i;
+
+  SCHEME_LOCK (pool_lock);
+  if (num_workers < 0)
+    {
+      n = sysconf (_SC_NPROCESSORS_ONLN) - 1;
+      if (n < 0)
+	{
+	  n = 0;
+	}
+      if (n > SCHEME_PARALLEL_WORKERS)
+	{
+	  n = SCHEME_PARALLEL_WORKERS;
+	}
+      workers = (Worker *) scheme_malloc ((n + 1) * sizeof (Worker));
+      for ( i=0 ; i<n ; ++i )
+	{
+	  w = &workers[i];
+	  pthread_mutex_init (&w->lock, NULL);
+	  w->size = SCHEME_PARALLEL_DEQUE;
+	  w->tasks = (Scheme_Task **) scheme_malloc (w->size * sizeof (Scheme_Task *));
+	  w->top = w->bottom = 0;
+	  w->context = scheme_make_context (scheme_env);
+	}
+      /* every deque is ready before any worker looks at them */
+      num_workers = n;
+      for ( i=0 ; i<n ; ++i )
+	{
+	  if (pthread_create (&workers[i].thread, NULL, worker_main, &workers[i]) == 0)
+	    {
+	      pthread_detach (workers[i].thread);
+	    }
+	}
+    }
+  SCHEME_UNLOCK (pool_lock);
+  return (num_workers);
+}
+
+static void *
+worker_main (void *arg)
+{
+  Scheme_Task *task;
+
+  self = (Worker *) arg;
+  scheme_attach_thread (self->context);
+  while (1)
+    {
+      task = take_task ();
+      if (task)
+	{
+	  scheme_run_task (task);
+	}
+      else
+	{
+	  SCHEME_LOCK (pool_lock);
+	  while (queued <= 0)
+	    {
+	      pthread_cond_wait (&pool_wake, &pool_lock);
+	    }
+	  SCHEME_UNLOCK (pool_lock);
+	}
+    }
+  return (NULL);
+}
+
+/* Push TASK onto the deque of the calling worker, or of some worker
+   for any other thread. */
+static void
+push_task (Scheme_Task *task)
+{
+  Scheme_Task **tasks;
+  Worker *w;
+  int i, count;
+
+  w = self;
+  if (! w)
+    {
+      SCHEME_LOCK (pool_lock);
+      w = &workers[next_worker++ % num_workers];
+      SCHEME_UNLOCK (pool_lock);
+    }
+
+  pthread_mutex_lock (&w->lock);
+  count = w->bottom - w->top;
+  if (count == w->size)
+    {
+      tasks = (Scheme_Task **) scheme_malloc (2 * w->size * sizeof (Scheme_Task *));
+      for ( i=0 ; i<count ; ++i )
+	{
+	  tasks[i] = w->tasks[(w->top + i) % w->size];
+	}
+      w->tasks = tasks;
+      w->size *= 2;
+      w->top = 0;
+      w->bottom = count;
+    }
+  w->tasks[w->bottom++ % w->size] = task;
+  pthread_mutex_unlock (&w->lock);
+
+  SCHEME_LOCK (pool_lock);
+  queued++;
+  pthread_cond_signal (&pool_wake);
+  SCHEME_UNLOCK (pool_lock);
+}
+
+/* The newest task of the calling worker, or else the oldest of
+   another, or NULL. */
+static Scheme_Task *
+take_task (void)
+{
+  Scheme_Task *task = NULL;
+  Worker *w;
+  int i, start;
+
+  if (self)
+    {
+      pthread_mutex_lock (&self->lock);
+      if (self->bottom > self->top)
+	{
+	  task = self->tasks[--self->bottom % self->size];
+	  self->tasks[self->bottom % self->size] = NULL;
+	}
+      pthread_mutex_unlock (&self->lock);
+    }
+  start = self ? (self - workers) + 1 : 0;
+  for ( i=0 ; !task && i<num_workers ; ++i )
+    {
+      w = &workers[(start + i) % num_workers];
+      if (w == self)
+	{
+	  continue;
+	}
+      pthread_mutex_lock (&w->lock);
+      if (w->bottom > w->top)
+	{
+	  task = w->tasks[w->top % w->size];
+	  w->tasks[w->top++ % w->size] = NULL;
+	}
+      pthread_mutex_unlock (&w->lock);
+    }
+  if (task)
+    {
+      SCHEME_LOCK (pool_lock);
+      queued--;
+      SCHEME_UNLOCK (pool_lock);
+    }
+  return (task);
+}
+
+static Scheme_Task *
+make_range (Job *job, int lo, int hi)
+{
+  Range *range;
+
+  range = (Range *) scheme_malloc (sizeof (Range));
+  range->task.run = range_run;
+  range->task.done = range_done;
+  range->job = job;
+  range->lo = lo;
+  range->hi = hi;
+  return (&range->task);
+}
+
+static Scheme_Value
+range_run (Scheme_Task *task)
+{
+  Range *range = (Range *) task;
+  int mid;
+
+  while (range->hi - range->lo > 1)
+    {
+      mid = range->lo + (range->hi - range->lo) / 2;
+      scheme_pool_submit (make_range (range->job, mid, range->hi));
+      range->hi = mid;
+    }
+  /* after an error the results are not wanted */
+  if (! __atomic_load_n (&range->job->failed, __ATOMIC_RELAXED))
+    {
+      run_chunk (range->job, range->lo);
+    }
+  return (scheme_null);
+}
+
+static void
+range_done (Scheme_Task *task, Scheme_Value val, int failed)
+{
+  Range *range = (Range *) task;
+  Job *job = range->job;
+
+  /* the first error is the one reported */
+  if (failed && __sync_bool_compare_and_swap (&job->failed, 0, 1))
+    {
+      job->message = val;
+    }
+  scheme_pool_finish (&job->pending, range->hi - range->lo);
+}
+
+#endif /* SCHEME_THREADS */
@@ -31,13 +31,18 @@ Scheme_Value scheme_pointer_type;
 static Scheme_Value pointer_p (int argc, Scheme_Value argv[]);
 static Scheme_Value pointer_eq (int argc, Scheme_Value argv[]);
 
+static const Scheme_Prim_Entry pointer_prims[] =
+{
+  SCHEME_PRIM_ENTRY ("pointer?", pointer_p, 0, -1),
+  SCHEME_PRIM_ENTRY ("pointer=?", pointer_eq, 0, -1)
+};
+
 void
 scheme_init_pointer (Scheme_Env *env)
 {
-  scheme_pointer_type = scheme_make_type ("<pointer>");
+  scheme_pointer_type = scheme_make_builtin_type ("<pointer>", SCHEME_POINTER_TYPE_INDEX);
   scheme_add_global ("<pointer>", scheme_pointer_type, env);
-  scheme_add_prim ("pointer?", pointer_p, env);
-  scheme_add_prim ("pointer=?", pointer_eq, env);
+  scheme_add_prims (pointer_prims, SCHEME_NUM_ENTRIES (pointer_prims), env);
 }
 
 Scheme_Value
@@ -45,7 +50,7 @@ scheme_make_pointer (void *pointer)
 {
   Scheme_Value sc;
 
-  sc = scheme_alloc_object (scheme_pointer_type, 0);
+  sc = scheme_alloc_sized (scheme_pointer_type, SCHEME_OBJ_SIZE (ptr_val));
   SCHEME_PTR_VAL (sc) = pointer;
   return (sc);
 }
@@ -26,8 +26,11 @@
 #include <string.h>
 #include <stdio.h>
 
+/* the end-of-file object is a static object */
+static Scheme_Object eof_object = { SCHEME_STATIC_HEADER (SCHEME_EOF_TYPE_INDEX), { 0 } };
+
 /* globals */
-Scheme_Value scheme_eof;
+Scheme_Value scheme_eof = &eof_object;
 Scheme_Value scheme_eof_type;
 Scheme_Value scheme_input_port_type;
 Scheme_Value scheme_output_port_type;
@@ -36,8 +39,8 @@ Scheme_Value scheme_stdout_port;
 Scheme_Value scheme_stderr_port;
 
 /* locals */
-static Scheme_Value cur_in_port;
-static Scheme_Value cur_out_port;
+#define cur_in_port  (scheme_context->in_port)
+#define cur_out_port (scheme_context->out_port)
 
 /* static function declarations */
 static Scheme_Value eof_object_p (int argc, Scheme_Value argv[]);
@@ -78,69 +81,73 @@ static Scheme_Value port_string (int argc, Scheme_Value argv[]);
 /* internal functions */
 static Scheme_Value get_port_string(Scheme_Value port);
 
+static const Scheme_Prim_Entry port_prims[] =
+{
+  SCHEME_PRIM_ENTRY ("eof-object?", eof_object_p, 0, -1),
+  SCHEME_PRIM_ENTRY ("input-port?", input_port_p, 0, -1),
+  SCHEME_PRIM_ENTRY ("output-port?", output_port_p, 0, -1),
+  SCHEME_PRIM_ENTRY ("open-input-file", open_input_file, 0, -1),
+  SCHEME_PRIM_ENTRY ("open-output-file", open_output_file, 0, -1),
+  SCHEME_PRIM_ENTRY ("open-input-string", open_input_string, 0, -1),
+  SCHEME_PRIM_ENTRY ("open-output-string", open_output_string, 0, -1),
+  SCHEME_PRIM_ENTRY ("close-input-port", close_input_port, 0, -1),
+  SCHEME_PRIM_ENTRY ("close-output-port", close_output_port, 0, -1),
+  SCHEME_PRIM_ENTRY ("current-input-port", current_input_port, 0, -1),
+  SCHEME_PRIM_ENTRY ("current-output-port", current_output_port, 0, -1),
+  SCHEME_PRIM_ENTRY ("call-with-input-file", call_with_input_file, 0, -1),
+  SCHEME_PRIM_ENTRY ("call-with-output-file", call_with_output_file, 0, -1),
+  SCHEME_PRIM_ENTRY ("with-input-from-file", with_input_from_file, 0, -1),
+  SCHEME_PRIM_ENTRY ("with-output-to-file", with_output_to_file, 0, -1),
+  SCHEME_PRIM_ENTRY ("read", read, 0, -1),
+  SCHEME_PRIM_ENTRY ("read-char", read_char, 0, -1),
+  SCHEME_PRIM_ENTRY ("read-line", read_line, 0, -1),
+  SCHEME_PRIM_ENTRY ("peek-char", peek_char, 0, -1),
+  SCHEME_PRIM_ENTRY ("char-ready?", char_ready_p, 0, -1),
+  SCHEME_PRIM_ENTRY ("write", write, 0, -1),
+  SCHEME_PRIM_ENTRY ("display", display, 0, -1),
+  SCHEME_PRIM_ENTRY ("newline", newline, 0, -1),
+  SCHEME_PRIM_ENTRY ("write-char", write_char, 0, -1),
+  SCHEME_PRIM_ENTRY ("load", load, 0, -1),
+  SCHEME_PRIM_ENTRY ("read-from-string", read_from_string, 0, -1),
+  SCHEME_PRIM_ENTRY ("write-to-string", write_to_string, 0, -1),
+  SCHEME_PRIM_ENTRY ("display-to-string", display_to_string, 0, -1),
+  SCHEME_PRIM_ENTRY ("drain-input", drain_input, 0, -1),
+  SCHEME_PRIM_ENTRY ("flush-output", flush_output, 0, -1),
+  SCHEME_PRIM_ENTRY ("port-string", port_string, 0, -1)
+};
+
 /* exported functions */
 
 void
 scheme_init_port (Scheme_Env *env)
 {
   /* end-of-file object */
-  scheme_eof_type = scheme_make_type ("<eof>");
+  scheme_eof_type = scheme_make_builtin_type ("<eof>", SCHEME_EOF_TYPE_INDEX);
   scheme_add_global ("<eof>", scheme_eof_type, env);
-  scheme_add_prim ("eof-object?", eof_object_p, env);
-  scheme_eof = scheme_alloc_object(scheme_eof_type, 0);
+  scheme_add_prims (port_prims, SCHEME_NUM_ENTRIES (port_prims), env);
 
   /* port types */
-  scheme_input_port_type = scheme_make_type ("<input-port>");
-  scheme_output_port_type = scheme_make_type ("<output-port>");
+  scheme_input_port_type = scheme_make_builtin_type ("<input-port>", SCHEME_INPUT_PORT_TYPE_INDEX);
+  scheme_output_port_type = scheme_make_builtin_type ("<output-port>", SCHEME_OUTPUT_PORT_TYPE_INDEX);
   scheme_add_global ("<input-port>", scheme_input_port_type, env);
-  scheme_add_prim ("input-port?", input_port_p, env);
   scheme_add_global ("<output-port>", scheme_output_port_type, env);
-  scheme_add_prim ("output-port?", output_port_p, env);
 
   /* opening and closing */
-  scheme_add_prim ("open-input-file", open_input_file, env);
-  scheme_add_prim ("open-output-file", open_output_file, env);
-  scheme_add_prim ("open-input-string", open_input_string, env);
-  scheme_add_prim ("open-output-string", open_output_string, env);
-  scheme_add_prim ("close-input-port", close_input_port, env);
-  scheme_add_prim ("close-output-port", close_output_port, env);
 
   /* current port */
-  scheme_add_prim ("current-input-port", current_input_port, env);
-  scheme_add_prim ("current-output-port", current_output_port, env);
-  scheme_add_prim ("call-with-input-file", call_with_input_file, env);
-  scheme_add_prim ("call-with-output-file", call_with_output_file, env);
-  scheme_add_prim ("with-input-from-file", with_input_from_file, env);
-  scheme_add_prim ("with-output-to-file", with_output_to_file, env);
 
   /* port operations */
-  scheme_add_prim ("read", read, env);
-  scheme_add_prim ("read-char", read_char, env);
-  scheme_add_prim ("read-line", read_line, env);
-  scheme_add_prim ("peek-char", peek_char, env);
-  scheme_add_prim ("char-ready?", char_ready_p, env);
-  scheme_add_prim ("write", write, env);
-  scheme_add_prim ("display", display, env);
-  scheme_add_prim ("newline", newline, env);
-  scheme_add_prim ("write-char", write_char, env);
-  scheme_add_prim ("load", load, env);
 
   /* reading to/from strings */
-  scheme_add_prim ("read-from-string", read_from_string, env);
-  scheme_add_prim ("write-to-string", write_to_string, env);
-  scheme_add_prim ("display-to-string", display_to_string, env);
 
   /* buffering */
-  scheme_add_prim ("drain-input", drain_input, env);
-  scheme_add_prim ("flush-output", flush_output, env);
 
   /* string ports */
-  scheme_add_prim ("port-string", port_string, env);
 
   /* standard ports */
   cur_in_port = scheme_stdin_port = scheme_make_input_port (stdin);
   cur_out_port = scheme_stdout_port = scheme_make_output_port (stdout);
-  scheme_stderr_port = scheme_make_output_port (stderr);
+  scheme_context->error_port = scheme_stderr_port = scheme_make_output_port (stderr);
 }
 
 Scheme_Value
@@ -170,10 +177,14 @@ scheme_make_output_port (FILE *stream)
 Scheme_Value
 scheme_make_string_input_port(const char *buf, size_t len)
 {
-  FILE *is = fmemopen((char*)buf, len, "r");
+  /* the stream keeps the buffer, so it must not move */
+  char *copy = scheme_malloc_fixed(len + 1);
+  memcpy(copy, buf, len);
+  copy[len] = 0;
+  FILE *is = fmemopen(copy, len, "r");
   Scheme_Value port = scheme_make_input_port(is);
   Scheme_Port *p = (Scheme_Port *)SCHEME_PTR_VAL(port);
-  p->buf = (char*)buf;
+  p->buf = copy;
   p->len = len;
   return port;
 }
@@ -181,7 +192,8 @@ scheme_make_string_input_port(const char *buf, size_t len)
 Scheme_Value
 scheme_make_string_output_port(size_t maxlen)
 {
-  char *buf = scheme_calloc(1, maxlen + 1);
+  char *buf = scheme_malloc_fixed(maxlen + 1);
+  memset(buf, 0, maxlen + 1);
   FILE *is = fmemopen(buf, maxlen, "w");
   Scheme_Value port = scheme_make_output_port(is);
   Scheme_Port *p = (Scheme_Port *)SCHEME_PTR_VAL(port);
@@ -352,9 +364,9 @@ with_input_from_file (int argc, Scheme_Value argv[])
 static Scheme_Value
 with_output_to_file (int argc, Scheme_Value argv[])
 {
-  FILE *fp, *old;
+  FILE *fp;
   char *filename;
-  Scheme_Value ret;
+  Scheme_Value ret, old_port, new_port;
 
   SCHEME_ASSERT ((argc == 2), "with-output-to-file: wrong number of args");
   SCHEME_ASSERT (SCHEME_STRINGP (argv[0]),
@@ -367,11 +379,13 @@ with_output_to_file (int argc, Scheme_Value argv[])
     {
       scheme_signal_error ("cannot open file for output: %s", filename);
     }
-  old = (FILE *)SCHEME_PTR_VAL (cur_out_port);
-  SCHEME_PTR_VAL (cur_out_port) = fp;
+  /* a port of its own, since other contexts may share the old one */
+  new_port = scheme_make_output_port (fp);
+  old_port = cur_out_port;
+  cur_out_port = new_port;
   ret = scheme_apply_to_list (argv[1], scheme_null);
-  SCHEME_PTR_VAL (cur_out_port) = old;
-  fclose (fp);
+  cur_out_port = old_port;
+  scheme_close_output_port (new_port);
   return (ret);
 }
 
@@ -649,11 +663,18 @@ static Scheme_Value
 load (int argc, Scheme_Value argv[])
 {
   Scheme_Value obj, ret = scheme_null, port;
+  Scheme_Env *env;
   char *filename;
   FILE *fp;
 
-  SCHEME_ASSERT ((argc == 1), "load: wrong number of args");
+  SCHEME_ASSERT ((argc == 1 || argc == 2), "load: wrong number of args");
   SCHEME_ASSERT (SCHEME_STRINGP (argv[0]), "load: arg must be a filename (string)");
+  env = scheme_env;
+  if (argc == 2)
+    {
+      SCHEME_ASSERT (SCHEME_ENVIRONMENTP (argv[1]), "load: second arg must be an environment");
+      env = SCHEME_ENV_VAL (argv[1]);
+    }
   filename = SCHEME_STR_VAL (argv[0]);
   printf ("; loading %s\n", filename);
   fp = fopen (filename, "r");
@@ -667,7 +688,7 @@ load (int argc, Scheme_Value argv[])
   port = scheme_make_input_port (fp);
   while ((obj = scheme_read (port)) != scheme_eof)
     {
-      ret = scheme_eval (obj, scheme_env);
+      ret = scheme_eval (scheme_freeze_literals (obj), env);
     }
   printf ("; done loading %s\n", filename);
   fclose (fp);
@@ -37,15 +37,23 @@ extern "C"
 {
 #endif
 
-struct Scheme_Hash_Bucket;
+struct Scheme_Hash_Entry;
 struct Scheme_Hash_Table;
+struct Scheme_Global_Cell;
 struct Scheme_Method;
 struct Scheme_Port;
 
-typedef struct Scheme_Hash_Bucket Scheme_Hash_Bucket;
+typedef struct Scheme_Hash_Entry Scheme_Hash_Entry;
 typedef struct Scheme_Hash_Table Scheme_Hash_Table;
+typedef struct Scheme_Global_Cell Scheme_Global_Cell;
 typedef struct Scheme_Method Scheme_Method;
 typedef struct Scheme_Port Scheme_Port;
+typedef struct Scheme_Node Scheme_Node;
+typedef struct Scheme_Lambda Scheme_Lambda;
+typedef struct Scheme_Task Scheme_Task;
+
+/* node handler, runs an analyzed form in a runtime environment */
+typedef Scheme_Value (Scheme_Node_Proc) (Scheme_Node *node, Scheme_Env *env);
 
 struct Scheme_Env
 {
@@ -54,6 +62,9 @@ struct Scheme_Env
   Scheme_Value *values;
   Scheme_Hash_Table *globals;
   struct Scheme_Env *next;
+  int on_stack;			/* lives in a C frame, see scheme_heap_env */
+  int frozen;			/* captured by a frozen closure */
+  struct Scheme_Env *base;	/* of a top-level env, see scheme_make_module_env */
 };
 
 struct Scheme_Cont
@@ -61,19 +72,40 @@ struct Scheme_Cont
   int escaped;
   jmp_buf buffer;
   Scheme_Value retval;
+  struct Scheme_Cont *next;
+  struct Scheme_Context *context;	/* where it may be called, */
+  Scheme_Task *task;			/* see scheme_apply */
 };
 
-struct Scheme_Hash_Bucket
+struct Scheme_Hash_Entry
 {
-  char *key;
+  char *key;			/* NULL in an empty entry */
   void *val;
-  struct Scheme_Hash_Bucket *next;
 };
 
+/* An open-addressing table of string keys.  The hash of each key is
+   kept in HASHES, apart from the entries so that the collector need
+   not be told which words are pointers, and is compared before the
+   key.  SIZE is a power of two. */
 struct Scheme_Hash_Table
 {
   int size;
-  Scheme_Hash_Bucket **buckets;
+  int count;
+  unsigned int *hashes;
+  Scheme_Hash_Entry *entries;
+};
+
+/* The value of a global variable.  The globals table maps names to
+   cells, so code can resolve a global once and read it with a single
+   load.  VAL is NULL while the variable is unbound; the variable then
+   has the value of BASE, the cell of the same name in the base of a
+   module, see scheme_make_module_env. */
+struct Scheme_Global_Cell
+{
+  Scheme_Value val;
+  char *name;
+  Scheme_Hash_Table *home;	/* the table it was made in */
+  struct Scheme_Global_Cell *base;
 };
 
 struct Scheme_Method
@@ -90,6 +122,145 @@ struct Scheme_Port
   size_t len;
 };
 
+typedef struct Scheme_Promise
+{
+  int forced;
+  Scheme_Value val;
+  Scheme_Env *env;
+} Scheme_Promise;
+
+typedef struct Scheme_Struct_Proc
+{
+  Scheme_Value struct_type;
+  enum {SCHEME_CONSTR, SCHEME_PRED, SCHEME_GETTER, SCHEME_SETTER} proc_type;
+  int slot_num;
+} Scheme_Struct_Proc;
+
+/* An analyzed form.  The analyzer resolves syntax, macros and the
+   shape of each form once; evaluation then just calls the handler.
+   A call analyzed in tail position of a lambda body does not make
+   the call: it returns scheme_tail_call and leaves it to the
+   scheme_apply running that body. */
+struct Scheme_Node
+{
+  Scheme_Node_Proc *eval;
+  Scheme_Value form;
+  union
+    {
+      Scheme_Value val;
+      Scheme_Env *frame;
+      Scheme_Lambda *lambda;
+      struct { int depth, index; } addr;
+      Scheme_Global_Cell *cell;
+    } u;
+  int num_nodes;
+  Scheme_Node *nodes[];
+};
+
+/* An analyzed lambda expression, shared by all of its closures. */
+struct Scheme_Lambda
+{
+  Scheme_Value code;
+  Scheme_Value params;
+  int num_params;		/* frame size, counting a rest parameter */
+  int rest;			/* nonzero if the last parameter is a rest list */
+  int stack_frame;		/* frames can be kept on the C stack */
+  Scheme_Value *symbols;	/* shared by every frame of the lambda */
+  Scheme_Node *body;
+};
+
+/* the call a node in tail position leaves for scheme_apply */
+typedef struct Scheme_Pending_Call
+{
+  Scheme_Value rator;
+  int num_rands;
+  Scheme_Value rands[SCHEME_MAX_ARGS];
+} Scheme_Pending_Call;
+
+/* SCHEME_THREADS: each thread runs in its own context, and the few
+   tables the contexts share are locked.  SCHEME_ONCE calls a function
+   the first time it is reached, in whichever thread. */
+#ifdef SCHEME_THREADS
+#include <pthread.h>
+#define SCHEME_THREAD_LOCAL __thread
+#define SCHEME_DEFINE_LOCK(name) static pthread_mutex_t name = PTHREAD_MUTEX_INITIALIZER
+#define SCHEME_LOCK(name)   pthread_mutex_lock (&(name))
+#define SCHEME_UNLOCK(name) pthread_mutex_unlock (&(name))
+#define SCHEME_DEFINE_ONCE(name) static pthread_once_t name = PTHREAD_ONCE_INIT
+#define SCHEME_ONCE(name, fun) pthread_once (&(name), (fun))
+#else
+#define SCHEME_THREAD_LOCAL
+#define SCHEME_DEFINE_LOCK(name) static int name
+#define SCHEME_LOCK(name)   ((void) (name))
+#define SCHEME_UNLOCK(name) ((void) (name))
+#define SCHEME_DEFINE_ONCE(name) static int name
+#define SCHEME_ONCE(name, fun) ((name) ? (void) 0 : ((name) = 1, (fun) ()))
+#endif
+
+/* Everything an interpreter changes as it runs.  The context is
+   scanned by the collectors, see scheme_make_context. */
+struct Scheme_Context
+{
+  Scheme_Env *env;
+  jmp_buf error_buf;
+  Scheme_Pending_Call pending_call;
+  Scheme_Cont *live_conts;	/* see call_cc */
+  int capture_count;
+  Scheme_Value in_port, out_port;
+  Scheme_Value error_port;	/* where errors are written */
+  Scheme_Value task_errors;	/* the error port of pool tasks */
+  Scheme_Task *task;		/* run for the pool, see scheme_parallel.c */
+};
+
+extern SCHEME_THREAD_LOCAL Scheme_Context *scheme_context;
+
+#undef scheme_env
+#undef scheme_error_buf
+#define scheme_env           (scheme_context->env)
+#define scheme_error_buf     (scheme_context->error_buf)
+#define scheme_pending_call  (scheme_context->pending_call)
+#define scheme_capture_count (scheme_context->capture_count)
+
+/* A piece of work for the thread pool.  RUN is called in the
+   environment and with the ports of the context that submitted the
+   task, and DONE after it with its value, or with FAILED set and the
+   message of the error it signalled. */
+struct Scheme_Task
+{
+  Scheme_Value (*run) (Scheme_Task *task);
+  void (*done) (Scheme_Task *task, Scheme_Value val, int failed);
+  Scheme_Env *env;
+  Scheme_Value in_port, out_port;
+};
+
+/* the thread pool.  Without SCHEME_THREADS, or without a processor to
+   spare, a submitted task runs at once. */
+void scheme_pool_submit (Scheme_Task *task);
+void scheme_pool_wait (int *pending);
+void scheme_pool_finish (int *pending, int count);
+void scheme_run_task (Scheme_Task *task);
+
+/* a future is a task evaluating NODE in ENV, or applying PROC if
+   there is no NODE */
+typedef struct Scheme_Future
+{
+  Scheme_Task task;
+  Scheme_Node *node;
+  Scheme_Env *env;
+  Scheme_Value proc;
+  int pending;			/* until it has run */
+  int failed;
+  Scheme_Value val;		/* or the message of its error */
+} Scheme_Future;
+
+#define SCHEME_EVAL_NODE(node, env) ((node)->eval ((node), (env)))
+#define SCHEME_NODE_VAL(node)       ((node)->u.val)
+#define SCHEME_NODE_FRAME(node)     ((node)->u.frame)
+#define SCHEME_NODE_LAMBDA(node)    ((node)->u.lambda)
+#define SCHEME_NODE_DEPTH(node)     ((node)->u.addr.depth)
+#define SCHEME_NODE_INDEX(node)     ((node)->u.addr.index)
+#define SCHEME_NODE_CELL(node)      ((node)->u.cell)
+
 /* init functions */
 void scheme_init_char (Scheme_Env *env);
 void scheme_init_bool (Scheme_Env *env);
@@ -108,20 +279,123 @@ void scheme_init_eval (Scheme_Env *env);
 void scheme_init_promise (Scheme_Env *env);
 void scheme_init_struct (Scheme_Env *env);
 void scheme_init_pointer (Scheme_Env *env);
+void scheme_init_compile (Scheme_Env *env);
+void scheme_init_profile (Scheme_Env *env);
+void scheme_init_image (Scheme_Env *env);
+void scheme_init_table (Scheme_Env *env);
+void scheme_init_module (Scheme_Env *env);
+void scheme_init_context (Scheme_Env *env);
+void scheme_init_freeze (Scheme_Env *env);
+void scheme_init_parallel (Scheme_Env *env);
+void scheme_init_channel (Scheme_Env *env);
 
 /* environment */
+Scheme_Env *scheme_alloc_frame (void);
 Scheme_Env *scheme_new_frame (int num_bindings);
 void scheme_add_binding (int index, Scheme_Value sym, Scheme_Value val, Scheme_Env *frame);
 Scheme_Env *scheme_extend_env (Scheme_Env *frame, Scheme_Env *env);
 Scheme_Env *scheme_add_frame (Scheme_Value syms, Scheme_Value vals, Scheme_Env *env);
+Scheme_Env *scheme_stack_frame (Scheme_Env *frame, Scheme_Value *values, int num_bindings, Scheme_Value *symbols);
+Scheme_Env *scheme_heap_env (Scheme_Env *env);
+void scheme_sync_env (Scheme_Env *env, Scheme_Env *copy);
+Scheme_Prim_Desc *scheme_make_desc (char *name, int mina, int maxa);
+int scheme_lexical_address (Scheme_Value symbol, Scheme_Env *env, int *depth, int *index);
+void scheme_set_global (Scheme_Value symbol, Scheme_Value val, Scheme_Env *env);
+Scheme_Global_Cell *scheme_global_cell (Scheme_Value symbol, Scheme_Env *env);
+Scheme_Value scheme_base_value (Scheme_Global_Cell *cell);
 Scheme_Env *scheme_pop_frame (Scheme_Env *env);
 
+/* eval */
+Scheme_Node *scheme_analyze (Scheme_Value obj, Scheme_Env *env, int tail);
+Scheme_Node *scheme_analyze_seq (Scheme_Value forms, Scheme_Env *env, int tail);
+Scheme_Node *scheme_make_node (Scheme_Node_Proc *proc, Scheme_Value form, int num_nodes);
+Scheme_Node *scheme_make_const_node (Scheme_Value val);
+Scheme_Value scheme_eval_syntax (Scheme_Value syntax, Scheme_Value form, Scheme_Env *env);
+
+/* syntax */
+Scheme_Lambda *scheme_analyze_lambda (Scheme_Value code, Scheme_Env *env);
+void scheme_analyze_lambda_body (Scheme_Lambda *lambda, Scheme_Env *env);
+Scheme_Node *scheme_analyze_body (Scheme_Value forms, Scheme_Env *env, int tail);
+Scheme_Lambda *scheme_make_lambda (Scheme_Value code);
+Scheme_Env *scheme_lambda_frame (Scheme_Lambda *lambda);
+
+/* fun */
+Scheme_Value scheme_make_lambda_closure (Scheme_Env *env, Scheme_Lambda *lambda);
+Scheme_Env *scheme_bind_args (Scheme_Lambda *lambda, int num_rands, Scheme_Value *rands);
+Scheme_Env *scheme_fill_frame (Scheme_Lambda *lambda, Scheme_Env *frame, int num_rands, Scheme_Value *rands);
+Scheme_Value scheme_tail_apply (Scheme_Value rator, int num_rands, Scheme_Value *rands);
+int scheme_applyp (Scheme_Value rator);
+Scheme_Value scheme_unwrap_apply (Scheme_Value rator, int *num_rands, Scheme_Value *rands);
+extern Scheme_Value scheme_tail_call;
+
 /* hash */
 Scheme_Hash_Table *scheme_make_hash_table (int size);
+unsigned int scheme_hash_string (char *key);
+unsigned int scheme_hash_folded (const char *name, int len);
+void scheme_add_hashed (Scheme_Hash_Table *table, char *key, unsigned int hash, void *val);
+void *scheme_lookup_hashed (Scheme_Hash_Table *table, char *key, unsigned int hash);
+void *scheme_lookup_folded (Scheme_Hash_Table *table, const char *name, int len, unsigned int hash);
 void scheme_add_to_table (Scheme_Hash_Table *table, char *key, void *val);
 void scheme_change_in_table (Scheme_Hash_Table *table, char *key, void *new_val);
 void *scheme_lookup_in_table (Scheme_Hash_Table *table, char *key);
 
+/* futures, see scheme_promise.c */
+Scheme_Value scheme_make_future (Scheme_Node *node, Scheme_Env *env);
+Scheme_Value scheme_make_thunk_future (Scheme_Value thunk);
+
+/* frozen data */
+void scheme_freeze_table (Scheme_Value table);
+
+/* hash tables, for images: a table of the same kind as another, and
+   its entries from index I on */
+Scheme_Value scheme_make_table (int kind, int size);
+int scheme_table_kind (Scheme_Value table);
+int scheme_table_next (Scheme_Value table, int i, Scheme_Value *key, Scheme_Value *val);
+void scheme_table_put (Scheme_Value table, Scheme_Value key, Scheme_Value val);
+void scheme_image_analyze_lambda (Scheme_Lambda *lambda, Scheme_Env *env);
+
+/* allocation profiler: SCHEME_PROFILE counts an allocation of SIZE
+   bytes of the type with index INDEX, SCHEME_PROFILE_ENTER notes the
+   procedure now running and SCHEME_PROFILE_CURRENT is the last one
+   noted */
+#define SCHEME_PROFILE_FRAME (-1)
+#ifdef SCHEME_PROFILE_ALLOC
+extern Scheme_Lambda *scheme_profile_lambda;
+void scheme_profile_alloc (int index, size_t size);
+#define SCHEME_PROFILE(index, size) scheme_profile_alloc ((index), (size))
+#define SCHEME_PROFILE_ENTER(lambda) (scheme_profile_lambda = (lambda))
+#define SCHEME_PROFILE_CURRENT scheme_profile_lambda
+#else
+#define SCHEME_PROFILE(index, size) ((void) 0)
+#define SCHEME_PROFILE_ENTER(lambda) ((void) (lambda))
+#define SCHEME_PROFILE_CURRENT NULL
+#endif
+
+/* precise collector: kinds of allocation */
+#define SCHEME_GC_OBJECT  1	/* a Scheme_Object, scanned by type */
+#define SCHEME_GC_SCANNED 2	/* every word may be a pointer */
+#define SCHEME_GC_ATOMIC  3	/* no pointers */
+#define SCHEME_GC_TYPED   4	/* pointers where its layout says */
+#define SCHEME_GC_KEYS    5	/* see scheme_malloc_keys */
+#define SCHEME_GC_TYPED_KIND(index) (SCHEME_GC_TYPED | ((index) << 8))
+void *scheme_gc_malloc (size_t size, int kind);
+int scheme_gc_layout (uintptr_t bitmap);
+
+/* SCHEME_THREADS: a thread other than the first is made known to the
+   collector before it touches the heap */
+void scheme_gc_init_threads (void);
+void scheme_gc_register_thread (void);
+void scheme_gc_unregister_thread (void);
+
+/* The pointer map of a typed allocation: bit I is set if word I may
+   hold a pointer.  DESCR is the collector's own form of it. */
+struct Scheme_Layout
+{
+  size_t size;
+  uintptr_t bitmap;
+  uintptr_t descr;
+};
+
 #ifdef __cplusplus
 }
 #endif
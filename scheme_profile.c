@@ -0,0 +1,344 @@
+/*
+  libscheme
+  Copyright (c) 1994 Brent Benson
+  All rights reserved.
+
+  Permission is hereby granted, without written agreement and without
+  license or royalty fees, to use, copy, modify, and distribute this
+  software and its documentation for any purpose, provided that the
+  above copyright notice and the following two paragraphs appear in
+  all copies of this software.
+
+  IN NO EVENT SHALL BRENT BENSON BE LIABLE TO ANY PARTY FOR DIRECT,
+  INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES ARISING OUT
+  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF BRENT
+  BENSON HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+  BRENT BENSON SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT
+  NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER
+  IS ON AN "AS IS" BASIS, AND BRENT BENSON HAS NO OBLIGATION TO
+  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR
+  MODIFICATIONS.
+*/
+
+/* The allocation profiler, built in with SCHEME_PROFILE_ALLOC (make
+   PROFILE=alloc).  Every object is counted with its size under its
+   type, and every heap frame under `frame'.  One allocation in
+   SCHEME_PROFILE_SAMPLE is also charged to the procedure running at
+   the time, or to `toplevel' outside of any.  (allocation-stats)
+   returns the counts and they are written to stderr at exit. */
+
+#include "scheme_private.h"
+
+/* locals */
+static Scheme_Value allocation_stats (int argc, Scheme_Value argv[]);
+
+#ifdef SCHEME_PROFILE_ALLOC
+
+#include <limits.h>
+#include <string.h>
+
+typedef struct Tally
+{
+  long count, bytes;
+} Tally;
+
+typedef struct Site
+{
+  Tally tally;
+  Scheme_Lambda *lambda;
+} Site;
+
+/* a type's tally, for sorting */
+typedef struct Type_Tally
+{
+  Tally tally;
+  int index;
+} Type_Tally;
+
+/* globals */
+Scheme_Lambda *scheme_profile_lambda;
+
+/* locals */
+static Tally *types;
+static int num_types;
+static Tally frames;
+/* The sites live in the data segment so that the collectors see the
+   lambdas in them and keep them alive and in place. */
+static Site sites[SCHEME_PROFILE_SITES];
+static Tally toplevel, other;
+static int countdown = SCHEME_PROFILE_SAMPLE;
+
+static void sample (size_t size);
+static Scheme_Value make_count (long n);
+static Scheme_Value tally_entry (Scheme_Value name, Tally *tally);
+static Scheme_Value lambda_name (Scheme_Lambda *lambda);
+static void dump (void);
+static void dump_line (Scheme_Value name, Tally *tally);
+static int by_bytes (const void *a, const void *b);
+
+#endif /* SCHEME_PROFILE_ALLOC */
+
+static const Scheme_Prim_Entry profile_prims[] =
+{
+  SCHEME_PRIM_ENTRY ("allocation-stats", allocation_stats, 0, -1)
+};
+
+void
+scheme_init_profile (Scheme_Env *env)
+{
+  scheme_add_prims (profile_prims, SCHEME_NUM_ENTRIES (profile_prims), env);
+#ifdef SCHEME_PROFILE_ALLOC
+  atexit (dump);
+#endif
+}
+
+#ifdef SCHEME_PROFILE_ALLOC
+
+/* Count an allocation of SIZE bytes of the type with index INDEX, or
+   of a frame if INDEX is SCHEME_PROFILE_FRAME. */
+void
+scheme_profile_alloc (int index, size_t size)
+{
+  Tally *tally;
+
+  if (index == SCHEME_PROFILE_FRAME)
+    {
+      tally = &frames;
+    }
+  else
+    {
+      if (index >= num_types)
+	{
+	  int n = scheme_num_types > index ? scheme_num_types : index + 1;
+
+	  types = (Tally *) realloc (types, n * sizeof (Tally));
+	  SCHEME_ASSERT ((types != NULL), "memory allocation failure");
+	  memset (types + num_types, 0, (n - num_types) * sizeof (Tally));
+	  num_types = n;
+	}
+      tally = &types[index];
+    }
+  tally->count++;
+  tally->bytes += size;
+  if (--countdown == 0)
+    {
+      countdown = SCHEME_PROFILE_SAMPLE;
+      sample (size);
+    }
+}
+
+#endif /* SCHEME_PROFILE_ALLOC */
+
+/* locals */
+
+/* (allocation-stats) returns ((types (TYPE COUNT BYTES) ...)
+   (procedures (NAME SAMPLES BYTES) ...)), the procedures being
+   sampled one allocation in SCHEME_PROFILE_SAMPLE. */
+static Scheme_Value
+allocation_stats (int argc, Scheme_Value argv[])
+{
+#ifdef SCHEME_PROFILE_ALLOC
+  Scheme_Value by_type, by_site;
+  Tally snapshot;
+  int i;
+
+  SCHEME_ASSERT ((argc == 0), "allocation-stats: wrong number of args");
+  /* building the lists allocates too, so each tally is copied
+     before its entry is made */
+  snapshot = frames;
+  by_type = scheme_make_pair (tally_entry (scheme_intern_symbol ("frame"), &snapshot),
+			      scheme_null);
+  for ( i=num_types-1 ; i>=0 ; --i )
+    {
+      if (types[i].count && scheme_type_table[i])
+	{
+	  snapshot = types[i];
+	  by_type = scheme_make_pair (tally_entry (scheme_type_table[i], &snapshot), by_type);
+	}
+    }
+  by_site = scheme_null;
+  for ( i=SCHEME_PROFILE_SITES-1 ; i>=0 ; --i )
+    {
+      if (sites[i].lambda)
+	{
+	  snapshot = sites[i].tally;
+	  by_site = scheme_make_pair (tally_entry (lambda_name (sites[i].lambda), &snapshot),
+				      by_site);
+	}
+    }
+  if (other.count)
+    {
+      snapshot = other;
+      by_site = scheme_make_pair (tally_entry (scheme_intern_symbol ("other"), &snapshot),
+				  by_site);
+    }
+  snapshot = toplevel;
+  by_site = scheme_make_pair (tally_entry (scheme_intern_symbol ("toplevel"), &snapshot),
+			      by_site);
+  return (scheme_make_pair (scheme_make_pair (scheme_intern_symbol ("types"), by_type),
+			    scheme_make_pair (scheme_make_pair (scheme_intern_symbol ("procedures"),
+								by_site),
+					      scheme_null)));
+#else
+  scheme_signal_error ("allocation-stats: built without SCHEME_PROFILE_ALLOC");
+  return (scheme_false);
+#endif
+}
+
+#ifdef SCHEME_PROFILE_ALLOC
+
+/* charge an allocation to the running procedure */
+static void
+sample (size_t size)
+{
+  Scheme_Lambda *lambda = scheme_profile_lambda;
+  Tally *tally;
+  unsigned long h;
+  int i;
+
+  if (! lambda)
+    {
+      tally = &toplevel;
+    }
+  else
+    {
+      tally = &other;
+      h = ((uintptr_t) lambda >> 4) % SCHEME_PROFILE_SITES;
+      for ( i=0 ; i<SCHEME_PROFILE_SITES ; ++i )
+	{
+	  Site *site = &sites[(h + i) % SCHEME_PROFILE_SITES];
+
+	  if (site->lambda == lambda || ! site->lambda)
+	    {
+	      site->lambda = lambda;
+	      tally = &site->tally;
+	      break;
+	    }
+	}
+    }
+  tally->count++;
+  tally->bytes += size;
+}
+
+static Scheme_Value
+make_count (long n)
+{
+  if (n <= INT_MAX)
+    {
+      return (scheme_make_integer ((int) n));
+    }
+  return (scheme_make_double ((double) n));
+}
+
+static Scheme_Value
+tally_entry (Scheme_Value name, Tally *tally)
+{
+  return (scheme_make_pair (name,
+			    scheme_make_pair (make_count (tally->count),
+					      scheme_make_pair (make_count (tally->bytes),
+								scheme_null))));
+}
+
+/* the global a closure of LAMBDA is bound to, or (lambda PARAMS) */
+static Scheme_Value
+lambda_name (Scheme_Lambda *lambda)
+{
+  Scheme_Hash_Table *globals;
+  int i;
+
+  globals = scheme_env->globals;
+  for ( i=0 ; i<globals->size ; ++i )
+    {
+      Scheme_Global_Cell *cell = (Scheme_Global_Cell *) globals->entries[i].val;
+
+      if (cell && cell->val && SCHEME_CLOSUREP (cell->val)
+	  && SCHEME_CLOS_LAMBDA (cell->val) == lambda)
+	{
+	  return (scheme_intern_symbol (cell->name));
+	}
+    }
+  return (scheme_make_pair (scheme_intern_symbol ("lambda"),
+			    scheme_make_pair (lambda->params, scheme_null)));
+}
+
+/* write the tallies to stderr, largest first */
+static void
+dump (void)
+{
+  Type_Tally *by_type;
+  Site *by_site;
+  int i, n;
+
+  by_type = (Type_Tally *) malloc ((num_types + 1) * sizeof (Type_Tally));
+  by_site = (Site *) malloc (SCHEME_PROFILE_SITES * sizeof (Site));
+  if (! by_type || ! by_site)
+    {
+      return;
+    }
+  fprintf (stderr, "\n; allocation profile\n;  %-30s %12s %14s\n", "type", "count", "bytes");
+  for ( i=n=0 ; i<num_types ; ++i )
+    {
+      if (types[i].count && scheme_type_table[i])
+	{
+	  by_type[n].tally = types[i];
+	  by_type[n++].index = i;
+	}
+    }
+  qsort (by_type, n, sizeof (Type_Tally), by_bytes);
+  for ( i=0 ; i<n ; ++i )
+    {
+      dump_line (scheme_type_table[by_type[i].index], &by_type[i].tally);
+    }
+  dump_line (scheme_intern_symbol ("frame"), &frames);
+
+  fprintf (stderr, ";\n;  %-30s %12s %14s  (1 in %d)\n", "procedure", "samples", "bytes",
+	   SCHEME_PROFILE_SAMPLE);
+  for ( i=n=0 ; i<SCHEME_PROFILE_SITES ; ++i )
+    {
+      if (sites[i].lambda)
+	{
+	  by_site[n++] = sites[i];
+	}
+    }
+  qsort (by_site, n, sizeof (Site), by_bytes);
+  dump_line (scheme_intern_symbol ("toplevel"), &toplevel);
+  for ( i=0 ; i<n ; ++i )
+    {
+      dump_line (lambda_name (by_site[i].lambda), &by_site[i].tally);
+    }
+  if (other.count)
+    {
+      dump_line (scheme_intern_symbol ("other"), &other);
+    }
+  free (by_type);
+  free (by_site);
+}
+
+static void
+dump_line (Scheme_Value name, Tally *tally)
+{
+  if (SCHEME_SYMBOLP (name) || SCHEME_TYPE (name) == scheme_type_type)
+    {
+      fprintf (stderr, ";  %-30s", SCHEME_STR_VAL (name));
+    }
+  else
+    {
+      fprintf (stderr, ";  ");
+      scheme_write (name, scheme_stderr_port);
+      fflush (stderr);
+    }
+  fprintf (stderr, " %12ld %14ld\n", tally->count, tally->bytes);
+}
+
+/* for qsort, on structures that start with a Tally */
+static int
+by_bytes (const void *a, const void *b)
+{
+  long x = ((const Tally *) a)->bytes, y = ((const Tally *) b)->bytes;
+
+  return ((x < y) - (x > y));
+}
+
+#endif /* SCHEME_PROFILE_ALLOC */
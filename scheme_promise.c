@@ -22,28 +22,40 @@
   MODIFICATIONS.
 */
 
-#include "scheme.h"
+/* Promises, from `delay', are evaluated when first forced.  Futures,
+   from `future', start evaluating at once on the thread pool of
+   scheme_parallel.c, and touching or forcing one waits for its value.
+   An error in a future is kept with its message and signalled again
+   by each touch. */
 
-struct Scheme_Promise
-{
-  int forced;
-  Scheme_Value val;
-  Scheme_Env *env;
-};
-typedef struct Scheme_Promise Scheme_Promise;
+#include "scheme_private.h"
 
 /* globals */
 Scheme_Value scheme_promise_type;
+Scheme_Value scheme_future_type;
 
 /* locals */
 static Scheme_Value force (int argc, Scheme_Value argv[]);
+static Scheme_Value touch (Scheme_Value obj);
+static Scheme_Value future_p (Scheme_Value obj);
+static Scheme_Value future_run (Scheme_Task *task);
+static void future_done (Scheme_Task *task, Scheme_Value val, int failed);
+
+static const Scheme_Prim_Entry promise_prims[] =
+{
+  SCHEME_PRIM_ENTRY ("force", force, 0, -1),
+  SCHEME_PRIM1_ENTRY ("touch", touch),
+  SCHEME_PRIM1_ENTRY ("future?", future_p)
+};
 
 void
 scheme_init_promise (Scheme_Env *env)
 {
-  scheme_promise_type = scheme_make_type ("<promise>");
+  scheme_promise_type = scheme_make_builtin_type ("<promise>", SCHEME_PROMISE_TYPE_INDEX);
   scheme_add_global ("<promise>", scheme_promise_type, env);
-  scheme_add_prim ("force", force, env);
+  scheme_future_type = scheme_make_builtin_type ("<future>", SCHEME_FUTURE_TYPE_INDEX);
+  scheme_add_global ("<future>", scheme_future_type, env);
+  scheme_add_prims (promise_prims, SCHEME_NUM_ENTRIES (promise_prims), env);
 }
 
 Scheme_Value
@@ -60,12 +72,60 @@ scheme_make_promise (Scheme_Value expr, Scheme_Env *env)
   return (obj);
 }
 
+/* Start evaluating NODE in ENV on the pool. */
+Scheme_Value
+scheme_make_future (Scheme_Node *node, Scheme_Env *env)
+{
+  Scheme_Value obj;
+  Scheme_Future *future;
+
+  obj = scheme_alloc_object (scheme_future_type, sizeof(Scheme_Future));
+  future = (Scheme_Future *) SCHEME_PTR_VAL (obj);
+  future->task.run = future_run;
+  future->task.done = future_done;
+  future->node = node;
+  future->env = env;
+  future->proc = scheme_null;
+  future->pending = 1;
+  future->failed = 0;
+  future->val = scheme_null;
+  scheme_pool_submit (&future->task);
+  return (obj);
+}
+
+/* A future applying THUNK, which the caller runs with
+   scheme_run_task, see spawn in scheme_channel.c. */
+Scheme_Value
+scheme_make_thunk_future (Scheme_Value thunk)
+{
+  Scheme_Value obj;
+  Scheme_Future *future;
+
+  obj = scheme_alloc_object (scheme_future_type, sizeof(Scheme_Future));
+  future = (Scheme_Future *) SCHEME_PTR_VAL (obj);
+  future->task.run = future_run;
+  future->task.done = future_done;
+  future->node = NULL;
+  future->env = NULL;
+  future->proc = thunk;
+  future->pending = 1;
+  future->failed = 0;
+  future->val = scheme_null;
+  return (obj);
+}
+
+/* locals */
+
 static Scheme_Value
 force (int argc, Scheme_Value argv[])
 {
   Scheme_Promise *promise;
 
   SCHEME_ASSERT ((argc == 1), "force: wrong number of args");
+  if (SCHEME_FUTUREP (argv[0]))
+    {
+      return (touch (argv[0]));
+    }
   SCHEME_ASSERT (SCHEME_PROMP(argv[0]), "force: arg must be a promise");
   promise = (Scheme_Promise *) SCHEME_PTR_VAL (argv[0]);
   if (promise->forced)
@@ -75,6 +135,57 @@ force (int argc, Scheme_Value argv[])
   else
     {
       promise->val = scheme_eval (promise->val, promise->env);
+      SCHEME_GC_WRITE (&promise->val);
+      promise->forced = 1;
       return (promise->val);
     }
 }
+
+/* The value of a future, once it has one, and anything else as it
+   is. */
+static Scheme_Value
+touch (Scheme_Value obj)
+{
+  Scheme_Future *future;
+
+  if (! SCHEME_FUTUREP (obj))
+    {
+      return (obj);
+    }
+  future = (Scheme_Future *) SCHEME_PTR_VAL (obj);
+  scheme_pool_wait (&future->pending);
+  if (future->failed)
+    {
+      scheme_signal_error ("touch: error in future: %s", SCHEME_STR_VAL (future->val));
+    }
+  return (future->val);
+}
+
+static Scheme_Value
+future_p (Scheme_Value obj)
+{
+  return (SCHEME_FUTUREP (obj) ? scheme_true : scheme_false);
+}
+
+static Scheme_Value
+future_run (Scheme_Task *task)
+{
+  Scheme_Future *future = (Scheme_Future *) task;
+
+  if (! future->node)
+    {
+      return (scheme_apply (future->proc, 0, NULL));
+    }
+  return (SCHEME_EVAL_NODE (future->node, future->env));
+}
+
+static void
+future_done (Scheme_Task *task, Scheme_Value val, int failed)
+{
+  Scheme_Future *future = (Scheme_Future *) task;
+
+  future->val = val;
+  SCHEME_GC_WRITE (&future->val);
+  future->failed = failed;
+  scheme_pool_finish (&future->pending, 1);
+}
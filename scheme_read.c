@@ -408,8 +408,7 @@ read_symbol (Scheme_Value port)
     {
       scheme_ungetc (ch, port);
     }
-  buf[i] = '\0';
-  return (scheme_intern_symbol ((char *)&buf));
+  return (scheme_intern_symbol_n (buf, i));
 }
 
 /* "#\" has been read */
@@ -55,33 +55,38 @@ static Scheme_Value string_fill (int argc, Scheme_Value argv[]);
 
 static int strcmp_ci (char *str1, char *str2);
 
+static const Scheme_Prim_Entry string_prims[] =
+{
+  SCHEME_PRIM_ENTRY ("string?", string_p, 0, -1),
+  SCHEME_PRIM_ENTRY ("make-string", make_string, 0, -1),
+  SCHEME_PRIM_ENTRY ("string", string, 0, -1),
+  SCHEME_PRIM_ENTRY ("string-length", string_length, 0, -1),
+  SCHEME_PRIM_ENTRY ("string-ref", string_ref, 0, -1),
+  SCHEME_PRIM_ENTRY ("string-set!", string_set, 0, -1),
+  SCHEME_PRIM_ENTRY ("string=?", string_eq, 0, -1),
+  SCHEME_PRIM_ENTRY ("string-ci=?", string_ci_eq, 0, -1),
+  SCHEME_PRIM_ENTRY ("string<?", string_lt, 0, -1),
+  SCHEME_PRIM_ENTRY ("string>?", string_gt, 0, -1),
+  SCHEME_PRIM_ENTRY ("string<=?", string_lt_eq, 0, -1),
+  SCHEME_PRIM_ENTRY ("string>=?", string_gt_eq, 0, -1),
+  SCHEME_PRIM_ENTRY ("string-ci<?", string_ci_lt, 0, -1),
+  SCHEME_PRIM_ENTRY ("string-ci>?", string_ci_gt, 0, -1),
+  SCHEME_PRIM_ENTRY ("string-ci<=?", string_ci_lt_eq, 0, -1),
+  SCHEME_PRIM_ENTRY ("string-ci>=?", string_ci_gt_eq, 0, -1),
+  SCHEME_PRIM_ENTRY ("substring", substring, 0, -1),
+  SCHEME_PRIM_ENTRY ("string-append", string_append, 0, -1),
+  SCHEME_PRIM_ENTRY ("string->list", string_to_list, 0, -1),
+  SCHEME_PRIM_ENTRY ("list->string", list_to_string, 0, -1),
+  SCHEME_PRIM_ENTRY ("string-copy", string_copy, 0, -1),
+  SCHEME_PRIM_ENTRY ("string-fill!", string_fill, 0, -1)
+};
+
 void
 scheme_init_string (Scheme_Env *env)
 {
-  scheme_string_type = scheme_make_type ("<string>");
+  scheme_string_type = scheme_make_builtin_type ("<string>", SCHEME_STRING_TYPE_INDEX);
   scheme_add_global ("<string>", scheme_string_type, env);
-  scheme_add_prim ("string?", string_p, env);
-  scheme_add_prim ("make-string", make_string, env);
-  scheme_add_prim ("string", string, env);
-  scheme_add_prim ("string-length", string_length, env);
-  scheme_add_prim ("string-ref", string_ref, env);
-  scheme_add_prim ("string-set!", string_set, env);
-  scheme_add_prim ("string=?", string_eq, env);
-  scheme_add_prim ("string-ci=?", string_ci_eq, env);
-  scheme_add_prim ("string<?", string_lt, env);
-  scheme_add_prim ("string>?", string_gt, env);
-  scheme_add_prim ("string<=?", string_lt_eq, env);
-  scheme_add_prim ("string>=?", string_gt_eq, env);
-  scheme_add_prim ("string-ci<?", string_ci_lt, env);
-  scheme_add_prim ("string-ci>?", string_ci_gt, env);
-  scheme_add_prim ("string-ci<=?", string_ci_lt_eq, env);
-  scheme_add_prim ("string-ci>=?", string_ci_gt_eq, env);
-  scheme_add_prim ("substring", substring, env);
-  scheme_add_prim ("string-append", string_append, env);
-  scheme_add_prim ("string->list", string_to_list, env);
-  scheme_add_prim ("list->string", list_to_string, env);
-  scheme_add_prim ("string-copy", string_copy, env);
-  scheme_add_prim ("string-fill!", string_fill, env);
+  scheme_add_prims (string_prims, SCHEME_NUM_ENTRIES (string_prims), env);
 }
 
 Scheme_Value
@@ -91,7 +96,7 @@ scheme_make_string (const char *chars)
   size_t len = strlen(chars);
   char *new;
 
-  str = scheme_alloc_object (scheme_string_type, len + 1);
+  str = scheme_alloc_atomic_object (scheme_string_type, len + 1);
   new = SCHEME_PTR_VAL(str);
   if(len > 0) {
     memcpy(new, chars, len);
@@ -105,15 +110,9 @@ Scheme_Value
 scheme_alloc_string (int size, char fill)
 {
   int i;
-  size_t nbytes = sizeof(Scheme_Object) + (size + 1) * sizeof(char);
   Scheme_Value str;
-  char *val;
-
-  str = scheme_malloc (nbytes);
-  val = (char*)(&str[1]);
 
-  SCHEME_TYPE (str) = scheme_string_type;
-  SCHEME_STR_VAL (str) = val;
+  str = scheme_alloc_atomic_object (scheme_string_type, (size + 1) * sizeof(char));
   for ( i=0 ; i<size ; ++i )
     {
       SCHEME_STR_VAL(str)[i] = fill;
@@ -204,6 +203,7 @@ string_set (int argc, Scheme_Value argv[])
 
   SCHEME_ASSERT ((argc == 3), "string-set!: wrong number of args");
   SCHEME_ASSERT (SCHEME_STRINGP(argv[0]), "string-set!: first arg must be a string");
+  SCHEME_ASSERT (! SCHEME_FROZENP (argv[0]), "string-set!: string is frozen");
   SCHEME_ASSERT (SCHEME_INTP(argv[1]), "string-set!: second arg must be an integer");
   SCHEME_ASSERT (SCHEME_CHARP(argv[2]), "string-set!: third arg must be a character");
   str = SCHEME_STR_VAL(argv[0]);
@@ -379,6 +379,7 @@ string_fill (int argc, Scheme_Value argv[])
 
   SCHEME_ASSERT ((argc == 2), "string-fill!: wrong number of args");
   SCHEME_ASSERT (SCHEME_STRINGP (argv[0]), "string-fill!: first arg must be a string");
+  SCHEME_ASSERT (! SCHEME_FROZENP (argv[0]), "string-fill!: string is frozen");
   SCHEME_ASSERT (SCHEME_CHARP (argv[1]), "string-fill!: second arg must be a character");
   chars = SCHEME_STR_VAL (argv[0]);
   ch = SCHEME_CHAR_VAL (argv[1]);
@@ -22,17 +22,9 @@
   MODIFICATIONS.
 */
 
-#include "scheme.h"
+#include "scheme_private.h"
 #include <string.h>
 
-struct Scheme_Struct_Proc
-{
-  Scheme_Value struct_type;
-  enum {SCHEME_CONSTR, SCHEME_PRED, SCHEME_GETTER, SCHEME_SETTER} proc_type;
-  int slot_num;
-};
-typedef struct Scheme_Struct_Proc Scheme_Struct_Proc;
-
 /* globals */
 Scheme_Value scheme_struct_proc_type;
 
@@ -53,7 +45,7 @@ static char *setter_name (char *struct_name, char *field_name);
 void
 scheme_init_struct (Scheme_Env *env)
 {
-  scheme_struct_proc_type = scheme_make_type ("<struct-procedure>");
+  scheme_struct_proc_type = scheme_make_builtin_type ("<struct-procedure>", SCHEME_STRUCT_PROC_TYPE_INDEX);
   scheme_add_global ("define-struct", scheme_make_syntax (define_struct_syntax), env);
 }
 
@@ -105,7 +97,10 @@ scheme_apply_struct_proc (Scheme_Value sp, Scheme_Value args)
 
 	inst = SCHEME_CAR (args);
 	SCHEME_ASSERT ((SCHEME_TYPE (inst)==proc->struct_type), "wrong type to getter function");
-	return (SCHEME_VEC_ELS(inst)[proc->slot_num] = SCHEME_CAR (SCHEME_CDR (args)));
+	SCHEME_ASSERT (! SCHEME_FROZENP (inst), "struct setter: instance is frozen");
+	SCHEME_VEC_ELS(inst)[proc->slot_num] = SCHEME_CAR (SCHEME_CDR (args));
+	SCHEME_GC_WRITE (&SCHEME_VEC_ELS(inst)[proc->slot_num]);
+	return (SCHEME_VEC_ELS(inst)[proc->slot_num]);
       }
     default:
       SCHEME_ASSERT ((0), "unknown struct procedure type");
@@ -129,6 +124,7 @@ define_struct_syntax (Scheme_Value form, Scheme_Env *env)
 
   struct_type_name = type_name (struct_name);
   type_obj = scheme_make_type (struct_type_name);
+  type_obj->header |= SCHEME_STRUCT_TYPE_FLAG;
   scheme_add_global (struct_type_name, type_obj, env);
 
   scheme_add_global (constructor_name (struct_name),
@@ -154,8 +150,8 @@ scheme_make_instance (Scheme_Value type, int num_fields)
   Scheme_Value inst;
   Scheme_Value *els;
 
-  inst = scheme_alloc_object (type, num_fields * sizeof(Scheme_Object*));
-  els = (Scheme_Value *) SCHEME_PTR_VAL(inst);
+  inst = scheme_alloc_sized (type, SCHEME_OBJ_SIZE (vector_val) + num_fields * sizeof(Scheme_Object*));
+  els = (Scheme_Value *) SCHEME_OBJ_PAYLOAD (inst, vector_val);
   SCHEME_VEC_SIZE (inst) = num_fields;
   SCHEME_VEC_ELS (inst) = els;
   return (inst);
@@ -207,7 +203,7 @@ type_name (char *struct_name)
 
   orig_len = strlen (struct_name);
   add_len = 2;			/* strlen("<") + strlen(">") */
-  name = (char *) scheme_malloc (sizeof(char) * (orig_len + add_len + 1));
+  name = (char *) scheme_malloc_atomic (sizeof(char) * (orig_len + add_len + 1));
   name[0] = '<';
   name[1] = '\0';
   strcat (name, struct_name);
@@ -224,7 +220,7 @@ constructor_name (char *struct_name)
 
   orig_len = strlen (struct_name);
   make_len = 5;			/* strlen ("make-") */
-  name = (char *) scheme_malloc (sizeof (char) * (orig_len + make_len + 1));
+  name = (char *) scheme_malloc_atomic (sizeof (char) * (orig_len + make_len + 1));
   strcpy (name, "make-");
   strcat (name, struct_name);
   return (name);
@@ -237,7 +233,7 @@ pred_name (char *struct_name)
   char *name;
 
   orig_len = strlen (struct_name);
-  name = (char *) scheme_malloc (sizeof(char) * (orig_len + 1 + 1));
+  name = (char *) scheme_malloc_atomic (sizeof(char) * (orig_len + 1 + 1));
   strcpy (name, struct_name);
   name[orig_len] = '?';
   name[orig_len+1] = '\0';
@@ -253,7 +249,7 @@ getter_name (char *struct_name, char *field_name)
   name_len = strlen (struct_name);
   field_len = strlen (field_name);
   dash_len = 1;			/* strlen ("-") */
-  name = (char *) scheme_malloc (sizeof (char) * (name_len + dash_len + field_len + 1));
+  name = (char *) scheme_malloc_atomic (sizeof (char) * (name_len + dash_len + field_len + 1));
   strcpy (name, struct_name);
   strcat (name, "-");
   strcat (name, field_name);
@@ -272,7 +268,7 @@ setter_name (char *struct_name, char *field_name)
   dash_len = 1;			/* strlen ("-") */
   bang_len = 1;			/* strlen ("!") */
   name = (char *)
-    scheme_malloc (sizeof (char)*(set_len + name_len + dash_len + field_len + bang_len + 1));
+    scheme_malloc_atomic (sizeof (char)*(set_len + name_len + dash_len + field_len + bang_len + 1));
   strcpy (name, "set-");
   strcat (name, struct_name);
   strcat (name, "-");
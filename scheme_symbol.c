@@ -35,6 +35,25 @@ Scheme_Value scheme_unquote_splicing_symbol;
 
 /* locals */
 static Scheme_Hash_Table *symbol_table;
+SCHEME_DEFINE_LOCK (symbol_lock);
+
+/* symbols the reader and the evaluator look for, in static storage
+   and entered in the symbol table as they are; their hashes are
+   filled in by scheme_init_symbol */
+#define STATIC_SYMBOL(name) \
+  { SCHEME_STATIC_HEADER (SCHEME_SYMBOL_TYPE_INDEX), \
+    { .symbol_val = { name, sizeof (name) - 1, 0 } } }
+static Scheme_Object static_symbols[] =
+{
+  STATIC_SYMBOL ("quote"),
+  STATIC_SYMBOL ("quasiquote"),
+  STATIC_SYMBOL ("unquote"),
+  STATIC_SYMBOL ("unquote-splicing"),
+  STATIC_SYMBOL ("define"),
+  STATIC_SYMBOL ("lambda"),
+  STATIC_SYMBOL ("else"),
+  STATIC_SYMBOL ("=>")
+};
 
 /* primitive declarations */
 static Scheme_Value symbol_p_prim (int argc, Scheme_Value argv[]);
@@ -42,43 +61,63 @@ static Scheme_Value string_to_symbol_prim (int argc, Scheme_Value argv[]);
 static Scheme_Value symbol_to_string_prim (int argc, Scheme_Value argv[]);
 
 /* internal declarations */
-static Scheme_Value make_symbol (char *name);
-static char *downcase (char *str);
+static Scheme_Value make_symbol (const char *name, int len, int fold);
+
+static const Scheme_Prim_Entry symbol_prims[] =
+{
+  SCHEME_PRIM_ENTRY ("symbol?", symbol_p_prim, 0, -1),
+  SCHEME_PRIM_ENTRY ("string->symbol", string_to_symbol_prim, 0, -1),
+  SCHEME_PRIM_ENTRY ("symbol->string", symbol_to_string_prim, 0, -1)
+};
 
 /* exported functions */
 
 void
 scheme_init_symbol (Scheme_Env *env)
 {
-  scheme_symbol_type = scheme_make_type ("<symbol>");
+  int i;
+
+  scheme_symbol_type = scheme_make_builtin_type ("<symbol>", SCHEME_SYMBOL_TYPE_INDEX);
   scheme_add_global ("<symbol>", scheme_symbol_type, env);
-  symbol_table = scheme_make_hash_table (SCHEME_SYMBOL_BUCKETS);
-  scheme_quote_symbol = scheme_intern_symbol ("quote");
-  scheme_quasiquote_symbol = scheme_intern_symbol ("quasiquote");
-  scheme_unquote_symbol = scheme_intern_symbol ("unquote");
-  scheme_unquote_splicing_symbol = scheme_intern_symbol ("unquote-splicing");
-  scheme_add_prim ("symbol?", symbol_p_prim, env);
-  scheme_add_prim ("string->symbol", string_to_symbol_prim, env);
-  scheme_add_prim ("symbol->string", symbol_to_string_prim, env);
+  symbol_table = scheme_make_hash_table (SCHEME_SYMBOL_TABLE_SIZE);
+  for ( i=0 ; i<SCHEME_NUM_ENTRIES (static_symbols) ; ++i )
+    {
+      Scheme_Value sym = &static_symbols[i];
+
+      SCHEME_SYM_HASH (sym) = scheme_hash_string (SCHEME_STR_VAL (sym));
+      scheme_add_hashed (symbol_table, SCHEME_STR_VAL (sym), SCHEME_SYM_HASH (sym), sym);
+    }
+  scheme_quote_symbol = &static_symbols[0];
+  scheme_quasiquote_symbol = &static_symbols[1];
+  scheme_unquote_symbol = &static_symbols[2];
+  scheme_unquote_splicing_symbol = &static_symbols[3];
+  scheme_add_prims (symbol_prims, SCHEME_NUM_ENTRIES (symbol_prims), env);
 }
 
 Scheme_Value
 scheme_intern_symbol (char *name)
+{
+  return (scheme_intern_symbol_n (name, strlen (name)));
+}
+
+/* Intern the LEN characters at NAME, in lower case.  NAME need not
+   be terminated, and nothing is allocated if the symbol exists. */
+Scheme_Value
+scheme_intern_symbol_n (const char *name, int len)
 {
   Scheme_Value sym;
+  unsigned int hash;
 
-  name = downcase (name);
-  sym = (Scheme_Value)scheme_lookup_in_table (symbol_table, name);
-  if (sym)
-    {
-      return (sym);
-    }
-  else
+  hash = scheme_hash_folded (name, len);
+  SCHEME_LOCK (symbol_lock);
+  sym = (Scheme_Value) scheme_lookup_folded (symbol_table, name, len, hash);
+  if (! sym)
     {
-      sym = make_symbol (name);
-      scheme_add_to_table (symbol_table, name, sym);
-      return (sym);
+      sym = make_symbol (name, len, 1);
+      scheme_add_hashed (symbol_table, SCHEME_STR_VAL (sym), hash, sym);
     }
+  SCHEME_UNLOCK (symbol_lock);
+  return (sym);
 }
 
 /* primitive functions */
@@ -95,7 +134,7 @@ string_to_symbol_prim (int argc, Scheme_Value argv[])
 {
   SCHEME_ASSERT ((argc == 1), "string->symbol: wrong number of args");
   SCHEME_ASSERT (SCHEME_STRINGP(argv[0]), "string->symbol: arg must be string");
-  return (make_symbol (SCHEME_STR_VAL(argv[0])));
+  return (make_symbol (SCHEME_STR_VAL(argv[0]), strlen (SCHEME_STR_VAL(argv[0])), 0));
 }
 
 static Scheme_Value
@@ -108,35 +147,24 @@ symbol_to_string_prim (int argc, Scheme_Value argv[])
 
 /* internal functions */
 
+/* a symbol named by the LEN characters at NAME, in lower case if
+   FOLD is set */
 static Scheme_Value
-make_symbol (char *name)
+make_symbol (const char *name, int len, int fold)
 {
   Scheme_Value sym;
-  size_t len = strlen(name);
-  char *new;
-
-  sym = scheme_alloc_object (scheme_symbol_type, len + 1);
-  new = SCHEME_PTR_VAL(sym);
-  if(len > 0) {
-    memcpy(new, name, len);
-  }
-  new[len] = 0;
-  SCHEME_STR_VAL(sym) = new;
-  return (sym);
-}
-
-static char *
-downcase (char *str)
-{
   char *new;
   int i;
 
-  i = 0;
-  new = scheme_strdup (str);
-  while (new[i])
+  sym = scheme_alloc_atomic_sized (scheme_symbol_type, SCHEME_OBJ_SIZE (symbol_val) + len + 1);
+  new = SCHEME_OBJ_PAYLOAD (sym, symbol_val);
+  for ( i=0 ; i<len ; ++i )
     {
-      new[i] = tolower (new[i]);
-      i++;
+      new[i] = fold ? tolower ((unsigned char) name[i]) : name[i];
     }
-  return (new);
+  new[len] = 0;
+  SCHEME_STR_VAL(sym) = new;
+  SCHEME_SYM_LEN(sym) = len;
+  SCHEME_SYM_HASH(sym) = scheme_hash_string (new);
+  return (sym);
 }
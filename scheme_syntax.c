@@ -29,24 +29,55 @@ Scheme_Value scheme_syntax_type;
 Scheme_Value scheme_macro_type;
 
 /* locals */
-static Scheme_Value lambda_syntax (Scheme_Value form, Scheme_Env *env);
-static Scheme_Value define_syntax (Scheme_Value form, Scheme_Env *env);
-static Scheme_Value quote_syntax (Scheme_Value form, Scheme_Env *env);
-static Scheme_Value if_syntax (Scheme_Value form, Scheme_Env *env);
-static Scheme_Value set_syntax (Scheme_Value form, Scheme_Env *env);
-static Scheme_Value cond_syntax (Scheme_Value form, Scheme_Env *env);
-static Scheme_Value case_syntax (Scheme_Value form, Scheme_Env *env);
-static Scheme_Value and_syntax (Scheme_Value form, Scheme_Env *env);
-static Scheme_Value or_syntax (Scheme_Value form, Scheme_Env *env);
-static Scheme_Value let_syntax (Scheme_Value form, Scheme_Env *env);
-static Scheme_Value let_star_syntax (Scheme_Value form, Scheme_Env *env);
-static Scheme_Value letrec_syntax (Scheme_Value form, Scheme_Env *env);
-static Scheme_Value begin_syntax (Scheme_Value form, Scheme_Env *env);
-static Scheme_Value do_syntax (Scheme_Value form, Scheme_Env *env);
-static Scheme_Value delay_syntax (Scheme_Value form, Scheme_Env *env);
-static Scheme_Value quasiquote_syntax (Scheme_Value form, Scheme_Env *env);
+static Scheme_Layout *lambda_layout;
+SCHEME_DEFINE_ONCE (layout_once);
+static void init_layout (void);
+static Scheme_Node *lambda_syntax (Scheme_Value form, Scheme_Env *env, int tail);
+static Scheme_Node *define_syntax (Scheme_Value form, Scheme_Env *env, int tail);
+static Scheme_Node *quote_syntax (Scheme_Value form, Scheme_Env *env, int tail);
+static Scheme_Node *if_syntax (Scheme_Value form, Scheme_Env *env, int tail);
+static Scheme_Node *set_syntax (Scheme_Value form, Scheme_Env *env, int tail);
+static Scheme_Node *cond_syntax (Scheme_Value form, Scheme_Env *env, int tail);
+static Scheme_Node *case_syntax (Scheme_Value form, Scheme_Env *env, int tail);
+static Scheme_Node *and_syntax (Scheme_Value form, Scheme_Env *env, int tail);
+static Scheme_Node *or_syntax (Scheme_Value form, Scheme_Env *env, int tail);
+static Scheme_Node *let_syntax (Scheme_Value form, Scheme_Env *env, int tail);
+static Scheme_Node *let_star_syntax (Scheme_Value form, Scheme_Env *env, int tail);
+static Scheme_Node *letrec_syntax (Scheme_Value form, Scheme_Env *env, int tail);
+static Scheme_Node *begin_syntax (Scheme_Value form, Scheme_Env *env, int tail);
+static Scheme_Node *do_syntax (Scheme_Value form, Scheme_Env *env, int tail);
+static Scheme_Node *delay_syntax (Scheme_Value form, Scheme_Env *env, int tail);
+static Scheme_Node *future_syntax (Scheme_Value form, Scheme_Env *env, int tail);
+static Scheme_Node *quasiquote_syntax (Scheme_Value form, Scheme_Env *env, int tail);
 /* non-standard */
-static Scheme_Value defmacro_syntax (Scheme_Value form, Scheme_Env *env);
+static Scheme_Node *defmacro_syntax (Scheme_Value form, Scheme_Env *env, int tail);
+
+/* node handlers */
+static Scheme_Value lambda_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value define_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value if_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value set_local_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value set_global_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value cond_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value cond_arrow_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value cond_arrow_tail_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value case_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value and_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value or_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value let_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value let_stack_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value named_let_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value named_let_tail_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value let_star_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value letrec_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value do_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value do_stack_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value delay_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value future_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value qq_cons_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value qq_splice_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value qq_vector_eval (Scheme_Node *node, Scheme_Env *env);
+static Scheme_Value defmacro_eval (Scheme_Node *node, Scheme_Env *env);
 
 /* symbols */
 static Scheme_Value scheme_quasiquote;
@@ -54,38 +85,54 @@ static Scheme_Value scheme_unquote;
 static Scheme_Value scheme_unquote_splicing;
 static Scheme_Value scheme_define;
 static Scheme_Value scheme_lambda;
+static Scheme_Value scheme_else;
+static Scheme_Value scheme_arrow;
 
 #define CONS(a,b) scheme_make_pair(a,b)
 
 void
 scheme_init_syntax (Scheme_Env *env)
 {
-  scheme_syntax_type = scheme_make_type ("<syntax>");
+  scheme_syntax_type = scheme_make_builtin_type ("<syntax>", SCHEME_SYNTAX_TYPE_INDEX);
   scheme_add_global ("<syntax>", scheme_syntax_type, env);
-  scheme_macro_type = scheme_make_type ("<macro>");
+  SCHEME_ONCE (layout_once, init_layout);
+  scheme_macro_type = scheme_make_builtin_type ("<macro>", SCHEME_MACRO_TYPE_INDEX);
   scheme_add_global ("<macro>", scheme_macro_type, env);
   scheme_quasiquote = scheme_intern_symbol ("quasiquote");
   scheme_unquote = scheme_intern_symbol ("unquote");
   scheme_unquote_splicing = scheme_intern_symbol ("unquote-splicing");
   scheme_define = scheme_intern_symbol ("define");
   scheme_lambda = scheme_intern_symbol ("lambda");
-  scheme_add_global ("lambda", scheme_make_syntax (lambda_syntax), env);
-  scheme_add_global ("define", scheme_make_syntax (define_syntax), env);
-  scheme_add_global ("quote", scheme_make_syntax (quote_syntax), env);
-  scheme_add_global ("if", scheme_make_syntax (if_syntax), env);
-  scheme_add_global ("set!", scheme_make_syntax (set_syntax), env);
-  scheme_add_global ("cond", scheme_make_syntax (cond_syntax), env);
-  scheme_add_global ("case", scheme_make_syntax (case_syntax), env);
-  scheme_add_global ("and", scheme_make_syntax (and_syntax), env);
-  scheme_add_global ("or", scheme_make_syntax (or_syntax), env);
-  scheme_add_global ("let", scheme_make_syntax (let_syntax), env);
-  scheme_add_global ("let*", scheme_make_syntax (let_star_syntax), env);
-  scheme_add_global ("letrec", scheme_make_syntax (letrec_syntax), env);
-  scheme_add_global ("begin", scheme_make_syntax (begin_syntax), env);
-  scheme_add_global ("do", scheme_make_syntax (do_syntax), env);
-  scheme_add_global ("delay", scheme_make_syntax (delay_syntax), env);
-  scheme_add_global ("quasiquote", scheme_make_syntax (quasiquote_syntax), env);
-  scheme_add_global ("defmacro", scheme_make_syntax (defmacro_syntax), env);
+  scheme_else = scheme_intern_symbol ("else");
+  scheme_arrow = scheme_intern_symbol ("=>");
+  scheme_add_global ("lambda", scheme_make_syntax_analyzer (lambda_syntax), env);
+  scheme_add_global ("define", scheme_make_syntax_analyzer (define_syntax), env);
+  scheme_add_global ("quote", scheme_make_syntax_analyzer (quote_syntax), env);
+  scheme_add_global ("if", scheme_make_syntax_analyzer (if_syntax), env);
+  scheme_add_global ("set!", scheme_make_syntax_analyzer (set_syntax), env);
+  scheme_add_global ("cond", scheme_make_syntax_analyzer (cond_syntax), env);
+  scheme_add_global ("case", scheme_make_syntax_analyzer (case_syntax), env);
+  scheme_add_global ("and", scheme_make_syntax_analyzer (and_syntax), env);
+  scheme_add_global ("or", scheme_make_syntax_analyzer (or_syntax), env);
+  scheme_add_global ("let", scheme_make_syntax_analyzer (let_syntax), env);
+  scheme_add_global ("let*", scheme_make_syntax_analyzer (let_star_syntax), env);
+  scheme_add_global ("letrec", scheme_make_syntax_analyzer (letrec_syntax), env);
+  scheme_add_global ("begin", scheme_make_syntax_analyzer (begin_syntax), env);
+  scheme_add_global ("do", scheme_make_syntax_analyzer (do_syntax), env);
+  scheme_add_global ("delay", scheme_make_syntax_analyzer (delay_syntax), env);
+  scheme_add_global ("future", scheme_make_syntax_analyzer (future_syntax), env);
+  scheme_add_global ("quasiquote", scheme_make_syntax_analyzer (quasiquote_syntax), env);
+  scheme_add_global ("defmacro", scheme_make_syntax_analyzer (defmacro_syntax), env);
+}
+
+static void
+init_layout (void)
+{
+  lambda_layout = scheme_make_layout (sizeof (Scheme_Lambda),
+				      SCHEME_LAYOUT_SLOT (Scheme_Lambda, code)
+				      | SCHEME_LAYOUT_SLOT (Scheme_Lambda, params)
+				      | SCHEME_LAYOUT_SLOT (Scheme_Lambda, symbols)
+				      | SCHEME_LAYOUT_SLOT (Scheme_Lambda, body));
 }
 
 Scheme_Value
@@ -93,184 +140,537 @@ scheme_make_syntax (Scheme_Syntax *proc)
 {
   Scheme_Value syntax;
 
-  syntax = scheme_alloc_object (scheme_syntax_type, 0);
+  syntax = scheme_alloc_sized (scheme_syntax_type, SCHEME_OBJ_SIZE (syntax_val));
   SCHEME_SYNTAX (syntax) = proc;
+  SCHEME_SYNTAX_ANALYZER (syntax) = NULL;
   return (syntax);
 }
 
-/* builtin syntax */
+Scheme_Value
+scheme_make_syntax_analyzer (Scheme_Analyzer *analyzer)
+{
+  Scheme_Value syntax;
+
+  syntax = scheme_alloc_sized (scheme_syntax_type, SCHEME_OBJ_SIZE (syntax_val));
+  SCHEME_SYNTAX (syntax) = NULL;
+  SCHEME_SYNTAX_ANALYZER (syntax) = analyzer;
+  return (syntax);
+}
+
+/* bodies and frames */
+
+static int internal_def_p (Scheme_Value form);
+static Scheme_Value internal_def_var (Scheme_Value form);
+static Scheme_Node *internal_def_val (Scheme_Value form, Scheme_Env *env);
+static Scheme_Value binding_var (Scheme_Value binding, char *who);
+static Scheme_Node *make_lambda_node (Scheme_Value form, Scheme_Value code, Scheme_Env *env);
+static Scheme_Env *instantiate_frame (Scheme_Env *scope);
+
+/* Analyzers bump scheme_capture_count for each form that can hold on
+   to its environment: lambdas, `delay', `future' and syntax that
+   runs at runtime.  If analyzing a body did not bump it, nothing can
+   capture the body's frame and it may live on the C stack. */
+
+Scheme_Lambda *
+scheme_analyze_lambda (Scheme_Value code, Scheme_Env *env)
+{
+  Scheme_Lambda *lambda;
+
+  lambda = scheme_make_lambda (code);
+  scheme_analyze_lambda_body (lambda, env);
+  return (lambda);
+}
+
+/* Analyze the body of LAMBDA, whose closures are made in ENV. */
+void
+scheme_analyze_lambda_body (Scheme_Lambda *lambda, Scheme_Env *env)
+{
+  int captures;
+
+  env = scheme_extend_env (scheme_lambda_frame (lambda), env);
+  captures = scheme_capture_count;
+  lambda->body = scheme_analyze_body (SCHEME_CDR (lambda->code), env, 1);
+  lambda->stack_frame = (captures == scheme_capture_count
+			 && lambda->num_params <= SCHEME_STACK_FRAME);
+  scheme_capture_count++;
+}
+
+/* Make the descriptor for lambda expression CODE, taking the
+   parameter list apart once so applying a closure only has to fill
+   in a frame.  The body is left for the caller to analyze. */
+Scheme_Lambda *
+scheme_make_lambda (Scheme_Value code)
+{
+  Scheme_Lambda *lambda;
+  Scheme_Value params;
+  int i;
+
+  SCHEME_ASSERT (SCHEME_PAIRP (code), "badly formed lambda");
+  SCHEME_ASSERT (SCHEME_PAIRP (SCHEME_CDR (code)), "badly formed lambda");
+  lambda = (Scheme_Lambda *) scheme_malloc_typed (sizeof (Scheme_Lambda), lambda_layout);
+  lambda->code = code;
+  lambda->params = SCHEME_CAR (code);
+  lambda->num_params = scheme_list_length (lambda->params);
+  lambda->symbols = (Scheme_Value *) scheme_malloc (lambda->num_params * sizeof (Scheme_Value));
+  lambda->rest = 0;
+  params = lambda->params;
+  for ( i=0 ; i<lambda->num_params ; ++i )
+    {
+      if (! SCHEME_PAIRP (params))
+	{
+	  lambda->symbols[i] = params;
+	  lambda->rest = 1;
+	}
+      else
+	{
+	  lambda->symbols[i] = SCHEME_CAR (params);
+	  params = SCHEME_CDR (params);
+	}
+    }
+  lambda->stack_frame = 0;
+  lambda->body = NULL;
+  return (lambda);
+}
+
+/* The frame a lambda's parameters are analyzed in; it has the
+   layout of the frames scheme_bind_args makes. */
+Scheme_Env *
+scheme_lambda_frame (Scheme_Lambda *lambda)
+{
+  Scheme_Env *frame;
+  int i;
+
+  frame = scheme_new_frame (lambda->num_params);
+  for ( i=0 ; i<lambda->num_params ; ++i )
+    {
+      scheme_add_binding (i, lambda->symbols[i], scheme_false, frame);
+    }
+  return (frame);
+}
+
+/* Internal defines at the head of a body are bound in a frame of
+   their own and initialized in order, like `letrec'. */
+
+Scheme_Node *
+scheme_analyze_body (Scheme_Value forms, Scheme_Env *env, int tail)
+{
+  Scheme_Value body, defs;
+  Scheme_Env *frame;
+  Scheme_Node *node;
+  int num_int_defs, i;
+
+  num_int_defs = 0;
+  body = defs = forms;
+  while (!SCHEME_NULLP(forms) && internal_def_p (SCHEME_CAR(forms)))
+    {
+      num_int_defs++;
+      forms = SCHEME_CDR (forms);
+    }
+  if (! num_int_defs)
+    {
+      return (scheme_analyze_seq (forms, env, tail));
+    }
+
+  frame = scheme_new_frame (num_int_defs);
+  for ( i=0 ; i<num_int_defs ; ++i )
+    {
+      scheme_add_binding (i, internal_def_var (SCHEME_CAR (defs)), scheme_false, frame);
+      defs = SCHEME_CDR (defs);
+    }
+  env = scheme_extend_env (frame, env);
+
+  node = scheme_make_node (letrec_eval, body, num_int_defs + 1);
+  SCHEME_NODE_FRAME (node) = frame;
+  defs = body;
+  for ( i=0 ; i<num_int_defs ; ++i )
+    {
+      node->nodes[i] = internal_def_val (SCHEME_CAR (defs), env);
+      defs = SCHEME_CDR (defs);
+    }
+  node->nodes[num_int_defs] = scheme_analyze_seq (forms, env, tail);
+  return (node);
+}
+
+static int
+internal_def_p (Scheme_Value form)
+{
+  return (SCHEME_PAIRP(form) && (SCHEME_CAR(form) == scheme_define));
+}
+
+static Scheme_Value
+internal_def_var (Scheme_Value form)
+{
+  Scheme_Value sec;
+
+  SCHEME_ASSERT (SCHEME_PAIRP (SCHEME_CDR (form)), "define: bad form");
+  sec = SCHEME_CADR (form);
+  if (SCHEME_PAIRP (sec))
+    {
+      return (SCHEME_CAR (sec));
+    }
+  return (sec);
+}
+
+static Scheme_Node *
+internal_def_val (Scheme_Value form, Scheme_Env *env)
+{
+  Scheme_Value sec;
+
+  sec = SCHEME_CADR (form);
+  if (SCHEME_PAIRP (sec))
+    {
+      return (make_lambda_node (form, CONS (SCHEME_CDR (sec), SCHEME_CDDR (form)), env));
+    }
+  SCHEME_ASSERT (SCHEME_PAIRP (SCHEME_CDDR (form)), "define: bad form");
+  return (scheme_analyze (SCHEME_CAR (SCHEME_CDDR (form)), env, 0));
+}
+
+static Scheme_Node *
+make_lambda_node (Scheme_Value form, Scheme_Value code, Scheme_Env *env)
+{
+  Scheme_Node *node;
+
+  node = scheme_make_node (lambda_eval, form, 0);
+  SCHEME_NODE_LAMBDA (node) = scheme_analyze_lambda (code, env);
+  return (node);
+}
 
+/* Binding lists are taken apart at analysis time now, so check
+   their shape before doing so. */
 static Scheme_Value
-lambda_syntax (Scheme_Value form, Scheme_Env *env)
+binding_var (Scheme_Value binding, char *who)
+{
+  if (!SCHEME_PAIRP (binding) || !SCHEME_SYMBOLP (SCHEME_CAR (binding))
+      || !SCHEME_PAIRP (SCHEME_CDR (binding)))
+    {
+      scheme_signal_error ("%s: bad binding", who);
+    }
+  return (SCHEME_CAR (binding));
+}
+
+/* Make a runtime frame with the symbols of an analyzed one. */
+static Scheme_Env *
+instantiate_frame (Scheme_Env *scope)
+{
+  Scheme_Env *frame;
+  int i;
+
+  frame = scheme_new_frame (scope->num_bindings);
+  for ( i=0 ; i<scope->num_bindings ; ++i )
+    {
+      scheme_add_binding (i, scope->symbols[i], scheme_false, frame);
+    }
+  return (frame);
+}
+
+/* builtin syntax */
+
+static Scheme_Node *
+lambda_syntax (Scheme_Value form, Scheme_Env *env, int tail)
 {
   SCHEME_ASSERT (SCHEME_PAIRP(form), "badly formed lambda");
   SCHEME_ASSERT (SCHEME_PAIRP(SCHEME_CDR(form)), "badly formed lambda");
-  return (scheme_make_closure (env, SCHEME_CDR(form)));
+  return (make_lambda_node (form, SCHEME_CDR (form), env));
 }
 
 static Scheme_Value
-define_syntax (Scheme_Value form, Scheme_Env *env)
+lambda_eval (Scheme_Node *node, Scheme_Env *env)
 {
-  Scheme_Value var = scheme_null, val = scheme_null;
-  Scheme_Value sec, params, forms;
+  return (scheme_make_lambda_closure (env, SCHEME_NODE_LAMBDA (node)));
+}
 
+static Scheme_Node *
+define_syntax (Scheme_Value form, Scheme_Env *env, int tail)
+{
+  Scheme_Value sec;
+  Scheme_Node *node;
+
+  SCHEME_ASSERT (SCHEME_PAIRP (SCHEME_CDR (form)), "define: bad form");
   sec = SCHEME_CAR (SCHEME_CDR (form));
 
+  node = scheme_make_node (define_eval, form, 1);
   if (SCHEME_TYPE(sec) == scheme_pair_type)
     {
-      var = SCHEME_CAR (sec);
-      params = SCHEME_CDR (sec);
-      forms = SCHEME_CDR (SCHEME_CDR (form));
-      val = scheme_make_closure (env, scheme_make_pair (params, forms));
+      SCHEME_NODE_VAL (node) = SCHEME_CAR (sec);
+      node->nodes[0] = make_lambda_node (form, CONS (SCHEME_CDR (sec),
+						     SCHEME_CDDR (form)), env);
     }
   else if (SCHEME_TYPE(sec) == scheme_symbol_type)
     {
-      var = sec;
-      val = SCHEME_CAR (SCHEME_CDR (SCHEME_CDR (form)));
-      val = scheme_eval (val, env);
+      SCHEME_ASSERT (SCHEME_PAIRP (SCHEME_CDDR (form)), "define: bad form");
+      SCHEME_NODE_VAL (node) = sec;
+      node->nodes[0] = scheme_analyze (SCHEME_CAR (SCHEME_CDDR (form)), env, 0);
     }
   else
     {
       scheme_signal_error ("define: second arg must be symbol or list");
     }
+  return (node);
+}
+
+static Scheme_Value
+define_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  Scheme_Value var, val;
+
+  var = SCHEME_NODE_VAL (node);
+  val = SCHEME_EVAL_NODE (node->nodes[0], env);
   scheme_add_global (SCHEME_STR_VAL(var), val, env);
   return (var);
 }
 
-static Scheme_Value
-quote_syntax (Scheme_Value form, Scheme_Env *env)
+static Scheme_Node *
+quote_syntax (Scheme_Value form, Scheme_Env *env, int tail)
 {
   SCHEME_ASSERT ((scheme_list_length (form) == 2), "quote: wrong number of args");
-  return (SCHEME_CAR (SCHEME_CDR (form)));
+  return (scheme_make_const_node (SCHEME_CAR (SCHEME_CDR (form))));
 }
 
-static Scheme_Value
-if_syntax (Scheme_Value form, Scheme_Env *env)
+static Scheme_Node *
+if_syntax (Scheme_Value form, Scheme_Env *env, int tail)
 {
   int len;
-  Scheme_Value test, thenp, elsep;
+  Scheme_Node *node;
 
   len = scheme_list_length (form);
   SCHEME_ASSERT (((len == 3) || (len == 4)), "badly formed if statement");
-  test = SCHEME_CAR (SCHEME_CDR (form));
-  test = scheme_eval (test, env);
-  if (test != scheme_false)
+  node = scheme_make_node (if_eval, form, 3);
+  node->nodes[0] = scheme_analyze (SCHEME_CADR (form), env, 0);
+  node->nodes[1] = scheme_analyze (SCHEME_CAR (SCHEME_CDDR (form)), env, tail);
+  if (len == 4)
     {
-      thenp = SCHEME_CAR (SCHEME_CDR (SCHEME_CDR (form)));
-      return (scheme_eval (thenp, env));
+      node->nodes[2] = scheme_analyze (SCHEME_CAR (SCHEME_CDR (SCHEME_CDDR (form))), env, tail);
     }
   else
     {
-      if (len == 4)
-        {
-          elsep = SCHEME_CAR (SCHEME_CDR (SCHEME_CDR ((SCHEME_CDR (form)))));
-          return (scheme_eval (elsep, env));
-        }
-      else
-        {
-          return (scheme_false);
-        }
+      node->nodes[2] = scheme_make_const_node (scheme_false);
     }
+  return (node);
 }
 
 static Scheme_Value
-set_syntax (Scheme_Value form, Scheme_Env *env)
+if_eval (Scheme_Node *node, Scheme_Env *env)
 {
-  Scheme_Value var, val;
+  if (SCHEME_EVAL_NODE (node->nodes[0], env) != scheme_false)
+    {
+      return (SCHEME_EVAL_NODE (node->nodes[1], env));
+    }
+  else
+    {
+      return (SCHEME_EVAL_NODE (node->nodes[2], env));
+    }
+}
+
+static Scheme_Node *
+set_syntax (Scheme_Value form, Scheme_Env *env, int tail)
+{
+  Scheme_Value var;
+  Scheme_Node *node;
+  int depth, index;
 
   SCHEME_ASSERT ((scheme_list_length (form) == 3), "bad set! form");
   var = SCHEME_CAR (SCHEME_CDR (form));
   SCHEME_ASSERT (SCHEME_TYPE (var) == scheme_symbol_type,
                  "second arg to `set!' must be symbol");
-  val = scheme_eval (SCHEME_CAR (SCHEME_CDR (SCHEME_CDR (form))), env);
-  scheme_set_value (var, val, env);
+  if (scheme_lexical_address (var, env, &depth, &index))
+    {
+      node = scheme_make_node (set_local_eval, form, 1);
+      SCHEME_NODE_DEPTH (node) = depth;
+      SCHEME_NODE_INDEX (node) = index;
+    }
+  else
+    {
+      node = scheme_make_node (set_global_eval, form, 1);
+      SCHEME_NODE_CELL (node) = scheme_global_cell (var, env);
+    }
+  node->nodes[0] = scheme_analyze (SCHEME_CAR (SCHEME_CDDR (form)), env, 0);
+  return (node);
+}
+
+static Scheme_Value
+set_local_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  Scheme_Value val;
+  Scheme_Env *frame;
+  int depth;
+
+  val = SCHEME_EVAL_NODE (node->nodes[0], env);
+  frame = env;
+  for ( depth=SCHEME_NODE_DEPTH (node) ; depth>0 ; --depth )
+    {
+      frame = frame->next;
+    }
+  if (frame->frozen)
+    {
+      scheme_signal_error ("set!: variable is frozen: %s",
+			   SCHEME_STR_VAL (frame->symbols[SCHEME_NODE_INDEX (node)]));
+    }
+  frame->values[SCHEME_NODE_INDEX (node)] = val;
+  SCHEME_GC_WRITE (&frame->values[SCHEME_NODE_INDEX (node)]);
   return (val);
 }
 
 static Scheme_Value
-cond_syntax (Scheme_Value form, Scheme_Env *env)
+set_global_eval (Scheme_Node *node, Scheme_Env *env)
 {
-  Scheme_Value clauses, clause, test, forms, ret;
+  Scheme_Global_Cell *cell;
+  Scheme_Value val;
+
+  val = SCHEME_EVAL_NODE (node->nodes[0], env);
+  cell = SCHEME_NODE_CELL (node);
+  if (! cell->val && ! scheme_base_value (cell))
+    {
+      scheme_signal_error ("set!: var unbound: %s", cell->name);
+    }
+  cell->val = val;
+  SCHEME_GC_WRITE (&cell->val);
+  return (val);
+}
+
+/* `cond' is analyzed into a chain of clause nodes: the test, the
+   clause body (or NULL) and the rest of the chain. */
+
+static Scheme_Node *
+cond_syntax (Scheme_Value form, Scheme_Env *env, int tail)
+{
+  Scheme_Value clauses, clause, forms;
+  Scheme_Node *node;
 
   clauses = SCHEME_CDR (form);
-  ret = scheme_false;
-  while (clauses != scheme_null)
+  if (SCHEME_NULLP (clauses))
     {
-      clause = SCHEME_CAR (clauses);
-      test = SCHEME_CAR (clause);
-      if (test == scheme_intern_symbol ("else"))
+      return (scheme_make_const_node (scheme_false));
+    }
+  clause = SCHEME_CAR (clauses);
+  SCHEME_ASSERT (SCHEME_PAIRP (clause), "cond: bad clause");
+  forms = SCHEME_CDR (clause);
+  if (SCHEME_CAR (clause) == scheme_else)
+    {
+      return (scheme_analyze_seq (forms, env, tail));
+    }
+  if (!SCHEME_NULLP (forms) && (SCHEME_CAR (forms) == scheme_arrow))
+    {
+      forms = SCHEME_CDR (forms);
+      SCHEME_ASSERT (!SCHEME_NULLP(forms), "cond: bad `=>' clause");
+      node = scheme_make_node (tail ? cond_arrow_tail_eval : cond_arrow_eval, form, 3);
+      node->nodes[1] = scheme_analyze (SCHEME_CAR (forms), env, 0);
+    }
+  else
+    {
+      node = scheme_make_node (cond_eval, form, 3);
+      node->nodes[1] = SCHEME_NULLP (forms) ? NULL : scheme_analyze_seq (forms, env, tail);
+    }
+  node->nodes[0] = scheme_analyze (SCHEME_CAR (clause), env, 0);
+  node->nodes[2] = cond_syntax (SCHEME_CDR (form), env, tail);
+  return (node);
+}
+
+static Scheme_Value
+cond_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  Scheme_Value test;
+
+  test = SCHEME_EVAL_NODE (node->nodes[0], env);
+  if (test != scheme_false)
+    {
+      if (node->nodes[1])
 	{
-	  test = scheme_true;
+	  return (SCHEME_EVAL_NODE (node->nodes[1], env));
 	}
-      else
+      return (test);
+    }
+  return (SCHEME_EVAL_NODE (node->nodes[2], env));
+}
+
+static Scheme_Value
+cond_arrow_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  Scheme_Value test, proc;
+
+  test = SCHEME_EVAL_NODE (node->nodes[0], env);
+  if (test != scheme_false)
+    {
+      proc = SCHEME_EVAL_NODE (node->nodes[1], env);
+      SCHEME_ASSERT (SCHEME_PROCP(proc), "cond: form after `=>' must evaluate to a procedure");
+      return (scheme_apply (proc, 1, &test));
+    }
+  return (SCHEME_EVAL_NODE (node->nodes[2], env));
+}
+
+static Scheme_Value
+cond_arrow_tail_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  Scheme_Value test, proc;
+
+  test = SCHEME_EVAL_NODE (node->nodes[0], env);
+  if (test != scheme_false)
+    {
+      proc = SCHEME_EVAL_NODE (node->nodes[1], env);
+      SCHEME_ASSERT (SCHEME_PROCP(proc), "cond: form after `=>' must evaluate to a procedure");
+      return (scheme_tail_apply (proc, 1, &test));
+    }
+  return (SCHEME_EVAL_NODE (node->nodes[2], env));
+}
+
+/* `case' keeps the list of clause data in the node; nodes[0] is the
+   key and nodes[i+1] the body of clause i. */
+
+static Scheme_Node *
+case_syntax (Scheme_Value form, Scheme_Env *env, int tail)
+{
+  Scheme_Value clauses, clause, data, last, pair;
+  Scheme_Node *node;
+  int num_clauses, i;
+
+  SCHEME_ASSERT (SCHEME_PAIRP (SCHEME_CDR (form)), "case: bad form");
+  clauses = SCHEME_CDDR (form);
+  num_clauses = scheme_list_length (clauses);
+  node = scheme_make_node (case_eval, form, num_clauses + 1);
+  node->nodes[0] = scheme_analyze (SCHEME_CADR (form), env, 0);
+  data = last = scheme_null;
+  for ( i=1 ; i<=num_clauses ; ++i )
+    {
+      clause = SCHEME_CAR (clauses);
+      SCHEME_ASSERT (SCHEME_PAIRP (clause), "case: bad clause");
+      SCHEME_ASSERT ((SCHEME_CAR (clause) == scheme_else) || SCHEME_PAIRP (SCHEME_CAR (clause)),
+		     "case: first thing in clause must be a list");
+      pair = scheme_make_pair (SCHEME_CAR (clause), scheme_null);
+      if (SCHEME_NULLP (data))
 	{
-	  test = scheme_eval (test, env);
+	  data = last = pair;
 	}
-      if (test != scheme_false)
+      else
 	{
-	  forms = SCHEME_CDR (clause);
-	  if (!SCHEME_NULLP (forms) &&
-	      (SCHEME_CAR(forms) == scheme_intern_symbol ("=>")))
-	    {
-	      Scheme_Value proc;
-
-	      forms = SCHEME_CDR (forms);
-	      SCHEME_ASSERT (!SCHEME_NULLP(forms), "cond: bad `=>' clause");
-	      proc = scheme_eval (SCHEME_CAR (forms), env);
-	      SCHEME_ASSERT (SCHEME_PROCP(proc), "cond: form after `=>' must evaluate to a procedure");
-	      ret = scheme_apply_to_list (proc, scheme_make_pair (test, scheme_null));
-	    }
-	  else
-	    {
-	      while (forms != scheme_null)
-		{
-		  ret = scheme_eval (SCHEME_CAR (forms), env);
-		  forms = SCHEME_CDR (forms);
-		}
-	    }
-	  return (ret);
+	  SCHEME_CDR (last) = pair;
+	  last = pair;
 	}
+      node->nodes[i] = scheme_analyze_seq (SCHEME_CDR (clause), env, tail);
       clauses = SCHEME_CDR (clauses);
     }
-  return (ret);
+  SCHEME_NODE_VAL (node) = data;
+  return (node);
 }
 
 static Scheme_Value
-case_syntax (Scheme_Value form, Scheme_Env *env)
+case_eval (Scheme_Node *node, Scheme_Env *env)
 {
-  Scheme_Value key, clauses, clause;
-  Scheme_Value data, exprs, res = scheme_null;
-
-  key = SCHEME_CAR (SCHEME_CDR (form));
-  clauses = SCHEME_CDR (SCHEME_CDR (form));
+  Scheme_Value key, clauses, data;
+  int i;
 
-  key = scheme_eval (key, env);
-  while (! SCHEME_NULLP (clauses))
+  key = SCHEME_EVAL_NODE (node->nodes[0], env);
+  clauses = SCHEME_NODE_VAL (node);
+  for ( i=1 ; i<node->num_nodes ; ++i )
     {
-      clause = SCHEME_CAR (clauses);
-      data = SCHEME_CAR (clause);
-      if (SCHEME_SYMBOLP (data) && (scheme_intern_symbol("else") == data))
+      data = SCHEME_CAR (clauses);
+      if (data == scheme_else)
 	{
-	  exprs = SCHEME_CDR (clause);
-	  while (! SCHEME_NULLP (exprs))
-	    {
-	      res = scheme_eval (SCHEME_CAR (exprs), env);
-	      exprs = SCHEME_CDR (exprs);
-	    }
-	  return (res);
+	  return (SCHEME_EVAL_NODE (node->nodes[i], env));
 	}
-      SCHEME_ASSERT (SCHEME_PAIRP(data), "case: first thing in clause must be a list");
       while (! SCHEME_NULLP (data))
 	{
 	  if (scheme_eqv (SCHEME_CAR (data), key))
 	    {
-	      exprs = SCHEME_CDR (clause);
-	      while (! SCHEME_NULLP (exprs))
-		{
-		  res = scheme_eval (SCHEME_CAR (exprs), env);
-		  exprs = SCHEME_CDR (exprs);
-		}
-	      return (res);
+	      return (SCHEME_EVAL_NODE (node->nodes[i], env));
 	    }
 	  data = SCHEME_CDR (data);
 	}
@@ -279,189 +679,276 @@ case_syntax (Scheme_Value form, Scheme_Env *env)
   return (scheme_false);
 }
 
-static Scheme_Value
-and_syntax (Scheme_Value form, Scheme_Env *env)
+static Scheme_Node *
+and_syntax (Scheme_Value form, Scheme_Env *env, int tail)
 {
-  Scheme_Value forms, ret;
+  Scheme_Value forms;
+  Scheme_Node *node;
+  int num_forms, i;
 
   forms = SCHEME_CDR (form);
-  ret = scheme_true;
-  while (forms != scheme_null)
+  num_forms = scheme_list_length (forms);
+  if (num_forms == 0)
+    {
+      return (scheme_make_const_node (scheme_true));
+    }
+  node = scheme_make_node (and_eval, form, num_forms);
+  for ( i=0 ; i<num_forms ; ++i )
     {
-      ret = scheme_eval (SCHEME_CAR (forms), env);
-      if (ret == scheme_false)
+      node->nodes[i] = scheme_analyze (SCHEME_CAR (forms), env,
+				       (i == num_forms - 1) ? tail : 0);
+      forms = SCHEME_CDR (forms);
+    }
+  return (node);
+}
+
+static Scheme_Value
+and_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  int i, last;
+
+  last = node->num_nodes - 1;
+  for ( i=0 ; i<last ; ++i )
+    {
+      if (SCHEME_EVAL_NODE (node->nodes[i], env) == scheme_false)
         {
           return (scheme_false);
         }
+    }
+  return (SCHEME_EVAL_NODE (node->nodes[last], env));
+}
+
+static Scheme_Node *
+or_syntax (Scheme_Value form, Scheme_Env *env, int tail)
+{
+  Scheme_Value forms;
+  Scheme_Node *node;
+  int num_forms, i;
+
+  forms = SCHEME_CDR (form);
+  num_forms = scheme_list_length (forms);
+  if (num_forms == 0)
+    {
+      return (scheme_make_const_node (scheme_false));
+    }
+  node = scheme_make_node (or_eval, form, num_forms);
+  for ( i=0 ; i<num_forms ; ++i )
+    {
+      node->nodes[i] = scheme_analyze (SCHEME_CAR (forms), env,
+				       (i == num_forms - 1) ? tail : 0);
       forms = SCHEME_CDR (forms);
     }
-  return (ret);
+  return (node);
 }
 
 static Scheme_Value
-or_syntax (Scheme_Value form, Scheme_Env *env)
+or_eval (Scheme_Node *node, Scheme_Env *env)
 {
-  Scheme_Value forms, ret;
+  Scheme_Value ret;
+  int i, last;
 
-  forms = SCHEME_CDR (form);
-  ret = scheme_false;
-  while (forms != scheme_null)
+  last = node->num_nodes - 1;
+  for ( i=0 ; i<last ; ++i )
     {
-      ret = scheme_eval (SCHEME_CAR (forms), env);
+      ret = SCHEME_EVAL_NODE (node->nodes[i], env);
       if (ret != scheme_false)
         {
           return (ret);
         }
-      forms = SCHEME_CDR (forms);
     }
-  return (ret);
+  return (SCHEME_EVAL_NODE (node->nodes[last], env));
 }
 
-static int internal_def_p (Scheme_Value form);
-static Scheme_Value named_let_syntax (Scheme_Value form, Scheme_Env *env);
+static Scheme_Node *named_let_syntax (Scheme_Value form, Scheme_Env *env, int tail);
 
-static Scheme_Value
-let_syntax (Scheme_Value form, Scheme_Env *env)
+/* The binding forms keep the analyzed frame in the node; nodes[0]
+   through nodes[n-1] are the initial values and nodes[n] the body. */
+
+static Scheme_Node *
+let_syntax (Scheme_Value form, Scheme_Env *env, int tail)
 {
-  Scheme_Value bindings, binding, vars, vals, forms;
-  Scheme_Value vars_last, vals_last, pair, aform, ret = scheme_null;
-  int num_int_defs, num_bindings, i;
+  Scheme_Value bindings, binding;
   Scheme_Env *frame;
+  Scheme_Node *node;
+  int num_bindings, captures, i;
 
+  SCHEME_ASSERT (SCHEME_PAIRP (SCHEME_CDR (form)), "badly formed `let' form");
   if (SCHEME_SYMBOLP (SCHEME_CAR (SCHEME_CDR (form))))
     {
-      return (named_let_syntax (form, env));
+      return (named_let_syntax (form, env, tail));
     }
   SCHEME_ASSERT ((scheme_list_length(form) >= 3), "badly formed `let' form");
   bindings = SCHEME_CAR (SCHEME_CDR (form));
   num_bindings = scheme_list_length (bindings);
   frame = scheme_new_frame (num_bindings);
+  node = scheme_make_node (let_eval, form, num_bindings + 1);
   for ( i=0 ; i<num_bindings; ++i )
     {
       binding = SCHEME_CAR (bindings);
-      scheme_add_binding (i, SCHEME_CAR (binding), scheme_eval (SCHEME_CADR (binding), env), frame);
+      scheme_add_binding (i, binding_var (binding, "let"), scheme_false, frame);
+      node->nodes[i] = scheme_analyze (SCHEME_CADR (binding), env, 0);
       bindings = SCHEME_CDR (bindings);
     }
   env = scheme_extend_env (frame, env);
-  forms = SCHEME_CDR (SCHEME_CDR (form));
-
-  /* process internal defines */
-  num_int_defs = 0;
-  vars = vals = vars_last = vals_last = scheme_null;
-  while (!SCHEME_NULLP(forms) && internal_def_p (SCHEME_CAR(forms)))
+  SCHEME_NODE_FRAME (node) = frame;
+  captures = scheme_capture_count;
+  node->nodes[num_bindings] = scheme_analyze_body (SCHEME_CDDR (form), env, tail);
+  if (captures == scheme_capture_count && num_bindings <= SCHEME_STACK_FRAME)
     {
-      num_int_defs++;
-      aform = SCHEME_CAR (forms);
-      /* get var */
-      if (SCHEME_PAIRP (SCHEME_CAR (SCHEME_CDR (aform))))
-	{
-	  pair = scheme_make_pair (SCHEME_CAR (SCHEME_CAR (SCHEME_CDR (aform))), scheme_null);
-	}
-      else
-	{
-	  pair = scheme_make_pair (SCHEME_CAR (SCHEME_CDR (aform)), scheme_null);
-	}
-      if (SCHEME_NULLP (vars))
-	{
-	  vars = vars_last = pair;
-	}
-      else
-	{
-	  SCHEME_CDR (vars_last) = pair;
-	  vars_last = pair;
-	}
-      /* get val */
-      if (SCHEME_PAIRP (SCHEME_CAR (SCHEME_CDR (aform))))
-	{
-	  pair = CONS (CONS (scheme_lambda, CONS (SCHEME_CDR (SCHEME_CAR (SCHEME_CDR (aform))),
-						  SCHEME_CDR (SCHEME_CDR (aform)))),
-		       scheme_null);
-	}
-      else
-	{
-	  pair = scheme_make_pair (SCHEME_CAR (SCHEME_CDR (SCHEME_CDR (aform))), scheme_null);
-	}
-      if (SCHEME_NULLP (vals))
-	{
-	  vals = vals_last = pair;
-	}
-      else
-	{
-	  SCHEME_CDR (vals_last) = pair;
-	  vals_last = pair;
-	}
-      forms = SCHEME_CDR (forms);
+      node->eval = let_stack_eval;
     }
-  if ( num_int_defs )
+  return (node);
+}
+
+static Scheme_Value
+let_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  Scheme_Env *frame;
+  int num_bindings, i;
+
+  frame = instantiate_frame (SCHEME_NODE_FRAME (node));
+  num_bindings = frame->num_bindings;
+  for ( i=0 ; i<num_bindings ; ++i )
     {
-      env = scheme_add_frame (vars, scheme_alloc_list (num_int_defs), env);
-      while (! SCHEME_NULLP (vars))
-	{
-	  scheme_set_value (SCHEME_CAR(vars),
-			    scheme_eval (SCHEME_CAR (vals), env),
-			    env);
-	  vars = SCHEME_CDR (vars);
-	  vals = SCHEME_CDR (vals);
-	}
+      frame->values[i] = SCHEME_EVAL_NODE (node->nodes[i], env);
     }
+  env = scheme_extend_env (frame, env);
+  return (SCHEME_EVAL_NODE (node->nodes[num_bindings], env));
+}
 
-  while (forms != scheme_null)
+static Scheme_Value
+let_stack_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  Scheme_Env *scope, *frame, stack_frame;
+  Scheme_Value values[SCHEME_STACK_FRAME];
+  int num_bindings, i;
+
+  scope = SCHEME_NODE_FRAME (node);
+  num_bindings = scope->num_bindings;
+  frame = scheme_stack_frame (&stack_frame, values, num_bindings, scope->symbols);
+  for ( i=0 ; i<num_bindings ; ++i )
     {
-      ret = scheme_eval (SCHEME_CAR (forms), env);
-      forms = SCHEME_CDR (forms);
+      values[i] = SCHEME_EVAL_NODE (node->nodes[i], env);
     }
-  /* pop internal define frame */
-  if ( num_int_defs )
+  env = scheme_extend_env (frame, env);
+  return (SCHEME_EVAL_NODE (node->nodes[num_bindings], env));
+}
+
+/* A named let binds the name in a frame of its own; nodes[n] is the
+   lambda, analyzed in that frame, and the inits are analyzed outside
+   of it. */
+
+static Scheme_Node *
+named_let_syntax (Scheme_Value form, Scheme_Env *env, int tail)
+{
+  Scheme_Value name, bindings, vars, forms;
+  Scheme_Env *frame;
+  Scheme_Node *node;
+  int num_bindings, i;
+
+  SCHEME_ASSERT ((scheme_list_length(form) >= 4), "badly formed `let' form");
+  name = SCHEME_CAR (SCHEME_CDR (form));
+  bindings = SCHEME_CAR (SCHEME_CDDR (form));
+  vars = scheme_map_1 (scheme_car, bindings);
+  forms = SCHEME_CDR (SCHEME_CDDR (form));
+  num_bindings = scheme_list_length (bindings);
+
+  node = scheme_make_node (tail ? named_let_tail_eval : named_let_eval,
+			   form, num_bindings + 1);
+  SCHEME_NODE_VAL (node) = name;
+  for ( i=0 ; i<num_bindings ; ++i )
     {
-      env = scheme_pop_frame (env);
+      binding_var (SCHEME_CAR (bindings), "let");
+      node->nodes[i] = scheme_analyze (SCHEME_CADR (SCHEME_CAR (bindings)), env, 0);
+      bindings = SCHEME_CDR (bindings);
     }
-  /* pop regular binding frame */
-  env = scheme_pop_frame (env);
-  return (ret);
+  frame = scheme_new_frame (1);
+  scheme_add_binding (0, name, scheme_false, frame);
+  env = scheme_extend_env (frame, env);
+  node->nodes[num_bindings] = make_lambda_node (form, CONS (vars, forms), env);
+  return (node);
 }
 
-static int
-internal_def_p (Scheme_Value form)
+/* Evaluate the inits into RANDS and make the loop procedure. */
+static Scheme_Value
+named_let_proc (Scheme_Node *node, Scheme_Env *env, Scheme_Value *rands)
 {
-  return (SCHEME_PAIRP(form) && (SCHEME_CAR(form) == scheme_define));
+  Scheme_Value proc;
+  Scheme_Env *frame;
+  int num_rands, i;
+
+  num_rands = node->num_nodes - 1;
+  for ( i=0 ; i<num_rands ; ++i )
+    {
+      rands[i] = SCHEME_EVAL_NODE (node->nodes[i], env);
+    }
+  frame = scheme_new_frame (1);
+  scheme_add_binding (0, SCHEME_NODE_VAL (node), scheme_false, frame);
+  env = scheme_extend_env (frame, env);
+  proc = SCHEME_EVAL_NODE (node->nodes[num_rands], env);
+  frame->values[0] = proc;
+  return (proc);
 }
 
 static Scheme_Value
-named_let_syntax (Scheme_Value form, Scheme_Env *env)
+named_let_eval (Scheme_Node *node, Scheme_Env *env)
 {
-  Scheme_Value name, bindings, vars, vals, forms;
-  Scheme_Value proc, init, ret;
+  Scheme_Value proc, rands[SCHEME_MAX_ARGS];
 
-  name = SCHEME_CAR (SCHEME_CDR (form));
-  bindings = SCHEME_CAR (SCHEME_CDR (SCHEME_CDR (form)));
-  vars = scheme_map_1 (scheme_car, bindings);
-  vals = scheme_map_1 (scheme_cadr, bindings);
-  forms = SCHEME_CDR (SCHEME_CDR (SCHEME_CDR (form)));
+  proc = named_let_proc (node, env, rands);
+  return (scheme_apply (proc, node->num_nodes - 1, rands));
+}
 
-  proc = CONS(scheme_intern_symbol ("lambda"), CONS(vars, forms));
-  init = CONS(name, vals);
+static Scheme_Value
+named_let_tail_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  Scheme_Value proc, rands[SCHEME_MAX_ARGS];
 
-  env = scheme_add_frame (CONS(name, scheme_null), CONS(scheme_null, scheme_null), env);
-  proc = scheme_eval (proc, env);
-  scheme_set_value (name, proc, env);
-  ret = scheme_eval (init, env);
-  env = scheme_pop_frame (env);
-  return (ret);
+  proc = named_let_proc (node, env, rands);
+  return (scheme_tail_apply (proc, node->num_nodes - 1, rands));
 }
 
-static Scheme_Value
-let_star_syntax (Scheme_Value form, Scheme_Env *env)
+/* `let*' uses a single frame whose bindings become visible one at a
+   time, so each init is analyzed with only the preceding ones. */
+
+static Scheme_Node *
+let_star_syntax (Scheme_Value form, Scheme_Env *env, int tail)
 {
-  Scheme_Value bindings, vars, vals, forms, ret = scheme_null;
-  Scheme_Value vars_last, vals_last, pair, aform;
+  Scheme_Value bindings, binding;
   Scheme_Env *frame;
-  int num_int_defs, num_bindings, i;
+  Scheme_Node *node;
+  int num_bindings, i;
 
   SCHEME_ASSERT ((scheme_list_length(form) >= 3), "badly formed `let*' form");
   bindings = SCHEME_CAR (SCHEME_CDR (form));
   num_bindings = scheme_list_length (bindings);
-  vars = scheme_map_1 (scheme_car, bindings);
-  vals = scheme_map_1 (scheme_cadr, bindings);
+  frame = scheme_new_frame (num_bindings);
+  env = scheme_extend_env (frame, env);
+  node = scheme_make_node (let_star_eval, form, num_bindings + 1);
+  for ( i=0 ; i<num_bindings ; ++i )
+    {
+      binding = SCHEME_CAR (bindings);
+      binding_var (binding, "let*");
+      frame->num_bindings = i;
+      node->nodes[i] = scheme_analyze (SCHEME_CADR (binding), env, 0);
+      frame->num_bindings = i + 1;
+      scheme_add_binding (i, SCHEME_CAR (binding), scheme_false, frame);
+      bindings = SCHEME_CDR (bindings);
+    }
+  frame->num_bindings = num_bindings;
+  SCHEME_NODE_FRAME (node) = frame;
+  node->nodes[num_bindings] = scheme_analyze_body (SCHEME_CDDR (form), env, tail);
+  return (node);
+}
+
+static Scheme_Value
+let_star_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  Scheme_Env *scope, *frame;
+  int num_bindings, i;
+
+  scope = SCHEME_NODE_FRAME (node);
+  num_bindings = scope->num_bindings;
   frame = scheme_new_frame (num_bindings);
 
   /* first install dummy bindings */
@@ -470,408 +957,412 @@ let_star_syntax (Scheme_Value form, Scheme_Env *env)
       scheme_add_binding (i, scheme_false, scheme_false, frame);
     }
   env = scheme_extend_env (frame, env);
-  i = 0;
-  while ( vars != scheme_null )
+  for ( i=0 ; i < num_bindings ; ++i )
     {
-      scheme_add_binding (i, SCHEME_CAR(vars), scheme_eval (SCHEME_CAR (vals), env), env);
-      vars = SCHEME_CDR (vars);
-      vals = SCHEME_CDR (vals);
-      i++;
+      scheme_add_binding (i, scope->symbols[i], SCHEME_EVAL_NODE (node->nodes[i], env), frame);
     }
-  forms = SCHEME_CDR (SCHEME_CDR (form));
-  /* process internal defines */
-  num_int_defs = 0;
-  vars = vals = vars_last = vals_last = scheme_null;
-  while (!SCHEME_NULLP(forms) && internal_def_p (SCHEME_CAR(forms)))
-    {
-      num_int_defs++;
-      aform = SCHEME_CAR (forms);
-      /* get var */
-      if (SCHEME_PAIRP (SCHEME_CAR (SCHEME_CDR (aform))))
-	{
-	  pair = scheme_make_pair (SCHEME_CAR (SCHEME_CAR (SCHEME_CDR (aform))), scheme_null);
-	}
-      else
-	{
-	  pair = scheme_make_pair (SCHEME_CAR (SCHEME_CDR (aform)), scheme_null);
-	}
-      if (SCHEME_NULLP (vars))
-	{
-	  vars = vars_last = pair;
-	}
-      else
-	{
-	  SCHEME_CDR (vars_last) = pair;
-	  vars_last = pair;
-	}
-      /* get val */
-      if (SCHEME_PAIRP (SCHEME_CAR (SCHEME_CDR (aform))))
-	{
-	  pair = CONS (CONS (scheme_lambda, CONS (SCHEME_CDR (SCHEME_CAR (SCHEME_CDR (aform))),
-						  SCHEME_CDR (SCHEME_CDR (aform)))),
-		       scheme_null);
-	}
-      else
-	{
-	  pair = scheme_make_pair (SCHEME_CAR (SCHEME_CDR (SCHEME_CDR (aform))), scheme_null);
-	}
-      if (SCHEME_NULLP (vals))
-	{
-	  vals = vals_last = pair;
-	}
-      else
-	{
-	  SCHEME_CDR (vals_last) = pair;
-	  vals_last = pair;
-	}
-      forms = SCHEME_CDR (forms);
-    }
-  if ( num_int_defs )
+  return (SCHEME_EVAL_NODE (node->nodes[num_bindings], env));
+}
+
+static Scheme_Node *
+letrec_syntax (Scheme_Value form, Scheme_Env *env, int tail)
+{
+  Scheme_Value bindings;
+  Scheme_Env *frame;
+  Scheme_Node *node;
+  int num_bindings, i;
+
+  SCHEME_ASSERT ((scheme_list_length(form) >= 3), "badly formed `letrec' form");
+  bindings = SCHEME_CAR (SCHEME_CDR (form));
+  num_bindings = scheme_list_length (bindings);
+  frame = scheme_new_frame (num_bindings);
+  for ( i=0 ; i<num_bindings ; ++i )
     {
-      env = scheme_add_frame (vars, scheme_alloc_list (num_int_defs), env);
-      while (! SCHEME_NULLP (vars))
-	{
-	  scheme_set_value (SCHEME_CAR(vars),
-			    scheme_eval (SCHEME_CAR (vals), env),
-			    env);
-	  vars = SCHEME_CDR (vars);
-	  vals = SCHEME_CDR (vals);
-	}
+      scheme_add_binding (i, binding_var (SCHEME_CAR (bindings), "letrec"), scheme_false, frame);
+      bindings = SCHEME_CDR (bindings);
     }
-  /* evaluate non-internal-definition forms */
-  while (forms != scheme_null)
+  env = scheme_extend_env (frame, env);
+  node = scheme_make_node (letrec_eval, form, num_bindings + 1);
+  SCHEME_NODE_FRAME (node) = frame;
+  bindings = SCHEME_CAR (SCHEME_CDR (form));
+  for ( i=0 ; i<num_bindings ; ++i )
     {
-      ret = scheme_eval (SCHEME_CAR (forms), env);
-      forms = SCHEME_CDR (forms);
+      node->nodes[i] = scheme_analyze (SCHEME_CADR (SCHEME_CAR (bindings)), env, 0);
+      bindings = SCHEME_CDR (bindings);
     }
-  /* pop internal define frame */
-  if ( num_int_defs )
+  node->nodes[num_bindings] = scheme_analyze_body (SCHEME_CDDR (form), env, tail);
+  return (node);
+}
+
+static Scheme_Value
+letrec_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  Scheme_Env *frame;
+  int num_bindings, i;
+
+  frame = instantiate_frame (SCHEME_NODE_FRAME (node));
+  num_bindings = frame->num_bindings;
+  env = scheme_extend_env (frame, env);
+  for ( i=0 ; i<num_bindings ; ++i )
     {
-      env = scheme_pop_frame (env);
+      frame->values[i] = SCHEME_EVAL_NODE (node->nodes[i], env);
     }
-  /* pop regular binding frame */
-  env = scheme_pop_frame (env);
-  return (ret);
+  return (SCHEME_EVAL_NODE (node->nodes[num_bindings], env));
 }
 
-static Scheme_Value
-letrec_syntax (Scheme_Value form, Scheme_Env *env)
+static Scheme_Node *
+begin_syntax (Scheme_Value form, Scheme_Env *env, int tail)
 {
-  Scheme_Value bindings, vars, vals, forms, res = scheme_null;
-  Scheme_Value vars_last, vals_last, pair, aform;
-  int num_int_defs;
+  if (SCHEME_NULLP (SCHEME_CDR (form)))
+    {
+      return (scheme_make_const_node (scheme_false));
+    }
+  return (scheme_analyze_seq (SCHEME_CDR (form), env, tail));
+}
 
-  bindings = SCHEME_CAR (SCHEME_CDR (form));
-  vars = scheme_map_1 (scheme_car, bindings);
-  vals = scheme_map_1 (scheme_cadr, bindings);
+/* `do' nodes hold the inits in nodes[0..n-1], the steps (NULL when
+   missing) in nodes[n..2n-1], then the test, the result forms and the
+   body (NULL when empty). */
 
-  env = scheme_add_frame (vars, scheme_alloc_list (scheme_list_length (vars)), env);
-  while (! SCHEME_NULLP (vars))
+static Scheme_Node *
+do_syntax (Scheme_Value form, Scheme_Env *env, int tail)
+{
+  Scheme_Value specs, clause, third, forms;
+  Scheme_Env *frame;
+  Scheme_Node *node;
+  int num_vars, captures, i;
+
+  SCHEME_ASSERT ((scheme_list_length(form) >= 3), "badly formed `do' form");
+  specs = SCHEME_CAR (SCHEME_CDR (form));
+  num_vars = scheme_list_length (specs);
+  frame = scheme_new_frame (num_vars);
+  node = scheme_make_node (do_eval, form, 2 * num_vars + 3);
+  for ( i=0 ; i<num_vars ; ++i )
     {
-      scheme_set_value (SCHEME_CAR (vars),
-			scheme_eval (SCHEME_CAR (vals), env),
-			env);
-      vars = SCHEME_CDR (vars);
-      vals = SCHEME_CDR (vals);
+      clause = SCHEME_CAR (specs);
+      scheme_add_binding (i, binding_var (clause, "do"), scheme_false, frame);
+      node->nodes[i] = scheme_analyze (SCHEME_CADR (clause), env, 0);
+      specs = SCHEME_CDR (specs);
     }
-  forms = SCHEME_CDR (SCHEME_CDR (form));
+  env = scheme_extend_env (frame, env);
+  SCHEME_NODE_FRAME (node) = frame;
+  captures = scheme_capture_count;
 
-  /* process internal defines */
-  num_int_defs = 0;
-  vars = vals = vars_last = vals_last = scheme_null;
-  while (!SCHEME_NULLP(forms) && internal_def_p (SCHEME_CAR(forms)))
+  /* the steps could be missing */
+  specs = SCHEME_CAR (SCHEME_CDR (form));
+  for ( i=0 ; i<num_vars ; ++i )
     {
-      num_int_defs++;
-      aform = SCHEME_CAR (forms);
-      /* get var */
-      if (SCHEME_PAIRP (SCHEME_CAR (SCHEME_CDR (aform))))
-	{
-	  pair = scheme_make_pair (SCHEME_CAR (SCHEME_CAR (SCHEME_CDR (aform))), scheme_null);
-	}
-      else
-	{
-	  pair = scheme_make_pair (SCHEME_CAR (SCHEME_CDR (aform)), scheme_null);
-	}
-      if (SCHEME_NULLP (vars))
-	{
-	  vars = vars_last = pair;
-	}
-      else
-	{
-	  SCHEME_CDR (vars_last) = pair;
-	  vars_last = pair;
-	}
-      /* get val */
-      if (SCHEME_PAIRP (SCHEME_CAR (SCHEME_CDR (aform))))
+      clause = SCHEME_CAR (specs);
+      if (SCHEME_NULLP (SCHEME_CDDR (clause)))
 	{
-	  pair = CONS (CONS (scheme_lambda, CONS (SCHEME_CDR (SCHEME_CAR (SCHEME_CDR (aform))),
-						  SCHEME_CDR (SCHEME_CDR (aform)))),
-		       scheme_null);
+	  node->nodes[num_vars + i] = NULL;
 	}
       else
 	{
-	  pair = scheme_make_pair (SCHEME_CAR (SCHEME_CDR (SCHEME_CDR (aform))), scheme_null);
+	  node->nodes[num_vars + i] = scheme_analyze (SCHEME_CAR (SCHEME_CDDR (clause)), env, 0);
 	}
-      if (SCHEME_NULLP (vals))
-	{
-	  vals = vals_last = pair;
-	}
-      else
-	{
-	  SCHEME_CDR (vals_last) = pair;
-	  vals_last = pair;
-	}
-      forms = SCHEME_CDR (forms);
+      specs = SCHEME_CDR (specs);
     }
-  if ( num_int_defs )
-    {
-      env = scheme_add_frame (vars, scheme_alloc_list (num_int_defs), env);
-      while (! SCHEME_NULLP (vars))
-	{
-	  scheme_set_value (SCHEME_CAR(vars),
-			    scheme_eval (SCHEME_CAR (vals), env),
-			    env);
-	  vars = SCHEME_CDR (vars);
-	  vals = SCHEME_CDR (vals);
-	}
-    }
-  while (! SCHEME_NULLP (forms))
-    {
-      res = scheme_eval (SCHEME_CAR (forms), env);
-      forms = SCHEME_CDR (forms);
-    }
-  /* pop internal define frame */
-  if ( num_int_defs )
+
+  third = SCHEME_CAR (SCHEME_CDDR (form));
+  SCHEME_ASSERT (SCHEME_PAIRP (third), "badly formed `do' form");
+  forms = SCHEME_CDR (SCHEME_CDDR (form));
+  node->nodes[2 * num_vars] = scheme_analyze (SCHEME_CAR (third), env, 0);
+  node->nodes[2 * num_vars + 1] =
+    SCHEME_NULLP (SCHEME_CDR (third)) ? NULL : scheme_analyze_seq (SCHEME_CDR (third), env, tail);
+  node->nodes[2 * num_vars + 2] =
+    SCHEME_NULLP (forms) ? NULL : scheme_analyze_seq (forms, env, 0);
+  if (captures == scheme_capture_count && num_vars <= SCHEME_STACK_FRAME)
     {
-      env = scheme_pop_frame (env);
+      node->eval = do_stack_eval;
     }
-  /* pop regular binding frame */
-  env = scheme_pop_frame (env);
-  return (res);
+  return (node);
 }
 
 static Scheme_Value
-begin_syntax (Scheme_Value form, Scheme_Env *env)
+do_eval (Scheme_Node *node, Scheme_Env *env)
 {
-  Scheme_Value forms, ret;
+  Scheme_Env *scope, *frame, *next;
+  Scheme_Node **steps, *test, *finals, *body;
+  Scheme_Value ret;
+  int num_vars, i;
+
+  scope = SCHEME_NODE_FRAME (node);
+  num_vars = scope->num_bindings;
+  steps = node->nodes + num_vars;
+  test = node->nodes[2 * num_vars];
+  finals = node->nodes[2 * num_vars + 1];
+  body = node->nodes[2 * num_vars + 2];
 
-  ret = scheme_false;
-  forms = SCHEME_CDR (form);
-  while (forms != scheme_null)
+  /* bind the vars to the initial values */
+  frame = instantiate_frame (scope);
+  for ( i=0 ; i<num_vars ; ++i )
     {
-      ret = scheme_eval (SCHEME_CAR (forms), env);
-      forms = SCHEME_CDR (forms);
+      frame->values[i] = SCHEME_EVAL_NODE (node->nodes[i], env);
     }
-  return (ret);
-}
+  frame = scheme_extend_env (frame, env);
 
-static Scheme_Value
-do_syntax (Scheme_Value form, Scheme_Env *env)
-{
-  Scheme_Value second, third;
-  Scheme_Value vars, inits, steps;
-  Scheme_Value test, finals, forms;
-  Scheme_Value ret, temp;
-  Scheme_Value step_first, step_last, clause, pair;
-
-  second = SCHEME_CAR (SCHEME_CDR (form));
-  vars = scheme_map_1 (scheme_car, second);
-  inits = scheme_map_1 (scheme_cadr, second);
-
-  /* We can't just map across the steps because
-     the could be missing. */
-  temp = second;
-  step_first = step_last = scheme_null;
-  while (! SCHEME_NULLP (temp))
-    {
-      clause = SCHEME_CAR (temp);
-      if (SCHEME_NULLP (SCHEME_CDR (SCHEME_CDR (clause))))
-	{
-	  pair = scheme_make_pair (SCHEME_CAR (clause), scheme_null);
-	}
-      else
-	{
-	  pair = scheme_make_pair (SCHEME_CAR (SCHEME_CDR (SCHEME_CDR (clause))), scheme_null);
-	}
-      if (SCHEME_NULLP (step_first))
+  ret = scheme_null;
+  while (SCHEME_EVAL_NODE (test, frame) == scheme_false)
+    {
+      if (body)
 	{
-	  step_first = step_last = pair;
+	  ret = SCHEME_EVAL_NODE (body, frame);
 	}
-      else
+      /* evaluate step expressions (all in the old frame)
+	 and rebind the vars in a fresh one */
+      next = instantiate_frame (scope);
+      for ( i=0 ; i<num_vars ; ++i )
 	{
-	  SCHEME_CDR (step_last) = pair;
-	  step_last = pair;
+	  next->values[i] = (steps[i]
+			     ? SCHEME_EVAL_NODE (steps[i], frame)
+			     : frame->values[i]);
 	}
-      temp = SCHEME_CDR (temp);
+      frame = scheme_extend_env (next, env);
     }
-  steps = step_first;
-
-  third = SCHEME_CAR (SCHEME_CDR (SCHEME_CDR (form)));
-  test = SCHEME_CAR (third);
-  finals = SCHEME_CDR (third);
-
-  forms = SCHEME_CDR (SCHEME_CDR (SCHEME_CDR (form)));
+  if (finals)
+    {
+      ret = SCHEME_EVAL_NODE (finals, frame);
+    }
+  return (ret);
+}
 
-  /* first evaluate the inits */
-  temp = inits;
-  while (! SCHEME_NULLP (temp))
+/* When nothing in the loop can capture its frame, the iterations
+   alternate between two frames on the C stack instead of making a
+   fresh one each time. */
+static Scheme_Value
+do_stack_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  Scheme_Env *scope, *frame, *next, frames[2];
+  Scheme_Node **steps, *test, *finals, *body;
+  Scheme_Value ret, values[2][SCHEME_STACK_FRAME];
+  int num_vars, cur, i;
+
+  scope = SCHEME_NODE_FRAME (node);
+  num_vars = scope->num_bindings;
+  steps = node->nodes + num_vars;
+  test = node->nodes[2 * num_vars];
+  finals = node->nodes[2 * num_vars + 1];
+  body = node->nodes[2 * num_vars + 2];
+
+  for ( cur=0 ; cur<2 ; ++cur )
     {
-      SCHEME_CAR(temp) = scheme_eval (SCHEME_CAR(temp), env);
-      temp = SCHEME_CDR (temp);
+      scheme_stack_frame (&frames[cur], values[cur], num_vars, scope->symbols);
+      scheme_extend_env (&frames[cur], env);
+    }
+  cur = 0;
+  frame = &frames[cur];
+  for ( i=0 ; i<num_vars ; ++i )
+    {
+      frame->values[i] = SCHEME_EVAL_NODE (node->nodes[i], env);
     }
-  /* bind the vars to the initial values */
-  env = scheme_add_frame (vars, inits, env);
 
   ret = scheme_null;
-  while (scheme_eval (test, env) == scheme_false)
+  while (SCHEME_EVAL_NODE (test, frame) == scheme_false)
     {
-      /* evaluate forms in body */
-      temp = forms;
-      while (! SCHEME_NULLP (temp))
+      if (body)
 	{
-	  ret = scheme_eval (SCHEME_CAR(temp), env);
-	  temp = SCHEME_CDR (temp);
+	  ret = SCHEME_EVAL_NODE (body, frame);
 	}
-      /* evaluate step expressions (all in the old env)
-	 and rebind the vars */
-      temp = steps;
-      step_first = step_last = scheme_null;
-      while (! SCHEME_NULLP (temp))
+      cur = !cur;
+      next = &frames[cur];
+      for ( i=0 ; i<num_vars ; ++i )
 	{
-	  pair = scheme_make_pair (scheme_eval (SCHEME_CAR(temp), env), scheme_null);
-	  if (step_first == scheme_null)
-	    {
-	      step_first = step_last = pair;
-	    }
-	  else
-	    {
-	      SCHEME_CDR (step_last) = pair;
-	      step_last = pair;
-	    }
-	  temp = SCHEME_CDR (temp);
+	  next->values[i] = (steps[i]
+			     ? SCHEME_EVAL_NODE (steps[i], frame)
+			     : frame->values[i]);
 	}
-      env = scheme_pop_frame (env);
-      env = scheme_add_frame (vars, step_first, env);
+      frame = next;
     }
-  /* evaluate the return forms */
-  temp = finals;
-  while (! SCHEME_NULLP (temp))
+  if (finals)
     {
-      ret = scheme_eval (SCHEME_CAR (temp), env);
-      temp = SCHEME_CDR (temp);
+      ret = SCHEME_EVAL_NODE (finals, frame);
     }
-
-  /* pop the frame we've added */
-  env = scheme_pop_frame (env);
   return (ret);
 }
 
-static Scheme_Value
-delay_syntax (Scheme_Value form, Scheme_Env *env)
+static Scheme_Node *
+delay_syntax (Scheme_Value form, Scheme_Env *env, int tail)
 {
+  Scheme_Node *node;
+
   SCHEME_ASSERT ((scheme_list_length(form) == 2), "delay: bad form");
-  return (scheme_make_promise  (SCHEME_CAR (SCHEME_CDR (form)), env));
+  scheme_capture_count++;
+  node = scheme_make_node (delay_eval, form, 0);
+  SCHEME_NODE_VAL (node) = SCHEME_CAR (SCHEME_CDR (form));
+  return (node);
 }
 
-static Scheme_Value quasi (Scheme_Value x, int level, Scheme_Env *env);
+static Scheme_Value
+delay_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  return (scheme_make_promise (SCHEME_NODE_VAL (node), env));
+}
+
+/* The expression of a future is analyzed here rather than by the
+   thread that runs it, which leaves the globals table alone. */
+static Scheme_Node *
+future_syntax (Scheme_Value form, Scheme_Env *env, int tail)
+{
+  Scheme_Node *node;
+
+  SCHEME_ASSERT ((scheme_list_length(form) == 2), "future: bad form");
+  scheme_capture_count++;
+  node = scheme_make_node (future_eval, form, 1);
+  node->nodes[0] = scheme_analyze (SCHEME_CADR (form), env, 0);
+  return (node);
+}
 
 static Scheme_Value
-quasiquote_syntax (Scheme_Value form, Scheme_Env *env)
+future_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  return (scheme_make_future (node->nodes[0], env));
+}
+
+/* Quasiquote templates are analyzed into nodes that build fresh
+   structure around the unquoted expressions. */
+
+static Scheme_Node *quasi (Scheme_Value x, int level, Scheme_Env *env);
+static Scheme_Node *make_qq_node (Scheme_Node_Proc *proc, Scheme_Value x,
+				  Scheme_Node *first, Scheme_Node *second);
+
+static Scheme_Node *
+quasiquote_syntax (Scheme_Value form, Scheme_Env *env, int tail)
 {
   SCHEME_ASSERT ((scheme_list_length (form) == 2), "quasiquote(`): wrong number of args");
   return (quasi (SCHEME_CAR (SCHEME_CDR (form)), 0, env));
 }
 
-static Scheme_Value
+static Scheme_Node *
 quasi (Scheme_Value x, int level, Scheme_Env *env)
 {
-  Scheme_Value form, list, tail, cell, qcar, qcdr, ret;
+  Scheme_Node *qcar, *qcdr;
 
   if (SCHEME_VECTORP (x))
     {
-      x = scheme_vector_to_list (x);
-      x = quasi (x, level, env);
-      return (scheme_list_to_vector (x));
+      return (make_qq_node (qq_vector_eval, x,
+			    quasi (scheme_vector_to_list (x), level, env), NULL));
     }
   if (! SCHEME_PAIRP (x))
     {
-      return x;
+      return (scheme_make_const_node (x));
     }
   if (SCHEME_CAR (x) == scheme_unquote)
     {
-      x = SCHEME_CDR (x);
-      SCHEME_ASSERT (SCHEME_PAIRP (x), "bad unquote form");
+      SCHEME_ASSERT (SCHEME_PAIRP (SCHEME_CDR (x)), "bad unquote form");
       if (level)
 	{
-	  ret = scheme_make_pair (SCHEME_CAR (x), scheme_null);
-	  ret = quasi (ret, level-1, env);
-	  ret = scheme_make_pair (scheme_unquote, ret);
+	  qcdr = quasi (scheme_make_pair (SCHEME_CADR (x), scheme_null), level-1, env);
+	  return (make_qq_node (qq_cons_eval, x, scheme_make_const_node (scheme_unquote), qcdr));
         }
       else
 	{
-	  ret = scheme_eval (SCHEME_CAR (x), env);
+	  return (scheme_analyze (SCHEME_CADR (x), env, 0));
 	}
-      return ret;
     }
   else if (SCHEME_PAIRP (SCHEME_CAR (x))
 	   && SCHEME_CAR (SCHEME_CAR (x)) == scheme_unquote_splicing)
     {
-      qcdr = SCHEME_CDR (x);
-      form = list = tail = cell = scheme_null;
-      x = SCHEME_CAR (x);
-      SCHEME_ASSERT (SCHEME_PAIRP (SCHEME_CDR (x)), "bad unquote-splicing form");
+      Scheme_Value splice;
+
+      splice = SCHEME_CAR (x);
+      SCHEME_ASSERT (SCHEME_PAIRP (SCHEME_CDR (splice)), "bad unquote-splicing form");
+      qcdr = quasi (SCHEME_CDR (x), level, env);
       if (level)
 	{
-	  list = quasi (SCHEME_CDR (x), level-1, env);
-	  list = scheme_make_pair (scheme_unquote_splicing, list);
-	  qcdr = quasi (qcdr, level, env);
-	  list = scheme_make_pair (list, qcdr);
-	  return list;
-	}
-      form = scheme_eval (SCHEME_CAR (SCHEME_CDR (x)), env);
-      for ( ; SCHEME_PAIRP(form) ; tail = cell, form = SCHEME_CDR (form))
-	{
-	  cell = scheme_make_pair (SCHEME_CAR (form), scheme_null);
-	  if (SCHEME_NULLP (list))
-	    list = cell;
-	  else
-	    SCHEME_CDR(tail) = cell;
-	}
-      qcdr = quasi (qcdr, level, env);
-      if (SCHEME_NULLP (list))
-	{
-	  return qcdr;
+	  qcar = make_qq_node (qq_cons_eval, splice,
+			       scheme_make_const_node (scheme_unquote_splicing),
+			       quasi (SCHEME_CDR (splice), level-1, env));
+	  return (make_qq_node (qq_cons_eval, x, qcar, qcdr));
 	}
-      SCHEME_CDR (tail) = qcdr;
-      return list;
+      return (make_qq_node (qq_splice_eval, x,
+			    scheme_analyze (SCHEME_CADR (splice), env, 0), qcdr));
     }
   else
     {
-      qcar = qcdr = scheme_null;
       if (SCHEME_CAR (x) == scheme_quasiquote)   /* hack! */
 	{
 	  ++level;
 	}
       qcar = quasi (SCHEME_CAR (x), level, env);
       qcdr = quasi (SCHEME_CDR (x), level, env);
-      list = scheme_make_pair (qcar, qcdr);
-      return list;
+      return (make_qq_node (qq_cons_eval, x, qcar, qcdr));
     }
 }
 
+static Scheme_Node *
+make_qq_node (Scheme_Node_Proc *proc, Scheme_Value x,
+	      Scheme_Node *first, Scheme_Node *second)
+{
+  Scheme_Node *node;
+
+  node = scheme_make_node (proc, x, 2);
+  node->nodes[0] = first;
+  node->nodes[1] = second;
+  return (node);
+}
+
 static Scheme_Value
-defmacro_syntax (Scheme_Value form, Scheme_Env *env)
+qq_cons_eval (Scheme_Node *node, Scheme_Env *env)
 {
-  Scheme_Value name, code;
-  Scheme_Value fun, macro;
+  Scheme_Value qcar;
+
+  qcar = SCHEME_EVAL_NODE (node->nodes[0], env);
+  return (scheme_make_pair (qcar, SCHEME_EVAL_NODE (node->nodes[1], env)));
+}
+
+static Scheme_Value
+qq_splice_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  Scheme_Value form, list, tail, cell;
+
+  list = tail = scheme_null;
+  form = SCHEME_EVAL_NODE (node->nodes[0], env);
+  for ( ; SCHEME_PAIRP(form) ; tail = cell, form = SCHEME_CDR (form))
+    {
+      cell = scheme_make_pair (SCHEME_CAR (form), scheme_null);
+      if (SCHEME_NULLP (list))
+	list = cell;
+      else
+	SCHEME_CDR(tail) = cell;
+    }
+  if (SCHEME_NULLP (list))
+    {
+      return (SCHEME_EVAL_NODE (node->nodes[1], env));
+    }
+  SCHEME_CDR (tail) = SCHEME_EVAL_NODE (node->nodes[1], env);
+  return (list);
+}
+
+static Scheme_Value
+qq_vector_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  return (scheme_list_to_vector (SCHEME_EVAL_NODE (node->nodes[0], env)));
+}
+
+static Scheme_Node *
+defmacro_syntax (Scheme_Value form, Scheme_Env *env, int tail)
+{
+  Scheme_Value name;
+  Scheme_Node *node;
 
   SCHEME_ASSERT ((scheme_list_length (form) > 3), "badly formed defmacro");
   name = SCHEME_CAR (SCHEME_CDR (form));
   SCHEME_ASSERT (SCHEME_SYMBOLP (name), "defmacro: second arg must be a symbol");
-  code = SCHEME_CDR (SCHEME_CDR (form));
-  fun = scheme_make_closure (env, code);
+  node = scheme_make_node (defmacro_eval, form, 0);
+  SCHEME_NODE_LAMBDA (node) = scheme_analyze_lambda (SCHEME_CDDR (form), env);
+  return (node);
+}
+
+static Scheme_Value
+defmacro_eval (Scheme_Node *node, Scheme_Env *env)
+{
+  Scheme_Value name, fun, macro;
+
+  name = SCHEME_CADR (node->form);
+  fun = scheme_make_lambda_closure (env, SCHEME_NODE_LAMBDA (node));
 
-  macro = scheme_alloc_object (scheme_macro_type, 0);
+  macro = scheme_alloc_sized (scheme_macro_type, SCHEME_OBJ_SIZE (ptr_val));
   SCHEME_PTR_VAL (macro) = fun;
 
   scheme_add_global (SCHEME_STR_VAL (name), macro, env);
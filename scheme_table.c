@@ -0,0 +1,720 @@
+/*
+  libscheme
+  Copyright (c) 1994 Brent Benson
+  All rights reserved.
+
+  Permission is hereby granted, without written agreement and without
+  license or royalty fees, to use, copy, modify, and distribute this
+  software and its documentation for any purpose, provided that the
+  above copyright notice and the following two paragraphs appear in
+  all copies of this software.
+
+  IN NO EVENT SHALL BRENT BENSON BE LIABLE TO ANY PARTY FOR DIRECT,
+  INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES ARISING OUT
+  OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF BRENT
+  BENSON HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+  BRENT BENSON SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT
+  NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER
+  IS ON AN "AS IS" BASIS, AND BRENT BENSON HAS NO OBLIGATION TO
+  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR
+  MODIFICATIONS.
+*/
+
+/* Hash tables for Scheme code, keyed by eq?, eqv?, equal? or string
+   contents.  They use open addressing like scheme_hash.c, but a
+   deleted entry keeps its hash with a NULL key so that probing goes
+   on past it.  The keys are kept in memory from scheme_malloc_keys, so
+   a table whose keys are hashed by address is rehashed only after the
+   collector has moved one of them. */
+
+#include "scheme_private.h"
+#include <string.h>
+
+enum { EQ_TABLE, EQV_TABLE, EQUAL_TABLE, STRING_TABLE };
+
+typedef struct Keys
+{
+  uintptr_t moved;		/* set by the collector */
+  Scheme_Value key[1];		/* NULL for a deleted entry */
+} Keys;
+
+typedef struct Table
+{
+  unsigned int *hashes;		/* 0 for an empty entry */
+  Keys *keys;
+  Scheme_Value *vals;
+  int kind;
+  int size;			/* a power of two */
+  int count;			/* keys in the table */
+  int used;			/* entries not empty, deleted ones too */
+  int by_address;		/* some key is hashed by its address */
+} Table;
+
+/* the most pairs and vector elements equal-hash looks at */
+#define EQUAL_HASH_NODES 64
+
+#define TABLE_OF(obj) ((Table *) SCHEME_PTR_VAL (obj))
+#define KEY(t, i) ((t)->keys->key[i])
+/* some key of T has moved since it was hashed by its address */
+#define STALE(t) ((t)->by_address && (t)->keys->moved)
+
+/* globals */
+Scheme_Value scheme_hash_table_type;
+
+/* locals */
+static Scheme_Layout *table_layout;
+SCHEME_DEFINE_ONCE (layout_once);
+
+static Scheme_Value make_table (int kind, const char *name, int argc, Scheme_Value argv[]);
+static Scheme_Value make_eq_hash_table (int argc, Scheme_Value argv[]);
+static Scheme_Value make_eqv_hash_table (int argc, Scheme_Value argv[]);
+static Scheme_Value make_equal_hash_table (int argc, Scheme_Value argv[]);
+static Scheme_Value make_string_hash_table (int argc, Scheme_Value argv[]);
+static Scheme_Value hash_table_p (Scheme_Value obj);
+static Scheme_Value hash_table_ref (int argc, Scheme_Value argv[]);
+static Scheme_Value hash_table_set (Scheme_Value table, Scheme_Value key, Scheme_Value val);
+static Scheme_Value hash_table_delete (Scheme_Value table, Scheme_Value key);
+static Scheme_Value hash_table_update (int argc, Scheme_Value argv[]);
+static Scheme_Value hash_table_count (Scheme_Value table);
+static Scheme_Value hash_table_fold (Scheme_Value table, Scheme_Value proc, Scheme_Value init);
+static Scheme_Value hash_table_keys (Scheme_Value table);
+static Scheme_Value hash_table_values (Scheme_Value table);
+static Scheme_Value equal_hash (Scheme_Value obj);
+
+static void init_layout (void);
+static unsigned int address_hash (void *p);
+static unsigned int eqv_hash (Scheme_Value obj, int *by_address);
+static unsigned int equal_hash_1 (Scheme_Value obj, int *by_address, int *nodes);
+static unsigned int key_hash (Table *t, Scheme_Value key, int *by_address);
+static int same_key (Table *t, Scheme_Value a, Scheme_Value b);
+static void resize (Table *t, int size);
+static int find (Table *t, Scheme_Value key);
+static void put (Table *t, Scheme_Value key, Scheme_Value val);
+static Table *check_table (Scheme_Value obj, const char *name);
+static Table *check_mutable (Scheme_Value obj, const char *name);
+static void check_key (Table *t, Scheme_Value key, const char *name);
+
+static const Scheme_Prim_Entry table_prims[] =
+{
+  SCHEME_PRIM_ENTRY ("make-eq-hash-table", make_eq_hash_table, 0, 1),
+  SCHEME_PRIM_ENTRY ("make-eqv-hash-table", make_eqv_hash_table, 0, 1),
+  SCHEME_PRIM_ENTRY ("make-equal-hash-table", make_equal_hash_table, 0, 1),
+  SCHEME_PRIM_ENTRY ("make-string-hash-table", make_string_hash_table, 0, 1),
+  SCHEME_PRIM1_ENTRY ("hash-table?", hash_table_p),
+  SCHEME_PRIM_ENTRY ("hash-table-ref", hash_table_ref, 2, 3),
+  SCHEME_PRIM3_ENTRY ("hash-table-set!", hash_table_set),
+  SCHEME_PRIM2_ENTRY ("hash-table-delete!", hash_table_delete),
+  SCHEME_PRIM_ENTRY ("hash-table-update!", hash_table_update, 3, 4),
+  SCHEME_PRIM1_ENTRY ("hash-table-count", hash_table_count),
+  SCHEME_PRIM3_ENTRY ("hash-table-fold", hash_table_fold),
+  SCHEME_PRIM1_ENTRY ("hash-table-keys", hash_table_keys),
+  SCHEME_PRIM1_ENTRY ("hash-table-values", hash_table_values),
+  SCHEME_PRIM1_ENTRY ("equal-hash", equal_hash)
+};
+
+void
+scheme_init_table (Scheme_Env *env)
+{
+  scheme_hash_table_type = scheme_make_builtin_type ("<hash-table>", SCHEME_HASH_TABLE_TYPE_INDEX);
+  scheme_add_global ("<hash-table>", scheme_hash_table_type, env);
+  scheme_add_prims (table_prims, SCHEME_NUM_ENTRIES (table_prims), env);
+  SCHEME_ONCE (layout_once, init_layout);
+}
+
+/* The hash of OBJ that is the same for objects that are equal?.  It
+   looks at no more than EQUAL_HASH_NODES pairs and vector elements;
+   an object compared by identity is hashed by its address, and *BY_ADDRESS
+   is set. */
+unsigned int
+scheme_equal_hash (Scheme_Value obj, int *by_address)
+{
+  int nodes = EQUAL_HASH_NODES;
+
+  return (equal_hash_1 (obj, by_address, &nodes));
+}
+
+/* Make a table of KIND, as given by scheme_table_kind, with room for
+   SIZE keys. */
+Scheme_Value
+scheme_make_table (int kind, int size)
+{
+  Scheme_Value obj;
+  Table *t;
+  int n;
+
+  for ( n=8 ; 100 * size > SCHEME_HASH_LOAD * n ; n*=2 )
+    ;
+  t = (Table *) scheme_malloc_typed (sizeof (Table), table_layout);
+  t->kind = kind;
+  t->size = 0;
+  t->count = 0;
+  t->by_address = 0;
+  t->hashes = NULL;
+  t->keys = NULL;
+  t->vals = NULL;
+  resize (t, n);
+  obj = scheme_alloc_sized (scheme_hash_table_type, SCHEME_OBJ_SIZE (ptr_val));
+  SCHEME_PTR_VAL (obj) = t;
+  return (obj);
+}
+
+int
+scheme_table_kind (Scheme_Value table)
+{
+  return (TABLE_OF (table)->kind);
+}
+
+/* The index of the first entry of TABLE at I or after, setting *KEY
+   and *VAL to it, or -1 if there is none. */
+int
+scheme_table_next (Scheme_Value table, int i, Scheme_Value *key, Scheme_Value *val)
+{
+  Table *t = TABLE_OF (table);
+
+  for ( ; i<t->size ; ++i )
+    {
+      if (KEY (t, i))
+	{
+	  *key = KEY (t, i);
+	  *val = t->vals[i];
+	  return (i);
+	}
+    }
+  return (-1);
+}
+
+void
+scheme_table_put (Scheme_Value table, Scheme_Value key, Scheme_Value val)
+{
+  put (TABLE_OF (table), key, val);
+}
+
+/* Freeze TABLE and its keys and values, for scheme_freeze. */
+void
+scheme_freeze_table (Scheme_Value table)
+{
+  Table *t = TABLE_OF (table);
+  int i;
+
+  table->header |= SCHEME_FROZEN_FLAG;
+  for ( i=0 ; i<t->size ; ++i )
+    {
+      if (KEY (t, i))
+	{
+	  scheme_freeze (KEY (t, i));
+	  scheme_freeze (t->vals[i]);
+	}
+    }
+}
+
+/* locals */
+
+static void
+init_layout (void)
+{
+  table_layout = scheme_make_layout (sizeof (Table),
+				     SCHEME_LAYOUT_SLOT (Table, hashes)
+				     | SCHEME_LAYOUT_SLOT (Table, keys)
+				     | SCHEME_LAYOUT_SLOT (Table, vals));
+}
+
+static unsigned int
+address_hash (void *p)
+{
+  uintptr_t a = (uintptr_t) p;
+
+  return ((unsigned int) ((a >> 3) ^ (a >> (4 * sizeof (uintptr_t)))) * 2654435761u);
+}
+
+/* the hash of OBJ that is the same for objects that are eqv? */
+static unsigned int
+eqv_hash (Scheme_Value obj, int *by_address)
+{
+  if (SCHEME_IMMEDIATEP (obj))
+    {
+      return (address_hash (obj));
+    }
+  switch (SCHEME_TYPE_INDEX (obj))
+    {
+    case SCHEME_SYMBOL_TYPE_INDEX:
+      /* eqv? compares symbols by name */
+      return (SCHEME_SYM_HASH (obj));
+    case SCHEME_DOUBLE_TYPE_INDEX:
+      {
+	double d = SCHEME_DBL_VAL (obj);
+	uint64_t bits;
+
+	if (d == 0.0)
+	  {
+	    /* -0.0 is eqv? to 0.0 */
+	    d = 0.0;
+	  }
+	memcpy (&bits, &d, sizeof (bits));
+	return ((unsigned int) (bits ^ (bits >> 32)) * 2654435761u);
+      }
+    case SCHEME_POINTER_TYPE_INDEX:
+      return (address_hash (SCHEME_PTR_VAL (obj)));
+    default:
+      *by_address = 1;
+      return (address_hash (obj));
+    }
+}
+
+static unsigned int
+equal_hash_1 (Scheme_Value obj, int *by_address, int *nodes)
+{
+  unsigned int h;
+  int i;
+
+  if (SCHEME_PAIRP (obj))
+    {
+      h = 17;
+      while (SCHEME_PAIRP (obj) && *nodes > 0)
+	{
+	  --*nodes;
+	  h = h * 31 + equal_hash_1 (SCHEME_CAR (obj), by_address, nodes);
+	  obj = SCHEME_CDR (obj);
+	}
+      if (! SCHEME_PAIRP (obj))
+	{
+	  h = h * 31 + equal_hash_1 (obj, by_address, nodes);
+	}
+      return (h);
+    }
+  else if (SCHEME_VECTORP (obj))
+    {
+      h = 19 + SCHEME_VEC_SIZE (obj);
+      for ( i=0 ; i<SCHEME_VEC_SIZE (obj) && *nodes > 0 ; ++i )
+	{
+	  --*nodes;
+	  h = h * 31 + equal_hash_1 (SCHEME_VEC_ELS (obj)[i], by_address, nodes);
+	}
+      return (h);
+    }
+  else if (SCHEME_STRINGP (obj))
+    {
+      return (scheme_hash_string (SCHEME_STR_VAL (obj)));
+    }
+  return (eqv_hash (obj, by_address));
+}
+
+/* the hash of KEY in T, never 0, setting *BY_ADDRESS if it is hashed
+   by its address.  Lookups leave T alone, so that any number of
+   threads may read a frozen table. */
+static unsigned int
+key_hash (Table *t, Scheme_Value key, int *by_address)
+{
+  unsigned int h;
+
+  switch (t->kind)
+    {
+    case EQ_TABLE:
+      if (SCHEME_SYMBOLP (key))
+	{
+	  h = SCHEME_SYM_HASH (key);
+	}
+      else
+	{
+	  if (! SCHEME_IMMEDIATEP (key))
+	    {
+	      *by_address = 1;
+	    }
+	  h = address_hash (key);
+	}
+      break;
+    case EQV_TABLE:
+      h = eqv_hash (key, by_address);
+      break;
+    case EQUAL_TABLE:
+      h = scheme_equal_hash (key, by_address);
+      break;
+    default:
+      h = scheme_hash_string (SCHEME_STR_VAL (key));
+      break;
+    }
+  return (h ? h : 1);
+}
+
+static int
+same_key (Table *t, Scheme_Value a, Scheme_Value b)
+{
+  if (a == b)
+    {
+      return (1);
+    }
+  switch (t->kind)
+    {
+    case EQ_TABLE:
+      return (0);
+    case EQV_TABLE:
+      return (scheme_eqv (a, b));
+    case EQUAL_TABLE:
+      return (scheme_equal (a, b));
+    default:
+      return (strcmp (SCHEME_STR_VAL (a), SCHEME_STR_VAL (b)) == 0);
+    }
+}
+
+/* Move the keys of T into new arrays of SIZE entries, dropping the
+   deleted ones.  The keys are hashed again if any is hashed by
+   address, so this also brings a stale table up to date. */
+static void
+resize (Table *t, int size)
+{
+  unsigned int *hashes, *old_hashes;
+  Scheme_Value *vals, *old_vals;
+  Keys *keys, *old_keys;
+  int i, j, old_size, rehash;
+
+  hashes = (unsigned int *) scheme_malloc_atomic (size * sizeof (unsigned int));
+  keys = (Keys *) scheme_malloc_keys (offsetof (Keys, key) + size * sizeof (Scheme_Value));
+  vals = (Scheme_Value *) scheme_calloc (size, sizeof (Scheme_Value));
+  memset (hashes, 0, size * sizeof (unsigned int));
+
+  /* nothing below allocates, so no key moves between being hashed and
+     being stored in KEYS, which the collector watches from then on */
+  old_hashes = t->hashes;
+  old_keys = t->keys;
+  old_vals = t->vals;
+  old_size = t->size;
+  rehash = t->by_address;
+  t->hashes = hashes;
+  t->keys = keys;
+  t->vals = vals;
+  SCHEME_GC_WRITE (&t->hashes);
+  SCHEME_GC_WRITE (&t->keys);
+  SCHEME_GC_WRITE (&t->vals);
+  t->size = size;
+  t->used = t->count;
+  t->by_address = 0;
+  for ( i=0 ; i<old_size ; ++i )
+    {
+      unsigned int h;
+
+      if (! old_keys->key[i])
+	{
+	  continue;
+	}
+      h = rehash ? key_hash (t, old_keys->key[i], &t->by_address) : old_hashes[i];
+      for ( j=h & (size - 1) ; hashes[j] ; j=(j + 1) & (size - 1) )
+	;
+      hashes[j] = h;
+      keys->key[j] = old_keys->key[i];
+      vals[j] = old_vals[i];
+    }
+}
+
+/* the index of KEY in T, or -1 */
+static int
+find (Table *t, Scheme_Value key)
+{
+  unsigned int mask, h;
+  int i, by_address;
+
+  if (STALE (t))
+    {
+      resize (t, t->size);
+    }
+  h = key_hash (t, key, &by_address);
+  mask = t->size - 1;
+  for ( i=h & mask ; t->hashes[i] ; i=(i + 1) & mask )
+    {
+      if (t->hashes[i] == h && KEY (t, i) && same_key (t, KEY (t, i), key))
+	{
+	  return (i);
+	}
+    }
+  return (-1);
+}
+
+static void
+put (Table *t, Scheme_Value key, Scheme_Value val)
+{
+  unsigned int mask, h;
+  int i, free;
+
+  /* make room first, as that allocates */
+  if (100 * (t->used + 1) > SCHEME_HASH_LOAD * t->size)
+    {
+      resize (t, (100 * (t->count + 1) > SCHEME_HASH_LOAD * t->size / 2)
+		 ? 2 * t->size : t->size);
+    }
+  else if (STALE (t))
+    {
+      resize (t, t->size);
+    }
+  h = key_hash (t, key, &t->by_address);
+  mask = t->size - 1;
+  free = -1;
+  for ( i=h & mask ; t->hashes[i] ; i=(i + 1) & mask )
+    {
+      if (! KEY (t, i))
+	{
+	  if (free < 0)
+	    {
+	      free = i;
+	    }
+	}
+      else if (t->hashes[i] == h && same_key (t, KEY (t, i), key))
+	{
+	  t->vals[i] = val;
+	  SCHEME_GC_WRITE (&t->vals[i]);
+	  return;
+	}
+    }
+  if (free < 0)
+    {
+      free = i;
+      t->used++;
+    }
+  t->hashes[free] = h;
+  KEY (t, free) = key;
+  SCHEME_GC_WRITE (&KEY (t, free));
+  t->vals[free] = val;
+  SCHEME_GC_WRITE (&t->vals[free]);
+  t->count++;
+}
+
+static Table *
+check_table (Scheme_Value obj, const char *name)
+{
+  if (! SCHEME_HASH_TABLEP (obj))
+    {
+      scheme_signal_error ("%s: first arg must be a hash table", name);
+    }
+  return (TABLE_OF (obj));
+}
+
+static Table *
+check_mutable (Scheme_Value obj, const char *name)
+{
+  Table *t;
+
+  t = check_table (obj, name);
+  if (SCHEME_FROZENP (obj))
+    {
+      scheme_signal_error ("%s: hash table is frozen", name);
+    }
+  return (t);
+}
+
+static void
+check_key (Table *t, Scheme_Value key, const char *name)
+{
+  if (t->kind == STRING_TABLE && ! SCHEME_STRINGP (key))
+    {
+      scheme_signal_error ("%s: key must be a string", name);
+    }
+}
+
+static Scheme_Value
+make_table (int kind, const char *name, int argc, Scheme_Value argv[])
+{
+  int size;
+
+  size = 0;
+  if (argc == 1)
+    {
+      if (! SCHEME_INTP (argv[0]) || SCHEME_INT_VAL (argv[0]) < 0)
+	{
+	  scheme_signal_error ("%s: size must be a non-negative integer", name);
+	}
+      size = SCHEME_INT_VAL (argv[0]);
+    }
+  return (scheme_make_table (kind, size));
+}
+
+static Scheme_Value
+make_eq_hash_table (int argc, Scheme_Value argv[])
+{
+  return (make_table (EQ_TABLE, "make-eq-hash-table", argc, argv));
+}
+
+static Scheme_Value
+make_eqv_hash_table (int argc, Scheme_Value argv[])
+{
+  return (make_table (EQV_TABLE, "make-eqv-hash-table", argc, argv));
+}
+
+static Scheme_Value
+make_equal_hash_table (int argc, Scheme_Value argv[])
+{
+  return (make_table (EQUAL_TABLE, "make-equal-hash-table", argc, argv));
+}
+
+static Scheme_Value
+make_string_hash_table (int argc, Scheme_Value argv[])
+{
+  return (make_table (STRING_TABLE, "make-string-hash-table", argc, argv));
+}
+
+static Scheme_Value
+hash_table_p (Scheme_Value obj)
+{
+  return (SCHEME_HASH_TABLEP (obj) ? scheme_true : scheme_false);
+}
+
+/* (hash-table-ref table key [default]) */
+static Scheme_Value
+hash_table_ref (int argc, Scheme_Value argv[])
+{
+  Table *t;
+  int i;
+
+  t = check_table (argv[0], "hash-table-ref");
+  check_key (t, argv[1], "hash-table-ref");
+  i = find (t, argv[1]);
+  if (i >= 0)
+    {
+      return (t->vals[i]);
+    }
+  if (argc == 3)
+    {
+      return (argv[2]);
+    }
+  scheme_signal_error ("hash-table-ref: key not found");
+  return (scheme_false);
+}
+
+static Scheme_Value
+hash_table_set (Scheme_Value table, Scheme_Value key, Scheme_Value val)
+{
+  Table *t;
+
+  t = check_mutable (table, "hash-table-set!");
+  check_key (t, key, "hash-table-set!");
+  put (t, key, val);
+  return (val);
+}
+
+static Scheme_Value
+hash_table_delete (Scheme_Value table, Scheme_Value key)
+{
+  Table *t;
+  int i;
+
+  t = check_mutable (table, "hash-table-delete!");
+  check_key (t, key, "hash-table-delete!");
+  i = find (t, key);
+  if (i < 0)
+    {
+      return (scheme_false);
+    }
+  KEY (t, i) = NULL;
+  t->vals[i] = NULL;
+  t->count--;
+  return (scheme_true);
+}
+
+/* (hash-table-update! table key proc [default]) sets KEY to PROC
+   applied to its value, or to DEFAULT if it has none. */
+static Scheme_Value
+hash_table_update (int argc, Scheme_Value argv[])
+{
+  Scheme_Value val;
+  Table *t;
+  int i;
+
+  t = check_mutable (argv[0], "hash-table-update!");
+  check_key (t, argv[1], "hash-table-update!");
+  SCHEME_ASSERT (SCHEME_PROCP (argv[2]), "hash-table-update!: third arg must be a procedure");
+  i = find (t, argv[1]);
+  if (i >= 0)
+    {
+      val = t->vals[i];
+    }
+  else if (argc == 4)
+    {
+      val = argv[3];
+    }
+  else
+    {
+      scheme_signal_error ("hash-table-update!: key not found");
+      return (scheme_false);
+    }
+  /* the procedure may change the table, so the key is looked up again */
+  val = scheme_apply (argv[2], 1, &val);
+  put (t, argv[1], val);
+  return (val);
+}
+
+static Scheme_Value
+hash_table_count (Scheme_Value table)
+{
+  return (scheme_make_integer (check_table (table, "hash-table-count")->count));
+}
+
+/* (hash-table-fold table proc init) calls (proc key value acc) on
+   each entry */
+static Scheme_Value
+hash_table_fold (Scheme_Value table, Scheme_Value proc, Scheme_Value init)
+{
+  Scheme_Value args[3];
+  Table *t;
+  int i;
+
+  t = check_table (table, "hash-table-fold");
+  SCHEME_ASSERT (SCHEME_PROCP (proc), "hash-table-fold: second arg must be a procedure");
+  args[2] = init;
+  /* PROC may change the table, so its arrays are read again each time */
+  for ( i=0 ; i<t->size ; ++i )
+    {
+      if (KEY (t, i))
+	{
+	  args[0] = KEY (t, i);
+	  args[1] = t->vals[i];
+	  args[2] = scheme_apply (proc, 3, args);
+	}
+    }
+  return (args[2]);
+}
+
+static Scheme_Value
+hash_table_keys (Scheme_Value table)
+{
+  Scheme_Value list;
+  Table *t;
+  int i;
+
+  t = check_table (table, "hash-table-keys");
+  list = scheme_null;
+  for ( i=t->size-1 ; i>=0 ; --i )
+    {
+      if (KEY (t, i))
+	{
+	  list = scheme_make_pair (KEY (t, i), list);
+	}
+    }
+  return (list);
+}
+
+static Scheme_Value
+hash_table_values (Scheme_Value table)
+{
+  Scheme_Value list;
+  Table *t;
+  int i;
+
+  t = check_table (table, "hash-table-values");
+  list = scheme_null;
+  for ( i=t->size-1 ; i>=0 ; --i )
+    {
+      if (KEY (t, i))
+	{
+	  list = scheme_make_pair (t->vals[i], list);
+	}
+    }
+  return (list);
+}
+
+/* (equal-hash obj) is a non-negative integer, the same for objects
+   that are equal?, that changes only when OBJ is changed or moved */
+static Scheme_Value
+equal_hash (Scheme_Value obj)
+{
+  int by_address = 0;
+
+  return (scheme_make_integer ((int) (scheme_equal_hash (obj, &by_address) >> 1)));
+}
@@ -22,32 +22,91 @@
   MODIFICATIONS.
 */
 
-#include "scheme.h"
+#include "scheme_private.h"
 #include <string.h>
 
+/* The builtin types and the table that holds them until the first
+   type is made at run time are static. */
+static Scheme_Object builtin_types[SCHEME_NUM_BUILTIN_TYPES];
+static Scheme_Value builtin_table[SCHEME_NUM_BUILTIN_TYPES];
+
 Scheme_Value scheme_type_type;
+Scheme_Value *scheme_type_table = builtin_table;
+int scheme_num_types = SCHEME_NUM_BUILTIN_TYPES;
+
+static int type_table_size = SCHEME_NUM_BUILTIN_TYPES;
+SCHEME_DEFINE_LOCK (type_lock);
+
+static void grow_type_table (void);
 
 void
 scheme_init_type (Scheme_Env *env)
 {
-  scheme_type_type = scheme_make_type ("<type>");
-  SCHEME_TYPE (scheme_type_type) = scheme_type_type;
+  scheme_type_type = scheme_make_builtin_type ("<type>", SCHEME_TYPE_TYPE_INDEX);
   scheme_add_global ("<type>", scheme_type_type, env);
 }
 
 Scheme_Value
 scheme_make_type (const char *name)
+{
+  Scheme_Value type;
+
+  /* the old table is left to the collector, since other threads may
+     still be reading it */
+  SCHEME_LOCK (type_lock);
+  if (scheme_num_types == type_table_size)
+    {
+      grow_type_table ();
+    }
+  type = scheme_make_builtin_type (name, scheme_num_types);
+  scheme_num_types++;
+  SCHEME_UNLOCK (type_lock);
+  return (type);
+}
+
+/* Make a type with a fixed INDEX in scheme_type_table, so that the
+   builtin type predicates can compare against a constant.  The types
+   below SCHEME_NUM_BUILTIN_TYPES are static and keep NAME itself. */
+Scheme_Value
+scheme_make_builtin_type (const char *name, int index)
 {
   Scheme_Value type;
   size_t len = strlen(name);
   char *new;
 
-  type = scheme_alloc_object (scheme_type_type, len + 1);
-  new = SCHEME_PTR_VAL(type);
+  if (index < SCHEME_NUM_BUILTIN_TYPES)
+    {
+      type = &builtin_types[index];
+      SCHEME_STR_VAL(type) = (char *) name;
+      SCHEME_TYPE_NUM(type) = index;
+      SCHEME_SET_TYPE (type, index == SCHEME_TYPE_TYPE_INDEX ? type : scheme_type_type);
+      scheme_type_table[index] = type;
+      return (type);
+    }
+  type = (Scheme_Value) scheme_malloc (SCHEME_OBJ_SIZE (type_val) + len + 1);
+  new = SCHEME_OBJ_PAYLOAD (type, type_val);
   if(len > 0) {
     memcpy(new, name, len);
   }
   new[len] = 0;
   SCHEME_STR_VAL(type) = new;
+  SCHEME_TYPE_NUM(type) = index;
+  scheme_type_table[index] = type;
+  SCHEME_SET_TYPE (type, index == SCHEME_TYPE_TYPE_INDEX ? type : scheme_type_type);
   return (type);
 }
+
+/* locals */
+
+static void
+grow_type_table (void)
+{
+  Scheme_Value *table;
+  int size;
+
+  size = 2 * type_table_size;
+  table = (Scheme_Value *) scheme_calloc (size, sizeof (Scheme_Value));
+  memcpy (table, scheme_type_table, type_table_size * sizeof (Scheme_Value));
+  scheme_type_table = table;
+  type_table_size = size;
+}
@@ -28,34 +28,39 @@
 Scheme_Value scheme_vector_type;
 
 /* primitive declarations */
-static Scheme_Value vector_p (int argc, Scheme_Value argv[]);
+static Scheme_Value vector_p (Scheme_Value obj);
 static Scheme_Value make_vector (int argc, Scheme_Value argv[]);
 static Scheme_Value vector (int argc, Scheme_Value argv[]);
-static Scheme_Value vector_length (int argc, Scheme_Value argv[]);
-static Scheme_Value vector_ref (int argc, Scheme_Value argv[]);
-static Scheme_Value vector_set (int argc, Scheme_Value argv[]);
+static Scheme_Value vector_length (Scheme_Value vec);
+static Scheme_Value vector_ref (Scheme_Value vec, Scheme_Value index);
+static Scheme_Value vector_set (Scheme_Value vec, Scheme_Value index, Scheme_Value val);
 static Scheme_Value vector_to_list (int argc, Scheme_Value argv[]);
 static Scheme_Value list_to_vector (int argc, Scheme_Value argv[]);
 static Scheme_Value vector_fill (int argc, Scheme_Value argv[]);
 static Scheme_Value vector_append (int argc, Scheme_Value argv[]);
 
+static const Scheme_Prim_Entry vector_prims[] =
+{
+  SCHEME_PRIM1_ENTRY ("vector?", vector_p),
+  SCHEME_PRIM_ENTRY ("make-vector", make_vector, 0, -1),
+  SCHEME_PRIM_ENTRY ("vector", vector, 0, -1),
+  SCHEME_PRIM1_ENTRY ("vector-length", vector_length),
+  SCHEME_PRIM2_ENTRY ("vector-ref", vector_ref),
+  SCHEME_PRIM3_ENTRY ("vector-set!", vector_set),
+  SCHEME_PRIM_ENTRY ("vector->list", vector_to_list, 0, -1),
+  SCHEME_PRIM_ENTRY ("list->vector", list_to_vector, 0, -1),
+  SCHEME_PRIM_ENTRY ("vector-fill!", vector_fill, 0, -1),
+  SCHEME_PRIM_ENTRY ("vector-append", vector_append, 0, -1)
+};
+
 /* exported functions */
 
 void
 scheme_init_vector (Scheme_Env *env)
 {
-  scheme_vector_type = scheme_make_type ("<vector>");
+  scheme_vector_type = scheme_make_builtin_type ("<vector>", SCHEME_VECTOR_TYPE_INDEX);
   scheme_add_global ("<vector>", scheme_vector_type, env);
-  scheme_add_prim ("vector?", vector_p, env);
-  scheme_add_prim ("make-vector", make_vector, env);
-  scheme_add_prim ("vector", vector, env);
-  scheme_add_prim ("vector-length", vector_length, env);
-  scheme_add_prim ("vector-ref", vector_ref, env);
-  scheme_add_prim ("vector-set!", vector_set, env);
-  scheme_add_prim ("vector->list", vector_to_list, env);
-  scheme_add_prim ("list->vector", list_to_vector, env);
-  scheme_add_prim ("vector-fill!", vector_fill, env);
-  scheme_add_prim ("vector-append", vector_append, env);
+  scheme_add_prims (vector_prims, SCHEME_NUM_ENTRIES (vector_prims), env);
 }
 
 Scheme_Value
@@ -63,12 +68,11 @@ scheme_make_vector (int size, Scheme_Value fill)
 {
   int i;
   Scheme_Value vec, *els;
-  size_t nbytes = sizeof(Scheme_Object) + sizeof(Scheme_Object*) * size;
+  size_t nbytes = SCHEME_OBJ_SIZE (vector_val) + sizeof(Scheme_Object*) * size;
 
-  vec = (Scheme_Value)scheme_malloc(nbytes);
-  els = (Scheme_Value *)(&vec[1]);
+  vec = scheme_alloc_sized (scheme_vector_type, nbytes);
+  els = (Scheme_Value *) SCHEME_OBJ_PAYLOAD (vec, vector_val);
 
-  SCHEME_TYPE(vec) = scheme_vector_type;
   SCHEME_VEC_SIZE(vec) = size;
   SCHEME_VEC_ELS(vec) = els;
 
@@ -124,10 +128,9 @@ scheme_vector_to_list (Scheme_Value vec)
 /* primitive functions */
 
 static Scheme_Value
-vector_p (int argc, Scheme_Value argv[])
+vector_p (Scheme_Value obj)
 {
-  SCHEME_ASSERT ((argc == 1), "vector?: wrong number of args");
-  return (SCHEME_VECTORP(argv[0]) ? scheme_true : scheme_false);
+  return (SCHEME_VECTORP(obj) ? scheme_true : scheme_false);
 }
 
 static Scheme_Value
@@ -166,40 +169,39 @@ vector (int argc, Scheme_Value argv[])
 }
 
 static Scheme_Value
-vector_length (int argc, Scheme_Value argv[])
+vector_length (Scheme_Value vec)
 {
-  SCHEME_ASSERT ((argc == 1), "vector-length: wrong number of args");
-  SCHEME_ASSERT (SCHEME_VECTORP (argv[0]), "vector-length: arg must be a vector");
-  return (scheme_make_integer (SCHEME_VEC_SIZE (argv[0])));
+  SCHEME_ASSERT (SCHEME_VECTORP (vec), "vector-length: arg must be a vector");
+  return (scheme_make_integer (SCHEME_VEC_SIZE (vec)));
 }
 
 static Scheme_Value
-vector_ref (int argc, Scheme_Value argv[])
+vector_ref (Scheme_Value vec, Scheme_Value index)
 {
   int i;
 
-  SCHEME_ASSERT ((argc == 2), "vector-ref: wrong number of args");
-  SCHEME_ASSERT (SCHEME_VECTORP (argv[0]), "vector-ref: first arg must be a vector");
-  SCHEME_ASSERT (SCHEME_INTP (argv[1]), "vector-ref: second arg must be an integer");
-  i = SCHEME_INT_VAL (argv[1]);
-  SCHEME_ASSERT ((i >= 0) && (i < SCHEME_VEC_SIZE (argv[0])),
+  SCHEME_ASSERT (SCHEME_VECTORP (vec), "vector-ref: first arg must be a vector");
+  SCHEME_ASSERT (SCHEME_INTP (index), "vector-ref: second arg must be an integer");
+  i = SCHEME_INT_VAL (index);
+  SCHEME_ASSERT ((i >= 0) && (i < SCHEME_VEC_SIZE (vec)),
 		 "vector-ref: index out of range");
-  return (SCHEME_VEC_ELS(argv[0])[i]);
+  return (SCHEME_VEC_ELS(vec)[i]);
 }
 
 static Scheme_Value
-vector_set (int argc, Scheme_Value argv[])
+vector_set (Scheme_Value vec, Scheme_Value index, Scheme_Value val)
 {
   int i;
 
-  SCHEME_ASSERT ((argc == 3), "vector-set!: wrong number of args");
-  SCHEME_ASSERT (SCHEME_VECTORP (argv[0]), "vector-set!: first arg must be a vector");
-  SCHEME_ASSERT (SCHEME_INTP (argv[1]), "vector-set!: second arg must be an integer");
-  i = SCHEME_INT_VAL (argv[1]);
-  SCHEME_ASSERT ((i >= 0) && (i < SCHEME_VEC_SIZE (argv[0])),
+  SCHEME_ASSERT (SCHEME_VECTORP (vec), "vector-set!: first arg must be a vector");
+  SCHEME_ASSERT (! SCHEME_FROZENP (vec), "vector-set!: vector is frozen");
+  SCHEME_ASSERT (SCHEME_INTP (index), "vector-set!: second arg must be an integer");
+  i = SCHEME_INT_VAL (index);
+  SCHEME_ASSERT ((i >= 0) && (i < SCHEME_VEC_SIZE (vec)),
                  "vector-ref: index out of range");
-  SCHEME_VEC_ELS(argv[0])[i] = argv[2];
-  return (argv[0]);
+  SCHEME_VEC_ELS(vec)[i] = val;
+  SCHEME_GC_WRITE (&SCHEME_VEC_ELS(vec)[i]);
+  return (vec);
 }
 
 static Scheme_Value
@@ -225,9 +227,11 @@ vector_fill (int argc, Scheme_Value argv[])
 
   SCHEME_ASSERT ((argc == 2), "vector-fill!: wrong number of args");
   SCHEME_ASSERT (SCHEME_VECTORP (argv[0]), "vector-fill!: first arg must be a vector");
+  SCHEME_ASSERT (! SCHEME_FROZENP (argv[0]), "vector-fill!: vector is frozen");
   for ( i=0 ; i<SCHEME_VEC_SIZE (argv[0]) ; ++i )
     {
       SCHEME_VEC_ELS(argv[0])[i] = argv[1];
+      SCHEME_GC_WRITE (&SCHEME_VEC_ELS(argv[0])[i]);
     }
   return (argv[0]);
 }
@@ -883,6 +883,340 @@
   (test write-test-obj 'load foo)
   (report-errs))
 
+;;; libscheme extensions.  Each (test-...) below covers one; the
+;;; definitions they need are made through eval so they happen when
+;;; the test is run.
+
+(define (test-tail-calls)
+  (newline)
+  (display ";testing tail calls; ")
+  (SECTION 'tail 'calls)
+  ;; each loop runs a million times in constant stack, in the tree
+  ;; evaluator through eval and in the bytecode machine through compile
+  (for-each
+   (lambda (form)
+     (test 'done eval form)
+     (test 'done eval (compile form)))
+   '((let loop ((i 0)) (if (= i 1000000) 'done (loop (+ i 1))))
+     (letrec ((f (lambda (i) (cond ((= i 1000000) 'done) (else (f (+ i 1)))))))
+       (f 0))
+     (letrec ((f (lambda (i)
+		   (case (if (= i 1000000) 'stop 'go)
+		     ((stop) 'done)
+		     (else (f (+ i 1)))))))
+       (f 0))
+     (letrec ((f (lambda (i) (or (and (= i 1000000) 'done) (and #t (f (+ i 1)))))))
+       (f 0))
+     (letrec ((f (lambda (i) (if (= i 1000000) 'done (let ((j (+ i 1))) (f j))))))
+       (f 0))
+     (letrec ((f (lambda (i) (if (= i 1000000) 'done (let* ((j i) (k (+ j 1))) (f k))))))
+       (f 0))
+     (letrec ((f (lambda (i) (if (= i 1000000) 'done (begin (+ i 1) (f (+ i 1)))))))
+       (f 0))
+     (letrec ((f (lambda (i) (define j (+ i 1)) (if (= j 1000001) 'done (f j)))))
+       (f 0))
+     (letrec ((even (lambda (i) (if (= i 1000000) 'done (odd (+ i 1)))))
+	      (odd (lambda (i) (even (+ i 1)))))
+       (even 0))
+     (letrec ((f (lambda (i) (if (= i 1000000) 'done (apply f (list (+ i 1)))))))
+       (f 0))
+     (do ((i 0 (+ i 1))) ((= i 1000000) 'done))))
+  (report-errs))
+
+(define (test-late-syntax)
+  (newline)
+  (display ";testing syntax defined after use; ")
+  (SECTION 'late 'syntax)
+  (eval '(define (late-set x) (late-assign x) x))
+  (eval '(define (late-let-set x) (let ((y 2)) (late-assign y) (+ x y))))
+  (eval '(defmacro late-assign (v) (list 'set! v 99)))
+  (test 99 late-set 1)
+  (test 100 late-let-set 1)
+  (report-errs))
+
+(define (test-modules)
+  (newline)
+  (display ";testing module environments; ")
+  (SECTION 'module 'environments)
+  (eval '(define module-x 11))
+  (eval '(define module-env (make-environment)))
+  (eval '(define (module-get-x) module-x) module-env)
+  (test 11 eval '(module-get-x) module-env)
+  (test 11 eval 'module-x module-env)
+  ;; the base's globals are shared until the module binds its own
+  (eval '(set! module-x 12))
+  (test 12 eval '(module-get-x) module-env)
+  (test 12 eval 'module-x module-env)
+  (eval '(set! module-x 5) module-env)
+  (test 5 eval '(module-get-x) module-env)
+  (test 5 eval 'module-x module-env)
+  (test 12 eval 'module-x)
+  (eval '(define module-y 1))
+  (eval '(define (module-get-y) module-y) module-env)
+  (eval '(define module-y 2) module-env)
+  (test 2 eval '(module-get-y) module-env)
+  (test 1 eval 'module-y)
+  (eval '(define (module-get-z) module-z) module-env)
+  (eval '(define module-z 3))
+  (test 3 eval '(module-get-z) module-env)
+  ;; an import shares the exporter's binding
+  (eval '(define module-env2 (make-environment)))
+  (eval '(define module-count 1) module-env)
+  (environment-import! module-env2 module-env 'module-count)
+  (eval '(set! module-count 2) module-env2)
+  (test 2 eval 'module-count module-env)
+  (test #t environment? module-env)
+  (report-errs))
+
+(define (test-clones)
+  (newline)
+  (display ";testing cloned environments; ")
+  (SECTION 'clone 'environments)
+  (eval '(define clone-count 0))
+  (eval '(define (clone-bump) (set! clone-count (+ clone-count 1)) clone-count))
+  (eval '(define (clone-helper) 'base))
+  (eval '(define (clone-call) (clone-helper)))
+  (eval '(define clone-1 (clone-environment)))
+  (eval '(define clone-2 (clone-environment)))
+  ;; procedures of the base work on its globals, which clones share
+  (test 1 eval '(clone-bump) clone-1)
+  (test 2 eval '(clone-bump) clone-2)
+  (test 2 eval 'clone-count)
+  ;; code in a clone changes only the clone
+  (eval '(set! clone-count 10) clone-1)
+  (test 10 eval 'clone-count clone-1)
+  (test 2 eval 'clone-count clone-2)
+  (test 2 eval 'clone-count)
+  (eval '(define clone-new 1) clone-1)
+  (eval '(define clone-new 2) clone-2)
+  (test 1 eval 'clone-new clone-1)
+  (test 2 eval 'clone-new clone-2)
+  ;; and is not seen by the base's procedures
+  (eval '(define (clone-helper) 'clone) clone-1)
+  (test 'clone eval '(clone-helper) clone-1)
+  (test 'base eval '(clone-call) clone-1)
+  (report-errs))
+
+(define (test-freeze)
+  (newline)
+  (display ";testing frozen data; ")
+  (SECTION 'frozen 'data)
+  (eval '(define frozen-data (list 1 (vector 2 "three") (make-string 2 #\a))))
+  (test #f frozen? frozen-data)
+  (test #t frozen? 'sym)
+  (test #t frozen? 1)
+  (test #t frozen? #\a)
+  (test '(1 #(2 "three") "aa") freeze! frozen-data)
+  (test #t frozen? frozen-data)
+  (test #t frozen? (cadr frozen-data))
+  (test #t frozen? (vector-ref (cadr frozen-data) 1))
+  (test #t frozen? (caddr frozen-data))
+  ;; a closure is frozen with the variables it captures
+  (eval '(define frozen-proc (let ((n (list 1))) (lambda () n))))
+  (test #f frozen? frozen-proc)
+  (freeze! frozen-proc)
+  (test #t frozen? frozen-proc)
+  (test #t frozen? (frozen-proc))
+  ;; quoted constants are frozen, copies of them are not
+  (test #t frozen? '(a b))
+  (test #t frozen? (vector-ref '#("abc") 0))
+  (test #f frozen? (string-copy (vector-ref '#("abc") 0)))
+  ;; data quoted by a form built at run time still belongs to its caller
+  (eval '(define quoted-data (list 1 (vector 2) (make-string 1 #\a))))
+  (test #t eq? quoted-data (eval (list 'quote quoted-data)))
+  (test #f frozen? quoted-data)
+  (test #f frozen? (cadr quoted-data))
+  (test #f frozen? (caddr quoted-data))
+  (set-car! quoted-data 5)
+  (vector-set! (cadr quoted-data) 0 6)
+  (string-set! (caddr quoted-data) 0 #\b)
+  (test '(5 #(6) "b") eval (list 'quote quoted-data))
+  (test '(5 #(6) "b") eval (compile (list 'quote quoted-data)))
+  (report-errs))
+
+(define (test-parallel)
+  (newline)
+  (display ";testing parallel procedures; ")
+  (SECTION 'parallel 'procedures)
+  (eval '(define parallel-list
+	   (let loop ((i 200) (l '())) (if (= i 0) l (loop (- i 1) (cons i l))))))
+  (eval '(define (parallel-square x) (* x x)))
+  (test '(1 4 9) parallel-map parallel-square '(1 2 3))
+  (test '#(1 4 9) parallel-map parallel-square '#(1 2 3))
+  (test '() parallel-map parallel-square '())
+  (test (map parallel-square parallel-list) parallel-map parallel-square parallel-list)
+  (test (list->vector (map parallel-square parallel-list))
+	parallel-map parallel-square (list->vector parallel-list))
+  (test 20100 parallel-reduce + 0 parallel-list)
+  (test 20100 parallel-reduce + 0 (list->vector parallel-list))
+  (test 7 parallel-reduce + 7 '())
+  ;; runs are folded in order
+  (test parallel-list parallel-reduce append '() (map list parallel-list))
+  (eval '(define parallel-seen (make-vector 201 #f)))
+  (parallel-for-each (lambda (i) (vector-set! parallel-seen i #t)) parallel-list)
+  (test #t 'parallel-for-each
+	(let loop ((i 1))
+	  (or (> i 200) (and (vector-ref parallel-seen i) (loop (+ i 1))))))
+  (test #f vector-ref parallel-seen 0)
+  (report-errs))
+
+(define (test-futures)
+  (newline)
+  (display ";testing futures; ")
+  (SECTION 'futures)
+  (eval '(define future-1 (future (* 6 7))))
+  (test #t future? future-1)
+  (test #f future? 42)
+  (test #f future? (delay 42))
+  (test 42 touch future-1)
+  (test 42 touch future-1)
+  (test 42 force future-1)
+  (test 5 touch 5)
+  ;; a future sees the variables around it
+  (eval '(define (future-sum n)
+	   (let ((a (future (* n 2)))
+		 (b (future (+ n 1))))
+	     (+ (touch a) (touch b)))))
+  (test 31 future-sum 10)
+  ;; an error is kept until the future is touched
+  (eval '(define future-bad (future (car '()))))
+  (test #t future? future-bad)
+  (report-errs))
+
+(define (test-channels)
+  (newline)
+  (display ";testing channels; ")
+  (SECTION 'channels)
+  (eval '(define chan (make-channel)))
+  (test #t channel? chan)
+  (test #f channel? '())
+  (channel-send chan 1)
+  (channel-send chan 'two)
+  (channel-send chan "three")
+  (test 1 channel-receive chan)
+  (test 'two channel-try-receive chan)
+  (test "three" channel-receive chan)
+  (test #f channel-try-receive chan)
+  (test 'none channel-try-receive chan 'none)
+  ;; mutable messages are copied, frozen ones handed over as they are
+  (eval '(define chan-msg (list 1 (vector 2))))
+  (channel-send chan chan-msg)
+  (test #f eq? chan-msg (channel-receive chan))
+  (freeze! chan-msg)
+  (channel-send chan chan-msg)
+  (test #t eq? chan-msg (channel-receive chan))
+  (test #t 'fifo
+	(begin
+	  (let loop ((i 0))
+	    (if (< i 100) (begin (channel-send chan i) (loop (+ i 1)))))
+	  (let loop ((i 0))
+	    (or (= i 100) (and (= i (channel-receive chan)) (loop (+ i 1)))))))
+  (eval '(define chan-2 (make-channel 2)))
+  (channel-send chan-2 'a)
+  (channel-send chan-2 'b)
+  (test 'a channel-receive chan-2)
+  ;; spawn runs a thunk in a clone of the environment
+  (eval '(define spawn-x 5))
+  (eval '(define spawned
+	   (spawn (lambda ()
+		    (eval '(define spawn-x 6))
+		    (let loop ((i 0))
+		      (if (< i 10) (begin (channel-send chan i) (loop (+ i 1)))))
+		    (* spawn-x 7)))))
+  (test #t future? spawned)
+  (test 42 touch spawned)
+  (test 45 'spawn-messages
+	(let loop ((i 0) (sum 0))
+	  (if (= i 10) sum (loop (+ i 1) (+ sum (channel-receive chan))))))
+  (test 5 eval 'spawn-x)
+  ;; the thunk's own assignments go to the clone and to copies of the
+  ;; variables it captured
+  (eval '(define spawn-y 1))
+  (test 12 touch (let ((k 10))
+		   (spawn (lambda ()
+			    (set! spawn-y (+ spawn-y 1))
+			    (set! k (+ k spawn-y))
+			    k))))
+  (test 1 eval 'spawn-y)
+  (report-errs))
+
+(define (test-image)
+  (newline)
+  (display ";testing heap images; ")
+  (SECTION 'heap 'images)
+  (eval '(define image-env (make-environment)))
+  (eval '(define (image-square x) (* x x)) image-env)
+  (eval '(define image-data (list 1 "two" 'three 4.5 (vector 5 #\6)))
+	image-env)
+  ;; the eq and eqv tables are keyed by objects whose addresses change
+  (eval '(define image-eq (make-eq-hash-table)) image-env)
+  (eval '(define image-eqv (make-eqv-hash-table)) image-env)
+  (eval '(define image-equal (make-equal-hash-table)) image-env)
+  (eval '(begin (hash-table-set! image-eq image-data 'data)
+		(hash-table-set! image-eq 'sym 1)
+		(hash-table-set! image-eqv (cdr image-data) 'rest)
+		(hash-table-set! image-eqv 4.5 'real)
+		(hash-table-set! image-equal (list "k" 2) 'list))
+	image-env)
+  (test #t save-image "tmp4" image-env)
+  (eval '(define image-loaded (make-environment)))
+  (test #t load-image "tmp4" image-loaded)
+  (test 49 eval '(image-square 7) image-loaded)
+  (test '(1 "two" three 4.5 #(5 #\6)) eval 'image-data image-loaded)
+  (test 'data eval '(hash-table-ref image-eq image-data #f) image-loaded)
+  (test 1 eval '(hash-table-ref image-eq 'sym #f) image-loaded)
+  (test 'rest eval '(hash-table-ref image-eqv (cdr image-data) #f) image-loaded)
+  (test 'real eval '(hash-table-ref image-eqv 4.5 #f) image-loaded)
+  (test 'list eval '(hash-table-ref image-equal (list "k" 2) #f) image-loaded)
+  (test 2 eval '(hash-table-count image-eq) image-loaded)
+  (report-errs))
+
+(define (test-tables)
+  (newline)
+  (display ";testing hash tables; ")
+  (SECTION 'hash 'tables)
+  (eval '(define table-eq (make-eq-hash-table)))
+  (eval '(define table-equal (make-equal-hash-table 4)))
+  (eval '(define table-string (make-string-hash-table)))
+  (test #t hash-table? table-eq)
+  (test #f hash-table? '())
+  (hash-table-set! table-eq 'a 1)
+  (hash-table-set! table-eq 'b 2)
+  (test 1 hash-table-ref table-eq 'a)
+  (test 'none hash-table-ref table-eq 'c 'none)
+  (test 2 hash-table-count table-eq)
+  (test 12 hash-table-update! table-eq 'b (lambda (v) (* v 6)))
+  (test 5 hash-table-update! table-eq 'c (lambda (v) (+ v 1)) 4)
+  (test #t hash-table-delete! table-eq 'a)
+  (test #f hash-table-delete! table-eq 'a)
+  (test 17 hash-table-fold table-eq (lambda (k v acc) (+ v acc)) 0)
+  (test 2 length (hash-table-keys table-eq))
+  (test 17 apply + (hash-table-values table-eq))
+  (hash-table-set! table-equal (list 1 "two" #(3)) 'list)
+  (test 'list hash-table-ref table-equal (list 1 "two" #(3)))
+  (test #t = (equal-hash (list 1 "two")) (equal-hash (list 1 "two")))
+  (hash-table-set! table-string (string #\k) 'k)
+  (test 'k hash-table-ref table-string "k")
+  (freeze! table-equal)
+  (test 'list hash-table-ref table-equal (list 1 "two" #(3)))
+  ;; keys hashed by address must still be found after collections
+  ;; have moved them
+  (eval '(define table-keys
+	   (let loop ((i 0) (keys '()))
+	     (if (= i 20000) keys (loop (+ i 1) (cons (list i) keys))))))
+  (eval '(define table-pairs (make-eq-hash-table)))
+  (for-each (lambda (k) (hash-table-set! table-pairs k (car k))) table-keys)
+  (let loop ((i 0))
+    (if (< i 20000)
+	(begin (make-vector 100 i) (loop (+ i 1)))))
+  (test #t 'eq-keys
+	(let loop ((keys table-keys))
+	  (or (null? keys)
+	      (and (eqv? (car (car keys)) (hash-table-ref table-pairs (car keys) #f))
+		   (loop (cdr keys))))))
+  (test 20000 hash-table-count table-pairs)
+  (report-errs))
+
 (report-errs)
 (display "To fully test continuations, Scheme 4, and inexact numbers do:")
 (newline)